@@ -5,325 +5,796 @@ extern "C"
 
 #include "bq40z80.h"
 
-    BQ40Z80::BQ40Z80(uint8_t i2c_scl_io, uint8_t i2c_sda_io, i2c_port_t i2c_master_num, uint8_t device_address)
-    {
-        this->DEVICE_ADDRESS = device_address;
-        this->I2C_MASTER_NUM = i2c_master_num;
-
-        i2c_config_t conf;
-        conf.mode = I2C_MODE_MASTER;
-        conf.sda_io_num = i2c_sda_io;
-        conf.scl_io_num = i2c_scl_io;
-        conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
-        conf.scl_pullup_en = GPIO_PULLUP_ENABLE;
-        conf.master.clk_speed = I2C_MASTER_FREQ_HZ;
-        conf.clk_flags = I2C_SCLK_SRC_FLAG_FOR_NOMAL;
-
-        ESP_ERROR_CHECK(i2c_param_config(i2c_master_num, &conf));
-
-        ESP_ERROR_CHECK(i2c_driver_install(i2c_master_num, conf.mode, I2C_MASTER_RX_BUF_DISABLE, I2C_MASTER_TX_BUF_DISABLE, 0));
-    }
-
-    BQ40Z80::~BQ40Z80()
-    {
-        i2c_driver_delete(this->I2C_MASTER_NUM);
-    }
-
     /***************************** Public Functions *****************************/
     uint16_t BQ40Z80::get_battery_mode()
     {
         uint16_t buf;
-        ESP_ERROR_CHECK(this->smbus_read_word(BQ40Z80_SBS_BatteryMode, &buf));
+        ESP_ERROR_CHECK(this->try_get_battery_mode(&buf));
         return buf;
     }
 
     void BQ40Z80::set_battery_mode(u_int16_t val)
     {
-        ESP_ERROR_CHECK(this->smbus_write_word(BQ40Z80_SBS_BatteryMode, val));
+        ESP_ERROR_CHECK(this->try_set_battery_mode(val));
         // this->update_basic_info();
     }
 
-    uint16_t BQ40Z80::get_temperature()
+    int16_t BQ40Z80::get_temperature()
     {
-        uint16_t buf;
-        ESP_ERROR_CHECK(this->smbus_read_word(BQ40Z80_SBS_Current, &buf));
-        return buf - 2732; // raw data unit: 0.1 Kelvin
+        int16_t buf;
+        ESP_ERROR_CHECK(this->try_get_temperature(&buf));
+        return buf;
     }
 
     uint16_t BQ40Z80::get_voltage()
     {
         uint16_t buf;
-        ESP_ERROR_CHECK(this->smbus_read_word(BQ40Z80_SBS_Voltage, &buf));
+        ESP_ERROR_CHECK(this->try_get_voltage(&buf));
         return buf;
     }
 
-    uint16_t BQ40Z80::get_current()
+    int16_t BQ40Z80::get_current()
     {
-        uint16_t buf;
-        ESP_ERROR_CHECK(this->smbus_read_word(BQ40Z80_SBS_Current, &buf));
+        int16_t buf;
+        ESP_ERROR_CHECK(this->try_get_current(&buf));
         return buf;
     }
 
     uint8_t BQ40Z80::get_rsoc()
     {
-        uint16_t buf;
-        ESP_ERROR_CHECK(this->smbus_read_word(BQ40Z80_SBS_RelativeStateOfCharge, &buf));
+        uint8_t buf;
+        ESP_ERROR_CHECK(this->try_get_rsoc(&buf));
         return buf;
     }
 
     uint16_t BQ40Z80::get_remaining_capacity()
     {
         uint16_t buf;
-        ESP_ERROR_CHECK(this->smbus_read_word(BQ40Z80_SBS_RemainingCapacity, &buf));
+        ESP_ERROR_CHECK(this->try_get_remaining_capacity(&buf));
         return buf;
     }
 
     uint16_t BQ40Z80::get_full_charge_capacity()
     {
         uint16_t buf;
-        ESP_ERROR_CHECK(this->smbus_read_word(BQ40Z80_SBS_FullChargeCapacity, &buf));
+        ESP_ERROR_CHECK(this->try_get_full_charge_capacity(&buf));
         return buf;
     }
 
     uint16_t BQ40Z80::get_average_time_to_empty()
     {
         uint16_t buf;
-        ESP_ERROR_CHECK(this->smbus_read_word(BQ40Z80_SBS_AverageTimeToEmpty, &buf));
+        ESP_ERROR_CHECK(this->try_get_average_time_to_empty(&buf));
         return buf;
     }
 
     uint16_t BQ40Z80::get_average_time_to_full()
     {
         uint16_t buf;
-        ESP_ERROR_CHECK(this->smbus_read_word(BQ40Z80_SBS_AverageTimeToFull, &buf));
+        ESP_ERROR_CHECK(this->try_get_average_time_to_full(&buf));
         return buf;
     }
 
     uint16_t BQ40Z80::get_cycle_count()
     {
         uint16_t buf;
-        ESP_ERROR_CHECK(this->smbus_read_word(BQ40Z80_SBS_CycleCount, &buf));
+        ESP_ERROR_CHECK(this->try_get_cycle_count(&buf));
         return buf;
     }
 
     uint16_t BQ40Z80::get_design_capacity()
     {
         uint16_t buf;
-        ESP_ERROR_CHECK(this->smbus_read_word(BQ40Z80_SBS_DesignCapacity, &buf));
+        ESP_ERROR_CHECK(this->try_get_design_capacity(&buf));
         return buf;
     }
 
     uint16_t BQ40Z80::get_design_voltage()
     {
         uint16_t buf;
-        ESP_ERROR_CHECK(this->smbus_read_word(BQ40Z80_SBS_DesignVoltage, &buf));
+        ESP_ERROR_CHECK(this->try_get_design_voltage(&buf));
         return buf;
     }
 
     uint16_t BQ40Z80::get_cell_voltage(uint8_t cell)
+    {
+        uint16_t buf;
+        ESP_ERROR_CHECK(this->try_get_cell_voltage(cell, &buf));
+        return buf;
+    }
+
+    void BQ40Z80::set_capm(bool val)
+    {
+        ESP_ERROR_CHECK(this->try_set_capm(val));
+    }
+
+    void BQ40Z80::read_da_status_1(DA_STATUS_1 *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_da_status_1(data));
+    }
+
+    void BQ40Z80::read_da_status_3(DA_STATUS_3 *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_da_status_3(data));
+    }
+
+    void BQ40Z80::read_operation_status(OPERATION_STATUS *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_operation_status(data));
+    }
+
+    void BQ40Z80::read_safety_alert(SAFETY_STATUS *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_safety_alert(data));
+    }
+
+    void BQ40Z80::read_safety_status(SAFETY_STATUS *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_safety_status(data));
+    }
+
+    void BQ40Z80::read_pf_alert(PF_STATUS *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_pf_alert(data));
+    }
+
+    void BQ40Z80::read_pf_status(PF_STATUS *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_pf_status(data));
+    }
+
+    void BQ40Z80::read_charging_status(CHARGING_STATUS *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_charging_status(data));
+    }
+
+    void BQ40Z80::read_gauging_status(GAUGING_STATUS *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_gauging_status(data));
+    }
+
+    void BQ40Z80::read_manufacturing_status(MANUFACTURING_STATUS *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_manufacturing_status(data));
+    }
+
+    /***************************** Non-aborting Functions *****************************/
+
+    esp_err_t BQ40Z80::try_get_battery_mode(uint16_t *val, BQ40Z80_CALL *call)
+    {
+        return this->try_read<BQ40Z80_REG_BatteryMode>(val, call);
+    }
+
+    esp_err_t BQ40Z80::try_set_battery_mode(uint16_t val, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_CALL *outer = this->call_begin(call);
+        return this->call_end(outer, this->smbus_write_word(BQ40Z80_SBS_BatteryMode, val));
+    }
+
+    esp_err_t BQ40Z80::try_get_temperature(int16_t *val, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_TEMPERATURE buf;
+        esp_err_t err = this->try_read<BQ40Z80_REG_Temperature>(&buf, call);
+        if (err == ESP_OK)
+            *val = buf.dk - 2732; // raw data unit: 0.1 Kelvin
+        return err;
+    }
+
+    esp_err_t BQ40Z80::try_get_voltage(uint16_t *val, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_VOLTAGE buf;
+        esp_err_t err = this->try_read<BQ40Z80_REG_Voltage>(&buf, call);
+        if (err == ESP_OK)
+            *val = buf.mv;
+        return err;
+    }
+
+    esp_err_t BQ40Z80::try_get_current(int16_t *val, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_CURRENT buf;
+        esp_err_t err = this->try_read<BQ40Z80_REG_Current>(&buf, call);
+        if (err == ESP_OK)
+            *val = buf.ma;
+        return err;
+    }
+
+    esp_err_t BQ40Z80::try_get_rsoc(uint8_t *val, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_PERCENT buf;
+        esp_err_t err = this->try_read<BQ40Z80_REG_RelativeStateOfCharge>(&buf, call);
+        if (err == ESP_OK)
+            *val = buf.percent;
+        return err;
+    }
+
+    esp_err_t BQ40Z80::try_get_remaining_capacity(uint16_t *val, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_CAPACITY buf;
+        esp_err_t err = this->try_read<BQ40Z80_REG_RemainingCapacity>(&buf, call);
+        if (err == ESP_OK)
+            *val = buf.mah;
+        return err;
+    }
+
+    esp_err_t BQ40Z80::try_get_full_charge_capacity(uint16_t *val, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_CAPACITY buf;
+        esp_err_t err = this->try_read<BQ40Z80_REG_FullChargeCapacity>(&buf, call);
+        if (err == ESP_OK)
+            *val = buf.mah;
+        return err;
+    }
+
+    esp_err_t BQ40Z80::try_get_average_time_to_empty(uint16_t *val, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_MINUTES buf;
+        esp_err_t err = this->try_read<BQ40Z80_REG_AverageTimeToEmpty>(&buf, call);
+        if (err == ESP_OK)
+            *val = buf.min;
+        return err;
+    }
+
+    esp_err_t BQ40Z80::try_get_average_time_to_full(uint16_t *val, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_MINUTES buf;
+        esp_err_t err = this->try_read<BQ40Z80_REG_AverageTimeToFull>(&buf, call);
+        if (err == ESP_OK)
+            *val = buf.min;
+        return err;
+    }
+
+    esp_err_t BQ40Z80::try_get_cycle_count(uint16_t *val, BQ40Z80_CALL *call)
+    {
+        return this->try_read<BQ40Z80_REG_CycleCount>(val, call);
+    }
+
+    esp_err_t BQ40Z80::try_get_design_capacity(uint16_t *val, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_CAPACITY buf;
+        esp_err_t err = this->try_read<BQ40Z80_REG_DesignCapacity>(&buf, call);
+        if (err == ESP_OK)
+            *val = buf.mah;
+        return err;
+    }
+
+    esp_err_t BQ40Z80::try_get_design_voltage(uint16_t *val, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_VOLTAGE buf;
+        esp_err_t err = this->try_read<BQ40Z80_REG_DesignVoltage>(&buf, call);
+        if (err == ESP_OK)
+            *val = buf.mv;
+        return err;
+    }
+
+    esp_err_t BQ40Z80::try_get_cell_voltage(uint8_t cell, uint16_t *val, BQ40Z80_CALL *call)
     {
         assert(1 <= cell && cell <= 7); //!< range check
 
-        if (cell <= 4)
-        {
-            DA_STATUS_1 da_status_1_data;
-            this->read_da_status_1(&da_status_1_data);
-            switch (cell)
-            {
-            case 1:
-                return da_status_1_data.cell_voltage_1;
-                break;
-            case 2:
-                return da_status_1_data.cell_voltage_2;
-                break;
-            case 3:
-                return da_status_1_data.cell_voltage_3;
-                break;
-            case 4:
-                return da_status_1_data.cell_voltage_4;
-            default:
-                break;
-            }
-        }
-        else
-        {
-            DA_STATUS_3 da_status_3_data;
-            this->read_da_status_3(&da_status_3_data);
-            switch (cell)
-            {
-            case 5:
-                return da_status_3_data.cell_voltage_5;
-                break;
-            case 6:
-                return da_status_3_data.cell_voltage_6;
-                break;
-            case 7:
-                return da_status_3_data.cell_voltage_7;
-                break;
-            default:
-                break;
-            }
-        }
-        return 0;
+        BQ40Z80_CALL *outer = this->call_begin(call);
+
+        // cells 4..7 have their own SBS word, which is far cheaper than a DAStatus block
+        BQ40Z80_TELEMETRY data;
+        esp_err_t err = this->try_read_fields(BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_CELL_VOLTAGE_1 + cell - 1), &data);
+        if (err == ESP_OK)
+            *val = data.cell_voltage[cell - 1];
+        return this->call_end(outer, err);
     }
 
-    void BQ40Z80::set_capm(bool val)
+    esp_err_t BQ40Z80::try_set_capm(bool val, BQ40Z80_CALL *call)
     {
-        uint16_t buf = this->get_battery_mode();
+        BQ40Z80_CALL *outer = this->call_begin(call);
+
+        uint16_t buf;
+        esp_err_t err = this->try_get_battery_mode(&buf);
+        if (err != ESP_OK)
+            return this->call_end(outer, err);
+
         if (val)
             buf |= 0x8000;
         else
             buf &= 0x7fff;
-        this->set_battery_mode(buf);
+        return this->call_end(outer, this->try_set_battery_mode(buf));
     }
 
-    void BQ40Z80::read_da_status_1(DA_STATUS_1 *data)
+    esp_err_t BQ40Z80::try_read_da_status_1(DA_STATUS_1 *data, BQ40Z80_CALL *call)
+    {
+        return this->try_read<BQ40Z80_REG_DAStatus1>(data, call);
+    }
+
+    esp_err_t BQ40Z80::try_read_da_status_3(DA_STATUS_3 *data, BQ40Z80_CALL *call)
     {
-        uint8_t buf[32];
+        return this->try_read<BQ40Z80_REG_DAStatus3>(data, call);
+    }
 
-        ESP_ERROR_CHECK(this->mfa_read_block(BQ40Z80_MFA_DA_STATUS_1, buf, 32));
+    esp_err_t BQ40Z80::try_read_operation_status(OPERATION_STATUS *data, BQ40Z80_CALL *call)
+    {
+        return this->try_read<BQ40Z80_REG_OperationStatus>(data, call);
+    }
 
-        data->cell_voltage_1 = (buf[1] << 8) | buf[0];
-        data->cell_voltage_2 = (buf[3] << 8) | buf[2];
-        data->cell_voltage_3 = (buf[5] << 8) | buf[4];
-        data->cell_voltage_4 = (buf[7] << 8) | buf[6];
-        data->bat_voltage = (buf[9] << 8) | buf[8];
-        data->pack_voltage = (buf[11] << 8) | buf[10];
-        data->cell_current_1 = (buf[13] << 8) | buf[12];
-        data->cell_current_2 = (buf[15] << 8) | buf[14];
-        data->cell_current_3 = (buf[17] << 8) | buf[16];
-        data->cell_current_4 = (buf[19] << 8) | buf[18];
-        data->cell_power_1 = (buf[21] << 8) | buf[20];
-        data->cell_power_2 = (buf[23] << 8) | buf[22];
-        data->cell_power_3 = (buf[25] << 8) | buf[24];
-        data->cell_power_4 = (buf[27] << 8) | buf[26];
-        data->power = (buf[29] << 8) | buf[28];
-        data->average_power = (buf[31] << 8) | buf[30];
+    esp_err_t BQ40Z80::try_read_safety_alert(SAFETY_STATUS *data, BQ40Z80_CALL *call)
+    {
+        return this->try_read<BQ40Z80_REG_SafetyAlert>(data, call);
+    }
 
-        return;
+    esp_err_t BQ40Z80::try_read_safety_status(SAFETY_STATUS *data, BQ40Z80_CALL *call)
+    {
+        return this->try_read<BQ40Z80_REG_SafetyStatus>(data, call);
     }
 
-    void BQ40Z80::read_da_status_3(DA_STATUS_3 *data)
+    esp_err_t BQ40Z80::try_read_pf_alert(PF_STATUS *data, BQ40Z80_CALL *call)
     {
-        uint8_t buf[18];
+        return this->try_read<BQ40Z80_REG_PFAlert>(data, call);
+    }
 
-        ESP_ERROR_CHECK(this->mfa_read_block(BQ40Z80_MFA_DA_STATUS_3, buf, 18));
+    esp_err_t BQ40Z80::try_read_pf_status(PF_STATUS *data, BQ40Z80_CALL *call)
+    {
+        return this->try_read<BQ40Z80_REG_PFStatus>(data, call);
+    }
+
+    esp_err_t BQ40Z80::try_read_charging_status(CHARGING_STATUS *data, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_CALL *outer = this->call_begin(call);
+        uint8_t buf[3] = {0};
+        esp_err_t err = this->smbus_read_block(BQ40Z80_SBS_ChargingStatus, buf, 3);
+        if (err == ESP_OK)
+        {
+            CHARGING_STATUS status;
+            status.raw = ((uint32_t)buf[2] << 16) | (buf[1] << 8) | buf[0];
+            *data = status;
+        }
+        return this->call_end(outer, err);
+    }
 
-        data->cell_voltage_5 = (buf[1] << 8) | buf[0];
-        data->cell_current_5 = (buf[3] << 8) | buf[2];
-        data->cell_power_5 = (buf[5] << 8) | buf[4];
-        data->cell_voltage_6 = (buf[7] << 8) | buf[6];
-        data->cell_current_6 = (buf[9] << 8) | buf[8];
-        data->cell_power_6 = (buf[11] << 8) | buf[10];
-        data->cell_voltage_7 = (buf[13] << 8) | buf[12];
-        data->cell_current_7 = (buf[15] << 8) | buf[14];
-        data->cell_power_7 = (buf[17] << 8) | buf[16];
+    esp_err_t BQ40Z80::try_read_gauging_status(GAUGING_STATUS *data, BQ40Z80_CALL *call)
+    {
+        return this->try_read<BQ40Z80_REG_GaugingStatus>(data, call);
+    }
 
-        return;
+    esp_err_t BQ40Z80::try_read_manufacturing_status(MANUFACTURING_STATUS *data, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_CALL *outer = this->call_begin(call);
+        uint8_t buf[2] = {0};
+        esp_err_t err = this->smbus_read_block(BQ40Z80_SBS_ManufacturingStatus, buf, 2);
+        if (err == ESP_OK)
+        {
+            MANUFACTURING_STATUS status;
+            status.raw = (buf[1] << 8) | buf[0];
+            *data = status;
+        }
+        return this->call_end(outer, err);
     }
 
     /***************************** Private Functions *****************************/
 
-    esp_err_t BQ40Z80::smbus_read_word(uint8_t reg_addr, uint16_t *data)
+#if BQ40Z80_STATS_ENABLE
+#define STATS_START() int64_t stats_start = bq40z80_time_us()
+#define STATS_RECORD(kind, command, bytes, conditions, attempts, err) this->stats_record(kind, command, bytes, conditions, attempts, err, stats_start)
+#else
+#define STATS_START()
+#define STATS_RECORD(kind, command, bytes, conditions, attempts, err)
+#endif
+
+    void BQ40Z80::device_init()
     {
-        esp_err_t err;
-        uint8_t buf[2];
+        bq40z80_mutex_init(&this->lock);
+        this->active_call = NULL;
+        this->unattached = false;
+        this->bus_timeout_us = I2C_MASTER_TIMEOUT_MS * 1000;
+        this->bus_freq_hz = I2C_MASTER_FREQ_HZ;
+        this->freq_limit_hz = I2C_MASTER_FREQ_HZ;
+        this->bus_errors = 0;
+        this->pec_enable = false;
+        this->reset_stats();
+        this->cache_init();
+        this->events_init();
+        this->alert_init();
+    }
 
-        err = i2c_master_write_read_device(this->I2C_MASTER_NUM, this->DEVICE_ADDRESS, &reg_addr, 1, buf, 2, I2C_MASTER_TIMEOUT_TICK);
+    BQ40Z80_CALL *BQ40Z80::call_begin(BQ40Z80_CALL *call)
+    {
+        // held until call_end(), one public call owns the bus and the bookkeeping at a time.
+        // Always gauge first, then shared bus, so gauges of one bus can't deadlock each other.
+        bq40z80_mutex_lock(&this->lock);
+        if (this->bus != NULL)
+            bq40z80_mutex_lock(&this->bus->lock);
 
-        *data = (buf[1] << 8) | buf[0];
+        BQ40Z80_CALL *outer = this->active_call;
 
+        // nested calls without their own options account to the enclosing call
+        if (call != NULL)
+        {
+            call->attempts = 0;
+            call->transactions = 0;
+            call->bytes = 0;
+            call->clocks = 0;
+            call->elapsed_us = 0;
+            call->started_us = bq40z80_time_us();
+            call->err = ESP_OK;
+            this->active_call = call;
+        }
+        return outer;
+    }
+
+    void BQ40Z80::call_transaction(uint32_t bytes, uint32_t conditions, uint8_t attempts)
+    {
+        BQ40Z80_CALL *call = this->active_call;
+
+        if (call != NULL)
+        {
+            call->transactions++;
+            call->bytes += bytes * attempts;
+            call->clocks += (bytes * 9 + conditions) * attempts;
+        }
+    }
+
+    void BQ40Z80::call_sleep_until_us(int64_t until_us)
+    {
+        if (until_us <= bq40z80_time_us())
+            return;
+
+        // the bus is idle meanwhile, other gauges of a shared bus may use it
+        if (this->bus != NULL)
+            bq40z80_mutex_unlock(&this->bus->lock);
+        bq40z80_sleep_until_us(until_us);
+        if (this->bus != NULL)
+            bq40z80_mutex_lock(&this->bus->lock);
+    }
+
+    esp_err_t BQ40Z80::call_end(BQ40Z80_CALL *outer, esp_err_t err)
+    {
+        BQ40Z80_CALL *call = this->active_call;
+
+        if (call != NULL && call != outer)
+        {
+            call->elapsed_us = (uint32_t)(bq40z80_time_us() - call->started_us);
+            call->err = err;
+        }
+        this->active_call = outer;
+
+        if (this->bus != NULL)
+            bq40z80_mutex_unlock(&this->bus->lock);
+        bq40z80_mutex_unlock(&this->lock);
         return err;
     }
 
-    esp_err_t BQ40Z80::smbus_write_word(uint8_t reg_addr, uint16_t data)
+    esp_err_t BQ40Z80::attempt_begin(uint32_t wire_time_us)
+    {
+        BQ40Z80_CALL *call = this->active_call;
+
+        if (this->unattached)
+            return ESP_ERR_NO_MEM;
+        if (call == NULL)
+        {
+            this->bus_timeout_us = I2C_MASTER_TIMEOUT_MS * 1000;
+            return this->bus != NULL ? this->bus->select(this->MUX_CHANNEL, this->bus_timeout_us) : ESP_OK;
+        }
+
+        // abort an attempt that outlives its wire time plus the longest legal clock stretching,
+        // the remaining budget is better spent on a retry
+        int64_t budget = wire_time_us + BQ40Z80_SMBUS_STRETCH_MAX_US;
+        if (call->deadline_us != BQ40Z80_NO_DEADLINE)
+        {
+            int64_t remaining = call->deadline_us - bq40z80_time_us();
+            if (remaining <= 0)
+                return ESP_ERR_TIMEOUT;
+            if (remaining < budget)
+                budget = remaining;
+        }
+        this->bus_timeout_us = (uint32_t)budget;
+        call->attempts++;
+        return this->bus != NULL ? this->bus->select(this->MUX_CHANNEL, this->bus_timeout_us) : ESP_OK;
+    }
+
+    bool BQ40Z80::attempt_retry(esp_err_t err, uint8_t attempts, uint32_t wire_time_us)
+    {
+        BQ40Z80_CALL *call = this->active_call;
+
+        if (err == ESP_OK)
+            return false;
+        // without options only a frame caught by its PEC is read again, right away: the gauge did answer,
+        // the bits flipped on the way
+        if (call == NULL)
+            return err == ESP_ERR_INVALID_CRC && attempts < BQ40Z80_CALL_DEFAULT_ATTEMPTS;
+        if (err != ESP_FAIL && err != ESP_ERR_TIMEOUT && err != ESP_ERR_INVALID_STATE && err != ESP_ERR_INVALID_CRC &&
+            err != ESP_ERR_INVALID_RESPONSE)
+            return false;
+        if (attempts >= (call->max_attempts ? call->max_attempts : BQ40Z80_CALL_DEFAULT_ATTEMPTS))
+            return false;
+
+        // a NACK means the gauge is busy for a moment, a timeout means the bus was held low
+        uint32_t backoff = err == ESP_ERR_TIMEOUT ? BQ40Z80_RETRY_TIMEOUT_BACKOFF_US : BQ40Z80_RETRY_NACK_BACKOFF_US;
+        backoff <<= attempts - 1;
+        if (backoff > BQ40Z80_RETRY_BACKOFF_MAX_US)
+            backoff = BQ40Z80_RETRY_BACKOFF_MAX_US;
+
+        if (call->deadline_us != BQ40Z80_NO_DEADLINE && bq40z80_time_us() + backoff + wire_time_us > call->deadline_us)
+            return false;
+
+        bq40z80_sleep_us(backoff);
+        return true;
+    }
+
+    esp_err_t BQ40Z80::smbus_read_word(uint8_t reg_addr, uint16_t *data)
     {
-        esp_err_t err;
         uint8_t buf[2];
-        buf[0] = data & 0x00FF;
-        buf[1] = data >> 8;
 
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (this->DEVICE_ADDRESS << 1) | I2C_MASTER_WRITE, true);
-        i2c_master_write_byte(cmd, reg_addr, true);
-        i2c_master_write(cmd, buf, 2, true);
-        i2c_master_stop(cmd);
+        if (this->cache_lookup(BQ40Z80_CACHE_SBS_WORD, reg_addr, buf, 2))
+        {
+            *data = (buf[1] << 8) | buf[0];
+            return ESP_OK;
+        }
 
-        err = i2c_master_cmd_begin(this->I2C_MASTER_NUM, cmd, I2C_MASTER_TIMEOUT_TICK);
-        i2c_cmd_link_delete(cmd);
+        // S addr+W, cmd, Sr addr+R, lo, hi, P
+        uint8_t attempts = 0;
+        uint32_t wire_time_us = bq40z80_wire_time_us(5 + this->pec_enable, 3, this->get_bus_speed());
+        esp_err_t err;
+        STATS_START();
+        do
+        {
+            err = this->attempt_begin(wire_time_us);
+            if (err == ESP_OK)
+            {
+                err = this->bus_read_word(reg_addr, data);
+                this->bus_speed_feedback(err);
+            }
+        } while (this->attempt_retry(err, ++attempts, wire_time_us));
+        STATS_RECORD(BQ40Z80_STATS_KIND_SBS, reg_addr, 5 + this->pec_enable, 3, attempts, err);
+        this->call_transaction(5 + this->pec_enable, 3, attempts);
 
+        if (err == ESP_OK)
+        {
+            buf[0] = *data & 0x00ff;
+            buf[1] = *data >> 8;
+            this->cache_store(BQ40Z80_CACHE_SBS_WORD, reg_addr, buf, 2);
+            this->event_observe(reg_addr, buf, 2);
+        }
         return err;
     }
 
-    esp_err_t BQ40Z80::smbus_read_block(uint8_t reg_addr, uint8_t *data, uint8_t len)
+    esp_err_t BQ40Z80::smbus_write_word(uint8_t reg_addr, uint16_t data)
     {
+        // S addr+W, cmd, lo, hi, P
+        uint8_t attempts = 0;
+        uint32_t wire_time_us = bq40z80_wire_time_us(4 + this->pec_enable, 2, this->get_bus_speed());
         esp_err_t err;
-        uint8_t slave_len = 0;
-
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, this->DEVICE_ADDRESS << 1 | I2C_MASTER_WRITE, true);
-        i2c_master_write_byte(cmd, reg_addr, true);
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, this->DEVICE_ADDRESS << 1 | I2C_MASTER_READ, true);
-        i2c_master_read_byte(cmd, &slave_len, I2C_MASTER_ACK);
-        err = i2c_master_cmd_begin(this->I2C_MASTER_NUM, cmd, I2C_MASTER_TIMEOUT_TICK);
-        i2c_cmd_link_delete(cmd);
+        STATS_START();
+        do
+        {
+            err = this->attempt_begin(wire_time_us);
+            if (err == ESP_OK)
+            {
+                err = this->bus_write_word(reg_addr, data);
+                this->bus_speed_feedback(err);
+            }
+        } while (this->attempt_retry(err, ++attempts, wire_time_us));
+        STATS_RECORD(BQ40Z80_STATS_KIND_SBS, reg_addr, 4 + this->pec_enable, 2, attempts, err);
+        this->call_transaction(4 + this->pec_enable, 2, attempts);
 
-        if (len < slave_len)
+        // write-through, a following read of the same register needs no bus traffic
+        if (err == ESP_OK)
         {
-            ESP_LOGE("SMBus", "slave data length(%d) exceeds provided data length(%d)", slave_len, len);
-            return ESP_ERR_INVALID_SIZE;
+            uint8_t buf[2] = {(uint8_t)(data & 0x00ff), (uint8_t)(data >> 8)};
+            this->cache_store(BQ40Z80_CACHE_SBS_WORD, reg_addr, buf, 2);
         }
-        if (len > slave_len)
-            ESP_LOGW("SMBus", "slave data length(%d) dosen't match provided data length(%d)", slave_len, len);
+        else
+        {
+            this->cache_invalidate(BQ40Z80_CACHE_SBS_WORD, reg_addr);
+        }
+        if (reg_addr == BQ40Z80_SBS_ManufacturerAccess)
+            this->cache_invalidate(BQ40Z80_CACHE_NONE, 0);
+        else if (reg_addr == BQ40Z80_SBS_BatteryMode)
+            this->cache_invalidate_capm();
+        return err;
+    }
 
-        if (err != ESP_OK)
-            return err;
+    esp_err_t BQ40Z80::smbus_read_block(uint8_t reg_addr, uint8_t *data, uint8_t len)
+    {
+        if (this->cache_lookup(BQ40Z80_CACHE_SBS_BLOCK, reg_addr, data, len))
+            return ESP_OK;
 
-        cmd = i2c_cmd_link_create();
-        i2c_master_read(cmd, data, slave_len, I2C_MASTER_LAST_NACK);
-        i2c_master_stop(cmd);
-        err = i2c_master_cmd_begin(this->I2C_MASTER_NUM, cmd, I2C_MASTER_TIMEOUT_TICK);
-        i2c_cmd_link_delete(cmd);
+        // S addr+W, cmd, Sr addr+R, count, data, P
+        uint8_t attempts = 0;
+        uint32_t wire_time_us = bq40z80_wire_time_us(4 + len + this->pec_enable, 3, this->get_bus_speed());
+        esp_err_t err;
+        STATS_START();
+        do
+        {
+            err = this->attempt_begin(wire_time_us);
+            if (err == ESP_OK)
+            {
+                err = this->bus_read_block(reg_addr, data, len);
+                this->bus_speed_feedback(err);
+            }
+        } while (this->attempt_retry(err, ++attempts, wire_time_us));
+        STATS_RECORD(BQ40Z80_STATS_KIND_SBS, reg_addr, 4 + len + this->pec_enable, 3, attempts, err);
+        this->call_transaction(4 + len + this->pec_enable, 3, attempts);
 
+        if (err == ESP_OK)
+        {
+            this->cache_store(BQ40Z80_CACHE_SBS_BLOCK, reg_addr, data, len);
+            this->event_observe(reg_addr, data, len);
+        }
         return err;
     }
 
     esp_err_t BQ40Z80::smbus_write_block(uint8_t reg_addr, uint8_t *data, uint8_t len)
     {
+        // S addr+W, cmd, count, data, P
+        uint8_t attempts = 0;
+        uint32_t wire_time_us = bq40z80_wire_time_us(3 + len + this->pec_enable, 2, this->get_bus_speed());
         esp_err_t err;
+        STATS_START();
+        do
+        {
+            err = this->attempt_begin(wire_time_us);
+            if (err == ESP_OK)
+            {
+                err = this->bus_write_block(reg_addr, data, len);
+                this->bus_speed_feedback(err);
+            }
+        } while (this->attempt_retry(err, ++attempts, wire_time_us));
+        STATS_RECORD(BQ40Z80_STATS_KIND_SBS, reg_addr, 3 + len + this->pec_enable, 2, attempts, err);
+        this->call_transaction(3 + len + this->pec_enable, 2, attempts);
+
+        this->cache_invalidate(BQ40Z80_CACHE_SBS_BLOCK, reg_addr);
+        // a MAC command may change any dynamic register
+        if (reg_addr == BQ40Z80_SBS_ManufacturerBlockAccess)
+            this->cache_invalidate(BQ40Z80_CACHE_NONE, 0);
+        return err;
+    }
 
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (this->DEVICE_ADDRESS << 1) | I2C_MASTER_WRITE, true);
-        i2c_master_write_byte(cmd, reg_addr, true);
-        i2c_master_write_byte(cmd, len, true);
-        i2c_master_write(cmd, data, len, true);
-        i2c_master_stop(cmd);
+    esp_err_t BQ40Z80::mfa_read_block(uint16_t mfa_command, uint8_t *data, uint8_t len)
+    {
+        if (this->cache_lookup(BQ40Z80_CACHE_MFA, mfa_command, data, len))
+            return ESP_OK;
 
-        err = i2c_master_cmd_begin(this->I2C_MASTER_NUM, cmd, I2C_MASTER_TIMEOUT_TICK);
-        i2c_cmd_link_delete(cmd);
+        // S addr+W, 0x44, count, command, P, S addr+W, 0x23, Sr addr+R, count, echo, data, P
+        // two transactions, the gauge runs the command on the STOP between them, each carries its own PEC
+        uint8_t attempts = 0;
+        uint32_t wire_time_us = bq40z80_wire_time_us(5 + 6 + len + 2 * this->pec_enable, 5, this->get_bus_speed());
+        esp_err_t err;
+        STATS_START();
+        do
+        {
+            err = this->attempt_begin(wire_time_us);
+            if (err == ESP_OK)
+            {
+                err = this->bus_mfa_read_block(mfa_command, data, len);
+                this->bus_speed_feedback(err);
+            }
+        } while (this->attempt_retry(err, ++attempts, wire_time_us));
+        STATS_RECORD(BQ40Z80_STATS_KIND_MFA, mfa_command, 5 + 6 + len + 2 * this->pec_enable, 5, attempts, err);
+        this->call_transaction(5 + this->pec_enable, 2, attempts);
+        this->call_transaction(6 + len + this->pec_enable, 3, attempts);
 
+        if (err == ESP_OK)
+            this->cache_store(BQ40Z80_CACHE_MFA, mfa_command, data, len);
         return err;
     }
 
-    esp_err_t BQ40Z80::mfa_read_block(uint16_t mfa_command, uint8_t *data, uint8_t len)
+    esp_err_t BQ40Z80::smbus_write_raw(const uint8_t *data, uint8_t len)
     {
+        // S addr+W, data, P
+        uint8_t attempts = 0;
+        uint32_t wire_time_us = bq40z80_wire_time_us(1 + len, 2, this->get_bus_speed());
         esp_err_t err;
-        uint8_t command[2];
-        command[0] = mfa_command & 0x00ff;
-        command[1] = mfa_command >> 8;
+        STATS_START();
+        do
+        {
+            err = this->attempt_begin(wire_time_us);
+            if (err == ESP_OK)
+            {
+                err = this->bus_write_raw(data, len);
+                this->bus_speed_feedback(err);
+            }
+        } while (this->attempt_retry(err, ++attempts, wire_time_us));
+        STATS_RECORD(BQ40Z80_STATS_KIND_SBS, data[0], 1 + len, 2, attempts, err);
+        this->call_transaction(1 + len, 2, attempts);
 
-        err = this->smbus_write_block(BQ40Z80_SBS_ManufacturerBlockAccess, command, 2);
-        if (err != ESP_OK)
-            return err;
+        // raw writes bypass the register model, nothing cached can be trusted
+        this->cache_invalidate(BQ40Z80_CACHE_NONE, 0);
+        return err;
+    }
 
-        err = this->smbus_read_block(BQ40Z80_SBS_ManufacturerData, data, len);
+    esp_err_t BQ40Z80::smbus_read_raw(uint8_t reg_addr, uint8_t *data, uint8_t len)
+    {
+        // S addr+W, cmd, Sr addr+R, data, P
+        uint8_t attempts = 0;
+        uint32_t wire_time_us = bq40z80_wire_time_us(3 + len, 3, this->get_bus_speed());
+        esp_err_t err;
+        STATS_START();
+        do
+        {
+            err = this->attempt_begin(wire_time_us);
+            if (err == ESP_OK)
+            {
+                err = this->bus_read_raw(reg_addr, data, len);
+                this->bus_speed_feedback(err);
+            }
+        } while (this->attempt_retry(err, ++attempts, wire_time_us));
+        STATS_RECORD(BQ40Z80_STATS_KIND_SBS, reg_addr, 3 + len, 3, attempts, err);
+        this->call_transaction(3 + len, 3, attempts);
         return err;
     }
 
+    esp_err_t BQ40Z80::read_register(uint8_t kind, uint16_t command, uint8_t *data, uint8_t len)
+    {
+        switch (kind)
+        {
+        case BQ40Z80_REG_SBS_WORD:
+        {
+            uint16_t buf;
+            esp_err_t err = this->smbus_read_word(command, &buf);
+            data[0] = buf & 0x00ff;
+            data[1] = buf >> 8;
+            return err;
+        }
+        case BQ40Z80_REG_SBS_BLOCK:
+            return this->smbus_read_block(command, data, len);
+        case BQ40Z80_REG_MFA:
+            return this->mfa_read_block(command, data, len);
+        default:
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    /**
+     * @brief Copy 'slave_len' bytes of a block, zero padding up to 'len'
+     */
+    static esp_err_t block_copy(const uint8_t *block, uint8_t slave_len, uint8_t *data, uint8_t len)
+    {
+        if (len < slave_len)
+        {
+            ESP_LOGE("SMBus", "slave data length(%d) exceeds provided data length(%d)", slave_len, len);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        if (len > slave_len)
+        {
+            ESP_LOGW("SMBus", "slave data length(%d) dosen't match provided data length(%d)", slave_len, len);
+            memset(data + slave_len, 0, len - slave_len);
+        }
+
+        memcpy(data, block, slave_len);
+        return ESP_OK;
+    }
+
+    esp_err_t BQ40Z80::smbus_block_result(uint8_t reg_addr, const uint8_t *raw, uint8_t *data, uint8_t len)
+    {
+        uint8_t slave_len = raw[0];
+
+        // the PEC byte follows the reported count, it was only read when the count fits
+        if (slave_len <= len)
+        {
+            esp_err_t err = this->pec_check(reg_addr, raw, 1 + slave_len);
+            if (err != ESP_OK)
+                return err;
+        }
+
+        return block_copy(raw + 1, slave_len, data, len);
+    }
+
+    esp_err_t BQ40Z80::mfa_block_result(uint16_t mfa_command, const uint8_t *raw, uint8_t *data, uint8_t len)
+    {
+        uint8_t slave_len = raw[0];
+        uint16_t echo = (raw[2] << 8) | raw[1];
+
+        if (slave_len <= BQ40Z80_MFA_ECHO_LEN + len)
+        {
+            esp_err_t err = this->pec_check(BQ40Z80_SBS_ManufacturerData, raw, 1 + slave_len);
+            if (err != ESP_OK)
+                return err;
+        }
+
+        // the gauge answers with the previous command until it has processed the new one
+        if (slave_len < BQ40Z80_MFA_ECHO_LEN || echo != mfa_command)
+        {
+            ESP_LOGW("SMBus", "MFA command echo 0x%04x doesn't match 0x%04x", echo, mfa_command);
+            return ESP_ERR_INVALID_RESPONSE;
+        }
+
+        return block_copy(raw + 1 + BQ40Z80_MFA_ECHO_LEN, slave_len - BQ40Z80_MFA_ECHO_LEN, data, len);
+    }
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
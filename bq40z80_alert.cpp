@@ -0,0 +1,152 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bq40z80.h"
+
+    /***************************** Public Functions *****************************/
+
+    void BQ40Z80::set_trip_points(uint16_t discharge, uint16_t charge)
+    {
+        ESP_ERROR_CHECK(this->try_set_trip_points(discharge, charge));
+    }
+
+    void BQ40Z80::arm_trip_window(uint16_t step)
+    {
+        ESP_ERROR_CHECK(this->try_arm_trip_window(step));
+    }
+
+    void BQ40Z80::notify_alert()
+    {
+        __atomic_store_n(&this->alert_pending, 1, __ATOMIC_RELEASE);
+        bq40z80_signal_give(&this->alert);
+    }
+
+    bool BQ40Z80::wait_alert(uint32_t timeout_ms)
+    {
+        int64_t deadline_us = bq40z80_time_us() + (int64_t)timeout_ms * 1000;
+
+        // the signal may be left over from an alert serviced without waiting, recheck the flag
+        while (!__atomic_load_n(&this->alert_pending, __ATOMIC_ACQUIRE))
+        {
+            int64_t left_us = deadline_us - bq40z80_time_us();
+            if (timeout_ms != UINT32_MAX && left_us <= 0)
+                return false;
+            uint32_t left_ms = timeout_ms == UINT32_MAX ? UINT32_MAX : (uint32_t)((left_us + 999) / 1000);
+            if (!bq40z80_signal_take(&this->alert, left_ms) && timeout_ms != UINT32_MAX)
+                return __atomic_load_n(&this->alert_pending, __ATOMIC_ACQUIRE);
+        }
+        return true;
+    }
+
+    void BQ40Z80::service_alert()
+    {
+        ESP_ERROR_CHECK(this->try_service_alert());
+    }
+
+    /***************************** Non-aborting Functions *****************************/
+
+    esp_err_t BQ40Z80::try_set_trip_points(uint16_t discharge, uint16_t charge, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_CALL *outer = this->call_begin(call);
+        this->btp_discharge = discharge;
+        this->btp_charge = charge;
+        this->btp_step = 0;
+        return this->call_end(outer, this->rearm_trip_points());
+    }
+
+    esp_err_t BQ40Z80::try_arm_trip_window(uint16_t step, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_CALL *outer = this->call_begin(call);
+        this->btp_step = step;
+        return this->call_end(outer, this->rearm_trip_points());
+    }
+
+    esp_err_t BQ40Z80::try_service_alert(BQ40Z80_CALL *call)
+    {
+        if (!__atomic_exchange_n(&this->alert_pending, 0, __ATOMIC_ACQ_REL))
+            return ESP_OK;
+
+        BQ40Z80_CALL *outer = this->call_begin(call);
+
+        // the line says something changed, cached status words are stale
+        this->cache_invalidate(BQ40Z80_CACHE_SBS_BLOCK, BQ40Z80_SBS_OperationStatus);
+        this->cache_invalidate(BQ40Z80_CACHE_SBS_WORD, BQ40Z80_SBS_BatteryStatus);
+        this->cache_invalidate(BQ40Z80_CACHE_SBS_BLOCK, BQ40Z80_SBS_SafetyStatus);
+        this->cache_invalidate(BQ40Z80_CACHE_SBS_BLOCK, BQ40Z80_SBS_PFStatus);
+
+        OPERATION_STATUS status;
+        uint16_t battery_status;
+        esp_err_t err = this->try_read_operation_status(&status);
+        if (err == ESP_OK)
+            err = this->smbus_read_word(BQ40Z80_SBS_BatteryStatus, &battery_status);
+
+        // SafetyStatus() and PFStatus() only move while [SS]/[PF] are set or right after they clear
+        if (err == ESP_OK && (status.ss() || this->event_values[1 + BQ40Z80_SBS_SafetyStatus - BQ40Z80_SBS_SafetyAlert]))
+        {
+            SAFETY_STATUS safety;
+            err = this->try_read_safety_status(&safety);
+        }
+        if (err == ESP_OK && (status.pf() || this->event_values[1 + BQ40Z80_SBS_PFStatus - BQ40Z80_SBS_SafetyAlert]))
+        {
+            PF_STATUS pf;
+            err = this->try_read_pf_status(&pf);
+        }
+        if (err == ESP_OK && status.btp_int())
+            err = this->rearm_trip_points();
+
+        if (err != ESP_OK)
+            __atomic_store_n(&this->alert_pending, 1, __ATOMIC_RELEASE);
+        return this->call_end(outer, err);
+    }
+
+    /***************************** Private Functions *****************************/
+
+    void BQ40Z80::alert_init()
+    {
+        bq40z80_signal_init(&this->alert);
+        this->alert_pending = 0;
+        this->btp_discharge = 0;
+        this->btp_charge = 0;
+        this->btp_step = 0;
+#if !defined(BQ40Z80_TRANSPORT_LINUX)
+        this->ALERT_GPIO = GPIO_NUM_NC;
+#endif
+    }
+
+    void BQ40Z80::alert_deinit()
+    {
+#if !defined(BQ40Z80_TRANSPORT_LINUX)
+        this->detach_alert();
+#endif
+        bq40z80_signal_deinit(&this->alert);
+    }
+
+    esp_err_t BQ40Z80::rearm_trip_points()
+    {
+        esp_err_t err;
+
+        if (this->btp_step != 0)
+        {
+            uint16_t rc;
+            this->cache_invalidate(BQ40Z80_CACHE_SBS_WORD, BQ40Z80_SBS_RemainingCapacity);
+            err = this->smbus_read_word(BQ40Z80_SBS_RemainingCapacity, &rc);
+            if (err != ESP_OK)
+                return err;
+            this->btp_discharge = rc > this->btp_step ? rc - this->btp_step : 0;
+            this->btp_charge = rc < UINT16_MAX - this->btp_step ? rc + this->btp_step : UINT16_MAX;
+        }
+
+        // writing either point clears OperationStatus()[BTP_INT] and releases the line
+        err = this->smbus_write_word(BQ40Z80_SBS_BTPDischargeSet, this->btp_discharge);
+        if (err == ESP_OK)
+            err = this->smbus_write_word(BQ40Z80_SBS_BTPChargeSet, this->btp_charge);
+        if (err == ESP_OK)
+            ESP_LOGD("BQ40Z80", "trip points armed at %u/%u", this->btp_discharge, this->btp_charge);
+        return err;
+    }
+
+#ifdef __cplusplus
+}
+#endif
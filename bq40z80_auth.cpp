@@ -0,0 +1,202 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bq40z80.h"
+
+#define SHA1_BLOCK 64
+
+    static inline uint32_t rol(uint32_t x, uint8_t n)
+    {
+        return (x << n) | (x >> (32 - n));
+    }
+
+    static inline uint32_t get_be32(const uint8_t *p)
+    {
+        return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+    }
+
+    static inline void put_be32(uint8_t *p, uint32_t val)
+    {
+        p[0] = val >> 24;
+        p[1] = val >> 16;
+        p[2] = val >> 8;
+        p[3] = val;
+    }
+
+    static void sha1_init(uint32_t *state)
+    {
+        state[0] = 0x67452301;
+        state[1] = 0xefcdab89;
+        state[2] = 0x98badcfe;
+        state[3] = 0x10325476;
+        state[4] = 0xc3d2e1f0;
+    }
+
+    static void sha1_compress(uint32_t *state, const uint8_t *block)
+    {
+        // the schedule is expanded in a 16-word ring, one loop per round function keeps the body branch-free
+        uint32_t w[16];
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+        uint8_t i;
+
+#define EXPAND(i) (w[(i) & 15] = rol(w[((i) + 13) & 15] ^ w[((i) + 8) & 15] ^ w[((i) + 2) & 15] ^ w[(i) & 15], 1))
+#define ROUND(f, k, x)                                \
+    {                                                 \
+        uint32_t t = rol(a, 5) + (f) + e + (k) + (x); \
+        e = d;                                        \
+        d = c;                                        \
+        c = rol(b, 30);                               \
+        b = a;                                        \
+        a = t;                                        \
+    }
+
+        for (i = 0; i < 16; i++)
+            ROUND(d ^ (b & (c ^ d)), 0x5a827999, w[i] = get_be32(block + 4 * i));
+        for (; i < 20; i++)
+            ROUND(d ^ (b & (c ^ d)), 0x5a827999, EXPAND(i));
+        for (; i < 40; i++)
+            ROUND(b ^ c ^ d, 0x6ed9eba1, EXPAND(i));
+        for (; i < 60; i++)
+            ROUND((b & c) | (d & (b | c)), 0x8f1bbcdc, EXPAND(i));
+        for (; i < 80; i++)
+            ROUND(b ^ c ^ d, 0xca62c1d6, EXPAND(i));
+
+#undef ROUND
+#undef EXPAND
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+    }
+
+    static void sha1_output(const uint32_t *state, uint8_t *digest)
+    {
+        for (uint8_t i = 0; i < 5; i++)
+            put_be32(digest + 4 * i, state[i]);
+    }
+
+    void bq40z80_sha1(const uint8_t *data, size_t len, uint8_t *digest)
+    {
+        uint32_t state[5];
+        uint8_t tail[2 * SHA1_BLOCK] = {0};
+        size_t full = len & ~(size_t)(SHA1_BLOCK - 1);
+
+        sha1_init(state);
+        for (size_t offset = 0; offset < full; offset += SHA1_BLOCK)
+            sha1_compress(state, data + offset);
+
+        // the 0x80 marker and the 64-bit length in bits take one or two more blocks
+        size_t rest = len - full;
+        size_t n_tail = rest + 9 > SHA1_BLOCK ? 2 * SHA1_BLOCK : SHA1_BLOCK;
+        memcpy(tail, data + full, rest);
+        tail[rest] = 0x80;
+        put_be32(tail + n_tail - 8, (uint32_t)((uint64_t)len >> 29));
+        put_be32(tail + n_tail - 4, (uint32_t)(len << 3));
+        for (size_t offset = 0; offset < n_tail; offset += SHA1_BLOCK)
+            sha1_compress(state, tail + offset);
+
+        sha1_output(state, digest);
+    }
+
+    void bq40z80_auth_digest(const uint8_t *key, const uint8_t *challenge, uint8_t *response)
+    {
+        uint8_t block[SHA1_BLOCK] = {0};
+        uint32_t state[5];
+
+        // key || message, then the padding of a 36-byte message, shared by both passes
+        memcpy(block, key, BQ40Z80_AUTH_KEY_LEN);
+        memcpy(block + BQ40Z80_AUTH_KEY_LEN, challenge, BQ40Z80_AUTH_CHALLENGE_LEN);
+        block[BQ40Z80_AUTH_KEY_LEN + BQ40Z80_AUTH_CHALLENGE_LEN] = 0x80;
+        put_be32(block + SHA1_BLOCK - 4, (BQ40Z80_AUTH_KEY_LEN + BQ40Z80_AUTH_CHALLENGE_LEN) * 8);
+
+        sha1_init(state);
+        sha1_compress(state, block);
+        sha1_output(state, block + BQ40Z80_AUTH_KEY_LEN);
+
+        sha1_init(state);
+        sha1_compress(state, block);
+        sha1_output(state, response);
+    }
+
+    /***************************** Public Functions *****************************/
+
+    bool BQ40Z80::authenticate(const BQ40Z80_AUTH_CHALLENGE *challenge)
+    {
+        // a wrong response is an answer, only bus errors abort
+        esp_err_t err = this->try_authenticate(challenge);
+        if (err != ESP_ERR_INVALID_RESPONSE)
+            ESP_ERROR_CHECK(err);
+        return err == ESP_OK;
+    }
+
+    /***************************** Non-aborting Functions *****************************/
+
+    esp_err_t BQ40Z80::try_authenticate(const BQ40Z80_AUTH_CHALLENGE *challenge, BQ40Z80_AUTH_TIMING *timing, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_CALL *outer = this->call_begin(call);
+        BQ40Z80_AUTH_TIMING work = {};
+        uint8_t buf[BQ40Z80_AUTH_CHALLENGE_LEN];
+        int64_t start_us = bq40z80_time_us();
+
+        memcpy(buf, challenge->challenge, BQ40Z80_AUTH_CHALLENGE_LEN);
+        esp_err_t err = this->smbus_write_block(BQ40Z80_SBS_Authenticate, buf, BQ40Z80_AUTH_CHALLENGE_LEN);
+        int64_t written_us = bq40z80_time_us();
+        work.challenge_us = written_us - start_us;
+
+        // OperationStatus()[AUTH] is set while the gauge computes the digest
+        bool busy = err == ESP_OK;
+        while (busy)
+        {
+            int64_t now_us = bq40z80_time_us();
+            int64_t wake_us = now_us + BQ40Z80_AUTH_POLL_MS * 1000;
+            if (now_us - written_us >= BQ40Z80_AUTH_TIMEOUT_MS * 1000 ||
+                (this->active_call != NULL && this->active_call->deadline_us != BQ40Z80_NO_DEADLINE && wake_us > this->active_call->deadline_us))
+            {
+                err = ESP_ERR_TIMEOUT;
+                break;
+            }
+
+            // the bus is idle meanwhile, other gauges of a shared bus may use it
+            if (this->bus != NULL)
+                bq40z80_mutex_unlock(&this->bus->lock);
+            bq40z80_sleep_us(BQ40Z80_AUTH_POLL_MS * 1000);
+            if (this->bus != NULL)
+                bq40z80_mutex_lock(&this->bus->lock);
+
+            OPERATION_STATUS status;
+            this->cache_invalidate(BQ40Z80_CACHE_SBS_BLOCK, BQ40Z80_SBS_OperationStatus);
+            err = this->try_read_operation_status(&status);
+            work.polls++;
+            busy = err == ESP_OK && status.auth();
+        }
+        int64_t computed_us = bq40z80_time_us();
+        work.digest_us = computed_us - written_us;
+
+        if (err == ESP_OK)
+            err = this->smbus_read_block(BQ40Z80_SBS_Authenticate, buf, BQ40Z80_AUTH_CHALLENGE_LEN);
+        if (err == ESP_OK)
+        {
+            // constant time, the position of the first wrong byte stays private
+            uint8_t diff = 0;
+            for (uint8_t i = 0; i < BQ40Z80_AUTH_CHALLENGE_LEN; i++)
+                diff |= buf[i] ^ challenge->response[i];
+            if (diff != 0)
+            {
+                ESP_LOGW("BQ40Z80", "authentication failed, the gauge doesn't hold the key");
+                err = ESP_ERR_INVALID_RESPONSE;
+            }
+        }
+        work.response_us = bq40z80_time_us() - computed_us;
+
+        if (timing != NULL)
+            *timing = work;
+        return this->call_end(outer, err);
+    }
+
+#ifdef __cplusplus
+}
+#endif
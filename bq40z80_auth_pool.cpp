@@ -0,0 +1,181 @@
+#include "bq40z80_auth_pool.h"
+
+BQ40Z80_AUTH_POOL::BQ40Z80_AUTH_POOL(const uint8_t *key, uint16_t capacity)
+{
+    memcpy(this->key, key, BQ40Z80_AUTH_KEY_LEN);
+    this->capacity = capacity > 0 ? capacity : 1;
+    this->entries = new BQ40Z80_AUTH_CHALLENGE[this->capacity];
+    this->head = 0;
+    this->count = 0;
+    bq40z80_mutex_init(&this->lock);
+    bq40z80_signal_init(&this->wake);
+    memset(&this->stats, 0, sizeof(this->stats));
+    this->running.store(false, std::memory_order_relaxed);
+#if !defined(BQ40Z80_TRANSPORT_LINUX)
+    this->task = NULL;
+    this->stopped = NULL;
+#endif
+}
+
+BQ40Z80_AUTH_POOL::~BQ40Z80_AUTH_POOL()
+{
+    this->stop();
+
+    // unused challenges would let a clone be prepared, wipe them with the key
+    volatile uint8_t *p = (volatile uint8_t *)this->entries;
+    for (size_t i = 0; i < sizeof(BQ40Z80_AUTH_CHALLENGE) * this->capacity; i++)
+        p[i] = 0;
+    p = (volatile uint8_t *)this->key;
+    for (size_t i = 0; i < sizeof(this->key); i++)
+        p[i] = 0;
+
+    delete[] this->entries;
+    bq40z80_signal_deinit(&this->wake);
+    bq40z80_mutex_deinit(&this->lock);
+}
+
+/***************************** Public Functions *****************************/
+
+esp_err_t BQ40Z80_AUTH_POOL::start()
+{
+    if (this->running.exchange(true))
+        return ESP_ERR_INVALID_STATE;
+
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+    this->thread = std::thread(task_entry, this);
+#else
+    this->stopped = xSemaphoreCreateBinary();
+    if (this->stopped == NULL || xTaskCreate(task_entry, "bq40z80_auth", BQ40Z80_AUTH_POOL_STACK_SIZE, this, BQ40Z80_AUTH_POOL_PRIORITY, &this->task) != pdPASS)
+    {
+        if (this->stopped != NULL)
+            vSemaphoreDelete(this->stopped);
+        this->stopped = NULL;
+        this->running.store(false);
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    return ESP_OK;
+}
+
+void BQ40Z80_AUTH_POOL::stop()
+{
+    if (!this->running.exchange(false))
+        return;
+
+    bq40z80_signal_give(&this->wake);
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+    this->thread.join();
+#else
+    xSemaphoreTake(this->stopped, portMAX_DELAY);
+    vSemaphoreDelete(this->stopped);
+    this->stopped = NULL;
+    this->task = NULL;
+#endif
+}
+
+uint16_t BQ40Z80_AUTH_POOL::refill()
+{
+    uint16_t added = 0;
+
+    while (true)
+    {
+        bq40z80_mutex_lock(&this->lock);
+        bool full = this->count == this->capacity;
+        bq40z80_mutex_unlock(&this->lock);
+        if (full)
+            break;
+
+        // computed unlocked, take() is never held up by a refill
+        BQ40Z80_AUTH_CHALLENGE entry;
+        this->generate(&entry);
+
+        bq40z80_mutex_lock(&this->lock);
+        full = this->count == this->capacity;
+        if (!full)
+        {
+            this->entries[(this->head + this->count) % this->capacity] = entry;
+            this->count++;
+            added++;
+        }
+        bq40z80_mutex_unlock(&this->lock);
+        if (full)
+            break;
+    }
+    return added;
+}
+
+bool BQ40Z80_AUTH_POOL::take(BQ40Z80_AUTH_CHALLENGE *entry)
+{
+    bq40z80_mutex_lock(&this->lock);
+    bool hit = this->count > 0;
+    if (hit)
+    {
+        BQ40Z80_AUTH_CHALLENGE *slot = &this->entries[this->head];
+        *entry = *slot;
+        memset(slot, 0, sizeof(BQ40Z80_AUTH_CHALLENGE));
+        this->head = (this->head + 1) % this->capacity;
+        this->count--;
+        this->stats.taken++;
+    }
+    else
+    {
+        this->stats.misses++;
+    }
+    bool low = this->count <= this->capacity / 2;
+    bq40z80_mutex_unlock(&this->lock);
+
+    if (!hit)
+    {
+        this->generate(entry);
+        bq40z80_mutex_lock(&this->lock);
+        this->stats.taken++;
+        bq40z80_mutex_unlock(&this->lock);
+    }
+    if (low && this->running.load())
+        bq40z80_signal_give(&this->wake);
+    return hit;
+}
+
+void BQ40Z80_AUTH_POOL::get_stats(BQ40Z80_AUTH_POOL_STATS *stats)
+{
+    bq40z80_mutex_lock(&this->lock);
+    *stats = this->stats;
+    stats->available = this->count;
+    bq40z80_mutex_unlock(&this->lock);
+}
+
+/***************************** Private Functions *****************************/
+
+void BQ40Z80_AUTH_POOL::generate(BQ40Z80_AUTH_CHALLENGE *entry)
+{
+    int64_t start_us = bq40z80_time_us();
+    bq40z80_random(entry->challenge, BQ40Z80_AUTH_CHALLENGE_LEN);
+    bq40z80_auth_digest(this->key, entry->challenge, entry->response);
+    uint32_t elapsed_us = bq40z80_time_us() - start_us;
+
+    bq40z80_mutex_lock(&this->lock);
+    this->stats.generated++;
+    this->stats.generate_total_us += elapsed_us;
+    if (elapsed_us > this->stats.generate_max_us)
+        this->stats.generate_max_us = elapsed_us;
+    bq40z80_mutex_unlock(&this->lock);
+}
+
+void BQ40Z80_AUTH_POOL::run()
+{
+    while (this->running.load())
+    {
+        this->refill();
+        bq40z80_signal_take(&this->wake, UINT32_MAX);
+    }
+}
+
+void BQ40Z80_AUTH_POOL::task_entry(void *arg)
+{
+    BQ40Z80_AUTH_POOL *pool = (BQ40Z80_AUTH_POOL *)arg;
+    pool->run();
+#if !defined(BQ40Z80_TRANSPORT_LINUX)
+    xSemaphoreGive(pool->stopped);
+    vTaskDelete(NULL);
+#endif
+}
@@ -0,0 +1,133 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bq40z80.h"
+
+    /***************************** Public Functions *****************************/
+
+    uint8_t BQ40Z80_BUS::get_device_count()
+    {
+        bq40z80_mutex_lock(&this->lock);
+        uint8_t n = this->n_devices;
+        bq40z80_mutex_unlock(&this->lock);
+        return n;
+    }
+
+    BQ40Z80 *BQ40Z80_BUS::get_device(uint8_t index)
+    {
+        bq40z80_mutex_lock(&this->lock);
+        BQ40Z80 *device = index < this->n_devices ? this->devices[index] : NULL;
+        bq40z80_mutex_unlock(&this->lock);
+        return device;
+    }
+
+    esp_err_t BQ40Z80_BUS::poll_next(const BQ40Z80_QUERY_PLAN *plan, BQ40Z80_TELEMETRY *data, uint8_t *index, BQ40Z80_CALL *call)
+    {
+        // only the cursor is guarded here, the read takes the gauge lock before the bus lock like any other call
+        bq40z80_mutex_lock(&this->lock);
+        if (this->n_devices == 0)
+        {
+            bq40z80_mutex_unlock(&this->lock);
+            return ESP_ERR_NOT_FOUND;
+        }
+        if (this->next_device >= this->n_devices)
+            this->next_device = 0;
+        uint8_t i = this->next_device++;
+        BQ40Z80 *device = this->devices[i];
+        bq40z80_mutex_unlock(&this->lock);
+
+        *index = i;
+        return device->try_read_fields(plan, data, call);
+    }
+
+    uint32_t BQ40Z80_BUS::get_mux_switches()
+    {
+        bq40z80_mutex_lock(&this->lock);
+        uint32_t n = this->mux_switches;
+        bq40z80_mutex_unlock(&this->lock);
+        return n;
+    }
+
+    uint32_t BQ40Z80_BUS::get_bus_speed()
+    {
+        bq40z80_mutex_lock(&this->lock);
+        uint32_t freq_hz = this->freq_hz;
+        bq40z80_mutex_unlock(&this->lock);
+        return freq_hz;
+    }
+
+    /***************************** Private Functions *****************************/
+
+    esp_err_t BQ40Z80_BUS::attach(BQ40Z80 *device)
+    {
+        bq40z80_mutex_lock(&this->lock);
+        if (this->n_devices >= BQ40Z80_BUS_MAX_DEVICES)
+        {
+            bq40z80_mutex_unlock(&this->lock);
+            ESP_LOGE("SMBus", "no room for more than %d gauges on the bus", BQ40Z80_BUS_MAX_DEVICES);
+            return ESP_ERR_NO_MEM;
+        }
+        this->devices[this->n_devices++] = device;
+        this->negotiate();
+        bq40z80_mutex_unlock(&this->lock);
+        return ESP_OK;
+    }
+
+    void BQ40Z80_BUS::detach(BQ40Z80 *device)
+    {
+        bq40z80_mutex_lock(&this->lock);
+        for (uint8_t i = 0; i < this->n_devices; i++)
+        {
+            if (this->devices[i] != device)
+                continue;
+            // keep the attach order, get_device() indexes follow it
+            memmove(&this->devices[i], &this->devices[i + 1], (this->n_devices - i - 1) * sizeof(BQ40Z80 *));
+            this->n_devices--;
+            if (this->next_device > i)
+                this->next_device--;
+            break;
+        }
+        this->negotiate();
+        bq40z80_mutex_unlock(&this->lock);
+    }
+
+    esp_err_t BQ40Z80_BUS::select(uint8_t channel, uint32_t timeout_us)
+    {
+        if (this->MUX_ADDRESS == BQ40Z80_BUS_NO_MUX || channel == this->mux_channel)
+            return ESP_OK;
+
+        // one bit per downstream channel, 0 disconnects them all
+        uint8_t value = channel < BQ40Z80_BUS_MUX_CHANNELS ? 1 << channel : 0;
+        esp_err_t err = this->mux_write(value, timeout_us);
+
+        // after a failed write the mux may be on any channel
+        this->mux_channel = err == ESP_OK ? channel : BQ40Z80_BUS_MUX_UNKNOWN;
+        if (err == ESP_OK)
+            this->mux_switches++;
+        return err;
+    }
+
+    esp_err_t BQ40Z80_BUS::negotiate()
+    {
+        if (this->n_devices == 0)
+            return ESP_OK;
+
+        uint32_t freq_hz = this->devices[0]->freq_limit_hz;
+        for (uint8_t i = 1; i < this->n_devices; i++)
+            if (this->devices[i]->freq_limit_hz < freq_hz)
+                freq_hz = this->devices[i]->freq_limit_hz;
+        if (freq_hz == this->freq_hz)
+            return ESP_OK;
+
+        uint32_t old_hz = this->freq_hz;
+        esp_err_t err = this->set_freq(freq_hz);
+        if (err == ESP_OK && this->freq_hz != old_hz)
+            ESP_LOGI("SMBus", "shared bus clock set to %u Hz", (unsigned)this->freq_hz);
+        return err;
+    }
+
+#ifdef __cplusplus
+}
+#endif
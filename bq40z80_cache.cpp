@@ -0,0 +1,295 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bq40z80.h"
+
+    /**
+     * @brief Registers that never change while the gauge runs
+     */
+    static const BQ40Z80_CACHE_OVERRIDE STATIC_REGISTERS[] = {
+        {BQ40Z80_CACHE_SBS_WORD, BQ40Z80_SBS_DesignCapacity, BQ40Z80_CACHE_TTL_FOREVER},
+        {BQ40Z80_CACHE_SBS_WORD, BQ40Z80_SBS_DesignVoltage, BQ40Z80_CACHE_TTL_FOREVER},
+        {BQ40Z80_CACHE_SBS_WORD, BQ40Z80_SBS_SpecificationInfo, BQ40Z80_CACHE_TTL_FOREVER},
+        {BQ40Z80_CACHE_SBS_WORD, BQ40Z80_SBS_ManufacturerDate, BQ40Z80_CACHE_TTL_FOREVER},
+        {BQ40Z80_CACHE_SBS_WORD, BQ40Z80_SBS_SerialNumber, BQ40Z80_CACHE_TTL_FOREVER},
+        {BQ40Z80_CACHE_SBS_BLOCK, BQ40Z80_SBS_ManufacturerName, BQ40Z80_CACHE_TTL_FOREVER},
+        {BQ40Z80_CACHE_SBS_BLOCK, BQ40Z80_SBS_DeviceName, BQ40Z80_CACHE_TTL_FOREVER},
+        {BQ40Z80_CACHE_SBS_BLOCK, BQ40Z80_SBS_DeviceChemistry, BQ40Z80_CACHE_TTL_FOREVER},
+        {BQ40Z80_CACHE_MFA, BQ40Z80_MFA_DEVICE_TYPE, BQ40Z80_CACHE_TTL_FOREVER},
+        {BQ40Z80_CACHE_MFA, BQ40Z80_MFA_FIRMWARE_VERSION, BQ40Z80_CACHE_TTL_FOREVER},
+        {BQ40Z80_CACHE_MFA, BQ40Z80_MFA_HARDWARE_VERSION, BQ40Z80_CACHE_TTL_FOREVER},
+        {BQ40Z80_CACHE_MFA, BQ40Z80_MFA_CHEMICAL_ID, BQ40Z80_CACHE_TTL_FOREVER},
+    };
+
+    /**
+     * @brief Words reported in mA/mAh or 10mW/10mWh depending on BatteryMode CAPM, and the times derived from AtRate
+     */
+    static const uint8_t CAPM_REGISTERS[] = {
+        BQ40Z80_SBS_RemainingCapacityAlarm,
+        BQ40Z80_SBS_AtRate,
+        BQ40Z80_SBS_AtRateTimeToFull,
+        BQ40Z80_SBS_AtRateTimeToEmpty,
+        BQ40Z80_SBS_AtRateOK,
+        BQ40Z80_SBS_RemainingCapacity,
+        BQ40Z80_SBS_FullChargeCapacity,
+        BQ40Z80_SBS_RunTimeToEmpty,
+        BQ40Z80_SBS_AverageTimeToEmpty,
+        BQ40Z80_SBS_AverageTimeToFull,
+        BQ40Z80_SBS_DesignCapacity,
+    };
+
+    /***************************** Public Functions *****************************/
+
+    uint16_t BQ40Z80::get_device_type()
+    {
+        uint16_t buf;
+        ESP_ERROR_CHECK(this->try_get_device_type(&buf));
+        return buf;
+    }
+
+    void BQ40Z80::get_firmware_version(FIRMWARE_VERSION *data)
+    {
+        ESP_ERROR_CHECK(this->try_get_firmware_version(data));
+    }
+
+    uint16_t BQ40Z80::get_chemical_id()
+    {
+        uint16_t buf;
+        ESP_ERROR_CHECK(this->try_get_chemical_id(&buf));
+        return buf;
+    }
+
+    esp_err_t BQ40Z80::try_get_device_type(uint16_t *val, BQ40Z80_CALL *call)
+    {
+        return this->try_read<BQ40Z80_REG_DeviceType>(val, call);
+    }
+
+    esp_err_t BQ40Z80::try_get_firmware_version(FIRMWARE_VERSION *data, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_CALL *outer = this->call_begin(call);
+        uint8_t buf[11];
+
+        esp_err_t err = this->mfa_read_block(BQ40Z80_MFA_FIRMWARE_VERSION, buf, 11);
+        if (err != ESP_OK)
+            return this->call_end(outer, err);
+
+        data->device_number = (buf[1] << 8) | buf[0];
+        data->version = (buf[3] << 8) | buf[2];
+        data->build_number = (buf[5] << 8) | buf[4];
+        data->firmware_type = buf[6];
+        data->it_version = (buf[8] << 8) | buf[7];
+
+        return this->call_end(outer, ESP_OK);
+    }
+
+    esp_err_t BQ40Z80::try_get_chemical_id(uint16_t *val, BQ40Z80_CALL *call)
+    {
+        return this->try_read<BQ40Z80_REG_ChemicalID>(val, call);
+    }
+
+    void BQ40Z80::set_cache_ttl(uint32_t ttl_ms)
+    {
+#if BQ40Z80_CACHE_ENABLE
+        bq40z80_mutex_lock(&this->lock);
+        this->cache_ttl_ms = ttl_ms;
+        // entries keep the lifetime they were stored with, drop the dynamic ones
+        this->cache_invalidate(BQ40Z80_CACHE_NONE, 0);
+        bq40z80_mutex_unlock(&this->lock);
+#else
+        (void)ttl_ms;
+#endif
+    }
+
+    void BQ40Z80::set_register_ttl(uint8_t sbs_command, bool word, uint32_t ttl_ms)
+    {
+        this->cache_override(word ? BQ40Z80_CACHE_SBS_WORD : BQ40Z80_CACHE_SBS_BLOCK, sbs_command, ttl_ms);
+    }
+
+    void BQ40Z80::set_mfa_ttl(uint16_t mfa_command, uint32_t ttl_ms)
+    {
+        this->cache_override(BQ40Z80_CACHE_MFA, mfa_command, ttl_ms);
+    }
+
+    void BQ40Z80::invalidate_cache()
+    {
+#if BQ40Z80_CACHE_ENABLE
+        bq40z80_mutex_lock(&this->lock);
+        for (uint8_t i = 0; i < BQ40Z80_CACHE_ENTRIES; i++)
+            this->cache[i].kind = BQ40Z80_CACHE_NONE;
+        bq40z80_mutex_unlock(&this->lock);
+#endif
+    }
+
+    void BQ40Z80::get_cache_stats(BQ40Z80_CACHE_STATS *stats)
+    {
+#if BQ40Z80_CACHE_ENABLE
+        bq40z80_mutex_lock(&this->lock);
+        *stats = this->cache_stats;
+        bq40z80_mutex_unlock(&this->lock);
+#else
+        memset(stats, 0, sizeof(BQ40Z80_CACHE_STATS));
+#endif
+    }
+
+    /***************************** Private Functions *****************************/
+
+    void BQ40Z80::cache_init()
+    {
+#if BQ40Z80_CACHE_ENABLE
+        memset(this->cache, 0, sizeof(this->cache));
+        memset(this->cache_overrides, 0, sizeof(this->cache_overrides));
+        memset(&this->cache_stats, 0, sizeof(this->cache_stats));
+        this->cache_ttl_ms = BQ40Z80_CACHE_TTL_DEFAULT_MS;
+#endif
+    }
+
+    void BQ40Z80::cache_override(uint8_t kind, uint16_t command, uint32_t ttl_ms)
+    {
+#if BQ40Z80_CACHE_ENABLE
+        bq40z80_mutex_lock(&this->lock);
+        uint8_t i;
+        for (i = 0; i < BQ40Z80_CACHE_OVERRIDES; i++)
+        {
+            BQ40Z80_CACHE_OVERRIDE *o = &this->cache_overrides[i];
+            if (o->kind == BQ40Z80_CACHE_NONE || (o->kind == kind && o->command == command))
+            {
+                o->kind = kind;
+                o->command = command;
+                o->ttl_ms = ttl_ms;
+                this->cache_invalidate(kind, command);
+                break;
+            }
+        }
+        bq40z80_mutex_unlock(&this->lock);
+
+        if (i == BQ40Z80_CACHE_OVERRIDES)
+            ESP_LOGW("BQ40Z80", "no room for TTL override of 0x%04x", command);
+#else
+        (void)kind;
+        (void)command;
+        (void)ttl_ms;
+#endif
+    }
+
+#if BQ40Z80_CACHE_ENABLE
+    static uint32_t cache_policy(const BQ40Z80_CACHE_OVERRIDE *overrides, uint32_t ttl_ms, uint8_t kind, uint16_t command)
+    {
+        for (uint8_t i = 0; i < BQ40Z80_CACHE_OVERRIDES; i++)
+            if (overrides[i].kind == kind && overrides[i].command == command)
+                return overrides[i].ttl_ms;
+
+        for (uint8_t i = 0; i < sizeof(STATIC_REGISTERS) / sizeof(STATIC_REGISTERS[0]); i++)
+            if (STATIC_REGISTERS[i].kind == kind && STATIC_REGISTERS[i].command == command)
+                return STATIC_REGISTERS[i].ttl_ms;
+
+        return ttl_ms;
+    }
+#endif
+
+    bool BQ40Z80::cache_lookup(uint8_t kind, uint16_t command, uint8_t *data, uint8_t len)
+    {
+#if BQ40Z80_CACHE_ENABLE
+        if (len > BQ40Z80_CACHE_DATA_MAX)
+            return false;
+
+        for (uint8_t i = 0; i < BQ40Z80_CACHE_ENTRIES; i++)
+        {
+            BQ40Z80_CACHE_ENTRY *e = &this->cache[i];
+            if (e->kind != kind || e->command != command || e->len != len)
+                continue;
+
+            if (e->ttl_ms != BQ40Z80_CACHE_TTL_FOREVER && bq40z80_time_us() - e->fetched_us >= (int64_t)e->ttl_ms * 1000)
+                break;
+            // a sampler stamps what it reads with the time of the call, an older value would lie
+            if (e->ttl_ms != BQ40Z80_CACHE_TTL_FOREVER && this->active_call != NULL && this->active_call->fresh)
+                break;
+
+            memcpy(data, e->data, len);
+            this->cache_stats.hits++;
+            return true;
+        }
+        this->cache_stats.misses++;
+#else
+        (void)kind;
+        (void)command;
+        (void)data;
+        (void)len;
+#endif
+        return false;
+    }
+
+    void BQ40Z80::cache_store(uint8_t kind, uint16_t command, const uint8_t *data, uint8_t len)
+    {
+#if BQ40Z80_CACHE_ENABLE
+        uint32_t ttl_ms = cache_policy(this->cache_overrides, this->cache_ttl_ms, kind, command);
+        BQ40Z80_CACHE_ENTRY *victim = NULL;
+
+        if (len > BQ40Z80_CACHE_DATA_MAX || ttl_ms == 0)
+            return;
+
+        // reuse the entry of the same register, else a free one, else the oldest dynamic one
+        for (uint8_t i = 0; i < BQ40Z80_CACHE_ENTRIES; i++)
+        {
+            BQ40Z80_CACHE_ENTRY *e = &this->cache[i];
+            if (e->kind == kind && e->command == command)
+            {
+                victim = e;
+                break;
+            }
+            if (e->kind == BQ40Z80_CACHE_NONE)
+            {
+                if (victim == NULL || victim->kind != BQ40Z80_CACHE_NONE)
+                    victim = e;
+            }
+            else if (e->ttl_ms != BQ40Z80_CACHE_TTL_FOREVER)
+            {
+                if (victim == NULL || (victim->kind != BQ40Z80_CACHE_NONE && e->fetched_us < victim->fetched_us))
+                    victim = e;
+            }
+        }
+        if (victim == NULL)
+            return;
+        if (victim->kind != BQ40Z80_CACHE_NONE && (victim->kind != kind || victim->command != command))
+            this->cache_stats.evictions++;
+
+        victim->kind = kind;
+        victim->command = command;
+        victim->len = len;
+        victim->ttl_ms = ttl_ms;
+        victim->fetched_us = bq40z80_time_us();
+        memcpy(victim->data, data, len);
+#else
+        (void)kind;
+        (void)command;
+        (void)data;
+        (void)len;
+#endif
+    }
+
+    void BQ40Z80::cache_invalidate(uint8_t kind, uint16_t command)
+    {
+#if BQ40Z80_CACHE_ENABLE
+        for (uint8_t i = 0; i < BQ40Z80_CACHE_ENTRIES; i++)
+        {
+            BQ40Z80_CACHE_ENTRY *e = &this->cache[i];
+            if (kind == BQ40Z80_CACHE_NONE ? e->ttl_ms != BQ40Z80_CACHE_TTL_FOREVER : (e->kind == kind && e->command == command))
+                e->kind = BQ40Z80_CACHE_NONE;
+        }
+#else
+        (void)kind;
+        (void)command;
+#endif
+    }
+
+    void BQ40Z80::cache_invalidate_capm()
+    {
+        // DesignCapacity is cached forever, only a BatteryMode write changes it
+        for (uint8_t i = 0; i < sizeof(CAPM_REGISTERS) / sizeof(CAPM_REGISTERS[0]); i++)
+            this->cache_invalidate(BQ40Z80_CACHE_SBS_WORD, CAPM_REGISTERS[i]);
+    }
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,312 @@
+#include "bq40z80_cell_history.h"
+
+/**
+ * @brief Running sums of one cell, turned into BQ40Z80_CELL_STATS at the end of analyse()
+ */
+typedef struct
+{
+    uint16_t min_mv;
+    uint16_t max_mv;
+    uint64_t sum;
+    uint64_t sum_sq;
+    uint64_t rest_sum;
+    uint64_t load_sum;
+    uint32_t resting;
+    uint32_t loaded;
+    int64_t dv_di;
+    int64_t di_di;
+    int64_t offset;           // distance above the average cell times 'cells', not balanced
+    int64_t offset_balancing; // same while balanced
+    uint32_t balancing;
+} CELL_ACC;
+
+/**
+ * @brief Extremes, moments and the rest/load split of one cell over a contiguous span
+ */
+static void cell_kernel(const uint16_t *v, const int16_t *i, uint32_t n, CELL_ACC *acc)
+{
+    uint16_t lo = acc->min_mv;
+    uint16_t hi = acc->max_mv;
+    uint64_t sum = 0, sum_sq = 0, rest_sum = 0, load_sum = 0;
+    uint32_t resting = 0, loaded = 0;
+
+    for (uint32_t k = 0; k < n; k++)
+    {
+        uint32_t mv = v[k];
+        int32_t ma = i[k];
+        uint32_t rest = ma > -BQ40Z80_CELL_REST_MA && ma < BQ40Z80_CELL_REST_MA;
+        uint32_t load = ma <= -BQ40Z80_CELL_LOAD_MA;
+        lo = mv < lo ? mv : lo;
+        hi = mv > hi ? mv : hi;
+        sum += mv;
+        sum_sq += mv * mv;
+        rest_sum += rest * mv;
+        load_sum += load * mv;
+        resting += rest;
+        loaded += load;
+    }
+
+    acc->min_mv = lo;
+    acc->max_mv = hi;
+    acc->sum += sum;
+    acc->sum_sq += sum_sq;
+    acc->rest_sum += rest_sum;
+    acc->load_sum += load_sum;
+    acc->resting += resting;
+    acc->loaded += loaded;
+}
+
+/**
+ * @brief Products of the voltage and current steps between consecutive samples of a contiguous span
+ * @note Differencing cancels the open-circuit voltage, which drifts slowly with the state of charge
+ */
+static void step_kernel(const uint16_t *v, const int16_t *i, uint32_t n, CELL_ACC *acc)
+{
+    int64_t dv_di = 0, di_di = 0;
+
+    for (uint32_t k = 1; k < n; k++)
+    {
+        int32_t dv = (int32_t)v[k] - v[k - 1];
+        int32_t di = (int32_t)i[k] - i[k - 1];
+        dv_di += (int64_t)dv * di;
+        di_di += (int64_t)di * di;
+    }
+    acc->dv_di += dv_di;
+    acc->di_di += di_di;
+}
+
+size_t BQ40Z80_CELL_HISTORY::arena_size(uint32_t capacity, uint8_t cells)
+{
+    // timestamp, balancing flags, then voltage, current and power per cell, aligned for the timestamps
+    return (size_t)capacity * (sizeof(int64_t) + sizeof(uint8_t) + cells * (sizeof(uint16_t) + sizeof(int16_t) + sizeof(int16_t))) +
+           alignof(int64_t) - 1;
+}
+
+BQ40Z80_CELL_HISTORY::BQ40Z80_CELL_HISTORY(void *arena, size_t size, uint8_t cells)
+{
+    this->cells = cells < 1 ? 1 : cells > BQ40Z80_CELLS ? BQ40Z80_CELLS : cells;
+
+    uintptr_t base = ((uintptr_t)arena + alignof(int64_t) - 1) & ~(uintptr_t)(alignof(int64_t) - 1);
+    size_t usable = size > base - (uintptr_t)arena ? size - (base - (uintptr_t)arena) : 0;
+    this->capacity = usable / (arena_size(1, this->cells) - (alignof(int64_t) - 1));
+
+    this->timestamp_us = (int64_t *)base;
+    this->voltage_mv = (uint16_t *)(this->timestamp_us + this->capacity);
+    this->current_ma = (int16_t *)(this->voltage_mv + this->cells * this->capacity);
+    this->power_cw = this->current_ma + this->cells * this->capacity;
+    this->balancing = (uint8_t *)(this->power_cw + this->cells * this->capacity);
+    this->head = 0;
+    this->held = 0;
+    bq40z80_mutex_init(&this->lock);
+}
+
+BQ40Z80_CELL_HISTORY::~BQ40Z80_CELL_HISTORY()
+{
+    bq40z80_mutex_deinit(&this->lock);
+}
+
+/***************************** Public Functions *****************************/
+
+void BQ40Z80_CELL_HISTORY::append(const BQ40Z80_CELL_SAMPLE *sample)
+{
+    if (this->capacity == 0)
+        return;
+
+    bq40z80_mutex_lock(&this->lock);
+    uint32_t slot = this->head;
+    this->timestamp_us[slot] = sample->timestamp_us;
+    this->balancing[slot] = sample->balancing;
+    for (uint8_t c = 0; c < this->cells; c++)
+    {
+        this->voltage_mv[c * this->capacity + slot] = sample->voltage_mv[c];
+        this->current_ma[c * this->capacity + slot] = sample->current_ma[c];
+        this->power_cw[c * this->capacity + slot] = sample->power_cw[c];
+    }
+    this->head = (slot + 1) % this->capacity;
+    if (this->held < this->capacity)
+        this->held++;
+    bq40z80_mutex_unlock(&this->lock);
+}
+
+void BQ40Z80_CELL_HISTORY::clear()
+{
+    bq40z80_mutex_lock(&this->lock);
+    this->head = 0;
+    this->held = 0;
+    bq40z80_mutex_unlock(&this->lock);
+}
+
+uint32_t BQ40Z80_CELL_HISTORY::count()
+{
+    bq40z80_mutex_lock(&this->lock);
+    uint32_t held = this->held;
+    bq40z80_mutex_unlock(&this->lock);
+    return held;
+}
+
+uint32_t BQ40Z80_CELL_HISTORY::get_capacity()
+{
+    return this->capacity;
+}
+
+bool BQ40Z80_CELL_HISTORY::get(uint32_t age, BQ40Z80_CELL_SAMPLE *sample)
+{
+    bq40z80_mutex_lock(&this->lock);
+    bool found = age < this->held;
+    if (found)
+    {
+        uint32_t slot = (this->head + this->capacity - 1 - age) % this->capacity;
+        memset(sample, 0, sizeof(BQ40Z80_CELL_SAMPLE));
+        sample->timestamp_us = this->timestamp_us[slot];
+        sample->balancing = this->balancing[slot];
+        for (uint8_t c = 0; c < this->cells; c++)
+        {
+            sample->voltage_mv[c] = this->voltage_mv[c * this->capacity + slot];
+            sample->current_ma[c] = this->current_ma[c * this->capacity + slot];
+            sample->power_cw[c] = this->power_cw[c * this->capacity + slot];
+        }
+    }
+    bq40z80_mutex_unlock(&this->lock);
+    return found;
+}
+
+void BQ40Z80_CELL_HISTORY::analyse(uint32_t window, BQ40Z80_CELL_ANALYSIS *analysis)
+{
+    int64_t start_us = bq40z80_time_us();
+    CELL_ACC acc[BQ40Z80_CELLS];
+    uint64_t spread_sum = 0;
+    uint16_t spread_max = 0;
+
+    memset(analysis, 0, sizeof(BQ40Z80_CELL_ANALYSIS));
+    memset(acc, 0, sizeof(acc));
+    for (uint8_t c = 0; c < BQ40Z80_CELLS; c++)
+        acc[c].min_mv = UINT16_MAX;
+
+    bq40z80_mutex_lock(&this->lock);
+    uint32_t n = window == 0 || window > this->held ? this->held : window;
+    uint8_t cells = this->cells;
+
+    // the window is one span, or two when it wraps around the end of the rows
+    uint32_t first = (this->head + this->capacity - n) % (this->capacity ? this->capacity : 1);
+    uint32_t span_start[2] = {first, 0};
+    uint32_t span_len[2] = {n < this->capacity - first ? n : this->capacity - first, 0};
+    span_len[1] = n - span_len[0];
+
+    for (uint8_t s = 0; s < 2; s++)
+    {
+        for (uint8_t c = 0; c < cells; c++)
+        {
+            const uint16_t *v = this->voltage_mv + c * this->capacity + span_start[s];
+            const int16_t *i = this->current_ma + c * this->capacity + span_start[s];
+            cell_kernel(v, i, span_len[s], &acc[c]);
+            step_kernel(v, i, span_len[s], &acc[c]);
+        }
+
+        // statistics across cells, one chunk of samples at a time
+        for (uint32_t offset = 0; offset < span_len[s]; offset += BQ40Z80_CELL_CHUNK)
+        {
+            uint32_t base = span_start[s] + offset;
+            uint32_t m = span_len[s] - offset < BQ40Z80_CELL_CHUNK ? span_len[s] - offset : BQ40Z80_CELL_CHUNK;
+            uint16_t lo[BQ40Z80_CELL_CHUNK], hi[BQ40Z80_CELL_CHUNK];
+            uint32_t sum[BQ40Z80_CELL_CHUNK];
+
+            const uint16_t *v0 = this->voltage_mv + base;
+            for (uint32_t k = 0; k < m; k++)
+            {
+                lo[k] = v0[k];
+                hi[k] = v0[k];
+                sum[k] = v0[k];
+            }
+            for (uint8_t c = 1; c < cells; c++)
+            {
+                const uint16_t *v = this->voltage_mv + c * this->capacity + base;
+                for (uint32_t k = 0; k < m; k++)
+                {
+                    lo[k] = v[k] < lo[k] ? v[k] : lo[k];
+                    hi[k] = v[k] > hi[k] ? v[k] : hi[k];
+                    sum[k] += v[k];
+                }
+            }
+            for (uint32_t k = 0; k < m; k++)
+            {
+                uint16_t spread = hi[k] - lo[k];
+                spread_sum += spread;
+                spread_max = spread > spread_max ? spread : spread_max;
+            }
+
+            const uint8_t *flags = this->balancing + base;
+            for (uint8_t c = 0; c < cells; c++)
+            {
+                const uint16_t *v = this->voltage_mv + c * this->capacity + base;
+                int64_t offset_idle = 0, offset_balancing = 0;
+                uint32_t balancing = 0;
+                for (uint32_t k = 0; k < m; k++)
+                {
+                    int32_t dev = (int32_t)v[k] * cells - (int32_t)sum[k];
+                    int32_t b = (flags[k] >> c) & 1;
+                    offset_balancing += b * dev;
+                    offset_idle += (1 - b) * dev;
+                    balancing += b;
+                }
+                acc[c].offset += offset_idle;
+                acc[c].offset_balancing += offset_balancing;
+                acc[c].balancing += balancing;
+            }
+        }
+    }
+
+    // the step across the wrap joins the two spans
+    if (span_len[0] > 0 && span_len[1] > 0)
+    {
+        for (uint8_t c = 0; c < cells; c++)
+        {
+            const uint16_t *v = this->voltage_mv + c * this->capacity;
+            const int16_t *i = this->current_ma + c * this->capacity;
+            int32_t dv = (int32_t)v[0] - v[this->capacity - 1];
+            int32_t di = (int32_t)i[0] - i[this->capacity - 1];
+            acc[c].dv_di += (int64_t)dv * di;
+            acc[c].di_di += (int64_t)di * di;
+        }
+    }
+    bq40z80_mutex_unlock(&this->lock);
+
+    analysis->samples = n;
+    analysis->cells = cells;
+    if (n > 0)
+    {
+        uint64_t lowest_mean = UINT64_MAX;
+        for (uint8_t c = 0; c < cells; c++)
+        {
+            BQ40Z80_CELL_STATS *stats = &analysis->cell[c];
+            const CELL_ACC *a = &acc[c];
+            // whole-millivolt division would truncate the mean by up to 1 mV, enough to swamp the variance
+            double mean = (double)a->sum / n;
+            double variance = (double)a->sum_sq / n - mean * mean;
+
+            stats->min_mv = a->min_mv;
+            stats->max_mv = a->max_mv;
+            stats->mean_mv = (uint16_t)(mean + 0.5);
+            stats->stddev_mv = (uint16_t)bq40z80_isqrt(variance > 0 ? (uint64_t)(variance + 0.5) : 0);
+            stats->loaded = a->loaded;
+            stats->resting = a->resting;
+            if (a->resting > 0 && a->loaded > 0)
+                stats->sag_mv = (int16_t)((int64_t)(a->rest_sum / a->resting) - (int64_t)(a->load_sum / a->loaded));
+            if (a->di_di >= (int64_t)BQ40Z80_CELL_STEP_MA * BQ40Z80_CELL_STEP_MA)
+                stats->resistance_uohm = (int32_t)((float)a->dv_di * 1000000.0f / (float)a->di_di);
+            stats->balancing = a->balancing;
+            if (n > a->balancing)
+                stats->offset_mv = (int16_t)(a->offset / ((int64_t)cells * (n - a->balancing)));
+            if (a->balancing > 0)
+                stats->offset_balancing_mv = (int16_t)(a->offset_balancing / ((int64_t)cells * a->balancing));
+
+            if (a->sum < lowest_mean)
+            {
+                lowest_mean = a->sum;
+                analysis->lowest_cell = c;
+            }
+        }
+        analysis->spread_max_mv = spread_max;
+        analysis->spread_mean_mv = (uint16_t)(spread_sum / n);
+    }
+    analysis->elapsed_us = (uint32_t)(bq40z80_time_us() - start_us);
+}
@@ -0,0 +1,52 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bq40z80.h"
+
+    void bq40z80_cells_gather(const DA_STATUS_1 *da1, const DA_STATUS_3 *da3, uint16_t cb_status, int64_t timestamp_us, BQ40Z80_CELL_SAMPLE *sample)
+    {
+        const uint16_t voltage[BQ40Z80_CELLS] = {da1->cell_voltage_1, da1->cell_voltage_2, da1->cell_voltage_3, da1->cell_voltage_4,
+                                                 da3->cell_voltage_5, da3->cell_voltage_6, da3->cell_voltage_7};
+        const int16_t current[BQ40Z80_CELLS] = {da1->cell_current_1, da1->cell_current_2, da1->cell_current_3, da1->cell_current_4,
+                                                da3->cell_current_5, da3->cell_current_6, da3->cell_current_7};
+        const int16_t power[BQ40Z80_CELLS] = {da1->cell_power_1, da1->cell_power_2, da1->cell_power_3, da1->cell_power_4,
+                                              da3->cell_power_5, da3->cell_power_6, da3->cell_power_7};
+
+        sample->timestamp_us = timestamp_us;
+        memcpy(sample->voltage_mv, voltage, sizeof(voltage));
+        memcpy(sample->current_ma, current, sizeof(current));
+        memcpy(sample->power_cw, power, sizeof(power));
+        sample->balancing = cb_status & ((1 << BQ40Z80_CELLS) - 1);
+    }
+
+    /***************************** Public Functions *****************************/
+
+    void BQ40Z80::read_cells(BQ40Z80_CELL_SAMPLE *sample)
+    {
+        ESP_ERROR_CHECK(this->try_read_cells(sample));
+    }
+
+    /***************************** Non-aborting Functions *****************************/
+
+    esp_err_t BQ40Z80::try_read_cells(BQ40Z80_CELL_SAMPLE *sample, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_CALL *outer = this->call_begin(call);
+        DA_STATUS_1 da1;
+        DA_STATUS_3 da3;
+        uint16_t cb_status;
+
+        esp_err_t err = this->try_read<BQ40Z80_REG_DAStatus1>(&da1);
+        if (err == ESP_OK)
+            err = this->try_read<BQ40Z80_REG_DAStatus3>(&da3);
+        if (err == ESP_OK)
+            err = this->try_read<BQ40Z80_REG_CBStatus>(&cb_status);
+        if (err == ESP_OK)
+            bq40z80_cells_gather(&da1, &da3, cb_status, bq40z80_time_us(), sample);
+        return this->call_end(outer, err);
+    }
+
+#ifdef __cplusplus
+}
+#endif
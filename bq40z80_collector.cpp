@@ -0,0 +1,113 @@
+#include "bq40z80_collector.h"
+
+#define FNV1A_OFFSET 0x811c9dc5u
+#define FNV1A_PRIME 0x01000193u
+
+static uint32_t fnv1a(const uint8_t *data, uint8_t len)
+{
+    uint32_t hash = FNV1A_OFFSET;
+    for (uint8_t i = 0; i < len; i++)
+        hash = (hash ^ data[i]) * FNV1A_PRIME;
+    return hash;
+}
+
+BQ40Z80_LIFETIME_COLLECTOR::BQ40Z80_LIFETIME_COLLECTOR(BQ40Z80 *gauge, uint32_t period_ms, bq40z80_lifetime_cb_t cb, void *arg)
+{
+    this->gauge = gauge;
+    this->period_ms = period_ms;
+    this->cb = cb;
+    this->arg = arg;
+    this->last_us = 0;
+    this->collected = false;
+    this->known = 0;
+    this->have_raw = 0;
+    memset(this->hashes, 0, sizeof(this->hashes));
+    memset(this->raw, 0, sizeof(this->raw));
+    memset(&this->stats, 0, sizeof(this->stats));
+}
+
+/***************************** Public Functions *****************************/
+
+esp_err_t BQ40Z80_LIFETIME_COLLECTOR::poll()
+{
+    if (this->collected && bq40z80_time_us() - this->last_us < (int64_t)this->period_ms * 1000)
+        return ESP_OK;
+    return this->collect();
+}
+
+esp_err_t BQ40Z80_LIFETIME_COLLECTOR::collect()
+{
+    uint8_t buf[BQ40Z80_LIFETIME_BLOCK_MAX];
+
+    for (uint8_t block = 1; block <= BQ40Z80_LIFETIME_BLOCKS; block++)
+    {
+        uint8_t index = block - 1;
+        uint8_t bit = 1 << index;
+        uint8_t size = bq40z80_lifetime_size(block);
+        BQ40Z80_CALL call = bq40z80_call_within(BQ40Z80_LIFETIME_BLOCK_TIMEOUT_MS * 1000, 0);
+
+        memset(buf, 0, sizeof(buf));
+        esp_err_t err = this->gauge->try_read_lifetime_block(block, buf, &call);
+        if (err != ESP_OK)
+            return err;
+        this->stats.blocks_read++;
+
+        uint32_t hash = fnv1a(buf, size);
+        if ((this->known & bit) && hash == this->hashes[index])
+        {
+            // same bytes as last time, or as the restored state, keep them for field diffs
+            if (!(this->have_raw & bit))
+                memcpy(this->raw[index], buf, size);
+            this->have_raw |= bit;
+            continue;
+        }
+
+        uint8_t count;
+        const BQ40Z80_LIFETIME_FIELD *fields = bq40z80_lifetime_fields(block, &count);
+        BQ40Z80_LIFETIME_UPDATE update;
+        update.block = block;
+        update.changed = 0;
+        update.raw = buf;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (!(this->have_raw & bit) || memcmp(buf + fields[i].offset, this->raw[index] + fields[i].offset, fields[i].width) != 0)
+            {
+                update.changed |= (uint32_t)1 << i;
+                this->stats.fields_changed++;
+            }
+        }
+
+        this->hashes[index] = hash;
+        this->known |= bit;
+        memcpy(this->raw[index], buf, size);
+        this->have_raw |= bit;
+
+        this->stats.blocks_changed++;
+        if (this->cb != NULL)
+            this->cb(&update, this->arg);
+    }
+
+    this->stats.collections++;
+    this->last_us = bq40z80_time_us();
+    this->collected = true;
+    return ESP_OK;
+}
+
+uint8_t BQ40Z80_LIFETIME_COLLECTOR::get_hashes(uint32_t *hashes) const
+{
+    memcpy(hashes, this->hashes, sizeof(this->hashes));
+    return this->known;
+}
+
+void BQ40Z80_LIFETIME_COLLECTOR::set_hashes(const uint32_t *hashes, uint8_t known)
+{
+    memcpy(this->hashes, hashes, sizeof(this->hashes));
+    this->known = known & ((1 << BQ40Z80_LIFETIME_BLOCKS) - 1);
+    // the bytes behind the restored hashes are unknown
+    this->have_raw = 0;
+}
+
+void BQ40Z80_LIFETIME_COLLECTOR::get_stats(BQ40Z80_LIFETIME_STATS *stats) const
+{
+    *stats = this->stats;
+}
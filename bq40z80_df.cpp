@@ -0,0 +1,160 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bq40z80.h"
+
+    static bool df_range(uint16_t address, size_t len)
+    {
+        return address >= BQ40Z80_DF_START && len <= BQ40Z80_DF_SIZE &&
+               (size_t)(address - BQ40Z80_DF_START) <= BQ40Z80_DF_SIZE - len;
+    }
+
+    /***************************** Public Functions *****************************/
+
+    void BQ40Z80::read_df(uint16_t address, uint8_t *data, size_t len)
+    {
+        ESP_ERROR_CHECK(this->try_read_df(address, data, len));
+    }
+
+    void BQ40Z80::write_df(uint16_t address, const uint8_t *image, size_t len, const uint16_t *expected_signature, BQ40Z80_DF_REPORT *report)
+    {
+        ESP_ERROR_CHECK(this->try_write_df(address, image, len, expected_signature, report));
+    }
+
+    uint16_t BQ40Z80::get_df_signature()
+    {
+        uint16_t buf;
+        ESP_ERROR_CHECK(this->try_get_df_signature(&buf));
+        return buf;
+    }
+
+    /***************************** Non-aborting Functions *****************************/
+
+    esp_err_t BQ40Z80::try_read_df(uint16_t address, uint8_t *data, size_t len, BQ40Z80_CALL *call)
+    {
+        if (!df_range(address, len))
+            return ESP_ERR_INVALID_ARG;
+
+        BQ40Z80_CALL *outer = this->call_begin(call);
+        uint8_t buf[BQ40Z80_DF_BLOCK];
+        esp_err_t err = ESP_OK;
+
+        // ManufacturerData() echoes the address, mfa_read_block() checks it like a command
+        for (size_t offset = 0; offset < len && err == ESP_OK; offset += BQ40Z80_DF_BLOCK)
+        {
+            size_t n = len - offset < BQ40Z80_DF_BLOCK ? len - offset : BQ40Z80_DF_BLOCK;
+            err = this->mfa_read_block(address + offset, buf, BQ40Z80_DF_BLOCK);
+            if (err == ESP_OK)
+                memcpy(data + offset, buf, n);
+        }
+        return this->call_end(outer, err);
+    }
+
+    esp_err_t BQ40Z80::try_write_df(uint16_t address, const uint8_t *image, size_t len, const uint16_t *expected_signature, BQ40Z80_DF_REPORT *report, BQ40Z80_CALL *call)
+    {
+        if (!df_range(address, len))
+            return ESP_ERR_INVALID_ARG;
+
+        BQ40Z80_CALL *outer = this->call_begin(call);
+        BQ40Z80_DF_REPORT work;
+        int64_t ready_us = 0;
+        esp_err_t err = ESP_OK;
+
+        memset(&work, 0, sizeof(work));
+        for (size_t offset = 0; offset < len && err == ESP_OK; offset += BQ40Z80_DF_BLOCK)
+        {
+            size_t n = len - offset < BQ40Z80_DF_BLOCK ? len - offset : BQ40Z80_DF_BLOCK;
+            err = this->df_sync_block(address + offset, image + offset, n, true, &ready_us, &work);
+        }
+
+        // data flash backs the static registers as well
+        if (work.blocks_dirty > 0)
+            this->invalidate_cache();
+
+        if (err == ESP_OK)
+            err = this->try_get_df_signature(&work.signature);
+        if (err == ESP_OK && expected_signature != NULL && work.signature != *expected_signature)
+        {
+            ESP_LOGE("BQ40Z80", "data flash signature 0x%04x, expected 0x%04x", work.signature, *expected_signature);
+            err = ESP_ERR_INVALID_CRC;
+        }
+
+        if (report != NULL)
+            *report = work;
+        return this->call_end(outer, err);
+    }
+
+    esp_err_t BQ40Z80::try_get_df_signature(uint16_t *val, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_CALL *outer = this->call_begin(call);
+        uint8_t buf[2] = {0};
+
+        // always computed afresh, a cached value may predate the last write
+        this->cache_invalidate(BQ40Z80_CACHE_MFA, BQ40Z80_MFA_ALL_DF_SIGNATURE);
+        esp_err_t err = this->mfa_read_block(BQ40Z80_MFA_ALL_DF_SIGNATURE, buf, 2);
+        if (err == ESP_OK)
+            *val = (buf[1] << 8) | buf[0];
+        return this->call_end(outer, err);
+    }
+
+    /***************************** Private Functions *****************************/
+
+    esp_err_t BQ40Z80::df_sync_block(uint16_t address, const uint8_t *target, uint8_t n, bool verify, int64_t *ready_us, BQ40Z80_DF_REPORT *work)
+    {
+        uint8_t device[BQ40Z80_DF_BLOCK];
+        uint8_t buf[2 + BQ40Z80_DF_WRITE_MAX];
+
+        // the gauge ignores the bus while it programs, the caller may work until then
+        this->call_sleep_until_us(*ready_us);
+        esp_err_t err = this->mfa_read_block(address, device, BQ40Z80_DF_BLOCK);
+        if (err != ESP_OK)
+            return err;
+        work->blocks++;
+
+        uint8_t first = 0, last = n;
+        while (first < n && device[first] == target[first])
+            first++;
+        if (first == n)
+            return ESP_OK;
+        while (device[last - 1] == target[last - 1])
+            last--;
+
+        // address + up to BQ40Z80_DF_WRITE_MAX bytes keeps each write within one SMBus block
+        for (uint8_t pos = first; pos < last && err == ESP_OK; pos += BQ40Z80_DF_WRITE_MAX)
+        {
+            uint8_t chunk = last - pos < BQ40Z80_DF_WRITE_MAX ? last - pos : BQ40Z80_DF_WRITE_MAX;
+            uint16_t addr = address + pos;
+            buf[0] = addr & 0x00ff;
+            buf[1] = addr >> 8;
+            memcpy(buf + 2, target + pos, chunk);
+            this->call_sleep_until_us(*ready_us);
+            err = this->smbus_write_block(BQ40Z80_SBS_ManufacturerBlockAccess, buf, 2 + chunk);
+            if (err == ESP_OK)
+            {
+                *ready_us = bq40z80_time_us() + BQ40Z80_DF_PROGRAM_US;
+                work->writes++;
+                work->bytes += chunk;
+            }
+        }
+        if (err != ESP_OK)
+            return err;
+        work->blocks_dirty++;
+
+        if (verify)
+        {
+            this->call_sleep_until_us(*ready_us);
+            err = this->mfa_read_block(address, device, BQ40Z80_DF_BLOCK);
+            if (err == ESP_OK && memcmp(device, target, n) != 0)
+            {
+                ESP_LOGE("BQ40Z80", "data flash 0x%04x didn't take the write, is the gauge sealed?", (unsigned)address);
+                err = ESP_ERR_INVALID_RESPONSE;
+            }
+        }
+        return err;
+    }
+
+#ifdef __cplusplus
+}
+#endif
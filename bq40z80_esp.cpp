@@ -0,0 +1,379 @@
+#if !defined(BQ40Z80_TRANSPORT_LINUX)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bq40z80.h"
+
+    /**
+     * @brief Convert the per-attempt timeout to FreeRTOS ticks, rounding up
+     */
+    static TickType_t timeout_ticks(uint32_t timeout_us)
+    {
+        TickType_t ticks = (timeout_us + portTICK_PERIOD_MS * 1000 - 1) / (portTICK_PERIOD_MS * 1000);
+        return ticks ? ticks : 1;
+    }
+
+    /**
+     * @brief Master configuration shared by the constructor and bus_set_freq()
+     */
+    static i2c_config_t master_config(uint8_t i2c_scl_io, uint8_t i2c_sda_io, uint32_t freq_hz)
+    {
+        i2c_config_t conf;
+        conf.mode = I2C_MODE_MASTER;
+        conf.sda_io_num = i2c_sda_io;
+        conf.scl_io_num = i2c_scl_io;
+        conf.sda_pullup_en = GPIO_PULLUP_ENABLE;
+        conf.scl_pullup_en = GPIO_PULLUP_ENABLE;
+        conf.master.clk_speed = freq_hz;
+        conf.clk_flags = I2C_SCLK_SRC_FLAG_FOR_NOMAL;
+        return conf;
+    }
+
+    BQ40Z80::BQ40Z80(uint8_t i2c_scl_io, uint8_t i2c_sda_io, i2c_port_t i2c_master_num, uint8_t device_address)
+    {
+        this->DEVICE_ADDRESS = device_address;
+        this->I2C_MASTER_NUM = i2c_master_num;
+        this->I2C_SCL_IO = i2c_scl_io;
+        this->I2C_SDA_IO = i2c_sda_io;
+
+        i2c_config_t conf = master_config(i2c_scl_io, i2c_sda_io, I2C_MASTER_FREQ_HZ);
+
+        ESP_ERROR_CHECK(i2c_param_config(i2c_master_num, &conf));
+
+        ESP_ERROR_CHECK(i2c_driver_install(i2c_master_num, conf.mode, I2C_MASTER_RX_BUF_DISABLE, I2C_MASTER_TX_BUF_DISABLE, 0));
+
+        this->bus = NULL;
+        this->MUX_CHANNEL = BQ40Z80_BUS_NO_MUX;
+        this->device_init();
+
+        // a missing gauge is not fatal here, the bus stays at I2C_MASTER_FREQ_HZ
+        esp_err_t err = this->try_negotiate_bus_speed();
+        if (err != ESP_OK)
+            ESP_LOGW("SMBus", "bus clock negotiation failed: %s", esp_err_to_name(err));
+    }
+
+    BQ40Z80::BQ40Z80(BQ40Z80_BUS *bus, uint8_t mux_channel, uint8_t device_address)
+    {
+        this->DEVICE_ADDRESS = device_address;
+        this->I2C_MASTER_NUM = bus->I2C_MASTER_NUM;
+        this->I2C_SCL_IO = bus->I2C_SCL_IO;
+        this->I2C_SDA_IO = bus->I2C_SDA_IO;
+        this->bus = bus;
+        this->MUX_CHANNEL = mux_channel;
+
+        this->device_init();
+        if (bus->attach(this) != ESP_OK)
+        {
+            // not half attached: no bus lock, no mux, and the port is left to the bus
+            this->bus = NULL;
+            this->unattached = true;
+            return;
+        }
+
+        // a missing gauge is not fatal here, it keeps the shared clock at I2C_MASTER_FREQ_HZ or below
+        esp_err_t err = this->try_negotiate_bus_speed();
+        if (err != ESP_OK)
+            ESP_LOGW("SMBus", "bus clock negotiation failed: %s", esp_err_to_name(err));
+    }
+
+    BQ40Z80::~BQ40Z80()
+    {
+        if (this->bus != NULL)
+            this->bus->detach(this);
+        else if (!this->unattached)
+            i2c_driver_delete(this->I2C_MASTER_NUM);
+        this->alert_deinit();
+        bq40z80_mutex_deinit(&this->lock);
+    }
+
+    BQ40Z80_BUS::BQ40Z80_BUS(uint8_t i2c_scl_io, uint8_t i2c_sda_io, i2c_port_t i2c_master_num, uint8_t mux_address)
+    {
+        this->I2C_MASTER_NUM = i2c_master_num;
+        this->I2C_SCL_IO = i2c_scl_io;
+        this->I2C_SDA_IO = i2c_sda_io;
+        this->MUX_ADDRESS = mux_address;
+
+        i2c_config_t conf = master_config(i2c_scl_io, i2c_sda_io, I2C_MASTER_FREQ_HZ);
+
+        ESP_ERROR_CHECK(i2c_param_config(i2c_master_num, &conf));
+
+        ESP_ERROR_CHECK(i2c_driver_install(i2c_master_num, conf.mode, I2C_MASTER_RX_BUF_DISABLE, I2C_MASTER_TX_BUF_DISABLE, 0));
+
+        bq40z80_mutex_init(&this->lock);
+        this->mux_channel = BQ40Z80_BUS_MUX_UNKNOWN;
+        this->mux_switches = 0;
+        this->freq_hz = I2C_MASTER_FREQ_HZ;
+        this->n_devices = 0;
+        this->next_device = 0;
+    }
+
+    BQ40Z80_BUS::~BQ40Z80_BUS()
+    {
+        i2c_driver_delete(this->I2C_MASTER_NUM);
+        bq40z80_mutex_deinit(&this->lock);
+    }
+
+    esp_err_t BQ40Z80::attach_alert(gpio_num_t pin)
+    {
+        this->detach_alert();
+
+        gpio_config_t conf = {};
+        conf.pin_bit_mask = 1ULL << pin;
+        conf.mode = GPIO_MODE_INPUT;
+        conf.pull_up_en = GPIO_PULLUP_ENABLE;
+        conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
+        conf.intr_type = GPIO_INTR_NEGEDGE;
+        esp_err_t err = gpio_config(&conf);
+        if (err != ESP_OK)
+            return err;
+
+        // the service may already be installed by the application
+        err = gpio_install_isr_service(0);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE)
+            return err;
+
+        err = gpio_isr_handler_add(pin, alert_isr, this);
+        if (err != ESP_OK)
+            return err;
+        this->ALERT_GPIO = pin;
+
+        // the line may have asserted before the handler was in place
+        if (gpio_get_level(pin) == 0)
+            this->notify_alert();
+        return ESP_OK;
+    }
+
+    void BQ40Z80::detach_alert()
+    {
+        if (this->ALERT_GPIO == GPIO_NUM_NC)
+            return;
+        gpio_isr_handler_remove(this->ALERT_GPIO);
+        this->ALERT_GPIO = GPIO_NUM_NC;
+    }
+
+    /***************************** Private Functions *****************************/
+
+    void IRAM_ATTR BQ40Z80::alert_isr(void *arg)
+    {
+        BQ40Z80 *gauge = (BQ40Z80 *)arg;
+        __atomic_store_n(&gauge->alert_pending, 1, __ATOMIC_RELEASE);
+        bq40z80_signal_give_from_isr(&gauge->alert);
+    }
+
+    esp_err_t BQ40Z80::bus_set_freq(uint32_t freq_hz)
+    {
+        i2c_config_t conf = master_config(this->I2C_SCL_IO, this->I2C_SDA_IO, freq_hz);
+        esp_err_t err = i2c_param_config(this->I2C_MASTER_NUM, &conf);
+        if (err == ESP_OK)
+            this->bus_freq_hz = freq_hz;
+        return err;
+    }
+
+    esp_err_t BQ40Z80::bus_read_word(uint8_t reg_addr, uint16_t *data)
+    {
+        esp_err_t err;
+        uint8_t buf[3];
+
+        err = i2c_master_write_read_device(this->I2C_MASTER_NUM, this->DEVICE_ADDRESS, &reg_addr, 1, buf, 2 + this->pec_enable, timeout_ticks(this->bus_timeout_us));
+        if (err == ESP_OK)
+            err = this->pec_check(reg_addr, buf, 2);
+
+        *data = (buf[1] << 8) | buf[0];
+
+        return err;
+    }
+
+    esp_err_t BQ40Z80::bus_write_word(uint8_t reg_addr, uint16_t data)
+    {
+        esp_err_t err;
+        uint8_t buf[3];
+        buf[0] = data & 0x00FF;
+        buf[1] = data >> 8;
+        buf[2] = this->pec_write(reg_addr, buf, 2);
+
+        i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(this->I2C_CMD_BUF, sizeof(this->I2C_CMD_BUF));
+        if (cmd == NULL)
+            return ESP_ERR_NO_MEM;
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (this->DEVICE_ADDRESS << 1) | I2C_MASTER_WRITE, true);
+        i2c_master_write_byte(cmd, reg_addr, true);
+        i2c_master_write(cmd, buf, 2 + this->pec_enable, true);
+        i2c_master_stop(cmd);
+
+        err = i2c_master_cmd_begin(this->I2C_MASTER_NUM, cmd, timeout_ticks(this->bus_timeout_us));
+        i2c_cmd_link_delete_static(cmd);
+
+        return err;
+    }
+
+    esp_err_t BQ40Z80::bus_read_block(uint8_t reg_addr, uint8_t *data, uint8_t len)
+    {
+        esp_err_t err;
+        uint8_t raw[1 + BQ40Z80_SMBUS_BLOCK_MAX + 1] = {0};
+
+        if (len > BQ40Z80_SMBUS_BLOCK_MAX)
+            return ESP_ERR_INVALID_SIZE;
+
+        i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(this->I2C_CMD_BUF, sizeof(this->I2C_CMD_BUF));
+        if (cmd == NULL)
+            return ESP_ERR_NO_MEM;
+
+        // count byte and the expected data in one transaction, the result is trimmed to the count
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, this->DEVICE_ADDRESS << 1 | I2C_MASTER_WRITE, true);
+        i2c_master_write_byte(cmd, reg_addr, true);
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, this->DEVICE_ADDRESS << 1 | I2C_MASTER_READ, true);
+        i2c_master_read(cmd, raw, 1 + len + this->pec_enable, I2C_MASTER_LAST_NACK);
+        i2c_master_stop(cmd);
+        err = i2c_master_cmd_begin(this->I2C_MASTER_NUM, cmd, timeout_ticks(this->bus_timeout_us));
+        i2c_cmd_link_delete_static(cmd);
+
+        if (err != ESP_OK)
+            return err;
+
+        return this->smbus_block_result(reg_addr, raw, data, len);
+    }
+
+    esp_err_t BQ40Z80::bus_write_block(uint8_t reg_addr, uint8_t *data, uint8_t len)
+    {
+        esp_err_t err;
+        uint8_t crc = bq40z80_pec(this->pec_write(reg_addr, &len, 1), data, len);
+
+        i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(this->I2C_CMD_BUF, sizeof(this->I2C_CMD_BUF));
+        if (cmd == NULL)
+            return ESP_ERR_NO_MEM;
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (this->DEVICE_ADDRESS << 1) | I2C_MASTER_WRITE, true);
+        i2c_master_write_byte(cmd, reg_addr, true);
+        i2c_master_write_byte(cmd, len, true);
+        i2c_master_write(cmd, data, len, true);
+        if (this->pec_enable)
+            i2c_master_write_byte(cmd, crc, true);
+        i2c_master_stop(cmd);
+
+        err = i2c_master_cmd_begin(this->I2C_MASTER_NUM, cmd, timeout_ticks(this->bus_timeout_us));
+        i2c_cmd_link_delete_static(cmd);
+
+        return err;
+    }
+
+    esp_err_t BQ40Z80::bus_mfa_read_block(uint16_t mfa_command, uint8_t *data, uint8_t len)
+    {
+        esp_err_t err;
+        uint8_t command[5];
+        uint8_t raw[1 + BQ40Z80_MFA_ECHO_LEN + BQ40Z80_SMBUS_BLOCK_MAX + 1] = {0};
+
+        if (len > BQ40Z80_SMBUS_BLOCK_MAX)
+            return ESP_ERR_INVALID_SIZE;
+
+        command[0] = BQ40Z80_SBS_ManufacturerBlockAccess;
+        command[1] = 2;
+        command[2] = mfa_command & 0x00ff;
+        command[3] = mfa_command >> 8;
+        command[4] = this->pec_write(command[0], command + 1, 3);
+
+        // the gauge executes the command on the STOP that ends its block write, a read joined to the write by
+        // a repeated START would get the result of the previous command
+        i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(this->I2C_CMD_BUF, sizeof(this->I2C_CMD_BUF));
+        if (cmd == NULL)
+            return ESP_ERR_NO_MEM;
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (this->DEVICE_ADDRESS << 1) | I2C_MASTER_WRITE, true);
+        i2c_master_write(cmd, command, 4 + this->pec_enable, true);
+        i2c_master_stop(cmd);
+        err = i2c_master_cmd_begin(this->I2C_MASTER_NUM, cmd, timeout_ticks(this->bus_timeout_us));
+        i2c_cmd_link_delete_static(cmd);
+
+        if (err != ESP_OK)
+            return err;
+
+        // block read of the echo and result, the command byte and the data joined by a repeated START
+        cmd = i2c_cmd_link_create_static(this->I2C_CMD_BUF, sizeof(this->I2C_CMD_BUF));
+        if (cmd == NULL)
+            return ESP_ERR_NO_MEM;
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (this->DEVICE_ADDRESS << 1) | I2C_MASTER_WRITE, true);
+        i2c_master_write_byte(cmd, BQ40Z80_SBS_ManufacturerData, true);
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, (this->DEVICE_ADDRESS << 1) | I2C_MASTER_READ, true);
+        i2c_master_read(cmd, raw, 1 + BQ40Z80_MFA_ECHO_LEN + len + this->pec_enable, I2C_MASTER_LAST_NACK);
+        i2c_master_stop(cmd);
+        err = i2c_master_cmd_begin(this->I2C_MASTER_NUM, cmd, timeout_ticks(this->bus_timeout_us));
+        i2c_cmd_link_delete_static(cmd);
+
+        if (err != ESP_OK)
+            return err;
+
+        return this->mfa_block_result(mfa_command, raw, data, len);
+    }
+
+    esp_err_t BQ40Z80::bus_write_raw(const uint8_t *data, uint8_t len)
+    {
+        return i2c_master_write_to_device(this->I2C_MASTER_NUM, this->DEVICE_ADDRESS, data, len, timeout_ticks(this->bus_timeout_us));
+    }
+
+    esp_err_t BQ40Z80::bus_read_raw(uint8_t reg_addr, uint8_t *data, uint8_t len)
+    {
+        return i2c_master_write_read_device(this->I2C_MASTER_NUM, this->DEVICE_ADDRESS, &reg_addr, 1, data, len, timeout_ticks(this->bus_timeout_us));
+    }
+
+    esp_err_t BQ40Z80::bus_sample_prepare(uint8_t reg_addr, uint8_t len)
+    {
+        if (len > sizeof(this->sample_raw))
+            return ESP_ERR_INVALID_SIZE;
+
+        i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(this->SAMPLE_CMD_BUF, sizeof(this->SAMPLE_CMD_BUF));
+        if (cmd == NULL)
+            return ESP_ERR_NO_MEM;
+
+        // the link is only walked by i2c_master_cmd_begin(), it runs again for every sample without rebuilding
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, this->DEVICE_ADDRESS << 1 | I2C_MASTER_WRITE, true);
+        i2c_master_write_byte(cmd, reg_addr, true);
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, this->DEVICE_ADDRESS << 1 | I2C_MASTER_READ, true);
+        i2c_master_read(cmd, this->sample_raw, len, I2C_MASTER_LAST_NACK);
+        i2c_master_stop(cmd);
+
+        this->sample_cmd = cmd;
+        this->sample_reg = reg_addr;
+        this->sample_len = len;
+        return ESP_OK;
+    }
+
+    esp_err_t BQ40Z80::bus_sample(uint8_t *raw)
+    {
+        esp_err_t err = i2c_master_cmd_begin(this->I2C_MASTER_NUM, this->sample_cmd, timeout_ticks(this->bus_timeout_us));
+        memcpy(raw, this->sample_raw, this->sample_len);
+        return err;
+    }
+
+    void BQ40Z80::bus_sample_release()
+    {
+        i2c_cmd_link_delete_static(this->sample_cmd);
+        this->sample_cmd = NULL;
+    }
+
+    esp_err_t BQ40Z80_BUS::mux_write(uint8_t value, uint32_t timeout_us)
+    {
+        return i2c_master_write_to_device(this->I2C_MASTER_NUM, this->MUX_ADDRESS, &value, 1, timeout_ticks(timeout_us));
+    }
+
+    esp_err_t BQ40Z80_BUS::set_freq(uint32_t freq_hz)
+    {
+        i2c_config_t conf = master_config(this->I2C_SCL_IO, this->I2C_SDA_IO, freq_hz);
+        esp_err_t err = i2c_param_config(this->I2C_MASTER_NUM, &conf);
+        if (err == ESP_OK)
+            this->freq_hz = freq_hz;
+        return err;
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bq40z80.h"
+
+    /**
+     * @brief Slot of a status word in event_values, -1 if untracked
+     */
+    static int8_t event_word(uint8_t reg_addr)
+    {
+        if (reg_addr == BQ40Z80_SBS_BatteryStatus)
+            return 0;
+        if (reg_addr >= BQ40Z80_SBS_SafetyAlert && reg_addr <= BQ40Z80_SBS_ManufacturingStatus)
+            return 1 + reg_addr - BQ40Z80_SBS_SafetyAlert;
+        return -1;
+    }
+
+    static uint8_t event_field(uint8_t word)
+    {
+        return word == 0 ? BQ40Z80_FIELD_BATTERY_STATUS : BQ40Z80_FIELD_SAFETY_ALERT + word - 1;
+    }
+
+    /***************************** Public Functions *****************************/
+
+    esp_err_t BQ40Z80::subscribe(uint8_t field, uint32_t mask, bq40z80_event_cb_t cb, void *arg)
+    {
+        if (cb == NULL || (field != BQ40Z80_FIELD_BATTERY_STATUS &&
+                           (field < BQ40Z80_FIELD_SAFETY_ALERT || field > BQ40Z80_FIELD_MANUFACTURING_STATUS)))
+            return ESP_ERR_INVALID_ARG;
+
+        esp_err_t err = ESP_ERR_NO_MEM;
+        bq40z80_mutex_lock(&this->lock);
+        for (uint8_t i = 0; i < BQ40Z80_EVENT_SUBSCRIBERS; i++)
+        {
+            BQ40Z80_EVENT_SUBSCRIBER *s = &this->subscribers[i];
+            if (s->cb == NULL)
+            {
+                s->cb = cb;
+                s->arg = arg;
+                s->field = field;
+                s->mask = mask;
+                err = ESP_OK;
+                break;
+            }
+        }
+        bq40z80_mutex_unlock(&this->lock);
+        return err;
+    }
+
+    void BQ40Z80::unsubscribe(bq40z80_event_cb_t cb, void *arg)
+    {
+        bq40z80_mutex_lock(&this->lock);
+        for (uint8_t i = 0; i < BQ40Z80_EVENT_SUBSCRIBERS; i++)
+        {
+            BQ40Z80_EVENT_SUBSCRIBER *s = &this->subscribers[i];
+            if (s->cb == cb && s->arg == arg)
+                s->cb = NULL;
+        }
+        bq40z80_mutex_unlock(&this->lock);
+    }
+
+    /***************************** Private Functions *****************************/
+
+    void BQ40Z80::events_init()
+    {
+        memset(this->subscribers, 0, sizeof(this->subscribers));
+        memset(this->event_values, 0, sizeof(this->event_values));
+    }
+
+    void BQ40Z80::event_observe(uint8_t reg_addr, const uint8_t *data, uint8_t len)
+    {
+        int8_t word = event_word(reg_addr);
+        if (word < 0)
+            return;
+
+        uint32_t value = 0;
+        for (uint8_t i = 0; i < len && i < 4; i++)
+            value |= (uint32_t)data[i] << (8 * i);
+
+        uint32_t changed = value ^ this->event_values[word];
+        if (changed == 0)
+            return;
+        this->event_values[word] = value;
+
+        // the table is copied so callbacks can (un)subscribe without upsetting the walk
+        BQ40Z80_EVENT_SUBSCRIBER subscribers[BQ40Z80_EVENT_SUBSCRIBERS];
+        memcpy(subscribers, this->subscribers, sizeof(subscribers));
+
+        BQ40Z80_EVENT event;
+        event.field = event_field(word);
+        event.value = value;
+        for (uint8_t i = 0; i < BQ40Z80_EVENT_SUBSCRIBERS; i++)
+        {
+            const BQ40Z80_EVENT_SUBSCRIBER *s = &subscribers[i];
+            if (s->cb == NULL || s->field != event.field || !(changed & s->mask))
+                continue;
+            event.set = changed & value & s->mask;
+            event.cleared = changed & ~value & s->mask;
+            s->cb(this, &event, s->arg);
+        }
+    }
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,379 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bq40z80.h"
+
+    int bq40z80_flash_read_file(void *arg, uint8_t *buf, size_t len)
+    {
+        FILE *file = (FILE *)arg;
+        size_t n = fread(buf, 1, len, file);
+        if (n == 0 && ferror(file))
+            return -1;
+        return (int)n;
+    }
+
+    /**
+     * @brief Pull the next line from the source into stream->line
+     * @param stream Line reader
+     * @param done Set once the source is exhausted, the line is then empty
+     * @return Error code
+     */
+    static esp_err_t stream_line(BQ40Z80_FLASH_STREAM *stream, bool *done)
+    {
+        size_t n = 0;
+
+        while (true)
+        {
+            if (stream->pos == stream->fill)
+            {
+                if (stream->end)
+                    break;
+                int got = stream->read(stream->arg, stream->chunk, BQ40Z80_FLASH_CHUNK);
+                if (got < 0)
+                {
+                    ESP_LOGE("BQ40Z80", "flash image read failed after line %u", (unsigned)stream->line_no);
+                    return ESP_FAIL;
+                }
+                stream->pos = 0;
+                stream->fill = got;
+                stream->end = got == 0;
+                continue;
+            }
+
+            char c = stream->chunk[stream->pos++];
+            if (c == '\n')
+                break;
+            if (c == '\r')
+                continue;
+            if (n == BQ40Z80_FLASH_LINE_MAX)
+            {
+                ESP_LOGE("BQ40Z80", "flash image line %u is longer than %u", (unsigned)stream->line_no + 1, BQ40Z80_FLASH_LINE_MAX);
+                return ESP_ERR_INVALID_SIZE;
+            }
+            stream->line[n++] = c;
+        }
+
+        stream->line[n] = '\0';
+        *done = n == 0 && stream->end && stream->pos == stream->fill;
+        if (!*done)
+            stream->line_no++;
+        return ESP_OK;
+    }
+
+    static esp_err_t bad_line(const BQ40Z80_FLASH_STREAM *stream)
+    {
+        ESP_LOGE("BQ40Z80", "flash image line %u is malformed: %s", (unsigned)stream->line_no, stream->line);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    static int hex_digit(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    /**
+     * @brief Parse space separated hex bytes, as on FlashStream lines
+     * @return Bytes parsed, -1 if a token isn't a two-digit hex byte or 'max' is exceeded
+     */
+    static int parse_bytes(const char *p, uint8_t *out, int max)
+    {
+        int n = 0;
+
+        while (true)
+        {
+            while (*p == ' ' || *p == '\t')
+                p++;
+            if (*p == '\0')
+                return n;
+
+            int hi = hex_digit(p[0]);
+            int lo = hi < 0 ? -1 : hex_digit(p[1]);
+            if (lo < 0 || (p[2] != '\0' && p[2] != ' ' && p[2] != '\t') || n == max)
+                return -1;
+            out[n++] = hi << 4 | lo;
+            p += 2;
+        }
+    }
+
+    /**
+     * @brief Parse a run of hex digits, as in S-records
+     * @return Bytes parsed, -1 on an odd count, a non-hex digit or 'max' exceeded
+     */
+    static int parse_hex(const char *p, uint8_t *out, int max)
+    {
+        int n = 0;
+
+        for (; *p != '\0'; p += 2)
+        {
+            int hi = hex_digit(p[0]);
+            int lo = hi < 0 ? -1 : hex_digit(p[1]);
+            if (lo < 0 || n == max)
+                return -1;
+            out[n++] = hi << 4 | lo;
+        }
+        return n;
+    }
+
+    static bool df_contains(uint32_t address, uint32_t len)
+    {
+        return address >= BQ40Z80_DF_START && address + len <= BQ40Z80_DF_START + BQ40Z80_DF_SIZE;
+    }
+
+    /***************************** Public Functions *****************************/
+
+    void BQ40Z80::flash(bq40z80_flash_read_t read, void *arg, const BQ40Z80_FLASH_OPTIONS *options, BQ40Z80_FLASH_REPORT *report)
+    {
+        ESP_ERROR_CHECK(this->try_flash(read, arg, options, report));
+    }
+
+    /***************************** Non-aborting Functions *****************************/
+
+    esp_err_t BQ40Z80::try_flash(bq40z80_flash_read_t read, void *arg, const BQ40Z80_FLASH_OPTIONS *options, BQ40Z80_FLASH_REPORT *report, BQ40Z80_CALL *call)
+    {
+        if (read == NULL || options->format > BQ40Z80_FLASH_SREC)
+            return ESP_ERR_INVALID_ARG;
+
+        BQ40Z80_CALL *outer = this->call_begin(call);
+        BQ40Z80_FLASH_REPORT work;
+        int64_t start_us = bq40z80_time_us();
+        esp_err_t err = ESP_OK;
+
+        memset(&work, 0, sizeof(work));
+
+        // an S-record covers the whole data flash, which StaticDFSignature() only partly does
+        bool srec = options->format == BQ40Z80_FLASH_SREC;
+        uint16_t *df_signature = srec ? &work.all_df_signature : &work.static_df_signature;
+        uint16_t expected_df_signature = srec ? options->all_df_signature : options->static_df_signature;
+
+        // a gauge that already runs the image costs two reads, one that can't answer is flashed anyway
+        if (options->check_signatures && this->flash_signatures(options->format, &work.instruction_signature, df_signature) == ESP_OK &&
+            work.instruction_signature == options->instruction_signature && *df_signature == expected_df_signature)
+            work.skipped = true;
+
+        if (!work.skipped)
+        {
+            BQ40Z80_FLASH_STREAM stream;
+            memset(&stream, 0, sizeof(stream));
+            stream.read = read;
+            stream.arg = arg;
+
+            if (options->format == BQ40Z80_FLASH_FS)
+            {
+                bool pec = this->pec_enable;
+                if (options->enter_rom_mode)
+                {
+                    err = this->smbus_write_word(BQ40Z80_SBS_ManufacturerAccess, BQ40Z80_MFA_ROM_MODE);
+                    if (err == ESP_OK)
+                        this->call_sleep_until_us(bq40z80_time_us() + (int64_t)BQ40Z80_FLASH_ROM_ENTRY_MS * 1000);
+                }
+
+                // the ROM speaks plain I2C, and the stream ends by restarting the firmware
+                this->pec_enable = false;
+                if (err == ESP_OK)
+                    err = this->flash_fs(&stream, &work);
+                this->pec_enable = pec;
+                if (err == ESP_OK)
+                    this->call_sleep_until_us(bq40z80_time_us() + (int64_t)BQ40Z80_FLASH_BOOT_MS * 1000);
+            }
+            else
+            {
+                err = this->flash_srec(&stream, &work);
+            }
+
+            // flash backs the static registers
+            this->invalidate_cache();
+
+            if (err == ESP_OK && options->check_signatures)
+                err = this->flash_signatures(options->format, &work.instruction_signature, df_signature);
+            if (err == ESP_OK && options->check_signatures &&
+                (work.instruction_signature != options->instruction_signature || *df_signature != expected_df_signature))
+            {
+                ESP_LOGE("BQ40Z80", "flash signatures 0x%04x/0x%04x, expected 0x%04x/0x%04x", work.instruction_signature,
+                         *df_signature, options->instruction_signature, expected_df_signature);
+                err = ESP_ERR_INVALID_CRC;
+            }
+        }
+
+        work.elapsed_us = bq40z80_time_us() - start_us;
+        if (report != NULL)
+            *report = work;
+        return this->call_end(outer, err);
+    }
+
+    /***************************** Private Functions *****************************/
+
+    esp_err_t BQ40Z80::flash_fs(BQ40Z80_FLASH_STREAM *stream, BQ40Z80_FLASH_REPORT *work)
+    {
+        uint8_t bytes[2 + BQ40Z80_FLASH_DATA_MAX]; // address, command, data
+        uint8_t device[BQ40Z80_FLASH_DATA_MAX];
+        int64_t ready_us = 0;
+        esp_err_t err;
+        bool done;
+
+        while ((err = stream_line(stream, &done)) == ESP_OK && !done)
+        {
+            work->lines++;
+            const char *line = stream->line;
+            while (*line == ' ' || *line == '\t')
+                line++;
+            if (*line == '\0' || *line == ';')
+                continue;
+            char op = line[0];
+            if (line[1] != ':')
+                return bad_line(stream);
+
+            if (op == 'X')
+            {
+                // the delay starts now and runs while the following lines are read and parsed
+                char *end;
+                unsigned long ms = strtoul(line + 2, &end, 10);
+                if (end == line + 2)
+                    return bad_line(stream);
+                int64_t now_us = bq40z80_time_us();
+                ready_us = (ready_us > now_us ? ready_us : now_us) + (int64_t)ms * 1000;
+                work->delay_ms += ms;
+                continue;
+            }
+
+            int n = parse_bytes(line + 2, bytes, sizeof(bytes));
+            if (n < 2 || bytes[0] != this->DEVICE_ADDRESS << 1)
+                return bad_line(stream);
+
+            this->call_sleep_until_us(ready_us);
+            switch (op)
+            {
+            case 'W':
+                err = this->smbus_write_raw(bytes + 1, n - 1);
+                if (err == ESP_OK)
+                {
+                    work->writes++;
+                    work->bytes += n - 2;
+                }
+                break;
+            case 'C':
+                if (n < 3)
+                    return bad_line(stream);
+                err = this->smbus_read_raw(bytes[1], device, n - 2);
+                if (err == ESP_OK && memcmp(device, bytes + 2, n - 2) != 0)
+                {
+                    ESP_LOGE("BQ40Z80", "flash image line %u: the gauge returned different data", (unsigned)stream->line_no);
+                    err = ESP_ERR_INVALID_RESPONSE;
+                }
+                break;
+            case 'R':
+                if (n != 3 || bytes[2] == 0 || bytes[2] > BQ40Z80_FLASH_DATA_MAX)
+                    return bad_line(stream);
+                err = this->smbus_read_raw(bytes[1], device, bytes[2]);
+                break;
+            default:
+                return bad_line(stream);
+            }
+            if (err != ESP_OK)
+                return err;
+        }
+
+        this->call_sleep_until_us(ready_us);
+        return err;
+    }
+
+    esp_err_t BQ40Z80::flash_srec(BQ40Z80_FLASH_STREAM *stream, BQ40Z80_FLASH_REPORT *work)
+    {
+        uint8_t record[BQ40Z80_FLASH_LINE_MAX / 2];
+        uint8_t row[BQ40Z80_DF_BLOCK];
+        uint16_t row_start = 0;
+        uint8_t row_len = 0;
+        BQ40Z80_DF_REPORT df;
+        int64_t ready_us = 0;
+        esp_err_t err;
+        bool done;
+
+        // rows are written without read-back while the next one is parsed, the signatures verify the whole
+        memset(&df, 0, sizeof(df));
+        while ((err = stream_line(stream, &done)) == ESP_OK && !done)
+        {
+            work->lines++;
+            if (stream->line[0] == '\0')
+                continue;
+            if (stream->line[0] != 'S')
+                return bad_line(stream);
+
+            // S0 header, S1/S2/S3 data with a 16/24/32-bit address, S5/S6 count, S7/S8/S9 start address
+            static const uint8_t ADDRESS_LEN[10] = {2, 2, 3, 4, 0, 2, 3, 4, 3, 2};
+            char type = stream->line[1];
+            int n = parse_hex(stream->line + 2, record, sizeof(record));
+            if (type < '0' || type > '9' || type == '4' || n < 1 || record[0] != n - 1 || n < 2 + ADDRESS_LEN[type - '0'])
+                return bad_line(stream);
+            uint8_t sum = 0;
+            for (int i = 0; i < n; i++)
+                sum += record[i];
+            if (sum != 0xff)
+                return bad_line(stream);
+            if (type < '1' || type > '3')
+                continue;
+
+            uint8_t address_len = ADDRESS_LEN[type - '0'];
+            uint32_t address = 0;
+            for (uint8_t i = 0; i < address_len; i++)
+                address = address << 8 | record[1 + i];
+            const uint8_t *data = record + 1 + address_len;
+            uint8_t len = n - 2 - address_len;
+            if (len > 0 && !df_contains(address, len))
+            {
+                ESP_LOGE("BQ40Z80", "flash image line %u: 0x%lx is outside data flash, flash the firmware from its FlashStream",
+                         (unsigned)stream->line_no, (unsigned long)address);
+                return ESP_ERR_NOT_SUPPORTED;
+            }
+
+            for (uint8_t i = 0; i < len; i++)
+            {
+                uint16_t addr = address + i;
+                if (row_len > 0 && (addr != row_start + row_len || (addr - BQ40Z80_DF_START) % BQ40Z80_DF_BLOCK == 0))
+                {
+                    err = this->df_sync_block(row_start, row, row_len, false, &ready_us, &df);
+                    row_len = 0;
+                    if (err != ESP_OK)
+                        return err;
+                }
+                if (row_len == 0)
+                    row_start = addr;
+                row[row_len++] = data[i];
+            }
+        }
+        if (err == ESP_OK && row_len > 0)
+            err = this->df_sync_block(row_start, row, row_len, false, &ready_us, &df);
+        this->call_sleep_until_us(ready_us);
+
+        work->rows = df.blocks;
+        work->rows_skipped = df.blocks - df.blocks_dirty;
+        work->writes = df.writes;
+        work->bytes = df.bytes;
+        return err;
+    }
+
+    esp_err_t BQ40Z80::flash_signatures(uint8_t format, uint16_t *instruction, uint16_t *df)
+    {
+        uint16_t df_command = format == BQ40Z80_FLASH_SREC ? BQ40Z80_MFA_ALL_DF_SIGNATURE : BQ40Z80_MFA_STATIC_DF_SIGNATURE;
+        uint8_t buf[2] = {0};
+
+        // computed afresh, a cached value may predate the flash
+        this->cache_invalidate(BQ40Z80_CACHE_MFA, BQ40Z80_MFA_INSTRUCTION_FLASH_SIGNATURE);
+        this->cache_invalidate(BQ40Z80_CACHE_MFA, df_command);
+        esp_err_t err = this->mfa_read_block(BQ40Z80_MFA_INSTRUCTION_FLASH_SIGNATURE, buf, 2);
+        *instruction = (buf[1] << 8) | buf[0];
+        if (err == ESP_OK)
+            err = this->mfa_read_block(df_command, buf, 2);
+        *df = (buf[1] << 8) | buf[0];
+        return err;
+    }
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,270 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <stddef.h>
+
+#include "bq40z80.h"
+
+#define FIELD(type, member, is_signed) {#member, offsetof(type, member), sizeof(((type *)0)->member), is_signed}
+
+    static const BQ40Z80_LIFETIME_FIELD LIFETIME_1[] = {
+        FIELD(LIFETIME_DATA_1, cell_1_max_voltage, false),
+        FIELD(LIFETIME_DATA_1, cell_2_max_voltage, false),
+        FIELD(LIFETIME_DATA_1, cell_3_max_voltage, false),
+        FIELD(LIFETIME_DATA_1, cell_4_max_voltage, false),
+        FIELD(LIFETIME_DATA_1, cell_5_max_voltage, false),
+        FIELD(LIFETIME_DATA_1, cell_6_max_voltage, false),
+        FIELD(LIFETIME_DATA_1, cell_7_max_voltage, false),
+        FIELD(LIFETIME_DATA_1, cell_1_min_voltage, false),
+        FIELD(LIFETIME_DATA_1, cell_2_min_voltage, false),
+        FIELD(LIFETIME_DATA_1, cell_3_min_voltage, false),
+        FIELD(LIFETIME_DATA_1, cell_4_min_voltage, false),
+        FIELD(LIFETIME_DATA_1, cell_5_min_voltage, false),
+        FIELD(LIFETIME_DATA_1, cell_6_min_voltage, false),
+        FIELD(LIFETIME_DATA_1, cell_7_min_voltage, false),
+        FIELD(LIFETIME_DATA_1, max_delta_cell_voltage, false),
+        FIELD(LIFETIME_DATA_1, max_charge_current, true),
+    };
+
+    static const BQ40Z80_LIFETIME_FIELD LIFETIME_2[] = {
+        FIELD(LIFETIME_DATA_2, cov_events, false),
+        FIELD(LIFETIME_DATA_2, last_cov_event, false),
+        FIELD(LIFETIME_DATA_2, cuv_events, false),
+        FIELD(LIFETIME_DATA_2, last_cuv_event, false),
+        FIELD(LIFETIME_DATA_2, ocd1_events, false),
+        FIELD(LIFETIME_DATA_2, last_ocd1_event, false),
+        FIELD(LIFETIME_DATA_2, ocd2_events, false),
+        FIELD(LIFETIME_DATA_2, last_ocd2_event, false),
+        FIELD(LIFETIME_DATA_2, occ1_events, false),
+        FIELD(LIFETIME_DATA_2, last_occ1_event, false),
+        FIELD(LIFETIME_DATA_2, occ2_events, false),
+        FIELD(LIFETIME_DATA_2, last_occ2_event, false),
+        FIELD(LIFETIME_DATA_2, aold_events, false),
+        FIELD(LIFETIME_DATA_2, last_aold_event, false),
+        FIELD(LIFETIME_DATA_2, ascd_events, false),
+        FIELD(LIFETIME_DATA_2, last_ascd_event, false),
+    };
+
+    static const BQ40Z80_LIFETIME_FIELD LIFETIME_3[] = {
+        FIELD(LIFETIME_DATA_3, ascc_events, false),
+        FIELD(LIFETIME_DATA_3, last_ascc_event, false),
+        FIELD(LIFETIME_DATA_3, otc_events, false),
+        FIELD(LIFETIME_DATA_3, last_otc_event, false),
+        FIELD(LIFETIME_DATA_3, otd_events, false),
+        FIELD(LIFETIME_DATA_3, last_otd_event, false),
+        FIELD(LIFETIME_DATA_3, otf_events, false),
+        FIELD(LIFETIME_DATA_3, last_otf_event, false),
+        FIELD(LIFETIME_DATA_3, valid_charge_terminations, false),
+        FIELD(LIFETIME_DATA_3, last_valid_charge_termination, false),
+        FIELD(LIFETIME_DATA_3, qmax_updates, false),
+        FIELD(LIFETIME_DATA_3, last_qmax_update, false),
+        FIELD(LIFETIME_DATA_3, ra_updates, false),
+        FIELD(LIFETIME_DATA_3, last_ra_update, false),
+        FIELD(LIFETIME_DATA_3, ra_disables, false),
+        FIELD(LIFETIME_DATA_3, last_ra_disable, false),
+    };
+
+    static const BQ40Z80_LIFETIME_FIELD LIFETIME_4[] = {
+        FIELD(LIFETIME_DATA_4, total_fw_runtime, false),
+        FIELD(LIFETIME_DATA_4, time_ut, false),
+        FIELD(LIFETIME_DATA_4, time_lt, false),
+        FIELD(LIFETIME_DATA_4, time_stl, false),
+        FIELD(LIFETIME_DATA_4, time_rt, false),
+        FIELD(LIFETIME_DATA_4, time_sth, false),
+        FIELD(LIFETIME_DATA_4, time_ht, false),
+        FIELD(LIFETIME_DATA_4, time_ot, false),
+    };
+
+    static const BQ40Z80_LIFETIME_FIELD LIFETIME_5[] = {
+        FIELD(LIFETIME_DATA_5, shutdowns, false),
+        FIELD(LIFETIME_DATA_5, partial_resets, false),
+        FIELD(LIFETIME_DATA_5, full_resets, false),
+        FIELD(LIFETIME_DATA_5, wdt_resets, false),
+        FIELD(LIFETIME_DATA_5, cb_time_cell_1, false),
+        FIELD(LIFETIME_DATA_5, cb_time_cell_2, false),
+        FIELD(LIFETIME_DATA_5, cb_time_cell_3, false),
+        FIELD(LIFETIME_DATA_5, cb_time_cell_4, false),
+        FIELD(LIFETIME_DATA_5, cb_time_cell_5, false),
+        FIELD(LIFETIME_DATA_5, cb_time_cell_6, false),
+        FIELD(LIFETIME_DATA_5, cb_time_cell_7, false),
+    };
+
+#undef FIELD
+
+    static const struct
+    {
+        const BQ40Z80_LIFETIME_FIELD *fields;
+        uint8_t count;
+        uint8_t size;
+    } LIFETIME_BLOCKS[BQ40Z80_LIFETIME_BLOCKS] = {
+        {LIFETIME_1, sizeof(LIFETIME_1) / sizeof(LIFETIME_1[0]), sizeof(LIFETIME_DATA_1)},
+        {LIFETIME_2, sizeof(LIFETIME_2) / sizeof(LIFETIME_2[0]), sizeof(LIFETIME_DATA_2)},
+        {LIFETIME_3, sizeof(LIFETIME_3) / sizeof(LIFETIME_3[0]), sizeof(LIFETIME_DATA_3)},
+        {LIFETIME_4, sizeof(LIFETIME_4) / sizeof(LIFETIME_4[0]), sizeof(LIFETIME_DATA_4)},
+        {LIFETIME_5, sizeof(LIFETIME_5) / sizeof(LIFETIME_5[0]), sizeof(LIFETIME_DATA_5)},
+    };
+
+    // the struct offsets double as wire offsets, padding would break the tables
+    static_assert(sizeof(LIFETIME_DATA_1) == 32, "LIFETIME_DATA_1 must match the wire layout");
+    static_assert(sizeof(LIFETIME_DATA_2) == 32, "LIFETIME_DATA_2 must match the wire layout");
+    static_assert(sizeof(LIFETIME_DATA_3) == 32, "LIFETIME_DATA_3 must match the wire layout");
+    static_assert(sizeof(LIFETIME_DATA_4) == 32, "LIFETIME_DATA_4 must match the wire layout");
+    static_assert(sizeof(LIFETIME_DATA_5) == 32, "LIFETIME_DATA_5 must match the wire layout");
+
+    uint8_t bq40z80_lifetime_size(uint8_t block)
+    {
+        if (block < 1 || block > BQ40Z80_LIFETIME_BLOCKS)
+            return 0;
+        return LIFETIME_BLOCKS[block - 1].size;
+    }
+
+    const BQ40Z80_LIFETIME_FIELD *bq40z80_lifetime_fields(uint8_t block, uint8_t *count)
+    {
+        if (block < 1 || block > BQ40Z80_LIFETIME_BLOCKS)
+        {
+            *count = 0;
+            return NULL;
+        }
+        *count = LIFETIME_BLOCKS[block - 1].count;
+        return LIFETIME_BLOCKS[block - 1].fields;
+    }
+
+    int64_t bq40z80_lifetime_value(const BQ40Z80_LIFETIME_FIELD *field, const uint8_t *raw)
+    {
+        uint32_t val = 0;
+        for (uint8_t i = field->width; i > 0; i--)
+            val = (val << 8) | raw[field->offset + i - 1];
+
+        if (field->is_signed && field->width < 4)
+        {
+            uint32_t sign = 1u << (field->width * 8 - 1);
+            return (int64_t)(int32_t)((val ^ sign) - sign);
+        }
+        return field->is_signed ? (int64_t)(int32_t)val : (int64_t)val;
+    }
+
+    void bq40z80_lifetime_decode(uint8_t block, const uint8_t *raw, void *data)
+    {
+        uint8_t count;
+        const BQ40Z80_LIFETIME_FIELD *fields = bq40z80_lifetime_fields(block, &count);
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            uint8_t *dst = (uint8_t *)data + fields[i].offset;
+            uint32_t val = (uint32_t)bq40z80_lifetime_value(&fields[i], raw);
+            if (fields[i].width == 1)
+                *dst = (uint8_t)val;
+            else if (fields[i].width == 2)
+                *(uint16_t *)dst = (uint16_t)val;
+            else
+                *(uint32_t *)dst = val;
+        }
+    }
+
+    void bq40z80_lifetime_encode(uint8_t block, const void *data, uint8_t *raw)
+    {
+        uint8_t count;
+        const BQ40Z80_LIFETIME_FIELD *fields = bq40z80_lifetime_fields(block, &count);
+
+        for (uint8_t i = 0; i < count; i++)
+        {
+            const uint8_t *src = (const uint8_t *)data + fields[i].offset;
+            uint32_t val;
+            if (fields[i].width == 1)
+                val = *src;
+            else if (fields[i].width == 2)
+                val = *(const uint16_t *)src;
+            else
+                val = *(const uint32_t *)src;
+            for (uint8_t j = 0; j < fields[i].width; j++)
+                raw[fields[i].offset + j] = val >> (8 * j);
+        }
+    }
+
+    /***************************** Public Functions *****************************/
+
+    void BQ40Z80::read_lifetime_data_1(LIFETIME_DATA_1 *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_lifetime_data_1(data));
+    }
+
+    void BQ40Z80::read_lifetime_data_2(LIFETIME_DATA_2 *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_lifetime_data_2(data));
+    }
+
+    void BQ40Z80::read_lifetime_data_3(LIFETIME_DATA_3 *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_lifetime_data_3(data));
+    }
+
+    void BQ40Z80::read_lifetime_data_4(LIFETIME_DATA_4 *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_lifetime_data_4(data));
+    }
+
+    void BQ40Z80::read_lifetime_data_5(LIFETIME_DATA_5 *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_lifetime_data_5(data));
+    }
+
+    void BQ40Z80::read_lifetime_block(uint8_t block, uint8_t *raw)
+    {
+        ESP_ERROR_CHECK(this->try_read_lifetime_block(block, raw));
+    }
+
+    /***************************** Non-aborting Functions *****************************/
+
+    esp_err_t BQ40Z80::try_read_lifetime_data_1(LIFETIME_DATA_1 *data, BQ40Z80_CALL *call)
+    {
+        return this->try_read_lifetime(1, data, call);
+    }
+
+    esp_err_t BQ40Z80::try_read_lifetime_data_2(LIFETIME_DATA_2 *data, BQ40Z80_CALL *call)
+    {
+        return this->try_read_lifetime(2, data, call);
+    }
+
+    esp_err_t BQ40Z80::try_read_lifetime_data_3(LIFETIME_DATA_3 *data, BQ40Z80_CALL *call)
+    {
+        return this->try_read_lifetime(3, data, call);
+    }
+
+    esp_err_t BQ40Z80::try_read_lifetime_data_4(LIFETIME_DATA_4 *data, BQ40Z80_CALL *call)
+    {
+        return this->try_read_lifetime(4, data, call);
+    }
+
+    esp_err_t BQ40Z80::try_read_lifetime_data_5(LIFETIME_DATA_5 *data, BQ40Z80_CALL *call)
+    {
+        return this->try_read_lifetime(5, data, call);
+    }
+
+    esp_err_t BQ40Z80::try_read_lifetime_block(uint8_t block, uint8_t *raw, BQ40Z80_CALL *call)
+    {
+        uint8_t size = bq40z80_lifetime_size(block);
+        if (size == 0)
+            return ESP_ERR_INVALID_ARG;
+
+        BQ40Z80_CALL *outer = this->call_begin(call);
+        esp_err_t err = this->mfa_read_block(BQ40Z80_MFA_LIFETIME_DATA_BLOCK_1 + block - 1, raw, size);
+        return this->call_end(outer, err);
+    }
+
+    /***************************** Private Functions *****************************/
+
+    esp_err_t BQ40Z80::try_read_lifetime(uint8_t block, void *data, BQ40Z80_CALL *call)
+    {
+        uint8_t raw[BQ40Z80_LIFETIME_BLOCK_MAX] = {0};
+
+        esp_err_t err = this->try_read_lifetime_block(block, raw, call);
+        if (err == ESP_OK)
+            bq40z80_lifetime_decode(block, raw, data);
+        return err;
+    }
+
+#ifdef __cplusplus
+}
+#endif
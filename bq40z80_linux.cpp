@@ -0,0 +1,425 @@
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bq40z80.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+    static int libc_open(const char *path, int flags)
+    {
+        return open(path, flags);
+    }
+
+    static int libc_ioctl(int fd, unsigned long request, void *arg)
+    {
+        return ioctl(fd, request, arg);
+    }
+
+    static int libc_close(int fd)
+    {
+        return close(fd);
+    }
+
+    static int libc_read(int fd, void *buf, size_t len)
+    {
+        return read(fd, buf, len);
+    }
+
+    static const BQ40Z80_LINUX_IO LIBC_IO = {libc_open, libc_ioctl, libc_close, libc_read};
+    static const BQ40Z80_LINUX_IO *linux_io = &LIBC_IO;
+
+    void bq40z80_linux_set_io(const BQ40Z80_LINUX_IO *io)
+    {
+        linux_io = io ? io : &LIBC_IO;
+    }
+
+    static esp_err_t errno_to_err(int e)
+    {
+        switch (e)
+        {
+        case ETIMEDOUT:
+            return ESP_ERR_TIMEOUT;
+        case EBADMSG:
+            return ESP_ERR_INVALID_CRC;
+        case EMSGSIZE:
+        case EPROTO:
+            return ESP_ERR_INVALID_SIZE;
+        case ENOMEM:
+            return ESP_ERR_NO_MEM;
+        default:
+            return ESP_FAIL; // ENXIO, EREMOTEIO, EIO: NACK or arbitration lost
+        }
+    }
+
+    /**
+     * @brief Clock of an adapter, the kernel's standard mode default if the device tree has none
+     * @note clock-frequency is a big-endian u32 device tree property
+     */
+    static uint32_t adapter_freq_hz(i2c_port_t i2c_adapter)
+    {
+        char path[64];
+        uint8_t raw[4];
+
+        snprintf(path, sizeof(path), "/sys/bus/i2c/devices/i2c-%d/of_node/clock-frequency", i2c_adapter);
+        int fd = linux_io->open(path, O_RDONLY);
+        if (fd < 0)
+            return BQ40Z80_BUS_FREQ_STD_HZ;
+        int n = linux_io->read(fd, raw, sizeof(raw));
+        linux_io->close(fd);
+        if (n != sizeof(raw))
+            return BQ40Z80_BUS_FREQ_STD_HZ;
+
+        uint32_t freq_hz = (uint32_t)raw[0] << 24 | (uint32_t)raw[1] << 16 | (uint32_t)raw[2] << 8 | raw[3];
+        return freq_hz ? freq_hz : BQ40Z80_BUS_FREQ_STD_HZ;
+    }
+
+    BQ40Z80::BQ40Z80(i2c_port_t i2c_adapter, uint8_t device_address)
+    {
+        char path[32];
+        unsigned long funcs = 0;
+
+        this->DEVICE_ADDRESS = device_address;
+        this->I2C_MASTER_NUM = i2c_adapter;
+
+        snprintf(path, sizeof(path), "/dev/i2c-%d", i2c_adapter);
+        this->I2C_FD = linux_io->open(path, O_RDWR);
+        if (this->I2C_FD < 0)
+        {
+            ESP_LOGE("SMBus", "failed to open %s: %s", path, strerror(errno));
+            ESP_ERROR_CHECK(ESP_ERR_NOT_FOUND);
+        }
+
+        if (linux_io->ioctl(this->I2C_FD, I2C_FUNCS, &funcs) < 0 || !(funcs & I2C_FUNC_I2C))
+        {
+            ESP_LOGE("SMBus", "%s doesn't support I2C_RDWR", path);
+            ESP_ERROR_CHECK(ESP_ERR_NOT_SUPPORTED);
+        }
+        this->I2C_RECV_LEN = funcs & I2C_FUNC_SMBUS_READ_BLOCK_DATA;
+        this->I2C_TIMEOUT_US = 0; // applied by the first transfer
+        this->bus = NULL;
+        this->MUX_CHANNEL = BQ40Z80_BUS_NO_MUX;
+
+        this->device_init();
+        this->bus_freq_hz = adapter_freq_hz(i2c_adapter);
+
+        // a gauge slower than the adapter is reported, not fatal
+        esp_err_t err = this->try_negotiate_bus_speed();
+        if (err != ESP_OK)
+            ESP_LOGW("SMBus", "bus clock negotiation failed: %s", esp_err_to_name(err));
+    }
+
+    BQ40Z80::BQ40Z80(BQ40Z80_BUS *bus, uint8_t mux_channel, uint8_t device_address)
+    {
+        this->DEVICE_ADDRESS = device_address;
+        this->I2C_MASTER_NUM = bus->I2C_MASTER_NUM;
+        this->I2C_FD = bus->I2C_FD;
+        this->I2C_RECV_LEN = bus->I2C_RECV_LEN;
+        this->I2C_TIMEOUT_US = 0;
+        this->bus = bus;
+        this->MUX_CHANNEL = mux_channel;
+
+        this->device_init();
+        if (bus->attach(this) != ESP_OK)
+        {
+            // not half attached: no bus lock, no mux, and the port is left to the bus
+            this->bus = NULL;
+            this->unattached = true;
+            return;
+        }
+
+        esp_err_t err = this->try_negotiate_bus_speed();
+        if (err != ESP_OK)
+            ESP_LOGW("SMBus", "bus clock negotiation failed: %s", esp_err_to_name(err));
+    }
+
+    BQ40Z80::~BQ40Z80()
+    {
+        if (this->bus != NULL)
+            this->bus->detach(this);
+        else if (!this->unattached)
+            linux_io->close(this->I2C_FD);
+        this->alert_deinit();
+        bq40z80_mutex_deinit(&this->lock);
+    }
+
+    BQ40Z80_BUS::BQ40Z80_BUS(i2c_port_t i2c_adapter, uint8_t mux_address)
+    {
+        char path[32];
+        unsigned long funcs = 0;
+
+        this->I2C_MASTER_NUM = i2c_adapter;
+        this->MUX_ADDRESS = mux_address;
+
+        snprintf(path, sizeof(path), "/dev/i2c-%d", i2c_adapter);
+        this->I2C_FD = linux_io->open(path, O_RDWR);
+        if (this->I2C_FD < 0)
+        {
+            ESP_LOGE("SMBus", "failed to open %s: %s", path, strerror(errno));
+            ESP_ERROR_CHECK(ESP_ERR_NOT_FOUND);
+        }
+
+        if (linux_io->ioctl(this->I2C_FD, I2C_FUNCS, &funcs) < 0 || !(funcs & I2C_FUNC_I2C))
+        {
+            ESP_LOGE("SMBus", "%s doesn't support I2C_RDWR", path);
+            ESP_ERROR_CHECK(ESP_ERR_NOT_SUPPORTED);
+        }
+        this->I2C_RECV_LEN = funcs & I2C_FUNC_SMBUS_READ_BLOCK_DATA;
+        this->I2C_TIMEOUT_US = 0;
+        this->freq_hz = adapter_freq_hz(i2c_adapter);
+
+        bq40z80_mutex_init(&this->lock);
+        this->mux_channel = BQ40Z80_BUS_MUX_UNKNOWN;
+        this->mux_switches = 0;
+        this->n_devices = 0;
+        this->next_device = 0;
+    }
+
+    BQ40Z80_BUS::~BQ40Z80_BUS()
+    {
+        linux_io->close(this->I2C_FD);
+        bq40z80_mutex_deinit(&this->lock);
+    }
+
+    /***************************** Private Functions *****************************/
+
+    esp_err_t BQ40Z80::i2c_transfer(struct i2c_msg *msgs, uint32_t n_msgs)
+    {
+        struct i2c_rdwr_ioctl_data rdwr;
+        rdwr.msgs = msgs;
+        rdwr.nmsgs = n_msgs;
+
+        // I2C_TIMEOUT is in units of 10 ms, only pay the extra syscall when the per-attempt timeout changes.
+        // It belongs to the file descriptor, which attached gauges share with their bus.
+        uint32_t *applied_us = this->bus != NULL ? &this->bus->I2C_TIMEOUT_US : &this->I2C_TIMEOUT_US;
+        if (this->bus_timeout_us != *applied_us)
+        {
+            unsigned long timeout = (this->bus_timeout_us + 9999) / 10000;
+            linux_io->ioctl(this->I2C_FD, I2C_TIMEOUT, (void *)(uintptr_t)timeout);
+            *applied_us = this->bus_timeout_us;
+        }
+
+        if (linux_io->ioctl(this->I2C_FD, I2C_RDWR, &rdwr) < 0)
+            return errno_to_err(errno);
+
+        return ESP_OK;
+    }
+
+    esp_err_t BQ40Z80::bus_set_freq(uint32_t freq_hz)
+    {
+        // the adapter clock comes from the kernel driver or device tree, userspace can't change it.
+        // Any limit at or above it is met already.
+        if (freq_hz >= this->bus_freq_hz)
+            return ESP_OK;
+        ESP_LOGW("SMBus", "adapter clock %u Hz is above %u Hz", (unsigned)this->bus_freq_hz, (unsigned)freq_hz);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    esp_err_t BQ40Z80::bus_read_word(uint8_t reg_addr, uint16_t *data)
+    {
+        esp_err_t err;
+        uint8_t buf[3] = {0};
+        struct i2c_msg msgs[2] = {
+            {this->DEVICE_ADDRESS, 0, 1, &reg_addr},
+            {this->DEVICE_ADDRESS, I2C_M_RD, (uint16_t)(2 + this->pec_enable), buf},
+        };
+
+        err = this->i2c_transfer(msgs, 2);
+        if (err == ESP_OK)
+            err = this->pec_check(reg_addr, buf, 2);
+
+        *data = (buf[1] << 8) | buf[0];
+
+        return err;
+    }
+
+    esp_err_t BQ40Z80::bus_write_word(uint8_t reg_addr, uint16_t data)
+    {
+        uint8_t buf[4];
+        buf[0] = reg_addr;
+        buf[1] = data & 0x00FF;
+        buf[2] = data >> 8;
+        buf[3] = this->pec_write(reg_addr, buf + 1, 2);
+
+        struct i2c_msg msg = {this->DEVICE_ADDRESS, 0, (uint16_t)(3 + this->pec_enable), buf};
+
+        return this->i2c_transfer(&msg, 1);
+    }
+
+    esp_err_t BQ40Z80::bus_read_block(uint8_t reg_addr, uint8_t *data, uint8_t len)
+    {
+        esp_err_t err;
+        uint8_t raw[1 + I2C_SMBUS_BLOCK_MAX + 1] = {0};
+        struct i2c_msg msgs[2] = {
+            {this->DEVICE_ADDRESS, 0, 1, &reg_addr},
+            {this->DEVICE_ADDRESS, I2C_M_RD, 0, raw},
+        };
+
+        if (len > I2C_SMBUS_BLOCK_MAX)
+            return ESP_ERR_INVALID_SIZE;
+
+        // With I2C_M_RECV_LEN the adapter reads the count byte first and extends the message by itself.
+        // i2c-dev takes the bytes beyond the data, count and PEC, from buf[0] and wants room for a full
+        // block after them. Otherwise read the expected length plus the count byte in the same transaction.
+        if (this->I2C_RECV_LEN)
+        {
+            msgs[1].flags |= I2C_M_RECV_LEN;
+            msgs[1].len = sizeof(raw);
+            raw[0] = 1 + this->pec_enable;
+        }
+        else
+        {
+            msgs[1].len = 1 + len + this->pec_enable;
+        }
+
+        err = this->i2c_transfer(msgs, 2);
+        if (err != ESP_OK)
+            return err;
+
+        return this->smbus_block_result(reg_addr, raw, data, len);
+    }
+
+    esp_err_t BQ40Z80::bus_write_block(uint8_t reg_addr, uint8_t *data, uint8_t len)
+    {
+        uint8_t buf[2 + I2C_SMBUS_BLOCK_MAX + 1];
+
+        if (len > I2C_SMBUS_BLOCK_MAX)
+            return ESP_ERR_INVALID_SIZE;
+
+        buf[0] = reg_addr;
+        buf[1] = len;
+        memcpy(buf + 2, data, len);
+        buf[2 + len] = this->pec_write(reg_addr, buf + 1, 1 + len);
+
+        struct i2c_msg msg = {this->DEVICE_ADDRESS, 0, (uint16_t)(2 + len + this->pec_enable), buf};
+
+        return this->i2c_transfer(&msg, 1);
+    }
+
+    esp_err_t BQ40Z80::bus_mfa_read_block(uint16_t mfa_command, uint8_t *data, uint8_t len)
+    {
+        esp_err_t err;
+        uint8_t command[5];
+        uint8_t reg_addr = BQ40Z80_SBS_ManufacturerData;
+        uint8_t raw[1 + BQ40Z80_MFA_ECHO_LEN + BQ40Z80_SMBUS_BLOCK_MAX + 1] = {0};
+
+        if (len > BQ40Z80_SMBUS_BLOCK_MAX)
+            return ESP_ERR_INVALID_SIZE;
+
+        command[0] = BQ40Z80_SBS_ManufacturerBlockAccess;
+        command[1] = 2;
+        command[2] = mfa_command & 0x00ff;
+        command[3] = mfa_command >> 8;
+        command[4] = this->pec_write(command[0], command + 1, 3);
+
+        // the gauge executes the command on the STOP that ends its block write, a read joined to the write by
+        // a repeated START would get the result of the previous command
+        struct i2c_msg write = {this->DEVICE_ADDRESS, 0, (uint16_t)(4 + this->pec_enable), command};
+        err = this->i2c_transfer(&write, 1);
+        if (err != ESP_OK)
+            return err;
+
+        // block read of the echo and result, the command byte and the data joined by a repeated START
+        struct i2c_msg msgs[2] = {
+            {this->DEVICE_ADDRESS, 0, 1, &reg_addr},
+            {this->DEVICE_ADDRESS, I2C_M_RD, 0, raw},
+        };
+
+        // I2C_M_RECV_LEN rejects counts above I2C_SMBUS_BLOCK_MAX, which 32-byte results plus the echo reach
+        if (this->I2C_RECV_LEN && BQ40Z80_MFA_ECHO_LEN + len <= I2C_SMBUS_BLOCK_MAX)
+        {
+            msgs[1].flags |= I2C_M_RECV_LEN;
+            msgs[1].len = sizeof(raw);
+            raw[0] = 1 + this->pec_enable;
+        }
+        else
+        {
+            msgs[1].len = 1 + BQ40Z80_MFA_ECHO_LEN + len + this->pec_enable;
+        }
+
+        err = this->i2c_transfer(msgs, 2);
+        if (err != ESP_OK)
+            return err;
+
+        return this->mfa_block_result(mfa_command, raw, data, len);
+    }
+
+    esp_err_t BQ40Z80::bus_write_raw(const uint8_t *data, uint8_t len)
+    {
+        struct i2c_msg msg = {this->DEVICE_ADDRESS, 0, len, (uint8_t *)data};
+
+        return this->i2c_transfer(&msg, 1);
+    }
+
+    esp_err_t BQ40Z80::bus_read_raw(uint8_t reg_addr, uint8_t *data, uint8_t len)
+    {
+        struct i2c_msg msgs[2] = {
+            {this->DEVICE_ADDRESS, 0, 1, &reg_addr},
+            {this->DEVICE_ADDRESS, I2C_M_RD, len, data},
+        };
+
+        return this->i2c_transfer(msgs, 2);
+    }
+
+    esp_err_t BQ40Z80::bus_sample_prepare(uint8_t reg_addr, uint8_t len)
+    {
+        // i2c-dev copies the messages in on every call, there is nothing to build ahead
+        this->sample_reg = reg_addr;
+        this->sample_len = len;
+        return ESP_OK;
+    }
+
+    esp_err_t BQ40Z80::bus_sample(uint8_t *raw)
+    {
+        struct i2c_msg msgs[2] = {
+            {this->DEVICE_ADDRESS, 0, 1, &this->sample_reg},
+            {this->DEVICE_ADDRESS, I2C_M_RD, this->sample_len, raw},
+        };
+
+        return this->i2c_transfer(msgs, 2);
+    }
+
+    void BQ40Z80::bus_sample_release()
+    {
+    }
+
+    esp_err_t BQ40Z80_BUS::mux_write(uint8_t value, uint32_t timeout_us)
+    {
+        struct i2c_msg msg = {this->MUX_ADDRESS, 0, 1, &value};
+        struct i2c_rdwr_ioctl_data rdwr;
+        rdwr.msgs = &msg;
+        rdwr.nmsgs = 1;
+
+        if (timeout_us != this->I2C_TIMEOUT_US)
+        {
+            unsigned long timeout = (timeout_us + 9999) / 10000;
+            linux_io->ioctl(this->I2C_FD, I2C_TIMEOUT, (void *)(uintptr_t)timeout);
+            this->I2C_TIMEOUT_US = timeout_us;
+        }
+
+        if (linux_io->ioctl(this->I2C_FD, I2C_RDWR, &rdwr) < 0)
+            return errno_to_err(errno);
+        return ESP_OK;
+    }
+
+    esp_err_t BQ40Z80_BUS::set_freq(uint32_t freq_hz)
+    {
+        if (freq_hz >= this->freq_hz)
+            return ESP_OK;
+        ESP_LOGW("SMBus", "adapter clock %u Hz is above %u Hz", (unsigned)this->freq_hz, (unsigned)freq_hz);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,82 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bq40z80.h"
+
+    typedef struct
+    {
+        uint8_t v[256];
+    } PEC_TABLE;
+
+    static constexpr PEC_TABLE pec_table()
+    {
+        PEC_TABLE table = {};
+        for (int i = 0; i < 256; i++)
+        {
+            uint8_t crc = i;
+            for (int bit = 0; bit < 8; bit++)
+                crc = crc & 0x80 ? (uint8_t)(crc << 1) ^ BQ40Z80_PEC_POLYNOMIAL : (uint8_t)(crc << 1);
+            table.v[i] = crc;
+        }
+        return table;
+    }
+
+    static constexpr PEC_TABLE PEC = pec_table();
+
+    static_assert(PEC.v[1] == BQ40Z80_PEC_POLYNOMIAL, "PEC table is not generated at compile time");
+
+    uint8_t bq40z80_pec(uint8_t crc, const uint8_t *data, size_t len)
+    {
+        for (size_t i = 0; i < len; i++)
+            crc = PEC.v[crc ^ data[i]];
+        return crc;
+    }
+
+    /***************************** Public Functions *****************************/
+
+    void BQ40Z80::set_pec(bool enable)
+    {
+        bq40z80_mutex_lock(&this->lock);
+        this->pec_enable = enable;
+        bq40z80_mutex_unlock(&this->lock);
+    }
+
+    bool BQ40Z80::get_pec()
+    {
+        return this->pec_enable;
+    }
+
+    /***************************** Private Functions *****************************/
+
+    uint8_t BQ40Z80::pec_write(uint8_t reg_addr, const uint8_t *data, uint8_t len)
+    {
+        uint8_t header[2] = {(uint8_t)(this->DEVICE_ADDRESS << 1), reg_addr};
+        return bq40z80_pec(bq40z80_pec(0, header, 2), data, len);
+    }
+
+    uint8_t BQ40Z80::pec_read(uint8_t reg_addr, const uint8_t *data, uint8_t len)
+    {
+        uint8_t header[3] = {(uint8_t)(this->DEVICE_ADDRESS << 1), reg_addr, (uint8_t)(this->DEVICE_ADDRESS << 1 | 1)};
+        return bq40z80_pec(bq40z80_pec(0, header, 3), data, len);
+    }
+
+    esp_err_t BQ40Z80::pec_check(uint8_t reg_addr, const uint8_t *data, uint8_t len)
+    {
+        if (!this->pec_enable)
+            return ESP_OK;
+
+        // 'data' is followed by the PEC byte the device appended
+        uint8_t crc = this->pec_read(reg_addr, data, len);
+        if (crc != data[len])
+        {
+            ESP_LOGW("SMBus", "PEC mismatch on 0x%02x: got 0x%02x, expected 0x%02x", reg_addr, data[len], crc);
+            return ESP_ERR_INVALID_CRC;
+        }
+        return ESP_OK;
+    }
+
+#ifdef __cplusplus
+}
+#endif
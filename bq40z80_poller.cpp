@@ -0,0 +1,195 @@
+#include "bq40z80_poller.h"
+
+BQ40Z80_POLLER::BQ40Z80_POLLER(BQ40Z80 *gauge, bq40z80_field_mask_t fields, uint32_t period_ms)
+{
+    this->gauge = gauge;
+    this->recorder = NULL;
+    this->scheduler = NULL;
+    memset(&this->latest, 0, sizeof(this->latest));
+    this->period_ms = period_ms;
+    this->sequence = 0;
+    this->seq.store(0, std::memory_order_relaxed);
+    for (size_t i = 0; i < WORDS; i++)
+        this->words[i].store(0, std::memory_order_relaxed);
+    this->n_failures.store(0, std::memory_order_relaxed);
+    this->running.store(false, std::memory_order_relaxed);
+#if !defined(BQ40Z80_TRANSPORT_LINUX)
+    this->task = NULL;
+    this->stopped = NULL;
+#endif
+
+    bq40z80_plan_query(fields, &this->plan);
+}
+
+BQ40Z80_POLLER::~BQ40Z80_POLLER()
+{
+    this->stop();
+}
+
+/***************************** Public Functions *****************************/
+
+esp_err_t BQ40Z80_POLLER::start()
+{
+    if (this->running.exchange(true))
+        return ESP_ERR_INVALID_STATE;
+
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+    this->thread = std::thread(task_entry, this);
+#else
+    this->stopped = xSemaphoreCreateBinary();
+    if (this->stopped == NULL || xTaskCreate(task_entry, "bq40z80_poller", BQ40Z80_POLLER_STACK_SIZE, this, BQ40Z80_POLLER_PRIORITY, &this->task) != pdPASS)
+    {
+        if (this->stopped != NULL)
+            vSemaphoreDelete(this->stopped);
+        this->stopped = NULL;
+        this->running.store(false);
+        return ESP_ERR_NO_MEM;
+    }
+#endif
+    return ESP_OK;
+}
+
+void BQ40Z80_POLLER::stop()
+{
+    if (!this->running.exchange(false))
+        return;
+
+    // the task notices the flag at its next period at the latest
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+    this->thread.join();
+#else
+    xSemaphoreTake(this->stopped, portMAX_DELAY);
+    vSemaphoreDelete(this->stopped);
+    this->stopped = NULL;
+    this->task = NULL;
+#endif
+}
+
+esp_err_t BQ40Z80_POLLER::poll_once()
+{
+    BQ40Z80_SNAPSHOT snapshot;
+    // a poll may take up to its period, clamped to the 32-bit deadline of a call (about 71 minutes)
+    uint64_t timeout_us = (uint64_t)this->period_ms * 1000;
+    BQ40Z80_CALL call = bq40z80_call_within(timeout_us < UINT32_MAX ? timeout_us : UINT32_MAX, 0);
+    call.fresh = true;
+
+    esp_err_t err;
+
+    if (this->scheduler != NULL)
+    {
+        bq40z80_field_mask_t due = this->scheduler->due(this->plan.fields, bq40z80_time_us());
+        if (due == 0)
+            return ESP_OK;
+        err = this->gauge->try_read_fields(due, &snapshot.telemetry, &call);
+        if (err == ESP_OK)
+        {
+            this->scheduler->update(call.started_us, call.elapsed_us, &snapshot.telemetry);
+            for (uint8_t i = 0; i < BQ40Z80_FIELD_COUNT; i++)
+                if (snapshot.telemetry.valid & BQ40Z80_FIELD_MASK(i))
+                    bq40z80_set_field(&this->latest, i, bq40z80_get_field(&snapshot.telemetry, i));
+            this->latest.valid |= snapshot.telemetry.valid;
+            snapshot.telemetry = this->latest;
+        }
+    }
+    else
+    {
+        err = this->gauge->try_read_fields(&this->plan, &snapshot.telemetry, &call);
+    }
+    if (err != ESP_OK)
+    {
+        this->n_failures.fetch_add(1, std::memory_order_relaxed);
+        return err;
+    }
+
+    snapshot.sequence = ++this->sequence;
+    snapshot.timestamp_us = call.started_us;
+    snapshot.duration_us = call.elapsed_us;
+    this->publish(&snapshot);
+    if (this->recorder != NULL)
+        this->recorder->append(snapshot.timestamp_us, &snapshot.telemetry);
+    return ESP_OK;
+}
+
+bool BQ40Z80_POLLER::read(BQ40Z80_SNAPSHOT *snapshot) const
+{
+    uint32_t buf[WORDS];
+    uint32_t begin, end;
+
+    do
+    {
+        begin = this->seq.load(std::memory_order_acquire);
+        for (size_t i = 0; i < WORDS; i++)
+            buf[i] = this->words[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        end = this->seq.load(std::memory_order_relaxed);
+    } while ((begin & 1) || begin != end);
+
+    if (begin == 0)
+        return false;
+
+    memcpy(snapshot, buf, sizeof(BQ40Z80_SNAPSHOT));
+    return true;
+}
+
+uint32_t BQ40Z80_POLLER::failures() const
+{
+    return this->n_failures.load(std::memory_order_relaxed);
+}
+
+void BQ40Z80_POLLER::set_recorder(BQ40Z80_RECORDER *recorder)
+{
+    this->recorder = recorder;
+}
+
+void BQ40Z80_POLLER::set_scheduler(BQ40Z80_SCHEDULER *scheduler)
+{
+    this->scheduler = scheduler;
+    memset(&this->latest, 0, sizeof(this->latest));
+}
+
+/***************************** Private Functions *****************************/
+
+void BQ40Z80_POLLER::publish(const BQ40Z80_SNAPSHOT *snapshot)
+{
+    uint32_t buf[WORDS] = {0};
+    memcpy(buf, snapshot, sizeof(BQ40Z80_SNAPSHOT));
+
+    // single writer: readers retry while the counter is odd or has moved
+    uint32_t s = this->seq.load(std::memory_order_relaxed);
+    this->seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < WORDS; i++)
+        this->words[i].store(buf[i], std::memory_order_relaxed);
+    this->seq.store(s + 2, std::memory_order_release);
+}
+
+void BQ40Z80_POLLER::run()
+{
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+    auto next = std::chrono::steady_clock::now();
+    while (this->running.load())
+    {
+        this->poll_once();
+        next += std::chrono::milliseconds(this->period_ms);
+        std::this_thread::sleep_until(next);
+    }
+#else
+    TickType_t last_wake = xTaskGetTickCount();
+    TickType_t period = pdMS_TO_TICKS(this->period_ms);
+    while (this->running.load())
+    {
+        this->poll_once();
+        vTaskDelayUntil(&last_wake, period ? period : 1);
+    }
+#endif
+}
+
+void BQ40Z80_POLLER::task_entry(void *arg)
+{
+    BQ40Z80_POLLER *poller = (BQ40Z80_POLLER *)arg;
+    poller->run();
+#if !defined(BQ40Z80_TRANSPORT_LINUX)
+    xSemaphoreGive(poller->stopped);
+    vTaskDelete(NULL);
+#endif
+}
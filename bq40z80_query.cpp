@@ -0,0 +1,418 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bq40z80.h"
+
+    typedef enum
+    {
+        SOURCE_SBS_WORD,  //!< SMBus read word
+        SOURCE_SBS_BLOCK, //!< SMBus read block
+        SOURCE_MFA_BLOCK, //!< ManufacturerBlockAccess() write followed by ManufacturerData() read
+    } source_kind_t;
+
+    typedef struct
+    {
+        uint8_t field;  //!< bq40z80_field_t
+        uint8_t offset; //!< Byte offset in the received data
+        uint8_t width;  //!< Little-endian width in bytes
+    } source_field_t;
+
+    typedef struct
+    {
+        source_kind_t kind;
+        uint16_t command; //!< SBS or MFA command
+        uint8_t len;      //!< Data length, excluding the block length byte and MFA command echo
+        uint8_t n_fields;
+        source_field_t map[7];
+    } source_t;
+
+    static const source_t SOURCES[] = {
+        {SOURCE_SBS_WORD, BQ40Z80_SBS_Temperature, 2, 1, {{BQ40Z80_FIELD_TEMPERATURE, 0, 2}}},
+        {SOURCE_SBS_WORD, BQ40Z80_SBS_Voltage, 2, 1, {{BQ40Z80_FIELD_VOLTAGE, 0, 2}}},
+        {SOURCE_SBS_WORD, BQ40Z80_SBS_Current, 2, 1, {{BQ40Z80_FIELD_CURRENT, 0, 2}}},
+        {SOURCE_SBS_WORD, BQ40Z80_SBS_AverageCurrent, 2, 1, {{BQ40Z80_FIELD_AVERAGE_CURRENT, 0, 2}}},
+        {SOURCE_SBS_WORD, BQ40Z80_SBS_RelativeStateOfCharge, 2, 1, {{BQ40Z80_FIELD_RSOC, 0, 1}}},
+        {SOURCE_SBS_WORD, BQ40Z80_SBS_RemainingCapacity, 2, 1, {{BQ40Z80_FIELD_REMAINING_CAPACITY, 0, 2}}},
+        {SOURCE_SBS_WORD, BQ40Z80_SBS_FullChargeCapacity, 2, 1, {{BQ40Z80_FIELD_FULL_CHARGE_CAPACITY, 0, 2}}},
+        {SOURCE_SBS_WORD, BQ40Z80_SBS_BatteryStatus, 2, 1, {{BQ40Z80_FIELD_BATTERY_STATUS, 0, 2}}},
+        {SOURCE_SBS_WORD, BQ40Z80_SBS_CellVoltage4, 2, 1, {{BQ40Z80_FIELD_CELL_VOLTAGE_4, 0, 2}}},
+        {SOURCE_SBS_WORD, BQ40Z80_SBS_CellVoltage5, 2, 1, {{BQ40Z80_FIELD_CELL_VOLTAGE_5, 0, 2}}},
+        {SOURCE_SBS_WORD, BQ40Z80_SBS_CellVoltage6, 2, 1, {{BQ40Z80_FIELD_CELL_VOLTAGE_6, 0, 2}}},
+        {SOURCE_SBS_WORD, BQ40Z80_SBS_CellVoltage7, 2, 1, {{BQ40Z80_FIELD_CELL_VOLTAGE_7, 0, 2}}},
+        {SOURCE_SBS_BLOCK, BQ40Z80_SBS_SafetyAlert, 4, 1, {{BQ40Z80_FIELD_SAFETY_ALERT, 0, 4}}},
+        {SOURCE_SBS_BLOCK, BQ40Z80_SBS_SafetyStatus, 4, 1, {{BQ40Z80_FIELD_SAFETY_STATUS, 0, 4}}},
+        {SOURCE_SBS_BLOCK, BQ40Z80_SBS_PFAlert, 4, 1, {{BQ40Z80_FIELD_PF_ALERT, 0, 4}}},
+        {SOURCE_SBS_BLOCK, BQ40Z80_SBS_PFStatus, 4, 1, {{BQ40Z80_FIELD_PF_STATUS, 0, 4}}},
+        {SOURCE_SBS_BLOCK, BQ40Z80_SBS_OperationStatus, 4, 1, {{BQ40Z80_FIELD_OPERATION_STATUS, 0, 4}}},
+        {SOURCE_SBS_BLOCK, BQ40Z80_SBS_ChargingStatus, 3, 1, {{BQ40Z80_FIELD_CHARGING_STATUS, 0, 3}}},
+        {SOURCE_SBS_BLOCK, BQ40Z80_SBS_GaugingStatus, 4, 1, {{BQ40Z80_FIELD_GAUGING_STATUS, 0, 4}}},
+        {SOURCE_SBS_BLOCK, BQ40Z80_SBS_ManufacturingStatus, 2, 1, {{BQ40Z80_FIELD_MANUFACTURING_STATUS, 0, 2}}},
+        {SOURCE_SBS_BLOCK, BQ40Z80_SBS_DAStatus1, 32, 6, {
+                                                            {BQ40Z80_FIELD_CELL_VOLTAGE_1, 0, 2},
+                                                            {BQ40Z80_FIELD_CELL_VOLTAGE_2, 2, 2},
+                                                            {BQ40Z80_FIELD_CELL_VOLTAGE_3, 4, 2},
+                                                            {BQ40Z80_FIELD_CELL_VOLTAGE_4, 6, 2},
+                                                            {BQ40Z80_FIELD_BAT_VOLTAGE, 8, 2},
+                                                            {BQ40Z80_FIELD_PACK_VOLTAGE, 10, 2},
+                                                        }},
+        {SOURCE_SBS_BLOCK, BQ40Z80_SBS_DAStatus2, 16, 7, {
+                                                            {BQ40Z80_FIELD_INT_TEMPERATURE, 0, 2},
+                                                            {BQ40Z80_FIELD_TS1_TEMPERATURE, 2, 2},
+                                                            {BQ40Z80_FIELD_TS2_TEMPERATURE, 4, 2},
+                                                            {BQ40Z80_FIELD_TS3_TEMPERATURE, 6, 2},
+                                                            {BQ40Z80_FIELD_TS4_TEMPERATURE, 8, 2},
+                                                            {BQ40Z80_FIELD_CELL_TEMPERATURE, 10, 2},
+                                                            {BQ40Z80_FIELD_FET_TEMPERATURE, 12, 2},
+                                                        }},
+        {SOURCE_SBS_BLOCK, BQ40Z80_SBS_DAStatus3, 18, 3, {
+                                                            {BQ40Z80_FIELD_CELL_VOLTAGE_5, 0, 2},
+                                                            {BQ40Z80_FIELD_CELL_VOLTAGE_6, 6, 2},
+                                                            {BQ40Z80_FIELD_CELL_VOLTAGE_7, 12, 2},
+                                                        }},
+        {SOURCE_MFA_BLOCK, BQ40Z80_MFA_DA_STATUS_1, 32, 6, {
+                                                               {BQ40Z80_FIELD_CELL_VOLTAGE_1, 0, 2},
+                                                               {BQ40Z80_FIELD_CELL_VOLTAGE_2, 2, 2},
+                                                               {BQ40Z80_FIELD_CELL_VOLTAGE_3, 4, 2},
+                                                               {BQ40Z80_FIELD_CELL_VOLTAGE_4, 6, 2},
+                                                               {BQ40Z80_FIELD_BAT_VOLTAGE, 8, 2},
+                                                               {BQ40Z80_FIELD_PACK_VOLTAGE, 10, 2},
+                                                           }},
+        {SOURCE_MFA_BLOCK, BQ40Z80_MFA_DA_STATUS_2, 16, 7, {
+                                                               {BQ40Z80_FIELD_INT_TEMPERATURE, 0, 2},
+                                                               {BQ40Z80_FIELD_TS1_TEMPERATURE, 2, 2},
+                                                               {BQ40Z80_FIELD_TS2_TEMPERATURE, 4, 2},
+                                                               {BQ40Z80_FIELD_TS3_TEMPERATURE, 6, 2},
+                                                               {BQ40Z80_FIELD_TS4_TEMPERATURE, 8, 2},
+                                                               {BQ40Z80_FIELD_CELL_TEMPERATURE, 10, 2},
+                                                               {BQ40Z80_FIELD_FET_TEMPERATURE, 12, 2},
+                                                           }},
+        {SOURCE_MFA_BLOCK, BQ40Z80_MFA_DA_STATUS_3, 18, 3, {
+                                                               {BQ40Z80_FIELD_CELL_VOLTAGE_5, 0, 2},
+                                                               {BQ40Z80_FIELD_CELL_VOLTAGE_6, 6, 2},
+                                                               {BQ40Z80_FIELD_CELL_VOLTAGE_7, 12, 2},
+                                                           }},
+    };
+
+#define N_SOURCES (sizeof(SOURCES) / sizeof(SOURCES[0]))
+
+    /**
+     * @brief Estimate the SCL clocks of a source: 9 clocks per byte plus one per START, repeated START and STOP
+     */
+    static uint32_t source_clocks(const source_t *src)
+    {
+        switch (src->kind)
+        {
+        case SOURCE_SBS_WORD:
+            // S addr+W, cmd, Sr addr+R, lo, hi, P
+            return 5 * 9 + 3;
+        case SOURCE_SBS_BLOCK:
+            // S addr+W, cmd, Sr addr+R, count, data, P
+            return (4 + src->len) * 9 + 3;
+        case SOURCE_MFA_BLOCK:
+            // S addr+W, 0x44, count, MFA lo, hi, P, then S addr+W, 0x23, Sr addr+R, count, echo lo, hi, data, P
+            return (5 * 9 + 2) + ((6 + src->len) * 9 + 3);
+        default:
+            return UINT32_MAX;
+        }
+    }
+
+    static bq40z80_field_mask_t source_fields(const source_t *src)
+    {
+        bq40z80_field_mask_t mask = 0;
+        for (uint8_t i = 0; i < src->n_fields; i++)
+            mask |= BQ40Z80_FIELD_MASK(src->map[i].field);
+        return mask;
+    }
+
+    void bq40z80_plan_query(bq40z80_field_mask_t fields, BQ40Z80_QUERY_PLAN *plan)
+    {
+        uint8_t multi[N_SOURCES];
+        uint8_t n_multi = 0;
+
+        fields &= BQ40Z80_FIELD_MASK_ALL;
+
+        // Sources carrying more than one field are the only real choice, try every combination of them
+        // and cover the remaining fields with their cheapest single-field source.
+        for (uint8_t i = 0; i < N_SOURCES; i++)
+            if (SOURCES[i].n_fields > 1 && (source_fields(&SOURCES[i]) & fields))
+                multi[n_multi++] = i;
+        assert(n_multi <= 8); //!< keeps the search at 256 combinations
+
+        uint32_t best_cost = UINT32_MAX;
+        uint32_t best_subset = 0;
+
+        for (uint32_t subset = 0; subset < (1u << n_multi); subset++)
+        {
+            bq40z80_field_mask_t covered = 0;
+            uint32_t cost = 0;
+            for (uint8_t i = 0; i < n_multi; i++)
+            {
+                if (subset & (1u << i))
+                {
+                    covered |= source_fields(&SOURCES[multi[i]]);
+                    cost += source_clocks(&SOURCES[multi[i]]);
+                }
+            }
+
+            bq40z80_field_mask_t remaining = fields & ~covered;
+            for (uint8_t i = 0; i < N_SOURCES && cost < best_cost; i++)
+            {
+                if (SOURCES[i].n_fields == 1 && (source_fields(&SOURCES[i]) & remaining))
+                {
+                    remaining &= ~source_fields(&SOURCES[i]);
+                    cost += source_clocks(&SOURCES[i]);
+                }
+            }
+
+            if (remaining == 0 && cost < best_cost)
+            {
+                best_cost = cost;
+                best_subset = subset;
+            }
+        }
+
+        plan->fields = fields;
+        plan->provided = 0;
+        plan->cost_clocks = 0;
+        plan->n_steps = 0;
+
+        for (uint8_t i = 0; i < n_multi; i++)
+        {
+            if (best_subset & (1u << i))
+            {
+                plan->steps[plan->n_steps++] = multi[i];
+                plan->provided |= source_fields(&SOURCES[multi[i]]);
+                plan->cost_clocks += source_clocks(&SOURCES[multi[i]]);
+            }
+        }
+        for (uint8_t i = 0; i < N_SOURCES; i++)
+        {
+            if (SOURCES[i].n_fields == 1 && (source_fields(&SOURCES[i]) & fields & ~plan->provided))
+            {
+                plan->steps[plan->n_steps++] = i;
+                plan->provided |= source_fields(&SOURCES[i]);
+                plan->cost_clocks += source_clocks(&SOURCES[i]);
+            }
+        }
+    }
+
+    void bq40z80_set_field(BQ40Z80_TELEMETRY *data, uint8_t field, uint32_t val)
+    {
+        switch (field)
+        {
+        case BQ40Z80_FIELD_TEMPERATURE:
+            data->temperature = val;
+            break;
+        case BQ40Z80_FIELD_VOLTAGE:
+            data->voltage = val;
+            break;
+        case BQ40Z80_FIELD_CURRENT:
+            data->current = (int16_t)val;
+            break;
+        case BQ40Z80_FIELD_AVERAGE_CURRENT:
+            data->average_current = (int16_t)val;
+            break;
+        case BQ40Z80_FIELD_RSOC:
+            data->rsoc = val;
+            break;
+        case BQ40Z80_FIELD_REMAINING_CAPACITY:
+            data->remaining_capacity = val;
+            break;
+        case BQ40Z80_FIELD_FULL_CHARGE_CAPACITY:
+            data->full_charge_capacity = val;
+            break;
+        case BQ40Z80_FIELD_BATTERY_STATUS:
+            data->battery_status = val;
+            break;
+        case BQ40Z80_FIELD_CELL_VOLTAGE_1:
+        case BQ40Z80_FIELD_CELL_VOLTAGE_2:
+        case BQ40Z80_FIELD_CELL_VOLTAGE_3:
+        case BQ40Z80_FIELD_CELL_VOLTAGE_4:
+        case BQ40Z80_FIELD_CELL_VOLTAGE_5:
+        case BQ40Z80_FIELD_CELL_VOLTAGE_6:
+        case BQ40Z80_FIELD_CELL_VOLTAGE_7:
+            data->cell_voltage[field - BQ40Z80_FIELD_CELL_VOLTAGE_1] = val;
+            break;
+        case BQ40Z80_FIELD_BAT_VOLTAGE:
+            data->bat_voltage = val;
+            break;
+        case BQ40Z80_FIELD_PACK_VOLTAGE:
+            data->pack_voltage = val;
+            break;
+        case BQ40Z80_FIELD_INT_TEMPERATURE:
+            data->int_temperature = val;
+            break;
+        case BQ40Z80_FIELD_TS1_TEMPERATURE:
+        case BQ40Z80_FIELD_TS2_TEMPERATURE:
+        case BQ40Z80_FIELD_TS3_TEMPERATURE:
+        case BQ40Z80_FIELD_TS4_TEMPERATURE:
+            data->ts_temperature[field - BQ40Z80_FIELD_TS1_TEMPERATURE] = val;
+            break;
+        case BQ40Z80_FIELD_CELL_TEMPERATURE:
+            data->cell_temperature = val;
+            break;
+        case BQ40Z80_FIELD_FET_TEMPERATURE:
+            data->fet_temperature = val;
+            break;
+        case BQ40Z80_FIELD_SAFETY_ALERT:
+            data->safety_alert.raw = val;
+            break;
+        case BQ40Z80_FIELD_SAFETY_STATUS:
+            data->safety_status.raw = val;
+            break;
+        case BQ40Z80_FIELD_PF_ALERT:
+            data->pf_alert.raw = val;
+            break;
+        case BQ40Z80_FIELD_PF_STATUS:
+            data->pf_status.raw = val;
+            break;
+        case BQ40Z80_FIELD_OPERATION_STATUS:
+            data->operation_status.raw = val;
+            break;
+        case BQ40Z80_FIELD_CHARGING_STATUS:
+            data->charging_status.raw = val;
+            break;
+        case BQ40Z80_FIELD_GAUGING_STATUS:
+            data->gauging_status.raw = val;
+            break;
+        case BQ40Z80_FIELD_MANUFACTURING_STATUS:
+            data->manufacturing_status.raw = val;
+            break;
+        default:
+            break;
+        }
+    }
+
+    int32_t bq40z80_get_field(const BQ40Z80_TELEMETRY *data, uint8_t field)
+    {
+        switch (field)
+        {
+        case BQ40Z80_FIELD_TEMPERATURE:
+            return data->temperature;
+        case BQ40Z80_FIELD_VOLTAGE:
+            return data->voltage;
+        case BQ40Z80_FIELD_CURRENT:
+            return data->current;
+        case BQ40Z80_FIELD_AVERAGE_CURRENT:
+            return data->average_current;
+        case BQ40Z80_FIELD_RSOC:
+            return data->rsoc;
+        case BQ40Z80_FIELD_REMAINING_CAPACITY:
+            return data->remaining_capacity;
+        case BQ40Z80_FIELD_FULL_CHARGE_CAPACITY:
+            return data->full_charge_capacity;
+        case BQ40Z80_FIELD_BATTERY_STATUS:
+            return data->battery_status;
+        case BQ40Z80_FIELD_CELL_VOLTAGE_1:
+        case BQ40Z80_FIELD_CELL_VOLTAGE_2:
+        case BQ40Z80_FIELD_CELL_VOLTAGE_3:
+        case BQ40Z80_FIELD_CELL_VOLTAGE_4:
+        case BQ40Z80_FIELD_CELL_VOLTAGE_5:
+        case BQ40Z80_FIELD_CELL_VOLTAGE_6:
+        case BQ40Z80_FIELD_CELL_VOLTAGE_7:
+            return data->cell_voltage[field - BQ40Z80_FIELD_CELL_VOLTAGE_1];
+        case BQ40Z80_FIELD_BAT_VOLTAGE:
+            return data->bat_voltage;
+        case BQ40Z80_FIELD_PACK_VOLTAGE:
+            return data->pack_voltage;
+        case BQ40Z80_FIELD_INT_TEMPERATURE:
+            return data->int_temperature;
+        case BQ40Z80_FIELD_TS1_TEMPERATURE:
+        case BQ40Z80_FIELD_TS2_TEMPERATURE:
+        case BQ40Z80_FIELD_TS3_TEMPERATURE:
+        case BQ40Z80_FIELD_TS4_TEMPERATURE:
+            return data->ts_temperature[field - BQ40Z80_FIELD_TS1_TEMPERATURE];
+        case BQ40Z80_FIELD_CELL_TEMPERATURE:
+            return data->cell_temperature;
+        case BQ40Z80_FIELD_FET_TEMPERATURE:
+            return data->fet_temperature;
+        case BQ40Z80_FIELD_SAFETY_ALERT:
+            return data->safety_alert.raw;
+        case BQ40Z80_FIELD_SAFETY_STATUS:
+            return data->safety_status.raw;
+        case BQ40Z80_FIELD_PF_ALERT:
+            return data->pf_alert.raw;
+        case BQ40Z80_FIELD_PF_STATUS:
+            return data->pf_status.raw;
+        case BQ40Z80_FIELD_OPERATION_STATUS:
+            return data->operation_status.raw;
+        case BQ40Z80_FIELD_CHARGING_STATUS:
+            return data->charging_status.raw;
+        case BQ40Z80_FIELD_GAUGING_STATUS:
+            return data->gauging_status.raw;
+        case BQ40Z80_FIELD_MANUFACTURING_STATUS:
+            return data->manufacturing_status.raw;
+        default:
+            return 0;
+        }
+    }
+
+    /***************************** Public Functions *****************************/
+
+    void BQ40Z80::read_fields(const BQ40Z80_QUERY_PLAN *plan, BQ40Z80_TELEMETRY *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_fields(plan, data));
+    }
+
+    void BQ40Z80::read_fields(bq40z80_field_mask_t fields, BQ40Z80_TELEMETRY *data)
+    {
+        ESP_ERROR_CHECK(this->try_read_fields(fields, data));
+    }
+
+    esp_err_t BQ40Z80::try_read_fields(const BQ40Z80_QUERY_PLAN *plan, BQ40Z80_TELEMETRY *data, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_CALL *outer = this->call_begin(call);
+        esp_err_t err = ESP_OK;
+
+        data->valid = 0;
+
+        for (uint8_t i = 0; i < plan->n_steps && err == ESP_OK; i++)
+        {
+            const source_t *src = &SOURCES[plan->steps[i]];
+            uint8_t buf[32] = {0};
+            uint16_t word;
+
+            switch (src->kind)
+            {
+            case SOURCE_SBS_WORD:
+                err = this->smbus_read_word(src->command, &word);
+                buf[0] = word & 0x00ff;
+                buf[1] = word >> 8;
+                break;
+            case SOURCE_SBS_BLOCK:
+                err = this->smbus_read_block(src->command, buf, src->len);
+                break;
+            case SOURCE_MFA_BLOCK:
+                err = this->mfa_read_block(src->command, buf, src->len);
+                break;
+            }
+            if (err != ESP_OK)
+                break;
+
+            // fill every field the transaction carries, requested or not
+            for (uint8_t j = 0; j < src->n_fields; j++)
+            {
+                const source_field_t *f = &src->map[j];
+                uint32_t val = 0;
+                for (uint8_t k = 0; k < f->width; k++)
+                    val |= (uint32_t)buf[f->offset + k] << (8 * k);
+                bq40z80_set_field(data, f->field, val);
+                data->valid |= BQ40Z80_FIELD_MASK(f->field);
+            }
+        }
+
+        return this->call_end(outer, err);
+    }
+
+    esp_err_t BQ40Z80::try_read_fields(bq40z80_field_mask_t fields, BQ40Z80_TELEMETRY *data, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_QUERY_PLAN plan;
+        bq40z80_plan_query(fields, &plan);
+        return this->try_read_fields(&plan, data, call);
+    }
+
+#ifdef __cplusplus
+}
+#endif
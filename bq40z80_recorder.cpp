@@ -0,0 +1,289 @@
+#include "bq40z80_recorder.h"
+
+#define VARINT32_MAX 5
+#define VARINT64_MAX 10
+
+static uint8_t *put_varint(uint8_t *p, uint64_t val)
+{
+    while (val >= 0x80)
+    {
+        *p++ = (uint8_t)val | 0x80;
+        val >>= 7;
+    }
+    *p++ = (uint8_t)val;
+    return p;
+}
+
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint64_t *val)
+{
+    uint64_t buf = 0;
+    for (uint8_t shift = 0; p < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = *p++;
+        buf |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+        {
+            *val = buf;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static inline uint64_t zigzag(int64_t val)
+{
+    return ((uint64_t)val << 1) ^ (uint64_t)(val >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t val)
+{
+    return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+static void cursor_seek(BQ40Z80_RECORDER_CURSOR *cursor, uint32_t block, uint16_t offset)
+{
+    // decoding restarts from zero at each block
+    cursor->block = block;
+    cursor->offset = offset;
+    cursor->timestamp_us = 0;
+    cursor->valid = 0;
+    memset(cursor->values, 0, sizeof(cursor->values));
+}
+
+static uint8_t field_width(uint8_t field)
+{
+    if (field == BQ40Z80_FIELD_RSOC)
+        return 1;
+    if (field >= BQ40Z80_FIELD_SAFETY_ALERT)
+        return 4;
+    return 2;
+}
+
+BQ40Z80_RECORDER::BQ40Z80_RECORDER(void *arena, size_t size, bq40z80_field_mask_t fields)
+{
+    // block headers are accessed in place, start on a word boundary
+    uintptr_t addr = (uintptr_t)arena;
+    uintptr_t aligned = (addr + alignof(BLOCK_HEADER) - 1) & ~(uintptr_t)(alignof(BLOCK_HEADER) - 1);
+    size = size > aligned - addr ? size - (aligned - addr) : 0;
+
+    this->arena = (uint8_t *)aligned;
+    this->n_blocks = size / BQ40Z80_RECORDER_BLOCK_SIZE < 0xffff ? size / BQ40Z80_RECORDER_BLOCK_SIZE : 0xffff;
+    this->fields = fields & BQ40Z80_FIELD_MASK_ALL;
+    this->n_fields = 0;
+    this->raw_size = sizeof(int64_t);
+    for (uint8_t i = 0; i < BQ40Z80_FIELD_COUNT; i++)
+    {
+        if (this->fields & BQ40Z80_FIELD_MASK(i))
+        {
+            this->n_fields++;
+            this->raw_size += field_width(i);
+        }
+    }
+    this->record_max = VARINT64_MAX * 2 + VARINT32_MAX * this->n_fields;
+    this->next_sequence = 0;
+    bq40z80_mutex_init(&this->lock);
+    memset(&this->stats, 0, sizeof(this->stats));
+
+    if (this->n_blocks < 2)
+    {
+        ESP_LOGE("BQ40Z80", "recorder arena of %u bytes holds less than two blocks", (unsigned)size);
+        this->n_blocks = 0;
+    }
+    this->clear();
+}
+
+BQ40Z80_RECORDER::~BQ40Z80_RECORDER()
+{
+    bq40z80_mutex_deinit(&this->lock);
+}
+
+/***************************** Public Functions *****************************/
+
+esp_err_t BQ40Z80_RECORDER::append(int64_t timestamp_us, const BQ40Z80_TELEMETRY *data)
+{
+    if (this->n_blocks == 0)
+        return ESP_ERR_INVALID_SIZE;
+
+#if BQ40Z80_STATS_ENABLE
+    int64_t start_us = bq40z80_time_us();
+#endif
+    bq40z80_mutex_lock(&this->lock);
+
+    BLOCK_HEADER *hdr = this->block(this->head);
+    if (hdr->used + this->record_max > BQ40Z80_RECORDER_BLOCK_SIZE || hdr->samples == 0xffff)
+    {
+        this->start_block();
+        hdr = this->block(this->head);
+    }
+
+    uint8_t *begin = (uint8_t *)hdr + hdr->used;
+    uint8_t *p = begin;
+    bq40z80_field_mask_t valid = data->valid & this->fields;
+
+    p = put_varint(p, zigzag(timestamp_us - this->last_timestamp_us));
+    p = put_varint(p, valid ^ this->last_valid);
+    for (uint8_t i = 0; i < BQ40Z80_FIELD_COUNT; i++)
+    {
+        if (!(valid & BQ40Z80_FIELD_MASK(i)))
+            continue;
+        int32_t val = bq40z80_get_field(data, i);
+        p = put_varint(p, zigzag((int32_t)((uint32_t)val - (uint32_t)this->last_values[i])));
+        this->last_values[i] = val;
+    }
+    this->last_timestamp_us = timestamp_us;
+    this->last_valid = valid;
+
+    hdr->used += p - begin;
+    hdr->samples++;
+    this->stats.samples++;
+    this->stats.encoded_bytes += p - begin;
+    this->stats.raw_bytes += this->raw_size;
+    this->stats.appended++;
+
+#if BQ40Z80_STATS_ENABLE
+    uint32_t elapsed_us = bq40z80_time_us() - start_us;
+    if (elapsed_us > this->stats.append_max_us)
+        this->stats.append_max_us = elapsed_us;
+    this->stats.append_total_us += elapsed_us;
+#endif
+    bq40z80_mutex_unlock(&this->lock);
+    return ESP_OK;
+}
+
+void BQ40Z80_RECORDER::clear()
+{
+    bq40z80_mutex_lock(&this->lock);
+    this->head = 0;
+    this->in_use = 0;
+    this->stats.samples = 0;
+    this->stats.encoded_bytes = 0;
+    this->stats.raw_bytes = 0;
+    if (this->n_blocks > 0)
+        this->start_block();
+    bq40z80_mutex_unlock(&this->lock);
+}
+
+void BQ40Z80_RECORDER::rewind(BQ40Z80_RECORDER_CURSOR *cursor)
+{
+    bq40z80_mutex_lock(&this->lock);
+    cursor->lost = 0;
+    cursor_seek(cursor, this->n_blocks > 0 ? this->block(this->oldest())->sequence : 0, sizeof(BLOCK_HEADER));
+    bq40z80_mutex_unlock(&this->lock);
+}
+
+bool BQ40Z80_RECORDER::next(BQ40Z80_RECORDER_CURSOR *cursor, int64_t *timestamp_us, BQ40Z80_TELEMETRY *data)
+{
+    if (this->n_blocks == 0)
+        return false;
+
+    bq40z80_mutex_lock(&this->lock);
+
+    uint16_t oldest = this->oldest();
+    uint32_t first = this->block(oldest)->sequence;
+    const BLOCK_HEADER *hdr;
+
+    // sequence numbers are consecutive from the oldest block to the head
+    if ((int32_t)(cursor->block - first) < 0)
+    {
+        cursor->lost += first - cursor->block;
+        cursor_seek(cursor, first, sizeof(BLOCK_HEADER));
+    }
+
+    while (true)
+    {
+        hdr = this->block((oldest + (cursor->block - first)) % this->n_blocks);
+        if (cursor->offset < hdr->used)
+            break;
+        if (cursor->block - first + 1 >= this->in_use)
+        {
+            bq40z80_mutex_unlock(&this->lock);
+            return false;
+        }
+        cursor_seek(cursor, cursor->block + 1, sizeof(BLOCK_HEADER));
+    }
+
+    const uint8_t *p = (const uint8_t *)hdr + cursor->offset;
+    const uint8_t *end = (const uint8_t *)hdr + hdr->used;
+    uint64_t val;
+
+    p = get_varint(p, end, &val);
+    if (p != NULL)
+        cursor->timestamp_us += unzigzag(val);
+    if (p != NULL && (p = get_varint(p, end, &val)) != NULL)
+        cursor->valid ^= val;
+    for (uint8_t i = 0; p != NULL && i < BQ40Z80_FIELD_COUNT; i++)
+    {
+        if (!(cursor->valid & BQ40Z80_FIELD_MASK(i)))
+            continue;
+        if ((p = get_varint(p, end, &val)) != NULL)
+            cursor->values[i] = (uint32_t)cursor->values[i] + (uint32_t)unzigzag(val);
+    }
+    if (p == NULL)
+    {
+        // truncated record, can't happen unless the arena was overwritten
+        ESP_LOGE("BQ40Z80", "recorder block %u is corrupted", (unsigned)cursor->block);
+        cursor->offset = hdr->used;
+        bq40z80_mutex_unlock(&this->lock);
+        return false;
+    }
+    cursor->offset = p - (const uint8_t *)hdr;
+
+    memset(data, 0, sizeof(BQ40Z80_TELEMETRY));
+    data->valid = cursor->valid;
+    for (uint8_t i = 0; i < BQ40Z80_FIELD_COUNT; i++)
+        if (cursor->valid & BQ40Z80_FIELD_MASK(i))
+            bq40z80_set_field(data, i, cursor->values[i]);
+    *timestamp_us = cursor->timestamp_us;
+
+    bq40z80_mutex_unlock(&this->lock);
+    return true;
+}
+
+void BQ40Z80_RECORDER::get_stats(BQ40Z80_RECORDER_STATS *stats)
+{
+    bq40z80_mutex_lock(&this->lock);
+    *stats = this->stats;
+    bq40z80_mutex_unlock(&this->lock);
+}
+
+/***************************** Private Functions *****************************/
+
+BQ40Z80_RECORDER::BLOCK_HEADER *BQ40Z80_RECORDER::block(uint16_t index)
+{
+    return (BLOCK_HEADER *)(this->arena + (size_t)index * BQ40Z80_RECORDER_BLOCK_SIZE);
+}
+
+uint16_t BQ40Z80_RECORDER::oldest()
+{
+    return (this->head + this->n_blocks - (this->in_use - 1)) % this->n_blocks;
+}
+
+void BQ40Z80_RECORDER::start_block()
+{
+    if (this->in_use > 0)
+        this->head = (this->head + 1) % this->n_blocks;
+
+    if (this->in_use == this->n_blocks)
+    {
+        // the head just wrapped onto the oldest block
+        BLOCK_HEADER *victim = this->block(this->head);
+        this->stats.samples -= victim->samples;
+        this->stats.encoded_bytes -= victim->used;
+        this->stats.raw_bytes -= victim->samples * this->raw_size;
+        this->stats.evicted_samples += victim->samples;
+    }
+    else
+    {
+        this->in_use++;
+    }
+
+    BLOCK_HEADER *hdr = this->block(this->head);
+    hdr->sequence = this->next_sequence++;
+    hdr->used = sizeof(BLOCK_HEADER);
+    hdr->samples = 0;
+    this->stats.encoded_bytes += sizeof(BLOCK_HEADER);
+
+    this->last_timestamp_us = 0;
+    this->last_valid = 0;
+    memset(this->last_values, 0, sizeof(this->last_values));
+}
@@ -0,0 +1,198 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bq40z80.h"
+
+    /***************************** Public Functions *****************************/
+
+    void BQ40Z80::sample_current(BQ40Z80_CURRENT_SAMPLE *samples, uint32_t n, const BQ40Z80_SAMPLING_OPTIONS *options, BQ40Z80_SAMPLING_REPORT *report)
+    {
+        ESP_ERROR_CHECK(this->try_sample_current(samples, n, options, report));
+    }
+
+    /***************************** Non-aborting Functions *****************************/
+
+    esp_err_t BQ40Z80::try_sample_current(BQ40Z80_CURRENT_SAMPLE *samples, uint32_t n, const BQ40Z80_SAMPLING_OPTIONS *options, BQ40Z80_SAMPLING_REPORT *report, BQ40Z80_CALL *call)
+    {
+        static const BQ40Z80_SAMPLING_OPTIONS BACK_TO_BACK = {0, 0};
+        BQ40Z80_CALL *outer = this->call_begin(call);
+        BQ40Z80_SAMPLING_REPORT work;
+        int32_t current_ma;
+
+        memset(&work, 0, sizeof(work));
+        if (options == NULL)
+            options = &BACK_TO_BACK;
+
+        esp_err_t err = this->try_get_voltage(&work.voltage_mv);
+        if (err != ESP_OK || n == 0)
+        {
+            if (report != NULL)
+                *report = work;
+            return this->call_end(outer, err);
+        }
+
+        // one probe decides the register for the whole run, firmware without CurrentLong() NACKs it or answers short
+        err = this->bus_sample_prepare(BQ40Z80_SBS_CurrentLong, 1 + sizeof(int32_t) + this->pec_enable);
+        work.current_long = err == ESP_OK && this->sample_once(&current_ma) == ESP_OK;
+        if (!work.current_long)
+        {
+            if (err == ESP_OK)
+                this->bus_sample_release();
+            err = this->bus_sample_prepare(BQ40Z80_SBS_Current, sizeof(int16_t) + this->pec_enable);
+        }
+        if (err != ESP_OK)
+        {
+            if (report != NULL)
+                *report = work;
+            return this->call_end(outer, err);
+        }
+
+        int64_t start_us = bq40z80_time_us();
+        int64_t next_us = start_us;
+        int64_t transfer_us = 0;
+        int64_t paused_us = 0;
+        uint32_t reads = 0;
+        uint8_t failures = 0;
+        int64_t prev_us = 0;
+        int32_t prev_ma = 0;
+        uint64_t interval_sum = 0;
+        uint64_t interval_sq_sum = 0;
+        int64_t charge2 = 0;    // twice the charge, the trapezoid halves once at the end
+        int64_t energy_rem = 0; // twice the energy below 1 nJ, carried to the next sample
+
+        while (work.samples < n)
+        {
+            if (options->interval_us > 0)
+            {
+                // a fixed grid, a late sample doesn't push the following ones back
+                int64_t pause_us = bq40z80_time_us();
+                if (next_us > pause_us)
+                {
+                    if (this->bus != NULL)
+                        bq40z80_mutex_unlock(&this->bus->lock);
+                    bq40z80_sleep_until_us(next_us);
+                    if (this->bus != NULL)
+                        bq40z80_mutex_lock(&this->bus->lock);
+                }
+                next_us += options->interval_us;
+                paused_us += bq40z80_time_us() - pause_us;
+            }
+
+            int64_t t0 = bq40z80_time_us();
+            esp_err_t e = this->sample_once(&current_ma);
+            int64_t t1 = bq40z80_time_us();
+            transfer_us += t1 - t0;
+            reads++;
+            if (e == ESP_ERR_TIMEOUT && this->active_call != NULL && this->active_call->deadline_us != BQ40Z80_NO_DEADLINE &&
+                t1 >= this->active_call->deadline_us)
+            {
+                err = e;
+                break;
+            }
+            if (e != ESP_OK)
+            {
+                work.errors++;
+                if (++failures < BQ40Z80_SAMPLING_ERRORS_MAX)
+                    continue;
+                err = e;
+                break;
+            }
+            failures = 0;
+
+            int64_t timestamp_us = t0 + (t1 - t0) / 2;
+            if (work.samples > 0)
+            {
+                uint32_t dt = (uint32_t)(timestamp_us - prev_us);
+                if (work.samples == 1 || dt < work.interval_min_us)
+                    work.interval_min_us = dt;
+                if (dt > work.interval_max_us)
+                    work.interval_max_us = dt;
+                interval_sum += dt;
+                interval_sq_sum += (uint64_t)dt * dt;
+
+                // mA * us = nC and mV * nC = pJ, kept whole so no charge is lost to rounding
+                int64_t q2 = (int64_t)(prev_ma + current_ma) * dt;
+                int64_t e2 = q2 * work.voltage_mv + energy_rem;
+                charge2 += q2;
+                work.energy_nj += e2 / 2000;
+                energy_rem = e2 % 2000;
+            }
+            samples[work.samples].timestamp_us = timestamp_us;
+            samples[work.samples].current_ma = current_ma;
+            work.samples++;
+            prev_us = timestamp_us;
+            prev_ma = current_ma;
+
+            if (options->voltage_every > 0 && work.samples % options->voltage_every == 0 && work.samples < n)
+            {
+                uint16_t voltage_mv;
+                int64_t v0 = bq40z80_time_us();
+                this->cache_invalidate(BQ40Z80_CACHE_SBS_WORD, BQ40Z80_SBS_Voltage);
+                if (this->smbus_read_word(BQ40Z80_SBS_Voltage, &voltage_mv) == ESP_OK)
+                    work.voltage_mv = voltage_mv;
+                else
+                    work.errors++;
+                transfer_us += bq40z80_time_us() - v0;
+            }
+        }
+        int64_t end_us = bq40z80_time_us();
+        this->bus_sample_release();
+
+        if (work.samples > 1)
+        {
+            uint32_t intervals = work.samples - 1;
+            uint64_t mean = interval_sum / intervals;
+            uint64_t mean_sq = interval_sq_sum / intervals;
+            work.elapsed_us = (uint32_t)interval_sum;
+            work.rate_hz = (uint32_t)((uint64_t)intervals * 1000000 / (interval_sum ? interval_sum : 1));
+            work.jitter_us = bq40z80_isqrt(mean_sq > mean * mean ? mean_sq - mean * mean : 0);
+        }
+        if (reads > 0)
+            work.overhead_ns = (uint32_t)((end_us - start_us - transfer_us - paused_us) * 1000 / reads);
+        work.charge_nc = charge2 / 2;
+
+        if (report != NULL)
+            *report = work;
+        return this->call_end(outer, err);
+    }
+
+    /***************************** Private Functions *****************************/
+
+    esp_err_t BQ40Z80::sample_once(int32_t *current_ma)
+    {
+        // S addr+W, cmd, Sr addr+R, [count], current, [PEC], P
+        uint32_t wire_time_us = bq40z80_wire_time_us(3 + this->sample_len, 3, this->get_bus_speed());
+        uint8_t raw[1 + sizeof(int32_t) + 1] = {0};
+
+        // selects the mux channel again if the bus was lent out meanwhile
+        esp_err_t err = this->attempt_begin(wire_time_us);
+        if (err == ESP_OK)
+        {
+            err = this->bus_sample(raw);
+            this->bus_speed_feedback(err);
+            this->call_transaction(3 + this->sample_len, 3, 1);
+        }
+        if (err != ESP_OK)
+            return err;
+
+        if (this->sample_reg == BQ40Z80_SBS_CurrentLong)
+        {
+            uint8_t buf[BQ40Z80_REG_CurrentLong::len];
+            BQ40Z80_CURRENT_LONG current;
+            if (raw[0] != sizeof(buf))
+                return ESP_ERR_INVALID_SIZE;
+            err = this->smbus_block_result(BQ40Z80_SBS_CurrentLong, raw, buf, sizeof(buf));
+            bq40z80_decode<BQ40Z80_REG_CurrentLong>(&current, buf);
+            *current_ma = current.ma;
+            return err;
+        }
+
+        *current_ma = (int16_t)((raw[1] << 8) | raw[0]);
+        return this->pec_check(BQ40Z80_SBS_Current, raw, 2);
+    }
+
+#ifdef __cplusplus
+}
+#endif
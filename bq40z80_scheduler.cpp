@@ -0,0 +1,169 @@
+#include "bq40z80_scheduler.h"
+
+#define NEVER INT64_MIN
+
+/**
+ * @brief Fields that decide the state, read in every state at the regular period
+ */
+static const bq40z80_field_mask_t STATE_FIELDS = BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_CURRENT) |
+                                                 BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_OPERATION_STATUS) |
+                                                 BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_CHARGING_STATUS);
+
+void bq40z80_schedule_default(BQ40Z80_SCHEDULE *schedule)
+{
+    memset(schedule, 0, sizeof(BQ40Z80_SCHEDULE));
+    schedule->period_ms[BQ40Z80_SCHED_ACTIVE] = 250;
+    schedule->period_ms[BQ40Z80_SCHED_IDLE] = 2000;
+    schedule->period_ms[BQ40Z80_SCHED_SLEEP] = 20000;
+    schedule->static_ms = 600000;
+    schedule->slow_factor = 4;
+    schedule->slow_fields = BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_TEMPERATURE) |
+                            BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_RSOC) |
+                            BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_REMAINING_CAPACITY) |
+                            BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_GAUGING_STATUS) |
+                            (BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_FET_TEMPERATURE + 1) - BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_INT_TEMPERATURE));
+    schedule->static_fields = BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_FULL_CHARGE_CAPACITY) |
+                              BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_MANUFACTURING_STATUS);
+    schedule->active_current_ma = 500;
+    schedule->budget_pct = 20;
+}
+
+BQ40Z80_SCHEDULER::BQ40Z80_SCHEDULER(const BQ40Z80_SCHEDULE *schedule)
+{
+    this->schedule = *schedule;
+    if (this->schedule.slow_factor == 0)
+        this->schedule.slow_factor = 1;
+    // the state fields must follow the state, whatever the policy says
+    this->schedule.slow_fields &= ~STATE_FIELDS;
+    this->schedule.static_fields &= ~STATE_FIELDS;
+
+    bq40z80_mutex_init(&this->lock);
+    this->state = BQ40Z80_SCHED_IDLE;
+    this->stretch = 1.0f;
+    this->window_start_us = NEVER;
+    this->window_bus_us = 0;
+    this->utilisation_permille = 0;
+    this->sleeping = false;
+    this->terminating = false;
+    this->current = 0;
+    for (uint8_t i = 0; i < BQ40Z80_FIELD_COUNT; i++)
+        this->last_read_us[i] = NEVER;
+    memset(this->interval_ms, 0, sizeof(this->interval_ms));
+    memset(this->reads, 0, sizeof(this->reads));
+}
+
+BQ40Z80_SCHEDULER::~BQ40Z80_SCHEDULER()
+{
+    bq40z80_mutex_deinit(&this->lock);
+}
+
+/***************************** Public Functions *****************************/
+
+bq40z80_field_mask_t BQ40Z80_SCHEDULER::due(bq40z80_field_mask_t fields, int64_t now_us)
+{
+    bq40z80_field_mask_t mask = 0;
+
+    bq40z80_mutex_lock(&this->lock);
+    fields = (fields | STATE_FIELDS) & BQ40Z80_FIELD_MASK_ALL;
+    for (uint8_t i = 0; i < BQ40Z80_FIELD_COUNT; i++)
+    {
+        if (!(fields & BQ40Z80_FIELD_MASK(i)))
+            continue;
+        if (this->last_read_us[i] == NEVER)
+        {
+            mask |= BQ40Z80_FIELD_MASK(i);
+            continue;
+        }
+        // an eighth of slack absorbs the jitter of the tick driving due()
+        int64_t period_us = (int64_t)(this->period_ms(i) * this->stretch) * 1000;
+        if (now_us - this->last_read_us[i] + period_us / 8 >= period_us)
+            mask |= BQ40Z80_FIELD_MASK(i);
+    }
+    bq40z80_mutex_unlock(&this->lock);
+    return mask;
+}
+
+void BQ40Z80_SCHEDULER::update(int64_t now_us, uint32_t bus_us, const BQ40Z80_TELEMETRY *data)
+{
+    bq40z80_mutex_lock(&this->lock);
+
+    for (uint8_t i = 0; i < BQ40Z80_FIELD_COUNT; i++)
+    {
+        if (!(data->valid & BQ40Z80_FIELD_MASK(i)))
+            continue;
+        if (this->last_read_us[i] != NEVER)
+        {
+            uint32_t interval_ms = (now_us - this->last_read_us[i]) / 1000;
+            this->interval_ms[i] = this->interval_ms[i] == 0 ? interval_ms : (this->interval_ms[i] * 3 + interval_ms) / 4;
+        }
+        this->last_read_us[i] = now_us;
+        this->reads[i]++;
+    }
+
+    if (data->valid & BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_CURRENT))
+        this->current = data->current;
+    if (data->valid & BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_OPERATION_STATUS))
+        this->sleeping = data->operation_status.sleep();
+    if (data->valid & BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_CHARGING_STATUS))
+        this->terminating = data->charging_status.nct() || data->charging_status.vct();
+
+    uint16_t magnitude = this->current < 0 ? -(int32_t)this->current : this->current;
+    if (this->sleeping)
+        this->state = BQ40Z80_SCHED_SLEEP;
+    else if (magnitude >= this->schedule.active_current_ma || this->terminating)
+        this->state = BQ40Z80_SCHED_ACTIVE;
+    else
+        this->state = BQ40Z80_SCHED_IDLE;
+
+    // budget: stretch the periods in proportion to the overshoot, relax them the same way
+    if (this->window_start_us == NEVER)
+        this->window_start_us = now_us;
+    this->window_bus_us += bus_us;
+    int64_t window_us = now_us - this->window_start_us;
+    if (window_us >= (int64_t)BQ40Z80_SCHEDULER_WINDOW_MS * 1000)
+    {
+        float utilisation = (float)this->window_bus_us / window_us;
+        this->utilisation_permille = utilisation * 1000 < 1000 ? utilisation * 1000 : 1000;
+        if (this->schedule.budget_pct > 0)
+        {
+            float target = this->stretch * utilisation * 100 / this->schedule.budget_pct;
+            // half steps keep the loop from oscillating
+            this->stretch = (this->stretch + target) / 2;
+            if (this->stretch < 1.0f)
+                this->stretch = 1.0f;
+            if (this->stretch > BQ40Z80_SCHEDULER_STRETCH_MAX)
+                this->stretch = BQ40Z80_SCHEDULER_STRETCH_MAX;
+        }
+        this->window_start_us = now_us;
+        this->window_bus_us = 0;
+    }
+
+    bq40z80_mutex_unlock(&this->lock);
+}
+
+void BQ40Z80_SCHEDULER::get_stats(BQ40Z80_SCHEDULER_STATS *stats)
+{
+    bq40z80_mutex_lock(&this->lock);
+    stats->state = this->state;
+    stats->utilisation_permille = this->utilisation_permille;
+    stats->stretch_pct = this->stretch * 100;
+    for (uint8_t i = 0; i < BQ40Z80_FIELD_COUNT; i++)
+    {
+        stats->reads[i] = this->reads[i];
+        stats->rate_mhz[i] = this->interval_ms[i] > 0 ? 1000000 / this->interval_ms[i] : 0;
+    }
+    bq40z80_mutex_unlock(&this->lock);
+}
+
+/***************************** Private Functions *****************************/
+
+uint32_t BQ40Z80_SCHEDULER::period_ms(uint8_t field)
+{
+    if (this->schedule.static_fields & BQ40Z80_FIELD_MASK(field))
+        return this->schedule.static_ms;
+
+    uint32_t period = this->schedule.period_ms[this->state];
+    if (this->schedule.slow_fields & BQ40Z80_FIELD_MASK(field))
+        period *= this->schedule.slow_factor;
+    return period;
+}
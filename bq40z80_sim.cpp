@@ -0,0 +1,904 @@
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+
+#include "bq40z80_sim.h"
+
+#include <errno.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#define GAUGE_ADDRESS 0x0b
+#define DIRECT BQ40Z80_BUS_MUX_CHANNELS /*!< Slot of the gauge wired straight to the bus */
+#define MA_US_PER_MAH 3600000000LL      /*!< Charge is counted in mA·us */
+#define SLEEP_CURRENT_MA 10             /*!< Below this the gauge reports SLEEP conditions */
+#define DEVICE_NUMBER 0x4800            /*!< DeviceType() of the bq40z80 */
+#define BALANCE_MV 6                    /*!< Cells this far above the lowest one are balanced */
+#define I2CDEV_MSG_MAX 8192             /*!< Longest message i2c-dev copies in */
+
+struct BQ40Z80_SIM_GAUGE
+{
+    BQ40Z80_SIM_PACK config;
+    int64_t charge;          //!< Remaining charge (mA·us)
+    int64_t discharged;      //!< Charge drawn since the last cycle was counted (mA·us)
+    int64_t model_us;        //!< Model time of the last update
+    int64_t updated_us;      //!< bq40z80_time_us() of the last update
+    int16_t current_ma;      //!< Set by set_current()
+    int16_t average_ma;      //!< Smoothed current
+    uint16_t temperature_dk; //!< Pack temperature (0.1 K)
+    uint16_t cell_mv[7];     //!< Cell voltages, unused cells are 0
+    uint16_t cycle_count;
+    uint16_t battery_mode;
+    uint16_t mac; //!< Last ManufacturerAccess() command
+    uint16_t btp_discharge;
+    uint16_t btp_charge;
+    bool btp_int;
+    uint8_t auth_key[BQ40Z80_AUTH_KEY_LEN];
+    uint8_t auth_response[BQ40Z80_AUTH_CHALLENGE_LEN];
+    int64_t auth_ready_us;    //!< bq40z80_time_us() at which the response is ready
+    LIFETIME_DATA_1 lifetime; //!< Extremes seen since add_pack()
+    int64_t balance_us[7];    //!< Model time each cell was balanced, LifetimeDataBlock5() CB Time Cell N
+    uint8_t df[BQ40Z80_DF_SIZE];
+};
+
+struct BQ40Z80_SIM_ADAPTER
+{
+    bq40z80_mutex_t lock; //!< Held for each transaction, the adapter is one physical bus
+    uint8_t mux;          //!< Channel mask written to the mux
+    uint32_t timeout_us;  //!< Set by I2C_TIMEOUT, 0 if never set
+    uint32_t rng;         //!< xorshift32 state of the fault model
+    BQ40Z80_SIM_GAUGE *packs[BQ40Z80_BUS_MUX_CHANNELS + 1];
+    BQ40Z80_SIM_COUNTERS counters;
+};
+
+static BQ40Z80_SIM *instance = NULL;
+static const uint8_t DEFAULT_KEY[BQ40Z80_AUTH_KEY_LEN] = BQ40Z80_AUTH_DEFAULT_KEY;
+
+static uint32_t xorshift32(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static void put16(uint8_t *p, uint16_t val)
+{
+    p[0] = val & 0xff;
+    p[1] = val >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t val)
+{
+    put16(p, val & 0xffff);
+    put16(p + 2, val >> 16);
+}
+
+static uint16_t ocv_mv(int64_t charge, int64_t full)
+{
+    // 3.0 V empty to 4.2 V full, good enough to exercise the driver
+    return 3000 + (uint16_t)(charge * 1200 / (full > 0 ? full : 1));
+}
+
+/**
+ * @brief CBStatus() bits, the cells standing above the lowest one bleed while charging or at rest
+ */
+static uint16_t pack_balancing(const BQ40Z80_SIM_GAUGE *pack)
+{
+    uint16_t lo = UINT16_MAX, mask = 0;
+    for (uint8_t i = 0; i < pack->config.cells; i++)
+        lo = pack->cell_mv[i] < lo ? pack->cell_mv[i] : lo;
+    for (uint8_t i = 0; i < pack->config.cells; i++)
+        if (pack->current_ma >= 0 && pack->cell_mv[i] >= lo + BALANCE_MV)
+            mask |= 1 << i;
+    return mask;
+}
+
+static int16_t cell_power_cw(uint16_t mv, int16_t ma)
+{
+    return (int16_t)((int32_t)mv * ma / 10000);
+}
+
+static bool is_block_command(uint8_t cmd)
+{
+    return cmd == BQ40Z80_SBS_ManufacturerName || cmd == BQ40Z80_SBS_DeviceName || cmd == BQ40Z80_SBS_DeviceChemistry ||
+           cmd == BQ40Z80_SBS_ManufacturerData || cmd == BQ40Z80_SBS_AuthChallenge || cmd == BQ40Z80_SBS_Authenticate ||
+           cmd == BQ40Z80_SBS_ManufacturerBlockAccess || cmd >= BQ40Z80_SBS_SafetyAlert;
+}
+
+/***************************** Pack model *****************************/
+
+static void pack_update(BQ40Z80_SIM_GAUGE *pack, uint32_t time_scale)
+{
+    int64_t now_us = bq40z80_time_us();
+    int64_t dt_us = (now_us - pack->updated_us) * (time_scale ? time_scale : 1);
+    int64_t full = (int64_t)pack->config.design_capacity_mah * MA_US_PER_MAH;
+    pack->updated_us = now_us;
+    pack->model_us += dt_us;
+
+    pack->charge += pack->current_ma * dt_us;
+    if (pack->charge < 0)
+        pack->charge = 0;
+    if (pack->charge > full)
+        pack->charge = full;
+    if (pack->current_ma < 0)
+    {
+        pack->discharged -= pack->current_ma * dt_us;
+        while (full > 0 && pack->discharged >= full)
+        {
+            pack->discharged -= full;
+            pack->cycle_count++;
+        }
+    }
+    pack->average_ma = (pack->average_ma * 3 + pack->current_ma) / 4;
+
+    // I²R heating of every cell, 1 K per 200 mW
+    int64_t power_mw = (int64_t)pack->current_ma * pack->current_ma * pack->config.resistance_mohm * pack->config.cells / 1000000;
+    pack->temperature_dk = pack->config.ambient_dk + (uint16_t)(power_mw / 20);
+
+    uint16_t ocv = ocv_mv(pack->charge, full);
+    int32_t drop_mv = (int32_t)pack->current_ma * pack->config.resistance_mohm / 1000;
+    for (uint8_t i = 0; i < 7; i++)
+    {
+        int32_t skew = (int32_t)((pack->config.serial_number + i * 7) % 11) - 5;
+        pack->cell_mv[i] = i < pack->config.cells ? (uint16_t)(ocv + drop_mv + skew) : 0;
+    }
+
+    LIFETIME_DATA_1 *lt = &pack->lifetime;
+    uint16_t *max_mv[7] = {&lt->cell_1_max_voltage, &lt->cell_2_max_voltage, &lt->cell_3_max_voltage, &lt->cell_4_max_voltage,
+                           &lt->cell_5_max_voltage, &lt->cell_6_max_voltage, &lt->cell_7_max_voltage};
+    uint16_t *min_mv[7] = {&lt->cell_1_min_voltage, &lt->cell_2_min_voltage, &lt->cell_3_min_voltage, &lt->cell_4_min_voltage,
+                           &lt->cell_5_min_voltage, &lt->cell_6_min_voltage, &lt->cell_7_min_voltage};
+    uint16_t lo = 0xffff, hi = 0;
+    for (uint8_t i = 0; i < pack->config.cells; i++)
+    {
+        if (pack->cell_mv[i] > *max_mv[i])
+            *max_mv[i] = pack->cell_mv[i];
+        if (*min_mv[i] == 0 || pack->cell_mv[i] < *min_mv[i])
+            *min_mv[i] = pack->cell_mv[i];
+        lo = pack->cell_mv[i] < lo ? pack->cell_mv[i] : lo;
+        hi = pack->cell_mv[i] > hi ? pack->cell_mv[i] : hi;
+    }
+    if (hi - lo > lt->max_delta_cell_voltage)
+        lt->max_delta_cell_voltage = hi - lo;
+    if (pack->current_ma > lt->max_charge_current)
+        lt->max_charge_current = pack->current_ma;
+
+    uint16_t balancing = pack_balancing(pack);
+    for (uint8_t i = 0; i < 7; i++)
+        if (balancing & (1 << i))
+            pack->balance_us[i] += dt_us;
+
+    uint16_t rc = pack->charge / MA_US_PER_MAH;
+    if ((pack->btp_discharge != 0 && rc <= pack->btp_discharge) || (pack->btp_charge != 0 && rc >= pack->btp_charge))
+        pack->btp_int = true;
+}
+
+static uint8_t pack_rsoc(const BQ40Z80_SIM_GAUGE *pack)
+{
+    int64_t full = (int64_t)pack->config.design_capacity_mah * MA_US_PER_MAH;
+    return full > 0 ? (uint8_t)((pack->charge * 100 + full / 2) / full) : 0;
+}
+
+static uint16_t pack_voltage(const BQ40Z80_SIM_GAUGE *pack)
+{
+    uint16_t sum = 0;
+    for (uint8_t i = 0; i < pack->config.cells; i++)
+        sum += pack->cell_mv[i];
+    return sum;
+}
+
+static uint32_t pack_operation_status(const BQ40Z80_SIM_GAUGE *pack, uint32_t freq_hz)
+{
+    uint32_t val = OPERATION_STATUS::PRES | OPERATION_STATUS::DSG | OPERATION_STATUS::CHG | OPERATION_STATUS::SEC1;
+    if (pack->current_ma > -SLEEP_CURRENT_MA && pack->current_ma < SLEEP_CURRENT_MA)
+        val |= OPERATION_STATUS::SLEEP;
+    if (pack->btp_int)
+        val |= OPERATION_STATUS::BTP_INT;
+    if (pack->updated_us < pack->auth_ready_us)
+        val |= OPERATION_STATUS::AUTH;
+    if (freq_hz >= 400000)
+        val |= OPERATION_STATUS::XL;
+    return val;
+}
+
+static uint32_t pack_charging_status(const BQ40Z80_SIM_GAUGE *pack)
+{
+    uint32_t val = CHARGING_STATUS::RT;
+    uint8_t rsoc = pack_rsoc(pack);
+    if (pack->current_ma > 0 && rsoc >= 95)
+        val |= CHARGING_STATUS::NCT;
+    if (rsoc >= 100)
+        val |= CHARGING_STATUS::VCT;
+    return val;
+}
+
+static bool pack_read_word(const BQ40Z80_SIM_GAUGE *pack, uint8_t cmd, uint16_t *val)
+{
+    uint8_t rsoc = pack_rsoc(pack);
+    uint16_t rc = pack->charge / MA_US_PER_MAH;
+
+    switch (cmd)
+    {
+    case BQ40Z80_SBS_ManufacturerAccess:
+        *val = pack->mac;
+        return true;
+    case BQ40Z80_SBS_BatteryMode:
+        *val = pack->battery_mode;
+        return true;
+    case BQ40Z80_SBS_Temperature:
+        *val = pack->temperature_dk;
+        return true;
+    case BQ40Z80_SBS_Voltage:
+        *val = pack_voltage(pack);
+        return true;
+    case BQ40Z80_SBS_Current:
+        *val = (uint16_t)pack->current_ma;
+        return true;
+    case BQ40Z80_SBS_AverageCurrent:
+        *val = (uint16_t)pack->average_ma;
+        return true;
+    case BQ40Z80_SBS_RelativeStateOfCharge:
+    case BQ40Z80_SBS_AbsoluteStateOfCharge:
+        *val = rsoc;
+        return true;
+    case BQ40Z80_SBS_RemainingCapacity:
+        *val = rc;
+        return true;
+    case BQ40Z80_SBS_FullChargeCapacity:
+    case BQ40Z80_SBS_DesignCapacity:
+        *val = pack->config.design_capacity_mah;
+        return true;
+    case BQ40Z80_SBS_AverageTimeToEmpty:
+        *val = pack->average_ma < 0 ? (uint16_t)((uint32_t)rc * 60 / -pack->average_ma) : 0xffff;
+        return true;
+    case BQ40Z80_SBS_AverageTimeToFull:
+        *val = pack->average_ma > 0 ? (uint16_t)((uint32_t)(pack->config.design_capacity_mah - rc) * 60 / pack->average_ma) : 0xffff;
+        return true;
+    case BQ40Z80_SBS_BatteryStatus:
+        *val = 0x0080 | (pack->current_ma <= 0 ? 0x0040 : 0) | (rsoc >= 100 ? 0x0020 : 0) | (rsoc == 0 ? 0x0010 : 0);
+        return true;
+    case BQ40Z80_SBS_CycleCount:
+        *val = pack->cycle_count;
+        return true;
+    case BQ40Z80_SBS_DesignVoltage:
+        *val = pack->config.cells * 3700;
+        return true;
+    case BQ40Z80_SBS_SpecificationInfo:
+        *val = 0x0031;
+        return true;
+    case BQ40Z80_SBS_SerialNumber:
+        *val = pack->config.serial_number;
+        return true;
+    case BQ40Z80_SBS_CellVoltage4:
+    case BQ40Z80_SBS_CellVoltage5:
+    case BQ40Z80_SBS_CellVoltage6:
+    case BQ40Z80_SBS_CellVoltage7:
+        // CellVoltage7() sits at the lowest command
+        *val = pack->cell_mv[3 + BQ40Z80_SBS_CellVoltage4 - cmd];
+        return true;
+    case BQ40Z80_SBS_BTPDischargeSet:
+        *val = pack->btp_discharge;
+        return true;
+    case BQ40Z80_SBS_BTPChargeSet:
+        *val = pack->btp_charge;
+        return true;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Result of a ManufacturerAccess() command, or the SBS block of the same number
+ * @return Length of the data, without the echo
+ */
+static uint8_t pack_read_mac(const BQ40Z80_SIM_GAUGE *pack, uint16_t cmd, uint32_t freq_hz, uint8_t *out)
+{
+    memset(out, 0, BQ40Z80_SMBUS_BLOCK_MAX);
+
+    if (cmd >= BQ40Z80_DF_START && cmd < BQ40Z80_DF_START + BQ40Z80_DF_SIZE)
+    {
+        uint16_t n = BQ40Z80_DF_START + BQ40Z80_DF_SIZE - cmd;
+        memcpy(out, pack->df + (cmd - BQ40Z80_DF_START), n < BQ40Z80_DF_BLOCK ? n : BQ40Z80_DF_BLOCK);
+        return BQ40Z80_DF_BLOCK;
+    }
+
+    uint16_t temp = pack->temperature_dk;
+    switch (cmd)
+    {
+    case BQ40Z80_MFA_DEVICE_TYPE:
+        put16(out, DEVICE_NUMBER);
+        return 2;
+    case BQ40Z80_MFA_FIRMWARE_VERSION:
+        put16(out, DEVICE_NUMBER);
+        put16(out + 2, 0x0101);
+        put16(out + 4, 0x0001);
+        out[6] = 0x00;
+        put16(out + 7, 0x0385);
+        return 11;
+    case BQ40Z80_MFA_HARDWARE_VERSION:
+        put16(out, 0x0001);
+        return 2;
+    case BQ40Z80_MFA_CHEMICAL_ID:
+        put16(out, 0x1210);
+        return 2;
+    case BQ40Z80_MFA_INSTRUCTION_FLASH_SIGNATURE:
+        put16(out, 0x5a3c);
+        return 2;
+    case BQ40Z80_MFA_STATIC_DF_SIGNATURE:
+    case BQ40Z80_MFA_ALL_DF_SIGNATURE:
+    {
+        // not the algorithm of the gauge, only a stable digest of the image, static or not
+        uint16_t sig = 0;
+        for (uint16_t i = 0; i < BQ40Z80_DF_SIZE; i++)
+            sig = (uint16_t)(sig * 31 + pack->df[i]);
+        put16(out, sig);
+        return 2;
+    }
+    case BQ40Z80_MFA_SAFETY_ALERT:
+    case BQ40Z80_MFA_SAFETY_STATUS:
+    case BQ40Z80_MFA_PFALERT:
+    case BQ40Z80_MFA_PFSTATUS:
+        return 4;
+    case BQ40Z80_MFA_OPERATION_STATUS:
+        put32(out, pack_operation_status(pack, freq_hz));
+        return 4;
+    case BQ40Z80_MFA_CHARGING_STATUS:
+        put32(out, pack_charging_status(pack));
+        return 3;
+    case BQ40Z80_MFA_GAUGING_STATUS:
+        put32(out, (pack_rsoc(pack) == 0 ? GAUGING_STATUS::FD : 0) | (pack_rsoc(pack) >= 100 ? GAUGING_STATUS::FC : 0));
+        return 4;
+    case BQ40Z80_MFA_MANUFACTURING_STATUS:
+        return 2;
+    case BQ40Z80_MFA_LIFETIME_DATA_BLOCK_1:
+        bq40z80_lifetime_encode(1, &pack->lifetime, out);
+        return sizeof(LIFETIME_DATA_1);
+    case BQ40Z80_MFA_LIFETIME_DATA_BLOCK_2:
+    case BQ40Z80_MFA_LIFETIME_DATA_BLOCK_3:
+        return 32;
+    case BQ40Z80_MFA_LIFETIME_DATA_BLOCK_4:
+        put32(out, (uint32_t)(pack->model_us / 3600000000LL));
+        return sizeof(LIFETIME_DATA_4);
+    case BQ40Z80_MFA_LIFETIME_DATA_BLOCK_5:
+    {
+        LIFETIME_DATA_5 lt = {};
+        uint32_t *cb_time[7] = {&lt.cb_time_cell_1, &lt.cb_time_cell_2, &lt.cb_time_cell_3, &lt.cb_time_cell_4,
+                                &lt.cb_time_cell_5, &lt.cb_time_cell_6, &lt.cb_time_cell_7};
+        for (uint8_t i = 0; i < 7; i++)
+            *cb_time[i] = (uint32_t)(pack->balance_us[i] / 1000000);
+        bq40z80_lifetime_encode(5, &lt, out);
+        return sizeof(LIFETIME_DATA_5);
+    }
+    case BQ40Z80_MFA_CB_STATUS:
+        put16(out, pack_balancing(pack));
+        return 2;
+    case BQ40Z80_MFA_CURRENT_LONG:
+        put32(out, (uint32_t)(int32_t)pack->current_ma);
+        return 4;
+    case BQ40Z80_MFA_DA_STATUS_1:
+        for (uint8_t i = 0; i < 4; i++)
+        {
+            put16(out + 2 * i, pack->cell_mv[i]);
+            put16(out + 12 + 2 * i, i < pack->config.cells ? (uint16_t)pack->current_ma : 0);
+            put16(out + 20 + 2 * i, (uint16_t)cell_power_cw(pack->cell_mv[i], pack->current_ma));
+        }
+        put16(out + 8, pack_voltage(pack));
+        put16(out + 10, pack_voltage(pack));
+        put16(out + 28, (uint16_t)cell_power_cw(pack_voltage(pack), pack->current_ma));
+        put16(out + 30, (uint16_t)cell_power_cw(pack_voltage(pack), pack->average_ma));
+        return 32;
+    case BQ40Z80_MFA_DA_STATUS_2:
+        for (uint8_t i = 0; i < 8; i++)
+            put16(out + 2 * i, temp);
+        put16(out + 12, temp + 20); // the FETs run a little warmer
+        return 16;
+    case BQ40Z80_MFA_DA_STATUS_3:
+        for (uint8_t i = 0; i < 3; i++)
+        {
+            put16(out + 6 * i, pack->cell_mv[4 + i]);
+            put16(out + 6 * i + 2, 4 + i < pack->config.cells ? (uint16_t)pack->current_ma : 0);
+            put16(out + 6 * i + 4, (uint16_t)cell_power_cw(pack->cell_mv[4 + i], pack->current_ma));
+        }
+        return 18;
+    default:
+        return 0;
+    }
+}
+
+static void pack_write_word(BQ40Z80_SIM_GAUGE *pack, uint8_t cmd, uint16_t val)
+{
+    switch (cmd)
+    {
+    case BQ40Z80_SBS_ManufacturerAccess:
+        pack->mac = val;
+        break;
+    case BQ40Z80_SBS_BatteryMode:
+        pack->battery_mode = val;
+        break;
+    case BQ40Z80_SBS_BTPDischargeSet:
+        pack->btp_discharge = val;
+        pack->btp_int = false;
+        break;
+    case BQ40Z80_SBS_BTPChargeSet:
+        pack->btp_charge = val;
+        pack->btp_int = false;
+        break;
+    default:
+        break;
+    }
+}
+
+static void pack_write_block(BQ40Z80_SIM_GAUGE *pack, uint8_t cmd, const uint8_t *data, uint8_t len, uint32_t auth_us)
+{
+    if (cmd == BQ40Z80_SBS_Authenticate && len == BQ40Z80_AUTH_CHALLENGE_LEN)
+    {
+        bq40z80_auth_digest(pack->auth_key, data, pack->auth_response);
+        pack->auth_ready_us = pack->updated_us + auth_us;
+        return;
+    }
+    if (cmd != BQ40Z80_SBS_ManufacturerBlockAccess || len < 2)
+        return;
+
+    uint16_t mac = data[0] | (data[1] << 8);
+    pack->mac = mac;
+    if (len > 2 && mac >= BQ40Z80_DF_START && mac < BQ40Z80_DF_START + BQ40Z80_DF_SIZE)
+    {
+        uint16_t n = BQ40Z80_DF_START + BQ40Z80_DF_SIZE - mac;
+        memcpy(pack->df + (mac - BQ40Z80_DF_START), data + 2, len - 2 < n ? len - 2 : n);
+    }
+}
+
+/***************************** Public Functions *****************************/
+
+BQ40Z80_SIM::BQ40Z80_SIM(const BQ40Z80_SIM_TIMING *timing)
+{
+    static const BQ40Z80_LINUX_IO SIM_IO = {sim_open, sim_ioctl, sim_close, sim_read};
+
+    this->timing = *timing;
+    memset(this->adapters, 0, sizeof(this->adapters));
+    bq40z80_mutex_init(&this->lock);
+
+    if (instance != NULL)
+        ESP_LOGE("BQ40Z80", "a simulator is already installed, replacing it");
+    instance = this;
+    bq40z80_linux_set_io(&SIM_IO);
+}
+
+BQ40Z80_SIM::~BQ40Z80_SIM()
+{
+    if (instance == this)
+    {
+        bq40z80_linux_set_io(NULL);
+        instance = NULL;
+    }
+    for (uint16_t i = 0; i < BQ40Z80_SIM_ADAPTERS; i++)
+    {
+        BQ40Z80_SIM_ADAPTER *a = this->adapters[i];
+        if (a == NULL)
+            continue;
+        for (uint8_t j = 0; j <= DIRECT; j++)
+            delete a->packs[j];
+        bq40z80_mutex_deinit(&a->lock);
+        delete a;
+    }
+    bq40z80_mutex_deinit(&this->lock);
+}
+
+void BQ40Z80_SIM::default_timing(BQ40Z80_SIM_TIMING *timing)
+{
+    memset(timing, 0, sizeof(BQ40Z80_SIM_TIMING));
+    timing->freq_hz = 100000;
+    timing->stretch_us = 50;
+    timing->auth_us = 250000;
+    timing->time_scale = 1;
+    timing->seed = 1;
+}
+
+void BQ40Z80_SIM::default_pack(BQ40Z80_SIM_PACK *pack)
+{
+    memset(pack, 0, sizeof(BQ40Z80_SIM_PACK));
+    pack->cells = 4;
+    pack->design_capacity_mah = 3000;
+    pack->soc_pct = 80;
+    pack->resistance_mohm = 30;
+    pack->ambient_dk = 2982;
+}
+
+esp_err_t BQ40Z80_SIM::add_pack(uint8_t adapter, uint8_t mux_channel, const BQ40Z80_SIM_PACK *pack)
+{
+    uint8_t slot = mux_channel == BQ40Z80_BUS_NO_MUX ? DIRECT : mux_channel;
+    if (slot > DIRECT || pack->cells < 1 || pack->cells > 7 || pack->soc_pct > 100)
+        return ESP_ERR_INVALID_ARG;
+
+    BQ40Z80_SIM_ADAPTER *a = this->adapter(adapter, true);
+    bq40z80_mutex_lock(&a->lock);
+    if (a->packs[slot] != NULL)
+    {
+        bq40z80_mutex_unlock(&a->lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    BQ40Z80_SIM_GAUGE *p = new BQ40Z80_SIM_GAUGE();
+    memset(p, 0, sizeof(BQ40Z80_SIM_GAUGE));
+    p->config = *pack;
+    p->charge = (int64_t)pack->design_capacity_mah * MA_US_PER_MAH * pack->soc_pct / 100;
+    p->updated_us = bq40z80_time_us();
+    memset(p->df, 0xff, sizeof(p->df));
+    memcpy(p->auth_key, DEFAULT_KEY, BQ40Z80_AUTH_KEY_LEN);
+    pack_update(p, this->timing.time_scale);
+    a->packs[slot] = p;
+    bq40z80_mutex_unlock(&a->lock);
+    return ESP_OK;
+}
+
+esp_err_t BQ40Z80_SIM::set_current(uint8_t adapter, uint8_t mux_channel, int16_t current_ma)
+{
+    uint8_t slot = mux_channel == BQ40Z80_BUS_NO_MUX ? DIRECT : mux_channel;
+    BQ40Z80_SIM_ADAPTER *a = this->adapter(adapter, false);
+    if (a == NULL || slot > DIRECT)
+        return ESP_ERR_NOT_FOUND;
+
+    bq40z80_mutex_lock(&a->lock);
+    BQ40Z80_SIM_GAUGE *p = a->packs[slot];
+    if (p != NULL)
+    {
+        // close the interval at the old current first
+        pack_update(p, this->timing.time_scale);
+        p->current_ma = current_ma;
+    }
+    bq40z80_mutex_unlock(&a->lock);
+    return p != NULL ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t BQ40Z80_SIM::set_auth_key(uint8_t adapter, uint8_t mux_channel, const uint8_t *key)
+{
+    uint8_t slot = mux_channel == BQ40Z80_BUS_NO_MUX ? DIRECT : mux_channel;
+    BQ40Z80_SIM_ADAPTER *a = this->adapter(adapter, false);
+    if (a == NULL || slot > DIRECT)
+        return ESP_ERR_NOT_FOUND;
+
+    bq40z80_mutex_lock(&a->lock);
+    BQ40Z80_SIM_GAUGE *p = a->packs[slot];
+    if (p != NULL)
+        memcpy(p->auth_key, key, BQ40Z80_AUTH_KEY_LEN);
+    bq40z80_mutex_unlock(&a->lock);
+    return p != NULL ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+void BQ40Z80_SIM::get_counters(BQ40Z80_SIM_COUNTERS *counters)
+{
+    memset(counters, 0, sizeof(BQ40Z80_SIM_COUNTERS));
+    for (uint16_t i = 0; i < BQ40Z80_SIM_ADAPTERS; i++)
+    {
+        BQ40Z80_SIM_ADAPTER *a = this->adapter(i, false);
+        if (a == NULL)
+            continue;
+        bq40z80_mutex_lock(&a->lock);
+        counters->transactions += a->counters.transactions;
+        counters->rejected += a->counters.rejected;
+        counters->nacks += a->counters.nacks;
+        counters->timeouts += a->counters.timeouts;
+        counters->pec_errors += a->counters.pec_errors;
+        counters->wire_time_us += a->counters.wire_time_us;
+        bq40z80_mutex_unlock(&a->lock);
+    }
+}
+
+int BQ40Z80_SIM::rdwr(uint8_t adapter, struct i2c_msg *msgs, uint32_t n_msgs)
+{
+    BQ40Z80_SIM_ADAPTER *a = this->adapter(adapter, true);
+    bq40z80_mutex_lock(&a->lock);
+    int result = this->transfer(a, msgs, n_msgs);
+    bq40z80_mutex_unlock(&a->lock);
+    return result;
+}
+
+/***************************** Private Functions *****************************/
+
+BQ40Z80_SIM_ADAPTER *BQ40Z80_SIM::adapter(uint8_t index, bool create)
+{
+    bq40z80_mutex_lock(&this->lock);
+    BQ40Z80_SIM_ADAPTER *a = this->adapters[index];
+    if (a == NULL && create)
+    {
+        a = new BQ40Z80_SIM_ADAPTER();
+        memset(a, 0, sizeof(BQ40Z80_SIM_ADAPTER));
+        bq40z80_mutex_init(&a->lock);
+        // xorshift32 must not start from zero
+        a->rng = (this->timing.seed ^ (index * 2654435761u)) | 1;
+        this->adapters[index] = a;
+    }
+    bq40z80_mutex_unlock(&this->lock);
+    return a;
+}
+
+int BQ40Z80_SIM::transfer(BQ40Z80_SIM_ADAPTER *adapter, struct i2c_msg *msgs, uint32_t n_msgs)
+{
+    uint16_t len[I2C_RDWR_IOCTL_MAX_MSGS];
+
+    // i2cdev_ioctl_rdwr(): everything is checked before the adapter sees the first message
+    if (msgs == NULL || n_msgs == 0 || n_msgs > I2C_RDWR_IOCTL_MAX_MSGS)
+    {
+        adapter->counters.rejected++;
+        return EINVAL;
+    }
+    for (uint32_t i = 0; i < n_msgs; i++)
+    {
+        struct i2c_msg *m = &msgs[i];
+        bool bad = m->len > I2CDEV_MSG_MAX;
+        if (!bad && (m->flags & I2C_M_RECV_LEN))
+            bad = !(m->flags & I2C_M_RD) || m->len == 0 || m->buf[0] < 1 || m->len < m->buf[0] + I2C_SMBUS_BLOCK_MAX;
+        if (bad)
+        {
+            adapter->counters.rejected++;
+            return EINVAL;
+        }
+        // the kernel works on its own copy, the length it extends isn't written back
+        len[i] = m->flags & I2C_M_RECV_LEN ? m->buf[0] : m->len;
+    }
+
+    int result = 0;
+    uint32_t stretch_us = this->timing.stretch_us;
+    if (this->timing.stretch_jitter_us > 0)
+        stretch_us += xorshift32(&adapter->rng) % (this->timing.stretch_jitter_us + 1);
+
+    adapter->counters.transactions++;
+    if (this->timing.nack_ppm > 0 && xorshift32(&adapter->rng) % 1000000 < this->timing.nack_ppm)
+        result = EREMOTEIO;
+    else if (msgs[0].addr == BQ40Z80_SIM_MUX_ADDRESS)
+    {
+        for (uint32_t i = 0; i < n_msgs; i++)
+        {
+            if (msgs[i].flags & I2C_M_RD)
+                memset(msgs[i].buf, adapter->mux, len[i]);
+            else if (len[i] > 0)
+                adapter->mux = msgs[i].buf[len[i] - 1];
+        }
+    }
+    else if (msgs[0].addr == GAUGE_ADDRESS)
+    {
+        // one channel on: the gauge behind it, none: the one on the bus, more: both drive the bus
+        uint8_t slot = adapter->mux == 0 ? DIRECT : __builtin_ctz(adapter->mux);
+        BQ40Z80_SIM_GAUGE *pack = (adapter->mux & (adapter->mux - 1)) == 0 ? adapter->packs[slot] : NULL;
+        result = pack != NULL ? this->gauge_transfer(adapter, pack, msgs, len, n_msgs) : ENXIO;
+    }
+    else
+    {
+        result = ENXIO;
+    }
+
+    // S, one address byte per message, Sr between messages, P
+    uint32_t bytes = 0;
+    for (uint32_t i = 0; i < n_msgs; i++)
+        bytes += 1 + len[i];
+    uint32_t wire_us = bq40z80_wire_time_us(bytes, n_msgs + 1, this->timing.freq_hz ? this->timing.freq_hz : 100000);
+
+    if (result == ENXIO || result == EREMOTEIO)
+        adapter->counters.nacks++;
+    else if (result == 0 && adapter->timeout_us > 0 && stretch_us > adapter->timeout_us)
+    {
+        result = ETIMEDOUT;
+        stretch_us = adapter->timeout_us;
+        adapter->counters.timeouts++;
+    }
+    adapter->counters.wire_time_us += wire_us + stretch_us;
+    if (this->timing.realtime)
+        bq40z80_sleep_us(wire_us + stretch_us);
+    return result;
+}
+
+int BQ40Z80_SIM::gauge_transfer(BQ40Z80_SIM_ADAPTER *adapter, BQ40Z80_SIM_GAUGE *pack, struct i2c_msg *msgs, uint16_t *len, uint32_t n_msgs)
+{
+    int result = 0;
+    const struct i2c_msg *mac = NULL; // last ManufacturerAccess() or ManufacturerBlockAccess() write
+    uint8_t mac_payload = 0;
+
+    pack_update(pack, this->timing.time_scale);
+
+    for (uint32_t i = 0; i < n_msgs && result == 0; i++)
+    {
+        struct i2c_msg *m = &msgs[i];
+        if (len[i] == 0 && !(m->flags & I2C_M_RECV_LEN))
+            continue;
+
+        if (!(m->flags & I2C_M_RD))
+        {
+            uint8_t cmd = m->buf[0];
+            if (i + 1 < n_msgs && (msgs[i + 1].flags & I2C_M_RD))
+                continue; // command byte of the read that follows
+
+            uint8_t header[2] = {(uint8_t)(GAUGE_ADDRESS << 1), cmd};
+            uint8_t payload = is_block_command(cmd) ? (len[i] >= 2 ? 1 + m->buf[1] : 0) : 2;
+            if (len[i] < 1 + payload)
+            {
+                result = EREMOTEIO;
+                break;
+            }
+            if (len[i] > 1 + payload && bq40z80_pec(bq40z80_pec(0, header, 2), m->buf + 1, payload) != m->buf[1 + payload])
+            {
+                adapter->counters.pec_errors++;
+                result = EREMOTEIO;
+                break;
+            }
+            if (cmd == BQ40Z80_SBS_ManufacturerAccess || cmd == BQ40Z80_SBS_ManufacturerBlockAccess)
+            {
+                mac = m;
+                mac_payload = payload;
+            }
+            else if (is_block_command(cmd))
+                pack_write_block(pack, cmd, m->buf + 2, payload - 1, this->timing.auth_us);
+            else
+                pack_write_word(pack, cmd, m->buf[1] | (m->buf[2] << 8));
+            continue;
+        }
+
+        // read: the command comes from the write before it
+        if (i == 0 || (msgs[i - 1].flags & I2C_M_RD) || len[i - 1] < 1)
+        {
+            result = EREMOTEIO;
+            break;
+        }
+        uint8_t cmd = msgs[i - 1].buf[len[i - 1] - 1];
+        uint8_t frame[1 + BQ40Z80_MFA_ECHO_LEN + BQ40Z80_SMBUS_BLOCK_MAX];
+        uint8_t frame_len;
+
+        if (!is_block_command(cmd))
+        {
+            uint16_t val = 0;
+            if (!pack_read_word(pack, cmd, &val))
+            {
+                result = EREMOTEIO;
+                break;
+            }
+            put16(frame, val);
+            frame_len = 2;
+        }
+        else if (cmd == BQ40Z80_SBS_ManufacturerData || cmd == BQ40Z80_SBS_ManufacturerBlockAccess)
+        {
+            // the MAC result repeats the command before the data
+            uint8_t n = pack_read_mac(pack, pack->mac, this->timing.freq_hz, frame + 1 + BQ40Z80_MFA_ECHO_LEN);
+            put16(frame + 1, pack->mac);
+            frame[0] = BQ40Z80_MFA_ECHO_LEN + n;
+            frame_len = 1 + frame[0];
+        }
+        else if (cmd == BQ40Z80_SBS_Authenticate)
+        {
+            // the gauge has nothing to send until the digest is done
+            if (pack->updated_us < pack->auth_ready_us)
+            {
+                result = EREMOTEIO;
+                break;
+            }
+            memcpy(frame + 1, pack->auth_response, BQ40Z80_AUTH_CHALLENGE_LEN);
+            frame[0] = BQ40Z80_AUTH_CHALLENGE_LEN;
+            frame_len = 1 + frame[0];
+        }
+        else
+        {
+            static const char *const NAMES[] = {"Texas Inst.", "bq40z80", "LION"};
+            uint8_t n;
+            if (cmd <= BQ40Z80_SBS_DeviceChemistry)
+            {
+                n = strlen(NAMES[cmd - BQ40Z80_SBS_ManufacturerName]);
+                memcpy(frame + 1, NAMES[cmd - BQ40Z80_SBS_ManufacturerName], n);
+            }
+            else
+            {
+                // SBS blocks from 0x50 share their number with the MAC command
+                n = pack_read_mac(pack, cmd, this->timing.freq_hz, frame + 1);
+            }
+            frame[0] = n;
+            frame_len = 1 + n;
+        }
+
+        if (m->flags & I2C_M_RECV_LEN)
+        {
+            // the adapter reads the count first and extends the message by it, buf[0] held the bytes around the data
+            if (frame[0] == 0 || frame[0] > I2C_SMBUS_BLOCK_MAX)
+            {
+                result = EPROTO;
+                break;
+            }
+            len[i] += frame[0];
+        }
+
+        // the gauge sends the PEC after the data, then idles high
+        uint8_t header[3] = {(uint8_t)(GAUGE_ADDRESS << 1), cmd, (uint8_t)(GAUGE_ADDRESS << 1 | 1)};
+        uint8_t pec = bq40z80_pec(bq40z80_pec(0, header, 3), frame, frame_len);
+        for (uint16_t j = 0; j < len[i]; j++)
+            m->buf[j] = j < frame_len ? frame[j] : j == frame_len ? pec : 0xff;
+    }
+
+    // the gauge runs a MAC command on the STOP ending its write, a read within the same transaction sees the previous one
+    if (mac != NULL)
+    {
+        if (mac->buf[0] == BQ40Z80_SBS_ManufacturerBlockAccess)
+            pack_write_block(pack, mac->buf[0], mac->buf + 2, mac_payload - 1, this->timing.auth_us);
+        else
+            pack_write_word(pack, mac->buf[0], mac->buf[1] | (mac->buf[2] << 8));
+    }
+    return result;
+}
+
+int BQ40Z80_SIM::sim_open(const char *path, int flags)
+{
+    int n;
+    (void)flags;
+
+    if (instance != NULL && sscanf(path, "/sys/bus/i2c/devices/i2c-%d/of_node/clock-frequency", &n) == 1 && n >= 0 && n < BQ40Z80_SIM_ADAPTERS)
+        return BQ40Z80_SIM_CLOCK_FD_BASE + n;
+    if (instance == NULL || sscanf(path, "/dev/i2c-%d", &n) != 1 || n < 0 || n >= BQ40Z80_SIM_ADAPTERS)
+    {
+        errno = ENOENT;
+        return -1;
+    }
+    instance->adapter(n, true);
+    return BQ40Z80_SIM_FD_BASE + n;
+}
+
+int BQ40Z80_SIM::sim_ioctl(int fd, unsigned long request, void *arg)
+{
+    int n = fd - BQ40Z80_SIM_FD_BASE;
+    BQ40Z80_SIM_ADAPTER *a = instance != NULL && n >= 0 && n < BQ40Z80_SIM_ADAPTERS ? instance->adapter(n, false) : NULL;
+    if (a == NULL)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    int result = 0;
+    switch (request)
+    {
+    case I2C_FUNCS:
+        *(unsigned long *)arg = I2C_FUNC_I2C | I2C_FUNC_SMBUS_READ_BLOCK_DATA | I2C_FUNC_SMBUS_PEC;
+        break;
+    case I2C_TIMEOUT:
+        bq40z80_mutex_lock(&a->lock);
+        a->timeout_us = (uint32_t)(uintptr_t)arg * 10000;
+        bq40z80_mutex_unlock(&a->lock);
+        break;
+    case I2C_RDWR:
+    {
+        struct i2c_rdwr_ioctl_data *rdwr = (struct i2c_rdwr_ioctl_data *)arg;
+        result = instance->rdwr(n, rdwr->msgs, rdwr->nmsgs);
+        break;
+    }
+    default:
+        break;
+    }
+
+    if (result != 0)
+    {
+        errno = result;
+        return -1;
+    }
+    return 0;
+}
+
+int BQ40Z80_SIM::sim_close(int fd)
+{
+    // adapters live as long as the simulator, packs stay plugged in between opens
+    (void)fd;
+    return 0;
+}
+
+int BQ40Z80_SIM::sim_read(int fd, void *buf, size_t len)
+{
+    int n = fd - BQ40Z80_SIM_CLOCK_FD_BASE;
+    if (instance == NULL || n < 0 || n >= BQ40Z80_SIM_ADAPTERS || len < 4)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    // a big-endian u32, like every device tree cell
+    uint32_t freq_hz = instance->timing.freq_hz;
+    uint8_t *raw = (uint8_t *)buf;
+    raw[0] = freq_hz >> 24;
+    raw[1] = freq_hz >> 16;
+    raw[2] = freq_hz >> 8;
+    raw[3] = freq_hz;
+    return 4;
+}
+
+#endif
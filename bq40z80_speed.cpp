@@ -0,0 +1,96 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include "bq40z80.h"
+
+    /**
+     * @brief Clock ladder walked down by bus_speed_feedback()
+     */
+    static const uint32_t BUS_SPEEDS[] = {BQ40Z80_BUS_FREQ_XL_HZ, BQ40Z80_BUS_FREQ_STD_HZ, I2C_MASTER_FREQ_HZ};
+
+    /***************************** Public Functions *****************************/
+
+    void BQ40Z80::negotiate_bus_speed()
+    {
+        ESP_ERROR_CHECK(this->try_negotiate_bus_speed());
+    }
+
+    uint32_t BQ40Z80::get_bus_speed()
+    {
+        return this->bus != NULL ? this->bus->freq_hz : this->bus_freq_hz;
+    }
+
+    esp_err_t BQ40Z80::try_negotiate_bus_speed(BQ40Z80_CALL *call)
+    {
+        BQ40Z80_CALL *outer = this->call_begin(call);
+
+        OPERATION_STATUS status;
+        esp_err_t err = this->try_read_operation_status(&status);
+        if (err != ESP_OK)
+            return this->call_end(outer, err);
+
+        uint32_t freq_hz = status.xl() ? BQ40Z80_BUS_FREQ_XL_HZ : BQ40Z80_BUS_FREQ_STD_HZ;
+        err = this->set_freq_limit(freq_hz);
+        if (err != ESP_OK)
+            return this->call_end(outer, err);
+        this->bus_errors = 0;
+
+        return this->call_end(outer, ESP_OK);
+    }
+
+    /***************************** Private Functions *****************************/
+
+    void BQ40Z80::bus_speed_feedback(esp_err_t err)
+    {
+        // only errors of the wire itself, a bad length or echo doesn't get better at a lower clock
+        if (err != ESP_FAIL && err != ESP_ERR_TIMEOUT && err != ESP_ERR_INVALID_CRC)
+        {
+            if (err == ESP_OK)
+                this->bus_errors = 0;
+            return;
+        }
+        if (++this->bus_errors < BQ40Z80_BUS_FALLBACK_ERRORS)
+            return;
+        this->bus_errors = 0;
+
+        uint32_t freq_hz = this->get_bus_speed();
+        for (uint8_t i = 0; i < sizeof(BUS_SPEEDS) / sizeof(BUS_SPEEDS[0]); i++)
+        {
+            if (BUS_SPEEDS[i] >= freq_hz)
+                continue;
+            if (this->set_freq_limit(BUS_SPEEDS[i]) != ESP_OK)
+                return;
+            ESP_LOGW("SMBus", "bus errors at %u Hz, falling back to %u Hz", (unsigned)freq_hz, (unsigned)this->get_bus_speed());
+            return;
+        }
+    }
+
+    esp_err_t BQ40Z80::set_freq_limit(uint32_t freq_hz)
+    {
+        // the port belongs to a bus the gauge never joined
+        if (this->unattached)
+            return ESP_ERR_NO_MEM;
+        if (freq_hz == this->freq_limit_hz && this->get_bus_speed() <= freq_hz)
+            return ESP_OK;
+
+        uint32_t old_limit_hz = this->freq_limit_hz;
+        uint32_t old_hz = this->get_bus_speed();
+        this->freq_limit_hz = freq_hz;
+
+        // on a shared bus the slowest gauge sets the pace, the limit of this one may not change it
+        esp_err_t err = this->bus != NULL ? this->bus->negotiate() : this->bus_set_freq(freq_hz);
+        if (err != ESP_OK)
+        {
+            this->freq_limit_hz = old_limit_hz;
+            return err;
+        }
+        if (this->bus == NULL && this->get_bus_speed() != old_hz)
+            ESP_LOGI("SMBus", "bus clock set to %u Hz", (unsigned)this->get_bus_speed());
+        return ESP_OK;
+    }
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,139 @@
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "bq40z80.h"
+
+    static_assert((BQ40Z80_STATS_MAX_COMMANDS & (BQ40Z80_STATS_MAX_COMMANDS - 1)) == 0, "BQ40Z80_STATS_MAX_COMMANDS must be a power of two");
+
+    uint32_t bq40z80_isqrt(uint64_t val)
+    {
+        uint64_t root = 0;
+        uint64_t bit = (uint64_t)1 << 62;
+
+        while (bit > val)
+            bit >>= 2;
+        while (bit != 0)
+        {
+            if (val >= root + bit)
+            {
+                val -= root + bit;
+                root = (root >> 1) + bit;
+            }
+            else
+            {
+                root >>= 1;
+            }
+            bit >>= 2;
+        }
+        return (uint32_t)root;
+    }
+
+    size_t bq40z80_stats_export(const BQ40Z80_STATS *stats, char *buf, size_t len)
+    {
+        size_t total = 0;
+
+        // snprintf() keeps counting past the end of the buffer, the result sizes a second pass
+        for (uint32_t i = 0; i < BQ40Z80_STATS_MAX_COMMANDS; i++)
+        {
+            const BQ40Z80_CMD_STATS *s = &stats->commands[i];
+            if (s->kind == BQ40Z80_STATS_KIND_NONE)
+                continue;
+            int n = snprintf(buf != NULL && total < len ? buf + total : NULL, buf != NULL && total < len ? len - total : 0,
+                             "{\"kind\":\"%s\",\"command\":%u,\"transactions\":%" PRIu32 ",\"errors\":%" PRIu32
+                             ",\"retries\":%" PRIu32 ",\"bytes\":%" PRIu64 ",\"clocks\":%" PRIu64
+                             ",\"wire_us_50k\":%" PRIu64 ",\"wire_us_100k\":%" PRIu64 ",\"wire_us_400k\":%" PRIu64
+                             ",\"latency_avg_us\":%" PRIu64 ",\"latency_max_us\":%" PRIu32 "}\n",
+                             s->kind == BQ40Z80_STATS_KIND_MFA ? "mfa" : "sbs", s->command, s->transactions, s->errors,
+                             s->retries, s->bytes, s->clocks, bq40z80_clocks_to_us(s->clocks, 50000),
+                             bq40z80_clocks_to_us(s->clocks, 100000), bq40z80_clocks_to_us(s->clocks, 400000),
+                             s->transactions ? s->latency_total_us / s->transactions : 0, s->latency_max_us);
+            if (n > 0)
+                total += n;
+        }
+        int n = snprintf(buf != NULL && total < len ? buf + total : NULL, buf != NULL && total < len ? len - total : 0,
+                         "{\"dropped\":%" PRIu32 "}\n", stats->dropped);
+        if (n > 0)
+            total += n;
+        return total;
+    }
+
+    /***************************** Public Functions *****************************/
+
+    void BQ40Z80::get_stats(BQ40Z80_STATS *snapshot)
+    {
+#if BQ40Z80_STATS_ENABLE
+        bq40z80_mutex_lock(&this->lock);
+        memcpy(snapshot, &this->stats, sizeof(BQ40Z80_STATS));
+        bq40z80_mutex_unlock(&this->lock);
+#else
+        memset(snapshot, 0, sizeof(BQ40Z80_STATS));
+#endif
+    }
+
+    void BQ40Z80::reset_stats()
+    {
+#if BQ40Z80_STATS_ENABLE
+        bq40z80_mutex_lock(&this->lock);
+        memset(&this->stats, 0, sizeof(BQ40Z80_STATS));
+        bq40z80_mutex_unlock(&this->lock);
+#endif
+    }
+
+    /***************************** Private Functions *****************************/
+
+#if BQ40Z80_STATS_ENABLE
+    void BQ40Z80::stats_record(uint8_t kind, uint16_t command, uint32_t bytes, uint32_t conditions, uint8_t attempts, esp_err_t err, int64_t start_us)
+    {
+        uint32_t latency = (uint32_t)(bq40z80_time_us() - start_us);
+        uint32_t key = ((uint32_t)kind << 16) | command;
+        // Fibonacci hashing, the top log2(BQ40Z80_STATS_MAX_COMMANDS) bits of the product pick the slot
+        uint32_t slot = (uint32_t)((uint64_t)(uint32_t)(key * 2654435761u) >> (32 - __builtin_ctz(BQ40Z80_STATS_MAX_COMMANDS)));
+        BQ40Z80_CMD_STATS *entry = NULL;
+
+        // open addressing, the table never shrinks so a probe ends at the first free slot
+        for (uint32_t i = 0; i < BQ40Z80_STATS_MAX_COMMANDS; i++)
+        {
+            BQ40Z80_CMD_STATS *s = &this->stats.commands[(slot + i) & (BQ40Z80_STATS_MAX_COMMANDS - 1)];
+            if (s->kind == BQ40Z80_STATS_KIND_NONE)
+            {
+                s->kind = kind;
+                s->command = command;
+            }
+            if (s->kind == kind && s->command == command)
+            {
+                entry = s;
+                break;
+            }
+        }
+        if (entry == NULL)
+        {
+            this->stats.dropped++;
+            return;
+        }
+
+        entry->transactions++;
+        entry->retries += attempts - 1;
+        if (err != ESP_OK)
+            entry->errors++;
+        entry->bytes += (uint64_t)bytes * attempts;
+        entry->wire_time_us += (uint64_t)bq40z80_wire_time_us(bytes, conditions, this->get_bus_speed()) * attempts;
+        entry->clocks += (uint64_t)(bytes * 9 + conditions) * attempts;
+        entry->latency_total_us += latency;
+        if (latency > entry->latency_max_us)
+            entry->latency_max_us = latency;
+
+        uint32_t bucket = 0;
+        while (bucket < BQ40Z80_STATS_LATENCY_BUCKETS - 1 && latency >= ((uint32_t)BQ40Z80_STATS_LATENCY_FIRST_US << bucket))
+            bucket++;
+        entry->latency_hist[bucket]++;
+    }
+#endif
+
+#ifdef __cplusplus
+}
+#endif
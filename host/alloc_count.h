@@ -0,0 +1,18 @@
+#ifndef __ALLOC_COUNT_H
+#define __ALLOC_COUNT_H
+
+#include <stdint.h>
+
+/**
+ * @brief Heap allocations made by the process since the last alloc_count_reset()
+ * @note Linking alloc_count.cpp replaces malloc, calloc, realloc and the global operator new of the
+ *       executable, every thread counts. Take the count right after the code under test.
+ */
+uint64_t alloc_count();
+
+/**
+ * @brief Restart the count at 0
+ */
+void alloc_count_reset();
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#include <stdio.h>
+#include <time.h>
+
+#include "bq40z80.h"
+
+#define BENCH_MIN_NS 50000000ULL /*!< Shortest run of a rate measurement */
+
+/**
+ * @brief Bus clocks the wire time is reported at
+ */
+static const uint32_t BENCH_FREQS_HZ[] = {50000, 100000, 400000};
+
+/**
+ * @brief Monotonic clock in nanoseconds
+ */
+static inline uint64_t bench_now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Open a result line
+ * @note Results are JSON Lines on stdout, one object per measurement with 'bench' and 'name' first.
+ *       Close each line with bench_end().
+ * @param bench Name of the benchmark executable
+ * @param name Name of the measurement
+ */
+static inline void bench_begin(const char *bench, const char *name)
+{
+    printf("{\"bench\":\"%s\",\"name\":\"%s\"", bench, name);
+}
+
+static inline void bench_u64(const char *key, uint64_t val)
+{
+    printf(",\"%s\":%llu", key, (unsigned long long)val);
+}
+
+static inline void bench_f64(const char *key, double val)
+{
+    printf(",\"%s\":%.3f", key, val);
+}
+
+static inline void bench_str(const char *key, const char *val)
+{
+    printf(",\"%s\":\"%s\"", key, val);
+}
+
+static inline void bench_end()
+{
+    printf("}\n");
+    fflush(stdout);
+}
+
+/**
+ * @brief Add the wire cost of a call: transactions, attempts, bytes, clocks and the wire time at each
+ *        of BENCH_FREQS_HZ as wire_us_<kHz>k
+ */
+static inline void bench_call(const BQ40Z80_CALL *call)
+{
+    char key[24];
+
+    bench_u64("transactions", call->transactions);
+    bench_u64("attempts", call->attempts);
+    bench_u64("bytes", call->bytes);
+    bench_u64("clocks", call->clocks);
+    for (size_t i = 0; i < sizeof(BENCH_FREQS_HZ) / sizeof(BENCH_FREQS_HZ[0]); i++)
+    {
+        snprintf(key, sizeof(key), "wire_us_%uk", (unsigned)(BENCH_FREQS_HZ[i] / 1000));
+        bench_u64(key, bq40z80_clocks_to_us(call->clocks, BENCH_FREQS_HZ[i]));
+    }
+}
+
+/**
+ * @brief Time an operation
+ * @note Runs it in batches until BENCH_MIN_NS have passed
+ * @param op Operation, called with arg
+ * @param arg Passed to op
+ * @return Mean time of one run, unit: ns
+ */
+template <typename ARG>
+static inline double bench_time_ns(void (*op)(ARG *arg), ARG *arg)
+{
+    uint64_t runs = 0;
+    uint64_t batch = 1;
+    uint64_t start = bench_now_ns();
+    uint64_t elapsed;
+
+    do
+    {
+        for (uint64_t i = 0; i < batch; i++)
+            op(arg);
+        runs += batch;
+        batch *= 2;
+        elapsed = bench_now_ns() - start;
+    } while (elapsed < BENCH_MIN_NS);
+    return (double)elapsed / runs;
+}
+
+#endif
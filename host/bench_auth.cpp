@@ -0,0 +1,207 @@
+/**
+ * Cost of pack authentication against the simulator in real time: the digest on the host, a challenge
+ * taken from the pool against one computed inline, then each phase of try_authenticate() with its wire
+ * cost, and the reads another pack of the same bus gets through while the gauge computes.
+ * Results are JSON Lines on stdout.
+ */
+#include "alloc_count.h"
+#include "bench.h"
+#include "bq40z80_auth_pool.h"
+#include "bq40z80_sim.h"
+#include "check.h"
+
+#include <pthread.h>
+
+#define BENCH "bench_auth"
+#define AUTH_US 20000          /*!< Digest time of the simulated gauges, the TRM gives 250 ms */
+#define AUTH_RUNS 8            /*!< Authentications averaged */
+#define POOL_CAPACITY 64       /*!< Entries of the pool */
+#define CALL_TIMEOUT_US 1000000
+
+typedef struct
+{
+    uint8_t key[BQ40Z80_AUTH_KEY_LEN];
+    uint8_t challenge[BQ40Z80_AUTH_CHALLENGE_LEN];
+    uint8_t response[BQ40Z80_AUTH_CHALLENGE_LEN];
+} DIGEST_ARG;
+
+typedef struct
+{
+    BQ40Z80_AUTH_POOL *pool;
+    BQ40Z80_AUTH_CHALLENGE entry;
+} TAKE_ARG;
+
+typedef struct
+{
+    BQ40Z80 *bq;
+    volatile bool stop;
+    uint32_t reads;
+} NEIGHBOUR;
+
+static void digest(DIGEST_ARG *arg)
+{
+    bq40z80_auth_digest(arg->key, arg->challenge, arg->response);
+    arg->challenge[0] = arg->response[0];
+}
+
+static void take(TAKE_ARG *arg)
+{
+    arg->pool->take(&arg->entry);
+}
+
+static void *neighbour(void *arg)
+{
+    NEIGHBOUR *n = (NEIGHBOUR *)arg;
+    uint16_t val;
+
+    while (!n->stop)
+    {
+        BQ40Z80_CALL call = bq40z80_call_within(CALL_TIMEOUT_US, 1);
+        if (n->bq->try_get_voltage(&val, &call) == ESP_OK)
+            n->reads++;
+    }
+    return NULL;
+}
+
+static void bench_digest()
+{
+    static const uint8_t KEY[BQ40Z80_AUTH_KEY_LEN] = BQ40Z80_AUTH_DEFAULT_KEY;
+    DIGEST_ARG arg;
+
+    memcpy(arg.key, KEY, sizeof(arg.key));
+    memset(arg.challenge, 0x5a, sizeof(arg.challenge));
+    alloc_count_reset();
+    double ns = bench_time_ns(digest, &arg);
+    uint64_t allocs = alloc_count();
+
+    bench_begin(BENCH, "auth_digest");
+    bench_f64("ns", ns);
+    bench_f64("digests_per_s", 1e9 / ns);
+    bench_u64("allocs", allocs);
+    bench_end();
+
+    CHECK_EQ(allocs, 0);
+}
+
+static void bench_pool()
+{
+    static const uint8_t KEY[BQ40Z80_AUTH_KEY_LEN] = BQ40Z80_AUTH_DEFAULT_KEY;
+    BQ40Z80_AUTH_POOL pool(KEY, POOL_CAPACITY);
+    BQ40Z80_AUTH_POOL_STATS stats;
+    TAKE_ARG arg = {&pool, {}};
+    uint64_t hit_ns = 0, refill_ns = 0, hits = 0;
+
+    // an empty pool computes each entry inline
+    double miss_ns = bench_time_ns(take, &arg);
+    pool.get_stats(&stats);
+    uint32_t misses = stats.misses;
+    CHECK(misses > 0);
+
+    // refill then drain, timed apart, no background task
+    while (hit_ns + refill_ns < BENCH_MIN_NS)
+    {
+        uint64_t start = bench_now_ns();
+        uint16_t added = pool.refill();
+        uint64_t filled = bench_now_ns();
+        for (uint16_t i = 0; i < added; i++)
+            pool.take(&arg.entry);
+        hit_ns += bench_now_ns() - filled;
+        refill_ns += filled - start;
+        hits += added;
+    }
+    pool.get_stats(&stats);
+
+    bench_begin(BENCH, "pool_take");
+    bench_f64("miss_ns", miss_ns);
+    bench_f64("hit_ns", hits ? (double)hit_ns / hits : 0);
+    bench_f64("refill_ns_per_entry", hits ? (double)refill_ns / hits : 0);
+    bench_end();
+
+    CHECK(hits > 0);
+    CHECK_EQ(stats.misses, misses);
+}
+
+/**
+ * @brief Phases of try_authenticate() on one pack, while a second pack of the bus is read in a loop
+ */
+static void bench_phases(BQ40Z80_SIM *sim)
+{
+    static const uint8_t KEY[BQ40Z80_AUTH_KEY_LEN] = BQ40Z80_AUTH_DEFAULT_KEY;
+    BQ40Z80_AUTH_POOL pool(KEY, POOL_CAPACITY);
+    BQ40Z80_BUS bus((i2c_port_t)0, BQ40Z80_SIM_MUX_ADDRESS);
+    BQ40Z80 bq(&bus, 0);
+    BQ40Z80 other(&bus, 1);
+    BQ40Z80_AUTH_TIMING timing;
+    BQ40Z80_AUTH_CHALLENGE entry;
+    NEIGHBOUR n = {&other, false, 0};
+    pthread_t thread;
+    uint64_t challenge_us = 0, digest_us = 0, response_us = 0, polls = 0, bytes = 0, clocks = 0, transactions = 0;
+    uint32_t failures = 0;
+
+    pool.refill();
+    other.set_cache_ttl(0);
+    pthread_create(&thread, NULL, neighbour, &n);
+    uint64_t start = bench_now_ns();
+    for (uint8_t i = 0; i < AUTH_RUNS; i++)
+    {
+        BQ40Z80_CALL call = bq40z80_call_within(CALL_TIMEOUT_US, 0);
+        pool.take(&entry);
+        if (bq.try_authenticate(&entry, &timing, &call) != ESP_OK)
+            failures++;
+        challenge_us += timing.challenge_us;
+        digest_us += timing.digest_us;
+        response_us += timing.response_us;
+        polls += timing.polls;
+        bytes += call.bytes;
+        clocks += call.clocks;
+        transactions += call.transactions;
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    n.stop = true;
+    pthread_join(thread, NULL);
+
+    bench_begin(BENCH, "authenticate");
+    bench_u64("auth_us", AUTH_US);
+    bench_u64("runs", AUTH_RUNS);
+    bench_u64("challenge_us", challenge_us / AUTH_RUNS);
+    bench_u64("digest_us", digest_us / AUTH_RUNS);
+    bench_u64("response_us", response_us / AUTH_RUNS);
+    bench_f64("polls", (double)polls / AUTH_RUNS);
+    bench_f64("transactions", (double)transactions / AUTH_RUNS);
+    bench_f64("bytes", (double)bytes / AUTH_RUNS);
+    bench_f64("clocks", (double)clocks / AUTH_RUNS);
+    bench_f64("neighbour_reads_per_s", n.reads * 1e9 / elapsed);
+    bench_end();
+
+    CHECK_EQ(failures, 0);
+    CHECK(digest_us / AUTH_RUNS >= AUTH_US);
+    // the bus is left to the other pack while the gauge computes
+    CHECK(n.reads > AUTH_RUNS);
+
+    // a pack holding another key fails the compare, at the same cost
+    static const uint8_t OTHER_KEY[BQ40Z80_AUTH_KEY_LEN] = {1};
+    sim->set_auth_key(0, 0, OTHER_KEY);
+    pool.take(&entry);
+    CHECK_EQ(bq.try_authenticate(&entry), ESP_ERR_INVALID_RESPONSE);
+    sim->set_auth_key(0, 0, KEY);
+}
+
+int main()
+{
+    BQ40Z80_SIM_TIMING timing;
+    BQ40Z80_SIM_PACK pack;
+
+    BQ40Z80_SIM::default_timing(&timing);
+    timing.auth_us = AUTH_US;
+    timing.realtime = true;
+    BQ40Z80_SIM sim(&timing);
+    BQ40Z80_SIM::default_pack(&pack);
+    sim.add_pack(0, 0, &pack);
+    sim.add_pack(0, 1, &pack);
+
+    bench_digest();
+    bench_pool();
+    bench_phases(&sim);
+
+    return check_result(BENCH);
+}
@@ -0,0 +1,142 @@
+/**
+ * Throughput of the cell history: host time of append() and of analyse() over windows of 1k, 10k and
+ * 100k samples for a 4S and a 7S pack, as cell-samples per second, with the heap allocations of both.
+ * Results are JSON Lines on stdout, the run fails when analyse() allocates or misses samples.
+ */
+#include <stdlib.h>
+
+#include "alloc_count.h"
+#include "bench.h"
+#include "bq40z80_cell_history.h"
+#include "check.h"
+
+#define BENCH "bench_cells"
+#define CAPACITY 100000  /*!< Samples held by the history */
+#define SAMPLES 1024     /*!< Distinct samples generated, appended in a loop */
+#define PERIOD_US 250000 /*!< Time between two samples */
+
+typedef struct
+{
+    BQ40Z80_CELL_HISTORY *history;
+    const BQ40Z80_CELL_SAMPLE *samples;
+    uint32_t i;
+} APPEND_ARG;
+
+typedef struct
+{
+    BQ40Z80_CELL_HISTORY *history;
+    uint32_t window;
+    BQ40Z80_CELL_ANALYSIS analysis;
+} ANALYSE_ARG;
+
+static uint32_t rng = 1;
+
+static uint32_t xorshift32()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static int32_t noise(int32_t amplitude)
+{
+    return (int32_t)(xorshift32() % (2 * amplitude + 1)) - amplitude;
+}
+
+/**
+ * @brief A pack alternating rest and 1.2 A discharge every 64 samples, so the sag and resistance kernels
+ *        have steps to work on, with the highest cell balanced at rest
+ */
+static void make_samples(BQ40Z80_CELL_SAMPLE *samples, uint32_t n)
+{
+    for (uint32_t s = 0; s < n; s++)
+    {
+        BQ40Z80_CELL_SAMPLE *d = &samples[s];
+        bool loaded = (s / 64) % 2;
+        memset(d, 0, sizeof(BQ40Z80_CELL_SAMPLE));
+        d->timestamp_us = (int64_t)s * PERIOD_US;
+        for (uint8_t i = 0; i < BQ40Z80_CELLS; i++)
+        {
+            d->current_ma[i] = loaded ? -1200 + noise(30) : noise(5);
+            d->voltage_mv[i] = 3900 + 4 * i + (loaded ? -60 - 2 * i : 0) + noise(2);
+            d->power_cw[i] = d->voltage_mv[i] * d->current_ma[i] / 10000;
+        }
+        d->balancing = loaded ? 0 : 1 << (BQ40Z80_CELLS - 1);
+    }
+}
+
+static void append_one(APPEND_ARG *arg)
+{
+    arg->history->append(&arg->samples[arg->i++ % SAMPLES]);
+}
+
+static void analyse_one(ANALYSE_ARG *arg)
+{
+    arg->history->analyse(arg->window, &arg->analysis);
+    __asm__ volatile("" : : "r"(&arg->analysis) : "memory");
+}
+
+static void bench_pack(uint8_t cells, void *arena, const BQ40Z80_CELL_SAMPLE *samples)
+{
+    static const uint32_t WINDOWS[] = {1000, 10000, 100000};
+    char name[32];
+    BQ40Z80_CELL_HISTORY history(arena, BQ40Z80_CELL_HISTORY::arena_size(CAPACITY, cells), cells);
+    APPEND_ARG append = {&history, samples, 0};
+    ANALYSE_ARG analyse;
+
+    CHECK_EQ(history.get_capacity(), CAPACITY);
+
+    alloc_count_reset();
+    double append_ns = bench_time_ns(append_one, &append);
+    uint64_t allocs = alloc_count();
+
+    snprintf(name, sizeof(name), "append_%us", (unsigned)cells);
+    bench_begin(BENCH, name);
+    bench_u64("cells", cells);
+    bench_f64("append_ns", append_ns);
+    bench_f64("cell_samples_per_s", cells * 1e9 / append_ns);
+    bench_u64("allocs", allocs);
+    bench_end();
+    CHECK_EQ(allocs, 0);
+
+    // the timed appends wrapped the ring many times, every window below is full
+    CHECK_EQ(history.count(), CAPACITY);
+    analyse.history = &history;
+    for (size_t i = 0; i < sizeof(WINDOWS) / sizeof(WINDOWS[0]); i++)
+    {
+        analyse.window = WINDOWS[i];
+        alloc_count_reset();
+        double analyse_ns = bench_time_ns(analyse_one, &analyse);
+        allocs = alloc_count();
+
+        snprintf(name, sizeof(name), "analyse_%us_%u", (unsigned)cells, (unsigned)WINDOWS[i]);
+        bench_begin(BENCH, name);
+        bench_u64("cells", cells);
+        bench_u64("window", WINDOWS[i]);
+        bench_f64("analyse_us", analyse_ns / 1000);
+        bench_f64("cell_samples_per_s", (double)WINDOWS[i] * cells * 1e9 / analyse_ns);
+        bench_u64("elapsed_us", analyse.analysis.elapsed_us);
+        bench_u64("allocs", allocs);
+        bench_end();
+
+        CHECK_EQ(analyse.analysis.samples, WINDOWS[i]);
+        CHECK_EQ(analyse.analysis.cells, cells);
+        CHECK(analyse.analysis.cell[0].loaded > 0 && analyse.analysis.cell[0].resting > 0);
+        CHECK_EQ(allocs, 0);
+    }
+}
+
+int main()
+{
+    static BQ40Z80_CELL_SAMPLE samples[SAMPLES];
+    // the history of the widest pack, allocated once before any count starts
+    void *arena = malloc(BQ40Z80_CELL_HISTORY::arena_size(CAPACITY, BQ40Z80_CELLS));
+
+    make_samples(samples, SAMPLES);
+    bench_pack(4, arena, samples);
+    bench_pack(BQ40Z80_CELLS, arena, samples);
+
+    free(arena);
+    return check_result(BENCH);
+}
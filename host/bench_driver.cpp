@@ -0,0 +1,138 @@
+/**
+ * Cost of the public calls against a replayed 4S pack: transactions, bytes, wire time at 50, 100 and
+ * 400 kHz, heap allocations and host time per call, and the decode throughput of the DAStatus blocks.
+ * Results are JSON Lines on stdout, the run fails when a call errors, allocates or its byte count
+ * disagrees with the adapter.
+ */
+#include "alloc_count.h"
+#include "bench.h"
+#include "check.h"
+#include "fake_i2cdev.h"
+#include "public_calls.h"
+
+#define BENCH "bench_driver"
+
+typedef struct
+{
+    BQ40Z80 *bq;
+    const PUBLIC_CALL *call;
+} CALL_ARG;
+
+typedef struct
+{
+    uint8_t buf[BQ40Z80_SMBUS_BLOCK_MAX];
+    DA_STATUS_1 da_status_1;
+    DA_STATUS_3 da_status_3;
+} DECODE_ARG;
+
+static void run_fresh(CALL_ARG *arg)
+{
+    BQ40Z80_CALL call = bq40z80_call_within(CALL_TIMEOUT_US, 0);
+    call.fresh = true;
+    arg->call->run(arg->bq, &call);
+}
+
+static void run_cached(CALL_ARG *arg)
+{
+    arg->call->run(arg->bq, NULL);
+}
+
+static void decode_da_status_1(DECODE_ARG *arg)
+{
+    bq40z80_decode<BQ40Z80_REG_DAStatus1>(&arg->da_status_1, arg->buf);
+    __asm__ volatile("" : : "r"(&arg->da_status_1) : "memory");
+}
+
+static void decode_da_status_3(DECODE_ARG *arg)
+{
+    bq40z80_decode<BQ40Z80_REG_DAStatus3>(&arg->da_status_3, arg->buf);
+    __asm__ volatile("" : : "r"(&arg->da_status_3) : "memory");
+}
+
+/**
+ * @brief Wire cost and host time of each public call, with a cold cache
+ */
+static void bench_calls(FAKE_I2CDEV *adapter, BQ40Z80 *bq)
+{
+    FAKE_I2CDEV_COUNTERS counters;
+
+    for (size_t i = 0; i < sizeof(CALLS) / sizeof(CALLS[0]); i++)
+    {
+        CALL_ARG arg = {bq, &CALLS[i]};
+
+        // the first call of each kind may set up logging or stdio, only the steady state counts
+        run_fresh(&arg);
+
+        BQ40Z80_CALL call = bq40z80_call_within(CALL_TIMEOUT_US, 0);
+        bq->invalidate_cache();
+        adapter->reset_counters();
+        alloc_count_reset();
+        esp_err_t err = CALLS[i].run(bq, &call);
+        uint64_t allocs = alloc_count();
+        adapter->get_counters(&counters);
+
+        double fresh_ns = bench_time_ns(run_fresh, &arg);
+        double cached_ns = bench_time_ns(run_cached, &arg);
+
+        bench_begin(BENCH, CALLS[i].name);
+        bench_str("err", esp_err_to_name(err));
+        bench_call(&call);
+        bench_u64("adapter_bytes", counters.bytes);
+        bench_u64("allocs", allocs);
+        bench_f64("host_ns", fresh_ns);
+        bench_f64("cached_ns", cached_ns);
+        bench_end();
+
+        CHECK_EQ(err, ESP_OK);
+        CHECK_EQ(allocs, 0);
+        CHECK_EQ(call.bytes, counters.bytes);
+    }
+}
+
+/**
+ * @brief Decode of the DAStatus blocks alone, out of the receive buffer
+ */
+static void bench_decode()
+{
+    static const struct
+    {
+        const char *name;
+        void (*op)(DECODE_ARG *arg);
+        uint8_t len;
+    } DECODES[] = {
+        {"decode_da_status_1", decode_da_status_1, BQ40Z80_REG_DAStatus1::len},
+        {"decode_da_status_3", decode_da_status_3, BQ40Z80_REG_DAStatus3::len},
+    };
+    DECODE_ARG arg;
+
+    for (size_t i = 0; i < sizeof(arg.buf); i++)
+        arg.buf[i] = (uint8_t)(i * 37);
+    for (size_t i = 0; i < sizeof(DECODES) / sizeof(DECODES[0]); i++)
+    {
+        alloc_count_reset();
+        double ns = bench_time_ns(DECODES[i].op, &arg);
+        uint64_t allocs = alloc_count();
+
+        bench_begin(BENCH, DECODES[i].name);
+        bench_u64("len", DECODES[i].len);
+        bench_f64("ns", ns);
+        bench_f64("decodes_per_s", 1e9 / ns);
+        bench_f64("mb_per_s", DECODES[i].len * 1e3 / ns);
+        bench_u64("allocs", allocs);
+        bench_end();
+
+        CHECK_EQ(allocs, 0);
+    }
+}
+
+int main()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+
+    bench_calls(&adapter, &bq);
+    bench_decode();
+
+    return check_result(BENCH);
+}
@@ -0,0 +1,134 @@
+/**
+ * Cost of SMBus PEC: bytes, wire time and host time of each public call with PEC off then on, the price
+ * of a frame caught by its PEC and read again, and the CRC-8 throughput of bq40z80_pec() alone.
+ * Results are JSON Lines on stdout.
+ */
+#include "bench.h"
+#include "check.h"
+#include "fake_i2cdev.h"
+#include "public_calls.h"
+
+#define BENCH "bench_pec"
+
+typedef struct
+{
+    BQ40Z80 *bq;
+    const PUBLIC_CALL *call;
+} CALL_ARG;
+
+typedef struct
+{
+    uint8_t buf[1 + BQ40Z80_MFA_ECHO_LEN + BQ40Z80_SMBUS_BLOCK_MAX];
+    uint8_t crc;
+} CRC_ARG;
+
+static void run_fresh(CALL_ARG *arg)
+{
+    BQ40Z80_CALL call = bq40z80_call_within(CALL_TIMEOUT_US, 0);
+    call.fresh = true;
+    arg->call->run(arg->bq, &call);
+}
+
+static void crc_block(CRC_ARG *arg)
+{
+    arg->crc = bq40z80_pec(arg->crc, arg->buf, sizeof(arg->buf));
+    __asm__ volatile("" : : "r"(&arg->crc) : "memory");
+}
+
+/**
+ * @brief Every public call with PEC off then on, the overhead is the difference of the two lines
+ */
+static void bench_calls(BQ40Z80 *bq)
+{
+    for (size_t i = 0; i < sizeof(CALLS) / sizeof(CALLS[0]); i++)
+    {
+        CALL_ARG arg = {bq, &CALLS[i]};
+        uint32_t bytes[2];
+
+        for (uint8_t pec = 0; pec < 2; pec++)
+        {
+            bq->set_pec(pec);
+            run_fresh(&arg);
+
+            BQ40Z80_CALL call = bq40z80_call_within(CALL_TIMEOUT_US, 0);
+            bq->invalidate_cache();
+            esp_err_t err = CALLS[i].run(bq, &call);
+            double ns = bench_time_ns(run_fresh, &arg);
+            bytes[pec] = call.bytes;
+
+            bench_begin(BENCH, CALLS[i].name);
+            bench_str("pec", pec ? "on" : "off");
+            bench_str("err", esp_err_to_name(err));
+            bench_call(&call);
+            bench_f64("host_ns", ns);
+            if (pec)
+                bench_f64("byte_overhead_pct", bytes[0] ? (bytes[1] - bytes[0]) * 100.0 / bytes[0] : 0);
+            bench_end();
+
+            CHECK_EQ(err, ESP_OK);
+            // one PEC byte per transaction
+            if (pec)
+                CHECK_EQ(bytes[1] - bytes[0], call.transactions);
+        }
+    }
+    bq->set_pec(false);
+}
+
+/**
+ * @brief A read whose PEC fails once: the frame is read again within the same call
+ */
+static void bench_corrupt(FAKE_GAUGE *gauge, BQ40Z80 *bq)
+{
+    for (size_t i = 0; i < sizeof(CALLS) / sizeof(CALLS[0]); i++)
+    {
+        BQ40Z80_CALL clean = bq40z80_call_within(CALL_TIMEOUT_US, 0);
+        BQ40Z80_CALL call = bq40z80_call_within(CALL_TIMEOUT_US, 0);
+        bq->set_pec(true);
+        bq->invalidate_cache();
+        CALLS[i].run(bq, &clean);
+        bq->invalidate_cache();
+        gauge->corrupt_reads(1);
+        esp_err_t err = CALLS[i].run(bq, &call);
+        gauge->corrupt_reads(0);
+
+        bench_begin(BENCH, CALLS[i].name);
+        bench_str("pec", "corrupt_once");
+        bench_str("err", esp_err_to_name(err));
+        bench_call(&call);
+        bench_end();
+
+        CHECK_EQ(err, ESP_OK);
+        CHECK_EQ(call.attempts, clean.attempts + 1);
+    }
+    bq->set_pec(false);
+}
+
+static void bench_crc()
+{
+    CRC_ARG arg;
+
+    for (size_t i = 0; i < sizeof(arg.buf); i++)
+        arg.buf[i] = (uint8_t)(i * 37);
+    arg.crc = 0;
+    double ns = bench_time_ns(crc_block, &arg);
+
+    bench_begin(BENCH, "bq40z80_pec");
+    bench_u64("len", sizeof(arg.buf));
+    bench_f64("ns", ns);
+    bench_f64("ns_per_byte", ns / sizeof(arg.buf));
+    bench_f64("mb_per_s", sizeof(arg.buf) * 1e3 / ns);
+    bench_end();
+}
+
+int main()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+
+    bench_calls(&bq);
+    bench_corrupt(&gauge, &bq);
+    bench_crc();
+
+    return check_result(BENCH);
+}
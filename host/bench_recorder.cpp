@@ -0,0 +1,188 @@
+/**
+ * Cost of the telemetry recorder: compression ratio and bytes per sample of a pack at rest, a pack
+ * discharging and random values as the worst case, for every field and for a voltage/current subset,
+ * then the host time of append() and of decoding with next(). Results are JSON Lines on stdout.
+ */
+#include "alloc_count.h"
+#include "bench.h"
+#include "bq40z80_recorder.h"
+#include "check.h"
+
+#define BENCH "bench_recorder"
+#define ARENA_SIZE (64 * 1024) /*!< Arena of each run */
+#define SAMPLES 1024           /*!< Samples generated per profile, appended in a loop */
+#define PERIOD_US 1000000      /*!< Time between two samples */
+
+typedef struct
+{
+    const char *name;
+    void (*make)(BQ40Z80_TELEMETRY *samples, uint32_t n);
+} PROFILE;
+
+typedef struct
+{
+    BQ40Z80_RECORDER *recorder;
+    const BQ40Z80_TELEMETRY *samples;
+    uint32_t i;
+    int64_t timestamp_us;
+} APPEND_ARG;
+
+typedef struct
+{
+    BQ40Z80_RECORDER *recorder;
+    BQ40Z80_RECORDER_CURSOR cursor;
+    BQ40Z80_TELEMETRY data;
+} DECODE_ARG;
+
+static uint32_t rng = 1;
+
+static uint32_t xorshift32()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+static int32_t noise(int32_t amplitude)
+{
+    return (int32_t)(xorshift32() % (2 * amplitude + 1)) - amplitude;
+}
+
+/**
+ * @brief The 4S pack of the fake gauge, idle: cells and temperatures jitter by a count
+ */
+static void make_rest(BQ40Z80_TELEMETRY *samples, uint32_t n)
+{
+    for (uint32_t s = 0; s < n; s++)
+    {
+        BQ40Z80_TELEMETRY *d = &samples[s];
+        memset(d, 0, sizeof(BQ40Z80_TELEMETRY));
+        d->valid = BQ40Z80_FIELD_MASK_ALL;
+        d->temperature = 2982 + noise(1);
+        d->rsoc = 78;
+        d->remaining_capacity = 2340;
+        d->full_charge_capacity = 3000;
+        d->battery_status = 0x00c0;
+        for (uint8_t i = 0; i < 4; i++)
+            d->cell_voltage[i] = 3900 + noise(1);
+        d->voltage = d->cell_voltage[0] + d->cell_voltage[1] + d->cell_voltage[2] + d->cell_voltage[3];
+        d->bat_voltage = d->voltage;
+        d->pack_voltage = d->voltage;
+        d->int_temperature = 2990 + noise(1);
+        for (uint8_t i = 0; i < 4; i++)
+            d->ts_temperature[i] = 2982 + noise(1);
+        d->cell_temperature = 2982;
+        d->fet_temperature = 3002;
+        d->operation_status.raw = 0x0a000107;
+    }
+}
+
+/**
+ * @brief Same pack discharging at 1.2 A: cells sag, charge and RSOC fall, current noise of 30 mA
+ */
+static void make_discharge(BQ40Z80_TELEMETRY *samples, uint32_t n)
+{
+    make_rest(samples, n);
+    for (uint32_t s = 0; s < n; s++)
+    {
+        BQ40Z80_TELEMETRY *d = &samples[s];
+        d->current = -1200 + noise(30);
+        d->average_current = -1200 + noise(3);
+        d->remaining_capacity = 2340 - s / 3;
+        d->rsoc = d->remaining_capacity * 100 / 3000;
+        for (uint8_t i = 0; i < 4; i++)
+            d->cell_voltage[i] = 3900 - s / 4 + noise(2);
+        d->voltage = d->cell_voltage[0] + d->cell_voltage[1] + d->cell_voltage[2] + d->cell_voltage[3];
+        d->bat_voltage = d->voltage + noise(2);
+        d->pack_voltage = d->voltage + noise(2);
+        d->temperature = 2982 + s / 60;
+        d->operation_status.raw = 0x0a000106;
+    }
+}
+
+/**
+ * @brief Worst case, every field random over its width
+ */
+static void make_random(BQ40Z80_TELEMETRY *samples, uint32_t n)
+{
+    for (uint32_t s = 0; s < n; s++)
+    {
+        memset(&samples[s], 0, sizeof(BQ40Z80_TELEMETRY));
+        samples[s].valid = BQ40Z80_FIELD_MASK_ALL;
+        for (uint8_t i = 0; i < BQ40Z80_FIELD_COUNT; i++)
+            bq40z80_set_field(&samples[s], i, xorshift32());
+    }
+}
+
+static void append_one(APPEND_ARG *arg)
+{
+    arg->recorder->append(arg->timestamp_us, &arg->samples[arg->i++ % SAMPLES]);
+    arg->timestamp_us += PERIOD_US;
+}
+
+static void decode_one(DECODE_ARG *arg)
+{
+    int64_t timestamp_us;
+
+    if (!arg->recorder->next(&arg->cursor, &timestamp_us, &arg->data))
+        arg->recorder->rewind(&arg->cursor);
+}
+
+static void bench_profile(const PROFILE *profile, const char *set, bq40z80_field_mask_t fields, const BQ40Z80_TELEMETRY *samples)
+{
+    static uint8_t arena[ARENA_SIZE];
+    char name[48];
+    BQ40Z80_RECORDER_STATS stats;
+    BQ40Z80_RECORDER recorder(arena, sizeof(arena), fields);
+    APPEND_ARG append = {&recorder, samples, 0, 0};
+    DECODE_ARG decode;
+
+    // fill the arena once, the ratio is that of the samples it holds
+    for (uint32_t i = 0; i < SAMPLES; i++)
+        append_one(&append);
+    recorder.get_stats(&stats);
+
+    alloc_count_reset();
+    double append_ns = bench_time_ns(append_one, &append);
+    decode.recorder = &recorder;
+    recorder.rewind(&decode.cursor);
+    double decode_ns = bench_time_ns(decode_one, &decode);
+    uint64_t allocs = alloc_count();
+
+    snprintf(name, sizeof(name), "%s_%s", profile->name, set);
+    bench_begin(BENCH, name);
+    bench_u64("samples", stats.samples);
+    bench_u64("encoded_bytes", stats.encoded_bytes);
+    bench_u64("raw_bytes", stats.raw_bytes);
+    bench_f64("ratio", stats.encoded_bytes ? (double)stats.raw_bytes / stats.encoded_bytes : 0);
+    bench_f64("bytes_per_sample", stats.samples ? (double)stats.encoded_bytes / stats.samples : 0);
+    bench_f64("append_ns", append_ns);
+    bench_f64("decode_ns", decode_ns);
+    bench_u64("allocs", allocs);
+    bench_end();
+
+    CHECK(stats.samples > 0);
+    CHECK_EQ(allocs, 0);
+}
+
+int main()
+{
+    static const PROFILE PROFILES[] = {
+        {"rest", make_rest},
+        {"discharge", make_discharge},
+        {"random", make_random},
+    };
+    static BQ40Z80_TELEMETRY samples[SAMPLES];
+    bq40z80_field_mask_t vi = BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_VOLTAGE) | BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_CURRENT) |
+                              BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_TEMPERATURE) | BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_RSOC);
+
+    for (size_t i = 0; i < sizeof(PROFILES) / sizeof(PROFILES[0]); i++)
+    {
+        PROFILES[i].make(samples, SAMPLES);
+        bench_profile(&PROFILES[i], "all", BQ40Z80_FIELD_MASK_ALL, samples);
+        bench_profile(&PROFILES[i], "vi", vi, samples);
+    }
+
+    return check_result(BENCH);
+}
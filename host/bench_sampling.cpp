@@ -0,0 +1,63 @@
+/**
+ * Current sampling rate: back to back and on a 1 ms and 500 us grid, from CurrentLong() and from
+ * Current(), with the achieved rate, the host overhead per read, the spacing jitter and the wire cost of
+ * the run. Results are JSON Lines on stdout, the run fails when a sample is lost or the run allocates.
+ */
+#include "alloc_count.h"
+#include "bench.h"
+#include "check.h"
+#include "fake_i2cdev.h"
+
+#define BENCH "bench_sampling"
+#define SAMPLES 1024              /*!< Samples of one run */
+#define RUN_TIMEOUT_US 10000000   /*!< Budget of one run */
+
+static void bench_run(BQ40Z80 *bq, const char *source, uint32_t interval_us)
+{
+    static BQ40Z80_CURRENT_SAMPLE samples[SAMPLES];
+    BQ40Z80_SAMPLING_OPTIONS options = {interval_us, 0};
+    BQ40Z80_SAMPLING_REPORT report;
+    BQ40Z80_CALL call = bq40z80_call_within(RUN_TIMEOUT_US, 0);
+    char name[32];
+
+    alloc_count_reset();
+    esp_err_t err = bq->try_sample_current(samples, SAMPLES, &options, &report, &call);
+    uint64_t allocs = alloc_count();
+
+    snprintf(name, sizeof(name), "%s_%u", source, (unsigned)interval_us);
+    bench_begin(BENCH, name);
+    bench_str("err", esp_err_to_name(err));
+    bench_u64("interval_us", interval_us);
+    bench_u64("samples", report.samples);
+    bench_u64("rate_hz", report.rate_hz);
+    bench_u64("overhead_ns", report.overhead_ns);
+    bench_u64("jitter_us", report.jitter_us);
+    bench_u64("interval_min_us", report.interval_min_us);
+    bench_u64("interval_max_us", report.interval_max_us);
+    bench_call(&call);
+    bench_u64("allocs", allocs);
+    bench_end();
+
+    CHECK_EQ(err, ESP_OK);
+    CHECK_EQ(report.samples, SAMPLES);
+    CHECK_EQ(report.errors, 0);
+    CHECK_EQ(allocs, 0);
+}
+
+int main()
+{
+    static const uint32_t INTERVALS_US[] = {0, 1000, 500};
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+
+    for (size_t i = 0; i < sizeof(INTERVALS_US) / sizeof(INTERVALS_US[0]); i++)
+        bench_run(&bq, "current_long", INTERVALS_US[i]);
+
+    // firmware without CurrentLong(), the probe NACKs once per run
+    gauge.drop(BQ40Z80_SBS_CurrentLong);
+    for (size_t i = 0; i < sizeof(INTERVALS_US) / sizeof(INTERVALS_US[0]); i++)
+        bench_run(&bq, "current", INTERVALS_US[i]);
+
+    return check_result(BENCH);
+}
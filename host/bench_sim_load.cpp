@@ -0,0 +1,148 @@
+/**
+ * Load on the pack simulator in real time: throughput and latency of the driver as buses and the threads
+ * sharing each bus are added. Every bus carries LOAD_PACKS_PER_BUS packs behind its mux.
+ * Throughput should grow with the buses, each bus is an adapter of its own, and stay flat with the threads
+ * per bus, which only queue on the bus lock and stretch the latency.
+ */
+#include "bench.h"
+#include "bq40z80_sim.h"
+#include "check.h"
+
+#include <pthread.h>
+
+#define LOAD_BUSES_MAX 8         /*!< Adapters with packs plugged in */
+#define LOAD_PACKS_PER_BUS 8     /*!< One pack per mux channel */
+#define LOAD_THREADS_MAX 4       /*!< Threads per bus, each one owns a share of the packs */
+#define LOAD_RUN_NS 200000000ULL /*!< Length of each measurement */
+#define LOAD_SAMPLES 4096        /*!< Latencies kept per thread */
+#define LOAD_TIMEOUT_US 1000000  /*!< Deadline of each call, queueing on the bus lock included */
+
+typedef struct
+{
+    BQ40Z80 *gauges[LOAD_PACKS_PER_BUS];
+    uint8_t n_gauges;
+    uint64_t end_ns;
+    uint32_t calls;
+    uint32_t errors;
+    uint32_t n_samples;
+    uint32_t samples_us[LOAD_SAMPLES];
+} LOAD_WORKER;
+
+static void *load_worker(void *arg)
+{
+    LOAD_WORKER *w = (LOAD_WORKER *)arg;
+    uint16_t val;
+
+    for (uint8_t i = 0; bench_now_ns() < w->end_ns; i = (i + 1) % w->n_gauges)
+    {
+        BQ40Z80_CALL call = bq40z80_call_within(LOAD_TIMEOUT_US, 1);
+        uint64_t start = bench_now_ns();
+        if (w->gauges[i]->try_get_voltage(&val, &call) != ESP_OK)
+            w->errors++;
+        w->calls++;
+        if (w->n_samples < LOAD_SAMPLES)
+            w->samples_us[w->n_samples++] = (uint32_t)((bench_now_ns() - start) / 1000);
+    }
+    return NULL;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void run_load(BQ40Z80_SIM *sim, uint8_t n_buses, uint8_t threads_per_bus)
+{
+    static LOAD_WORKER workers[LOAD_BUSES_MAX * LOAD_THREADS_MAX];
+    static uint32_t samples_us[LOAD_BUSES_MAX * LOAD_THREADS_MAX * LOAD_SAMPLES];
+    pthread_t threads[LOAD_BUSES_MAX * LOAD_THREADS_MAX];
+    BQ40Z80_BUS *buses[LOAD_BUSES_MAX];
+    BQ40Z80 *gauges[LOAD_BUSES_MAX * LOAD_PACKS_PER_BUS];
+    BQ40Z80_SIM_COUNTERS before, after;
+    uint8_t n_workers = n_buses * threads_per_bus;
+    uint32_t calls = 0, errors = 0, n_samples = 0;
+
+    memset(workers, 0, sizeof(workers));
+    for (uint8_t b = 0; b < n_buses; b++)
+    {
+        buses[b] = new BQ40Z80_BUS((i2c_port_t)b, BQ40Z80_SIM_MUX_ADDRESS);
+        for (uint8_t c = 0; c < LOAD_PACKS_PER_BUS; c++)
+        {
+            BQ40Z80 *bq = new BQ40Z80(buses[b], c);
+            bq->set_cache_ttl(0);
+            gauges[b * LOAD_PACKS_PER_BUS + c] = bq;
+            LOAD_WORKER *w = &workers[b * threads_per_bus + c % threads_per_bus];
+            w->gauges[w->n_gauges++] = bq;
+        }
+    }
+
+    sim->get_counters(&before);
+    uint64_t start = bench_now_ns();
+    for (uint8_t i = 0; i < n_workers; i++)
+    {
+        workers[i].end_ns = start + LOAD_RUN_NS;
+        pthread_create(&threads[i], NULL, load_worker, &workers[i]);
+    }
+    for (uint8_t i = 0; i < n_workers; i++)
+        pthread_join(threads[i], NULL);
+    uint64_t elapsed = bench_now_ns() - start;
+    sim->get_counters(&after);
+
+    for (uint8_t i = 0; i < n_workers; i++)
+    {
+        calls += workers[i].calls;
+        errors += workers[i].errors;
+        memcpy(samples_us + n_samples, workers[i].samples_us, workers[i].n_samples * sizeof(uint32_t));
+        n_samples += workers[i].n_samples;
+    }
+    qsort(samples_us, n_samples, sizeof(uint32_t), compare_u32);
+
+    bench_begin("bench_sim_load", "get_voltage");
+    bench_u64("buses", n_buses);
+    bench_u64("threads_per_bus", threads_per_bus);
+    bench_u64("packs", n_buses * LOAD_PACKS_PER_BUS);
+    bench_u64("calls", calls);
+    bench_u64("errors", errors);
+    bench_f64("calls_per_s", calls * 1e9 / elapsed);
+    bench_u64("p50_us", n_samples ? samples_us[n_samples / 2] : 0);
+    bench_u64("p99_us", n_samples ? samples_us[n_samples * 99 / 100] : 0);
+    bench_u64("max_us", n_samples ? samples_us[n_samples - 1] : 0);
+    bench_f64("sim_wire_us_per_call", calls ? (double)(after.wire_time_us - before.wire_time_us) / calls : 0);
+    bench_end();
+
+    CHECK_EQ(errors, 0);
+    CHECK(calls > 0);
+
+    for (uint8_t i = 0; i < n_buses * LOAD_PACKS_PER_BUS; i++)
+        delete gauges[i];
+    for (uint8_t b = 0; b < n_buses; b++)
+        delete buses[b];
+}
+
+int main()
+{
+    static const uint8_t BUSES[] = {1, 2, 4, 8};
+    static const uint8_t THREADS[] = {1, LOAD_THREADS_MAX};
+    BQ40Z80_SIM_TIMING timing;
+    BQ40Z80_SIM_PACK pack;
+
+    BQ40Z80_SIM::default_timing(&timing);
+    timing.realtime = true;
+    BQ40Z80_SIM sim(&timing);
+    BQ40Z80_SIM::default_pack(&pack);
+    for (uint8_t b = 0; b < LOAD_BUSES_MAX; b++)
+    {
+        for (uint8_t c = 0; c < LOAD_PACKS_PER_BUS; c++)
+        {
+            pack.serial_number = b * LOAD_PACKS_PER_BUS + c + 1;
+            sim.add_pack(b, c, &pack);
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(BUSES); i++)
+        for (size_t j = 0; j < sizeof(THREADS); j++)
+            run_load(&sim, BUSES[i], THREADS[j]);
+
+    return check_result("bench_sim_load");
+}
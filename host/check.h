@@ -0,0 +1,44 @@
+#ifndef __CHECK_H
+#define __CHECK_H
+
+#include <stdio.h>
+
+/**
+ * @brief Minimal assertions of the host tests, a failed check is reported and the test goes on
+ */
+static int check_failures = 0;
+
+#define CHECK(cond)                                                         \
+    do                                                                      \
+    {                                                                       \
+        if (!(cond))                                                        \
+        {                                                                   \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            check_failures++;                                               \
+        }                                                                   \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                                                  \
+    do                                                                                                  \
+    {                                                                                                   \
+        long long a_ = (long long)(a), b_ = (long long)(b);                                             \
+        if (a_ != b_)                                                                                   \
+        {                                                                                               \
+            fprintf(stderr, "%s:%d: check failed: %s == %s (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, a_, b_); \
+            check_failures++;                                                                           \
+        }                                                                                               \
+    } while (0)
+
+/**
+ * @brief Exit code of a test, 0 when every check passed
+ */
+static inline int check_result(const char *name)
+{
+    if (check_failures == 0)
+        fprintf(stderr, "%s: passed\n", name);
+    else
+        fprintf(stderr, "%s: %d check(s) failed\n", name, check_failures);
+    return check_failures != 0;
+}
+
+#endif
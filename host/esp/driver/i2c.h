@@ -0,0 +1,98 @@
+#ifndef __FAKE_DRIVER_I2C_H
+#define __FAKE_DRIVER_I2C_H
+
+#include "esp_err.h"
+#include "esp_types.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+
+typedef int i2c_port_t;
+
+#define I2C_NUM_0 0
+#define I2C_NUM_1 1
+#define I2C_NUM_MAX 2
+
+typedef enum
+{
+    I2C_MODE_SLAVE = 0,
+    I2C_MODE_MASTER,
+} i2c_mode_t;
+
+typedef enum
+{
+    I2C_MASTER_WRITE = 0,
+    I2C_MASTER_READ,
+} i2c_rw_t;
+
+typedef enum
+{
+    I2C_MASTER_ACK = 0,
+    I2C_MASTER_NACK = 1,
+    I2C_MASTER_LAST_NACK = 2,
+} i2c_ack_type_t;
+
+#define I2C_SCLK_SRC_FLAG_FOR_NOMAL 0
+
+typedef struct
+{
+    i2c_mode_t mode;
+    int sda_io_num;
+    int scl_io_num;
+    bool sda_pullup_en;
+    bool scl_pullup_en;
+    union
+    {
+        struct
+        {
+            uint32_t clk_speed;
+        } master;
+        struct
+        {
+            uint8_t addr_10bit_en;
+            uint16_t slave_addr;
+        } slave;
+    };
+    uint32_t clk_flags;
+} i2c_config_t;
+
+typedef void *i2c_cmd_handle_t;
+
+#define I2C_INTERNAL_STRUCT_SIZE 24 /*!< One queued operation, as in the driver */
+#define I2C_LINK_RECOMMENDED_SIZE(TRANSACTIONS) (2 * I2C_INTERNAL_STRUCT_SIZE + I2C_INTERNAL_STRUCT_SIZE * (5 * (TRANSACTIONS)))
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+esp_err_t i2c_param_config(i2c_port_t port, const i2c_config_t *config);
+esp_err_t i2c_driver_install(i2c_port_t port, i2c_mode_t mode, size_t rx_buf_len, size_t tx_buf_len, int flags);
+esp_err_t i2c_driver_delete(i2c_port_t port);
+
+/**
+ * @note The helpers build their command link on the stack, like the driver
+ */
+esp_err_t i2c_master_write_read_device(i2c_port_t port, uint8_t address, const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size, TickType_t ticks);
+esp_err_t i2c_master_write_to_device(i2c_port_t port, uint8_t address, const uint8_t *write_buffer, size_t write_size, TickType_t ticks);
+esp_err_t i2c_master_read_from_device(i2c_port_t port, uint8_t address, uint8_t *read_buffer, size_t read_size, TickType_t ticks);
+
+/**
+ * @note i2c_cmd_link_create() takes its link from the heap, i2c_cmd_link_create_static() from the buffer
+ */
+i2c_cmd_handle_t i2c_cmd_link_create(void);
+i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size);
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd);
+void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd);
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd);
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd);
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ack_en);
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, const uint8_t *data, size_t data_len, bool ack_en);
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd, uint8_t *data, i2c_ack_type_t ack);
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd, uint8_t *data, size_t data_len, i2c_ack_type_t ack);
+esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t ticks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,6 @@
+#ifndef __FAKE_ESP_ATTR_H
+#define __FAKE_ESP_ATTR_H
+
+#define IRAM_ATTR
+
+#endif
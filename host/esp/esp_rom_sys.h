@@ -0,0 +1,17 @@
+#ifndef __FAKE_ESP_ROM_SYS_H
+#define __FAKE_ESP_ROM_SYS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+void esp_rom_delay_us(uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
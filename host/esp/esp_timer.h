@@ -0,0 +1,20 @@
+#ifndef __FAKE_ESP_TIMER_H
+#define __FAKE_ESP_TIMER_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @brief Microseconds on the monotonic clock of the host
+ */
+int64_t esp_timer_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef __FAKE_ESP_TYPES_H
+#define __FAKE_ESP_TYPES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef __FAKE_FREERTOS_H
+#define __FAKE_FREERTOS_H
+
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define configTICK_RATE_HZ 100 /*!< CONFIG_FREERTOS_HZ of the default sdkconfig */
+#define portTICK_PERIOD_MS (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY (TickType_t)0xffffffffUL
+#define pdFALSE 0
+#define pdTRUE 1
+#define pdFAIL pdFALSE
+#define pdPASS pdTRUE
+#define pdMS_TO_TICKS(ms) ((TickType_t)(((TickType_t)(ms) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef __FAKE_FREERTOS_SEMPHR_H
+#define __FAKE_FREERTOS_SEMPHR_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <semaphore.h>
+
+#include "FreeRTOS.h"
+
+/**
+ * @brief Storage of a semaphore, a recursive pthread mutex or a POSIX semaphore
+ */
+typedef struct
+{
+    uint8_t kind;
+    bool dynamic; //!< Came from the heap, freed by vSemaphoreDelete()
+    pthread_mutex_t mutex;
+    sem_t sem;
+} StaticSemaphore_t;
+
+typedef StaticSemaphore_t *SemaphoreHandle_t;
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer);
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutexStatic(StaticSemaphore_t *buffer);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *woken);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
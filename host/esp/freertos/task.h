@@ -0,0 +1,31 @@
+#ifndef __FAKE_FREERTOS_TASK_H
+#define __FAKE_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef struct FAKE_TASK *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @brief Run the task on a host thread, its control block comes from the heap like on FreeRTOS
+ */
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stack_depth, void *arg, UBaseType_t priority, TaskHandle_t *task);
+
+/**
+ * @note Only NULL, the calling task, is supported
+ */
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t period);
+TickType_t xTaskGetTickCount(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
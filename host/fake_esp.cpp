@@ -0,0 +1,701 @@
+#include "fake_esp.h"
+
+#include <errno.h>
+#include <sys/random.h>
+#include <unistd.h>
+
+#define LINK_START 1
+#define LINK_STOP 2
+#define LINK_WRITE 3
+#define LINK_READ 4
+
+#define DEVICE_OPS 8 /*!< Operations of the link an i2c_master_*_device() helper builds on its stack */
+#define DYNAMIC_OPS 64 /*!< Capacity of a link from i2c_cmd_link_create() */
+
+#define SEM_MUTEX 1
+#define SEM_BINARY 2
+
+/**
+ * @brief Queued operation of a command link, written and read bytes stay in the caller's buffers
+ */
+typedef struct
+{
+    uint8_t op;     //!< LINK_*
+    uint8_t byte;   //!< Single byte written, when data is NULL
+    bool ack_en;    //!< A NACK of a written byte fails the transaction
+    uint32_t len;
+    const uint8_t *data;
+    uint8_t *dest;
+} LINK_OP;
+
+typedef struct
+{
+    uint16_t n_ops;
+    uint16_t capacity;
+    bool dynamic;
+    LINK_OP *ops;
+} LINK;
+
+/**
+ * @brief Pin state behind the GPIO driver
+ */
+typedef struct
+{
+    gpio_int_type_t intr_type;
+    gpio_isr_t handler;
+    void *arg;
+    int level;
+} PIN;
+
+struct FAKE_TASK
+{
+    pthread_t thread;
+    TaskFunction_t code;
+    void *arg;
+};
+
+static FAKE_ESP *instance = NULL;
+static bool installed[I2C_NUM_MAX];
+static uint32_t clocks_hz[I2C_NUM_MAX];
+static PIN pins[GPIO_NUM_MAX];
+static bool isr_service = false;
+static uint64_t links_created = 0;
+static thread_local FAKE_TASK *current_task = NULL;
+
+static void pins_reset()
+{
+    for (int i = 0; i < GPIO_NUM_MAX; i++)
+    {
+        pins[i].intr_type = GPIO_INTR_DISABLE;
+        pins[i].handler = NULL;
+        pins[i].arg = NULL;
+        pins[i].level = 1;
+    }
+    isr_service = false;
+}
+
+FAKE_ESP::FAKE_ESP(FAKE_GAUGE *gauge)
+{
+    this->gauge = gauge;
+    pthread_mutex_init(&this->lock, NULL);
+    this->reset_counters();
+    memset(installed, 0, sizeof(installed));
+    memset(clocks_hz, 0, sizeof(clocks_hz));
+    pins_reset();
+    instance = this;
+}
+
+FAKE_ESP::~FAKE_ESP()
+{
+    instance = NULL;
+    pthread_mutex_destroy(&this->lock);
+}
+
+/***************************** Public Functions *****************************/
+
+void FAKE_ESP::get_counters(FAKE_ESP_COUNTERS *counters)
+{
+    pthread_mutex_lock(&this->lock);
+    *counters = this->counters;
+    counters->links_created = __atomic_load_n(&links_created, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&this->lock);
+}
+
+void FAKE_ESP::reset_counters()
+{
+    memset(&this->counters, 0, sizeof(this->counters));
+    __atomic_store_n(&links_created, 0, __ATOMIC_RELAXED);
+}
+
+uint32_t FAKE_ESP::get_clock(i2c_port_t port)
+{
+    return port >= 0 && port < I2C_NUM_MAX ? clocks_hz[port] : 0;
+}
+
+void FAKE_ESP::set_level(gpio_num_t pin, int level)
+{
+    if (pin < 0 || pin >= GPIO_NUM_MAX)
+        return;
+
+    PIN *p = &pins[pin];
+    int old = p->level;
+    p->level = level ? 1 : 0;
+    if (p->handler == NULL)
+        return;
+
+    bool fire;
+    switch (p->intr_type)
+    {
+    case GPIO_INTR_NEGEDGE:
+        fire = old == 1 && p->level == 0;
+        break;
+    case GPIO_INTR_POSEDGE:
+        fire = old == 0 && p->level == 1;
+        break;
+    case GPIO_INTR_ANYEDGE:
+        fire = old != p->level;
+        break;
+    case GPIO_INTR_LOW_LEVEL:
+        fire = p->level == 0;
+        break;
+    case GPIO_INTR_HIGH_LEVEL:
+        fire = p->level == 1;
+        break;
+    default:
+        fire = false;
+        break;
+    }
+    if (fire)
+        p->handler(p->arg);
+}
+
+esp_err_t FAKE_ESP::transfer(i2c_port_t port, i2c_cmd_handle_t cmd)
+{
+    const LINK *link = (const LINK *)cmd;
+    bool address = false;
+
+    pthread_mutex_lock(&this->lock);
+    this->counters.transactions++;
+    if (port < 0 || port >= I2C_NUM_MAX || !installed[port])
+    {
+        this->counters.failed++;
+        pthread_mutex_unlock(&this->lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    for (uint16_t i = 0; i < link->n_ops; i++)
+    {
+        const LINK_OP *op = &link->ops[i];
+        switch (op->op)
+        {
+        case LINK_START:
+            this->counters.conditions++;
+            address = true;
+            break;
+        case LINK_STOP:
+            this->counters.conditions++;
+            this->gauge->stop();
+            break;
+        case LINK_WRITE:
+            for (uint32_t j = 0; j < op->len; j++)
+            {
+                uint8_t byte = op->data != NULL ? op->data[j] : op->byte;
+                bool ack = address ? this->gauge->start(byte) : this->gauge->write(byte);
+                address = false;
+                this->counters.bytes++;
+                if (!ack && op->ack_en)
+                {
+                    // the driver ends a NACKed transaction with a STOP
+                    this->counters.conditions++;
+                    this->counters.failed++;
+                    this->gauge->stop();
+                    pthread_mutex_unlock(&this->lock);
+                    return ESP_FAIL;
+                }
+            }
+            break;
+        case LINK_READ:
+            for (uint32_t j = 0; j < op->len; j++)
+                op->dest[j] = this->gauge->read();
+            this->counters.bytes += op->len;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&this->lock);
+    return ESP_OK;
+}
+
+/***************************** Command links *****************************/
+
+static esp_err_t link_append(i2c_cmd_handle_t cmd, uint8_t kind, const uint8_t *data, uint8_t *dest, uint32_t len, uint8_t byte, bool ack_en)
+{
+    LINK *link = (LINK *)cmd;
+    if (link == NULL)
+        return ESP_ERR_INVALID_ARG;
+    if (link->n_ops == link->capacity)
+        return ESP_ERR_NO_MEM;
+
+    LINK_OP *op = &link->ops[link->n_ops++];
+    op->op = kind;
+    op->byte = byte;
+    op->ack_en = ack_en;
+    op->len = len;
+    op->data = data;
+    op->dest = dest;
+    return ESP_OK;
+}
+
+/**
+ * @brief Lay a link out in a buffer, aligned for its operations
+ */
+static LINK *link_init(uint8_t *buffer, uint32_t size, bool dynamic)
+{
+    uintptr_t base = ((uintptr_t)buffer + alignof(LINK_OP) - 1) & ~(uintptr_t)(alignof(LINK_OP) - 1);
+    uintptr_t end = (uintptr_t)buffer + size;
+    if (base + sizeof(LINK) + sizeof(LINK_OP) > end)
+        return NULL;
+
+    LINK *link = (LINK *)base;
+    link->n_ops = 0;
+    link->capacity = (end - base - sizeof(LINK)) / sizeof(LINK_OP);
+    link->dynamic = dynamic;
+    link->ops = (LINK_OP *)(base + sizeof(LINK));
+    return link;
+}
+
+static esp_err_t device_transfer(i2c_port_t port, LINK *link)
+{
+    return instance != NULL ? instance->transfer(port, link) : ESP_FAIL;
+}
+
+static int64_t monotonic_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * @brief Absolute CLOCK_REALTIME point a number of ticks from now, for the timed pthread and semaphore waits
+ */
+static struct timespec ticks_from_now(TickType_t ticks)
+{
+    struct timespec ts;
+    uint64_t ms = (uint64_t)ticks * portTICK_PERIOD_MS;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+static void *task_main(void *arg)
+{
+    current_task = (FAKE_TASK *)arg;
+    current_task->code(current_task->arg);
+    // a FreeRTOS task must not return, it deletes itself
+    abort();
+    return NULL;
+}
+
+extern "C"
+{
+    /***************************** esp_err.h *****************************/
+
+    const char *esp_err_to_name(esp_err_t code)
+    {
+        switch (code)
+        {
+        case ESP_OK:
+            return "ESP_OK";
+        case ESP_FAIL:
+            return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:
+            return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:
+            return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:
+            return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:
+            return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:
+            return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:
+            return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:
+            return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE:
+            return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_INVALID_CRC:
+            return "ESP_ERR_INVALID_CRC";
+        default:
+            return "UNKNOWN ERROR";
+        }
+    }
+
+    /***************************** esp_timer.h, esp_rom_sys.h, esp_random.h *****************************/
+
+    int64_t esp_timer_get_time(void)
+    {
+        return monotonic_us();
+    }
+
+    void esp_rom_delay_us(uint32_t us)
+    {
+        int64_t end = monotonic_us() + us;
+        while (monotonic_us() < end)
+            ;
+    }
+
+    void esp_fill_random(void *buf, size_t len)
+    {
+        uint8_t *p = (uint8_t *)buf;
+        while (len > 0)
+        {
+            ssize_t n = getrandom(p, len, 0);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                abort();
+            }
+            p += n;
+            len -= n;
+        }
+    }
+
+    uint32_t esp_random(void)
+    {
+        uint32_t val;
+        esp_fill_random(&val, sizeof(val));
+        return val;
+    }
+
+    /***************************** driver/i2c.h *****************************/
+
+    esp_err_t i2c_param_config(i2c_port_t port, const i2c_config_t *config)
+    {
+        if (port < 0 || port >= I2C_NUM_MAX || config == NULL)
+            return ESP_ERR_INVALID_ARG;
+        if (config->mode == I2C_MODE_MASTER && (config->master.clk_speed == 0 || config->master.clk_speed > 1000000))
+            return ESP_ERR_INVALID_ARG;
+        clocks_hz[port] = config->master.clk_speed;
+        return ESP_OK;
+    }
+
+    esp_err_t i2c_driver_install(i2c_port_t port, i2c_mode_t mode, size_t rx_buf_len, size_t tx_buf_len, int flags)
+    {
+        (void)mode;
+        (void)rx_buf_len;
+        (void)tx_buf_len;
+        (void)flags;
+        if (port < 0 || port >= I2C_NUM_MAX)
+            return ESP_ERR_INVALID_ARG;
+        if (installed[port])
+            return ESP_FAIL;
+        installed[port] = true;
+        return ESP_OK;
+    }
+
+    esp_err_t i2c_driver_delete(i2c_port_t port)
+    {
+        if (port < 0 || port >= I2C_NUM_MAX || !installed[port])
+            return ESP_FAIL;
+        installed[port] = false;
+        return ESP_OK;
+    }
+
+    esp_err_t i2c_master_write_read_device(i2c_port_t port, uint8_t address, const uint8_t *write_buffer, size_t write_size, uint8_t *read_buffer, size_t read_size, TickType_t ticks)
+    {
+        (void)ticks;
+        uint8_t buffer[sizeof(LINK) + DEVICE_OPS * sizeof(LINK_OP) + alignof(LINK_OP)];
+        LINK *link = link_init(buffer, sizeof(buffer), false);
+        link_append(link, LINK_START, NULL, NULL, 0, 0, false);
+        link_append(link, LINK_WRITE, NULL, NULL, 1, address << 1 | I2C_MASTER_WRITE, true);
+        link_append(link, LINK_WRITE, write_buffer, NULL, write_size, 0, true);
+        link_append(link, LINK_START, NULL, NULL, 0, 0, false);
+        link_append(link, LINK_WRITE, NULL, NULL, 1, address << 1 | I2C_MASTER_READ, true);
+        link_append(link, LINK_READ, NULL, read_buffer, read_size, 0, false);
+        link_append(link, LINK_STOP, NULL, NULL, 0, 0, false);
+        return device_transfer(port, link);
+    }
+
+    esp_err_t i2c_master_write_to_device(i2c_port_t port, uint8_t address, const uint8_t *write_buffer, size_t write_size, TickType_t ticks)
+    {
+        (void)ticks;
+        uint8_t buffer[sizeof(LINK) + DEVICE_OPS * sizeof(LINK_OP) + alignof(LINK_OP)];
+        LINK *link = link_init(buffer, sizeof(buffer), false);
+        link_append(link, LINK_START, NULL, NULL, 0, 0, false);
+        link_append(link, LINK_WRITE, NULL, NULL, 1, address << 1 | I2C_MASTER_WRITE, true);
+        link_append(link, LINK_WRITE, write_buffer, NULL, write_size, 0, true);
+        link_append(link, LINK_STOP, NULL, NULL, 0, 0, false);
+        return device_transfer(port, link);
+    }
+
+    esp_err_t i2c_master_read_from_device(i2c_port_t port, uint8_t address, uint8_t *read_buffer, size_t read_size, TickType_t ticks)
+    {
+        (void)ticks;
+        uint8_t buffer[sizeof(LINK) + DEVICE_OPS * sizeof(LINK_OP) + alignof(LINK_OP)];
+        LINK *link = link_init(buffer, sizeof(buffer), false);
+        link_append(link, LINK_START, NULL, NULL, 0, 0, false);
+        link_append(link, LINK_WRITE, NULL, NULL, 1, address << 1 | I2C_MASTER_READ, true);
+        link_append(link, LINK_READ, NULL, read_buffer, read_size, 0, false);
+        link_append(link, LINK_STOP, NULL, NULL, 0, 0, false);
+        return device_transfer(port, link);
+    }
+
+    i2c_cmd_handle_t i2c_cmd_link_create(void)
+    {
+        size_t size = sizeof(LINK) + DYNAMIC_OPS * sizeof(LINK_OP);
+        uint8_t *buffer = (uint8_t *)malloc(size);
+        if (buffer == NULL)
+            return NULL;
+        __atomic_fetch_add(&links_created, 1, __ATOMIC_RELAXED);
+        // malloc() is aligned for any operation, the link starts at the buffer
+        return link_init(buffer, size, true);
+    }
+
+    i2c_cmd_handle_t i2c_cmd_link_create_static(uint8_t *buffer, uint32_t size)
+    {
+        return buffer != NULL ? link_init(buffer, size, false) : NULL;
+    }
+
+    void i2c_cmd_link_delete(i2c_cmd_handle_t cmd)
+    {
+        if (cmd != NULL && ((LINK *)cmd)->dynamic)
+            free(cmd);
+    }
+
+    void i2c_cmd_link_delete_static(i2c_cmd_handle_t cmd)
+    {
+        (void)cmd;
+    }
+
+    esp_err_t i2c_master_start(i2c_cmd_handle_t cmd)
+    {
+        return link_append(cmd, LINK_START, NULL, NULL, 0, 0, false);
+    }
+
+    esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd)
+    {
+        return link_append(cmd, LINK_STOP, NULL, NULL, 0, 0, false);
+    }
+
+    esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ack_en)
+    {
+        return link_append(cmd, LINK_WRITE, NULL, NULL, 1, data, ack_en);
+    }
+
+    esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, const uint8_t *data, size_t data_len, bool ack_en)
+    {
+        return link_append(cmd, LINK_WRITE, data, NULL, data_len, 0, ack_en);
+    }
+
+    esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd, uint8_t *data, i2c_ack_type_t ack)
+    {
+        (void)ack;
+        return link_append(cmd, LINK_READ, NULL, data, 1, 0, false);
+    }
+
+    esp_err_t i2c_master_read(i2c_cmd_handle_t cmd, uint8_t *data, size_t data_len, i2c_ack_type_t ack)
+    {
+        (void)ack;
+        return link_append(cmd, LINK_READ, NULL, data, data_len, 0, false);
+    }
+
+    esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t ticks)
+    {
+        (void)ticks;
+        if (cmd == NULL)
+            return ESP_ERR_INVALID_ARG;
+        return device_transfer(port, (LINK *)cmd);
+    }
+
+    /***************************** driver/gpio.h *****************************/
+
+    esp_err_t gpio_config(const gpio_config_t *config)
+    {
+        if (config == NULL || config->pin_bit_mask == 0 || config->pin_bit_mask >> GPIO_NUM_MAX)
+            return ESP_ERR_INVALID_ARG;
+        for (int i = 0; i < GPIO_NUM_MAX; i++)
+        {
+            if (!(config->pin_bit_mask & (1ULL << i)))
+                continue;
+            pins[i].intr_type = config->intr_type;
+            if (config->pull_up_en == GPIO_PULLUP_ENABLE)
+                pins[i].level = 1;
+            else if (config->pull_down_en == GPIO_PULLDOWN_ENABLE)
+                pins[i].level = 0;
+        }
+        return ESP_OK;
+    }
+
+    esp_err_t gpio_install_isr_service(int flags)
+    {
+        (void)flags;
+        if (isr_service)
+            return ESP_ERR_INVALID_STATE;
+        isr_service = true;
+        return ESP_OK;
+    }
+
+    esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t handler, void *arg)
+    {
+        if (!isr_service)
+            return ESP_ERR_INVALID_STATE;
+        if (pin < 0 || pin >= GPIO_NUM_MAX)
+            return ESP_ERR_INVALID_ARG;
+        pins[pin].handler = handler;
+        pins[pin].arg = arg;
+        return ESP_OK;
+    }
+
+    esp_err_t gpio_isr_handler_remove(gpio_num_t pin)
+    {
+        if (!isr_service)
+            return ESP_ERR_INVALID_STATE;
+        if (pin < 0 || pin >= GPIO_NUM_MAX)
+            return ESP_ERR_INVALID_ARG;
+        pins[pin].handler = NULL;
+        pins[pin].arg = NULL;
+        return ESP_OK;
+    }
+
+    int gpio_get_level(gpio_num_t pin)
+    {
+        return pin >= 0 && pin < GPIO_NUM_MAX ? pins[pin].level : 0;
+    }
+
+    /***************************** freertos/task.h *****************************/
+
+    BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stack_depth, void *arg, UBaseType_t priority, TaskHandle_t *task)
+    {
+        (void)name;
+        (void)stack_depth;
+        (void)priority;
+        FAKE_TASK *t = (FAKE_TASK *)malloc(sizeof(FAKE_TASK));
+        if (t == NULL)
+            return pdFAIL;
+        t->code = code;
+        t->arg = arg;
+        if (pthread_create(&t->thread, NULL, task_main, t) != 0)
+        {
+            free(t);
+            return pdFAIL;
+        }
+        pthread_detach(t->thread);
+        if (task != NULL)
+            *task = t;
+        return pdPASS;
+    }
+
+    void vTaskDelete(TaskHandle_t task)
+    {
+        if (task != NULL && task != current_task)
+            abort();
+        free(current_task);
+        current_task = NULL;
+        pthread_exit(NULL);
+    }
+
+    void vTaskDelay(TickType_t ticks)
+    {
+        usleep((useconds_t)ticks * portTICK_PERIOD_MS * 1000);
+    }
+
+    TickType_t xTaskGetTickCount(void)
+    {
+        return (TickType_t)(monotonic_us() / (portTICK_PERIOD_MS * 1000));
+    }
+
+    void vTaskDelayUntil(TickType_t *previous_wake, TickType_t period)
+    {
+        *previous_wake += period;
+        TickType_t now = xTaskGetTickCount();
+        if ((int32_t)(*previous_wake - now) > 0)
+            vTaskDelay(*previous_wake - now);
+    }
+
+    /***************************** freertos/semphr.h *****************************/
+
+    SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buffer)
+    {
+        buffer->kind = SEM_BINARY;
+        buffer->dynamic = false;
+        sem_init(&buffer->sem, 0, 0);
+        return buffer;
+    }
+
+    SemaphoreHandle_t xSemaphoreCreateBinary(void)
+    {
+        StaticSemaphore_t *buffer = (StaticSemaphore_t *)malloc(sizeof(StaticSemaphore_t));
+        if (buffer == NULL)
+            return NULL;
+        xSemaphoreCreateBinaryStatic(buffer);
+        buffer->dynamic = true;
+        return buffer;
+    }
+
+    SemaphoreHandle_t xSemaphoreCreateRecursiveMutexStatic(StaticSemaphore_t *buffer)
+    {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(&buffer->mutex, &attr);
+        pthread_mutexattr_destroy(&attr);
+        buffer->kind = SEM_MUTEX;
+        buffer->dynamic = false;
+        return buffer;
+    }
+
+    BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+    {
+        if (sem->kind != SEM_BINARY)
+            abort();
+        if (ticks == portMAX_DELAY)
+        {
+            while (sem_wait(&sem->sem) != 0)
+                if (errno != EINTR)
+                    return pdFALSE;
+            return pdTRUE;
+        }
+        struct timespec ts = ticks_from_now(ticks);
+        int ret;
+        while ((ret = sem_timedwait(&sem->sem, &ts)) != 0 && errno == EINTR)
+            ;
+        return ret == 0 ? pdTRUE : pdFALSE;
+    }
+
+    BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+    {
+        int val;
+        if (sem->kind != SEM_BINARY)
+            abort();
+        // binary: a give on a given semaphore fails
+        if (sem_getvalue(&sem->sem, &val) != 0 || val > 0)
+            return pdFALSE;
+        sem_post(&sem->sem);
+        return pdTRUE;
+    }
+
+    BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *woken)
+    {
+        if (woken != NULL)
+            *woken = pdFALSE;
+        return xSemaphoreGive(sem);
+    }
+
+    BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t mutex, TickType_t ticks)
+    {
+        if (mutex->kind != SEM_MUTEX)
+            abort();
+        if (ticks == portMAX_DELAY)
+            return pthread_mutex_lock(&mutex->mutex) == 0 ? pdTRUE : pdFALSE;
+        struct timespec ts = ticks_from_now(ticks);
+        return pthread_mutex_timedlock(&mutex->mutex, &ts) == 0 ? pdTRUE : pdFALSE;
+    }
+
+    BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t mutex)
+    {
+        if (mutex->kind != SEM_MUTEX)
+            abort();
+        return pthread_mutex_unlock(&mutex->mutex) == 0 ? pdTRUE : pdFALSE;
+    }
+
+    void vSemaphoreDelete(SemaphoreHandle_t sem)
+    {
+        if (sem == NULL)
+            return;
+        if (sem->kind == SEM_MUTEX)
+            pthread_mutex_destroy(&sem->mutex);
+        else
+            sem_destroy(&sem->sem);
+        if (sem->dynamic)
+            free(sem);
+    }
+}
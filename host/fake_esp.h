@@ -0,0 +1,71 @@
+#ifndef __FAKE_ESP_H
+#define __FAKE_ESP_H
+
+#include "fake_gauge.h"
+
+/**
+ * @brief Traffic seen by the fake I2C driver
+ */
+typedef struct
+{
+    uint64_t transactions;  //!< i2c_master_cmd_begin() and i2c_master_*_device() calls
+    uint64_t failed;        //!< Transactions that ended on a NACK or on a missing driver
+    uint64_t bytes;         //!< Bytes on the wire, address bytes included
+    uint64_t conditions;    //!< START, repeated START and STOP conditions
+    uint64_t links_created; //!< Command links taken from the heap by i2c_cmd_link_create()
+} FAKE_ESP_COUNTERS;
+
+/**
+ * @brief ESP-IDF I2C master driver, GPIO and FreeRTOS primitives in process, with one FAKE_GAUGE on every port
+ * @note Stands behind the headers of host/esp, which replace the ESP-IDF ones for a host build of the
+ *       library on its ESP-IDF backend (bq40z80_esp.cpp). Command links are walked operation by operation
+ *       against the gauge: a NACKed byte with ack checking fails the transaction with ESP_FAIL after a
+ *       STOP, like the driver. Links and the i2c_master_*_device() helpers live in the caller's buffer or
+ *       on the stack, only i2c_cmd_link_create(), xSemaphoreCreateBinary() and xTaskCreate() allocate, as
+ *       on target. Semaphores are pthread mutexes and POSIX semaphores, tasks are threads and a tick is
+ *       portTICK_PERIOD_MS of the monotonic clock. Only one instance may exist at a time.
+ */
+class FAKE_ESP
+{
+public:
+    /**
+     * @param gauge Gauge on the bus, must outlive the fake
+     */
+    FAKE_ESP(FAKE_GAUGE *gauge);
+
+    /**
+     * @brief Take the gauge off the bus, later transactions are NACKed
+     */
+    ~FAKE_ESP();
+
+    void get_counters(FAKE_ESP_COUNTERS *counters);
+    void reset_counters();
+
+    /**
+     * @brief Clock set by the last i2c_param_config() of a port
+     * @return Clock frequency, unit: Hz, 0 if the port was never configured
+     */
+    uint32_t get_clock(i2c_port_t port);
+
+    /**
+     * @brief Drive an input line
+     * @note An edge matching the interrupt type of the pin runs its handler on the calling thread, the way an
+     *       interrupt preempts the running task
+     * @param pin GPIO number
+     * @param level 0 or 1
+     */
+    void set_level(gpio_num_t pin, int level);
+
+    /**
+     * @brief Run the operations of a command link
+     * @return ESP_OK, ESP_FAIL on a NACK, ESP_ERR_INVALID_STATE if the driver of the port isn't installed
+     */
+    esp_err_t transfer(i2c_port_t port, i2c_cmd_handle_t cmd);
+
+private:
+    FAKE_GAUGE *gauge;
+    FAKE_ESP_COUNTERS counters;
+    pthread_mutex_t lock; //!< One transaction at a time, like the driver
+};
+
+#endif
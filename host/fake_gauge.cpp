@@ -0,0 +1,357 @@
+#include "fake_gauge.h"
+
+#define KIND_NONE 0
+#define KIND_WORD 1
+#define KIND_BLOCK 2
+
+static void put16(uint8_t *buf, uint16_t val)
+{
+    buf[0] = val & 0xff;
+    buf[1] = val >> 8;
+}
+
+static uint8_t put_words(uint8_t *buf, const uint16_t *words, uint8_t n)
+{
+    for (uint8_t i = 0; i < n; i++)
+        put16(buf + 2 * i, words[i]);
+    return 2 * n;
+}
+
+FAKE_GAUGE::FAKE_GAUGE(uint8_t address)
+{
+    // captured from a 4S pack, cells 5 to 7 unused
+    static const uint8_t WORDS[][3] = {
+        {BQ40Z80_SBS_ManufacturerAccess, 0x00, 0x00},   {BQ40Z80_SBS_RemainingCapacityAlarm, 0x2c, 0x01},
+        {BQ40Z80_SBS_RemainingTimeAlarm, 0x0a, 0x00},   {BQ40Z80_SBS_BatteryMode, 0x81, 0x60},
+        {BQ40Z80_SBS_AtRate, 0x00, 0x00},               {BQ40Z80_SBS_AtRateTimeToFull, 0xff, 0xff},
+        {BQ40Z80_SBS_AtRateTimeToEmpty, 0xff, 0xff},    {BQ40Z80_SBS_AtRateOK, 0x01, 0x00},
+        {BQ40Z80_SBS_Temperature, 0xa6, 0x0b},          {BQ40Z80_SBS_Voltage, 0x00, 0x3d},
+        {BQ40Z80_SBS_Current, 0x4d, 0xfb},              {BQ40Z80_SBS_AverageCurrent, 0x5d, 0xfb},
+        {BQ40Z80_SBS_MaxError, 0x01, 0x00},             {BQ40Z80_SBS_RelativeStateOfCharge, 0x4e, 0x00},
+        {BQ40Z80_SBS_AbsoluteStateOfCharge, 0x4a, 0x00}, {BQ40Z80_SBS_RemainingCapacity, 0x24, 0x09},
+        {BQ40Z80_SBS_FullChargeCapacity, 0xb8, 0x0b},   {BQ40Z80_SBS_RunTimeToEmpty, 0x75, 0x00},
+        {BQ40Z80_SBS_AverageTimeToEmpty, 0x76, 0x00},   {BQ40Z80_SBS_AverageTimeToFull, 0xff, 0xff},
+        {BQ40Z80_SBS_ChargingCurrent, 0x00, 0x00},      {BQ40Z80_SBS_ChargingVoltage, 0xa0, 0x41},
+        {BQ40Z80_SBS_BatteryStatus, 0xc0, 0x00},        {BQ40Z80_SBS_CycleCount, 0x25, 0x00},
+        {BQ40Z80_SBS_DesignCapacity, 0xb8, 0x0b},       {BQ40Z80_SBS_DesignVoltage, 0x40, 0x38},
+        {BQ40Z80_SBS_SpecificationInfo, 0x31, 0x00},    {BQ40Z80_SBS_ManufacturerDate, 0x21, 0x5a},
+        {BQ40Z80_SBS_SerialNumber, 0x34, 0x12},         {BQ40Z80_SBS_CellVoltage7, 0x00, 0x00},
+        {BQ40Z80_SBS_CellVoltage6, 0x00, 0x00},         {BQ40Z80_SBS_CellVoltage5, 0x00, 0x00},
+        {BQ40Z80_SBS_CellVoltage4, 0x40, 0x0f},         {BQ40Z80_SBS_BTPDischargeSet, 0x96, 0x00},
+        {BQ40Z80_SBS_BTPChargeSet, 0xaf, 0x00},
+    };
+    static const char *const NAMES[] = {"Texas Inst.", "bq40z80", "LION"};
+    static const uint16_t DA_STATUS_1_WORDS[] = {3895, 3901, 3897, 3904, 15601, 15590, (uint16_t)-1203, (uint16_t)-1203,
+                                                 (uint16_t)-1203, (uint16_t)-1203, (uint16_t)-469, (uint16_t)-469,
+                                                 (uint16_t)-469, (uint16_t)-470, (uint16_t)-1877, (uint16_t)-1852};
+    static const uint16_t DA_STATUS_2_WORDS[] = {3001, 2982, 2984, 2981, 0, 2983, 2990, 2983};
+    static const uint16_t DA_STATUS_3_WORDS[] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+    static const uint8_t FIRMWARE[] = {0x00, 0x48, 0x01, 0x01, 0x1d, 0x00, 0x00, 0x38, 0x04, 0x00, 0x00};
+    uint8_t buf[BQ40Z80_SMBUS_BLOCK_MAX];
+
+    this->address = address;
+    memset(this->kind, KIND_NONE, sizeof(this->kind));
+    memset(this->sbs, 0, sizeof(this->sbs));
+    this->n_mfa = 0;
+    for (size_t i = 0; i < sizeof(this->df); i++)
+        this->df[i] = (uint8_t)(i * 37 + (i >> 8));
+    this->df_sealed = false;
+    this->mac = 0;
+    this->mac_written = false;
+    this->writing = false;
+    this->frame_len = 0;
+    this->response_len = 0;
+    this->response_pos = 0;
+    this->corrupt = 0;
+    this->reset_counters();
+
+    for (size_t i = 0; i < sizeof(WORDS) / sizeof(WORDS[0]); i++)
+        this->set_word(WORDS[i][0], WORDS[i][1] | (WORDS[i][2] << 8));
+    for (uint8_t i = 0; i < 3; i++)
+        this->set_block(BQ40Z80_SBS_ManufacturerName + i, (const uint8_t *)NAMES[i], strlen(NAMES[i]));
+    this->kind[BQ40Z80_SBS_ManufacturerBlockAccess] = KIND_BLOCK;
+    this->kind[BQ40Z80_SBS_ManufacturerData] = KIND_BLOCK;
+
+    put16(buf, 0x4800);
+    this->set_mfa(BQ40Z80_MFA_DEVICE_TYPE, buf, 2);
+    this->set_mfa(BQ40Z80_MFA_FIRMWARE_VERSION, FIRMWARE, sizeof(FIRMWARE));
+    put16(buf, 0x0200);
+    this->set_mfa(BQ40Z80_MFA_HARDWARE_VERSION, buf, 2);
+    put16(buf, 0x9a3c);
+    this->set_mfa(BQ40Z80_MFA_INSTRUCTION_FLASH_SIGNATURE, buf, 2);
+    put16(buf, 0x51f0);
+    this->set_mfa(BQ40Z80_MFA_STATIC_DF_SIGNATURE, buf, 2);
+    put16(buf, 0x1210);
+    this->set_mfa(BQ40Z80_MFA_CHEMICAL_ID, buf, 2);
+    put16(buf, 0x7e21);
+    this->set_mfa(BQ40Z80_MFA_ALL_DF_SIGNATURE, buf, 2);
+
+    // status words, little-endian: XCHG|XDSG clear, DSG set, SLEEP off, XL off. ChargingStatus is 24-bit,
+    // ManufacturingStatus 16-bit
+    static const uint32_t STATUS[][3] = {
+        {BQ40Z80_MFA_SAFETY_ALERT, 0x00000000, 4},  {BQ40Z80_MFA_SAFETY_STATUS, 0x00000000, 4},
+        {BQ40Z80_MFA_PFALERT, 0x00000000, 4},       {BQ40Z80_MFA_PFSTATUS, 0x00000000, 4},
+        {BQ40Z80_MFA_OPERATION_STATUS, 0x0a000107, 4}, {BQ40Z80_MFA_CHARGING_STATUS, 0x00000408, 3},
+        {BQ40Z80_MFA_GAUGING_STATUS, 0x00002050, 4}, {BQ40Z80_MFA_MANUFACTURING_STATUS, 0x00000038, 2},
+    };
+    for (size_t i = 0; i < sizeof(STATUS) / sizeof(STATUS[0]); i++)
+    {
+        put16(buf, STATUS[i][1] & 0xffff);
+        put16(buf + 2, STATUS[i][1] >> 16);
+        this->set_mfa(STATUS[i][0], buf, STATUS[i][2]);
+    }
+
+    this->set_mfa(BQ40Z80_MFA_DA_STATUS_1, buf, put_words(buf, DA_STATUS_1_WORDS, 16));
+    this->set_mfa(BQ40Z80_MFA_DA_STATUS_2, buf, put_words(buf, DA_STATUS_2_WORDS, 8));
+    this->set_mfa(BQ40Z80_MFA_DA_STATUS_3, buf, put_words(buf, DA_STATUS_3_WORDS, 9));
+    put16(buf, 0x0008);
+    this->set_mfa(BQ40Z80_MFA_CB_STATUS, buf, 2);
+    put16(buf, (uint16_t)-1203);
+    put16(buf + 2, 0xffff);
+    this->set_mfa(BQ40Z80_MFA_CURRENT_LONG, buf, 4);
+
+    for (uint8_t block = 1; block <= BQ40Z80_LIFETIME_BLOCKS; block++)
+    {
+        uint8_t len = bq40z80_lifetime_size(block);
+        for (uint8_t i = 0; i < len; i++)
+            buf[i] = (uint8_t)(block * 29 + i * 3);
+        this->set_mfa(BQ40Z80_MFA_LIFETIME_DATA_BLOCK_1 + block - 1, buf, len);
+    }
+}
+
+/***************************** Public Functions *****************************/
+
+void FAKE_GAUGE::set_word(uint8_t command, uint16_t value)
+{
+    this->kind[command] = KIND_WORD;
+    put16(this->sbs[command], value);
+}
+
+uint16_t FAKE_GAUGE::get_word(uint8_t command)
+{
+    return this->sbs[command][0] | (this->sbs[command][1] << 8);
+}
+
+void FAKE_GAUGE::set_block(uint8_t command, const uint8_t *data, uint8_t len)
+{
+    this->kind[command] = KIND_BLOCK;
+    this->sbs[command][0] = len;
+    memcpy(this->sbs[command] + 1, data, len);
+}
+
+void FAKE_GAUGE::set_mfa(uint16_t command, const uint8_t *data, uint8_t len)
+{
+    MFA_ENTRY *entry = this->find_mfa(command);
+    if (entry == NULL)
+    {
+        if (this->n_mfa == FAKE_GAUGE_MFA_ENTRIES)
+            return;
+        entry = &this->mfa[this->n_mfa++];
+        entry->command = command;
+    }
+    entry->len = len;
+    memcpy(entry->data, data, len);
+
+    // SBS blocks from 0x50 are the MAC results of the same number
+    if (command >= BQ40Z80_SBS_SafetyAlert && command <= 0xff)
+        this->kind[command] = KIND_BLOCK;
+}
+
+void FAKE_GAUGE::drop(uint8_t command)
+{
+    this->kind[command] = KIND_NONE;
+}
+
+uint16_t FAKE_GAUGE::get_mac()
+{
+    return this->mac;
+}
+
+void FAKE_GAUGE::corrupt_reads(uint32_t frames)
+{
+    this->corrupt = frames;
+}
+
+void FAKE_GAUGE::seal_df(bool sealed)
+{
+    this->df_sealed = sealed;
+}
+
+void FAKE_GAUGE::get_counters(FAKE_GAUGE_COUNTERS *counters)
+{
+    *counters = this->counters;
+}
+
+void FAKE_GAUGE::reset_counters()
+{
+    memset(&this->counters, 0, sizeof(this->counters));
+}
+
+bool FAKE_GAUGE::start(uint8_t address_byte)
+{
+    this->counters.bytes++;
+    if ((address_byte >> 1) != this->address)
+        return false;
+    this->counters.starts++;
+
+    // a repeated START ends the write frame before it, the MAC command still waits for the STOP
+    this->end_frame();
+    if (!(address_byte & 1))
+    {
+        this->writing = true;
+        this->frame_len = 0;
+        return true;
+    }
+
+    // read: answer the command byte of the write frame before, or nothing
+    uint8_t command = this->frame_len > 0 ? this->frame[0] : 0;
+    uint8_t *r = this->response;
+    this->response_len = 0;
+    this->response_pos = 0;
+    if (this->frame_len == 0)
+        return true;
+
+    if (this->kind[command] == KIND_WORD)
+    {
+        memcpy(r, this->sbs[command], 2);
+        this->response_len = 2;
+    }
+    else if (command == BQ40Z80_SBS_ManufacturerData || command == BQ40Z80_SBS_ManufacturerBlockAccess)
+    {
+        uint8_t n = this->mfa_result(this->mac, r + 1 + BQ40Z80_MFA_ECHO_LEN);
+        put16(r + 1, this->mac);
+        r[0] = BQ40Z80_MFA_ECHO_LEN + n;
+        this->response_len = 1 + r[0];
+    }
+    else if (this->kind[command] == KIND_BLOCK)
+    {
+        MFA_ENTRY *entry = command >= BQ40Z80_SBS_SafetyAlert ? this->find_mfa(command) : NULL;
+        if (entry != NULL)
+        {
+            r[0] = entry->len;
+            memcpy(r + 1, entry->data, entry->len);
+        }
+        else
+        {
+            memcpy(r, this->sbs[command], 1 + this->sbs[command][0]);
+        }
+        this->response_len = 1 + r[0];
+    }
+
+    uint8_t header[3] = {(uint8_t)(this->address << 1), command, address_byte};
+    r[this->response_len] = bq40z80_pec(bq40z80_pec(0, header, 3), r, this->response_len);
+    if (this->corrupt > 0)
+    {
+        r[this->response_len] ^= 0x01;
+        this->corrupt--;
+    }
+    this->response_len++;
+    return true;
+}
+
+bool FAKE_GAUGE::write(uint8_t byte)
+{
+    this->counters.bytes++;
+    if (!this->writing)
+        return false;
+
+    // unknown commands are NACKed on the command byte
+    if (this->frame_len == 0 && this->kind[byte] == KIND_NONE)
+    {
+        this->counters.nacks++;
+        return false;
+    }
+    if (this->frame_len == sizeof(this->frame))
+        return false;
+    this->frame[this->frame_len++] = byte;
+    return true;
+}
+
+uint8_t FAKE_GAUGE::read()
+{
+    this->counters.bytes++;
+    return this->response_pos < this->response_len ? this->response[this->response_pos++] : 0xff;
+}
+
+void FAKE_GAUGE::stop()
+{
+    this->end_frame();
+    this->counters.transactions++;
+    if (!this->mac_written)
+        return;
+
+    // the gauge executes the ManufacturerAccess() command once the transaction is over
+    this->mac_written = false;
+    this->mac = this->mac_pending;
+}
+
+/***************************** Private Functions *****************************/
+
+FAKE_GAUGE::MFA_ENTRY *FAKE_GAUGE::find_mfa(uint16_t command)
+{
+    for (uint8_t i = 0; i < this->n_mfa; i++)
+        if (this->mfa[i].command == command)
+            return &this->mfa[i];
+    return NULL;
+}
+
+uint8_t FAKE_GAUGE::mfa_result(uint16_t command, uint8_t *data)
+{
+    if (command >= BQ40Z80_DF_START && command < BQ40Z80_DF_START + BQ40Z80_DF_SIZE)
+    {
+        uint16_t offset = command - BQ40Z80_DF_START;
+        uint8_t n = BQ40Z80_DF_SIZE - offset < BQ40Z80_DF_BLOCK ? BQ40Z80_DF_SIZE - offset : BQ40Z80_DF_BLOCK;
+        memcpy(data, this->df + offset, n);
+        return n;
+    }
+
+    MFA_ENTRY *entry = this->find_mfa(command);
+    if (entry == NULL)
+        return 0;
+    memcpy(data, entry->data, entry->len);
+    return entry->len;
+}
+
+void FAKE_GAUGE::end_frame()
+{
+    if (!this->writing)
+        return;
+    this->writing = false;
+    if (this->frame_len < 2)
+        return; // command byte of a read, or nothing
+
+    uint8_t command = this->frame[0];
+    uint8_t payload = this->kind[command] == KIND_BLOCK ? 1 + this->frame[1] : 2;
+    if (this->frame_len < 1 + payload)
+        return;
+
+    uint8_t header[2] = {(uint8_t)(this->address << 1), command};
+    if (this->frame_len > 1 + payload && bq40z80_pec(bq40z80_pec(0, header, 2), this->frame + 1, payload) != this->frame[1 + payload])
+    {
+        this->counters.pec_errors++;
+        return;
+    }
+
+    if (command == BQ40Z80_SBS_ManufacturerAccess)
+    {
+        this->mac_pending = this->frame[1] | (this->frame[2] << 8);
+        this->mac_written = true;
+    }
+    else if (command == BQ40Z80_SBS_ManufacturerBlockAccess && payload >= 3)
+    {
+        uint16_t mac = this->frame[2] | (this->frame[3] << 8);
+        uint8_t n = payload - 3;
+        if (n > 0 && !this->df_sealed && mac >= BQ40Z80_DF_START && mac + n <= BQ40Z80_DF_START + BQ40Z80_DF_SIZE)
+            memcpy(this->df + mac - BQ40Z80_DF_START, this->frame + 4, n);
+        this->mac_pending = mac;
+        this->mac_written = true;
+    }
+    else if (this->kind[command] == KIND_WORD)
+    {
+        memcpy(this->sbs[command], this->frame + 1, 2);
+    }
+    else if (command < BQ40Z80_SBS_SafetyAlert)
+    {
+        memcpy(this->sbs[command], this->frame + 1, payload);
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef __FAKE_GAUGE_H
+#define __FAKE_GAUGE_H
+
+#include "bq40z80.h"
+
+#define FAKE_GAUGE_MFA_ENTRIES 48 /*!< ManufacturerAccess() results the gauge can replay */
+
+/**
+ * @brief Traffic seen by the fake gauge
+ */
+typedef struct
+{
+    uint64_t transactions; //!< STOP conditions
+    uint64_t starts;       //!< START and repeated START conditions addressed to the gauge
+    uint64_t bytes;        //!< Bytes on the wire, address bytes included
+    uint64_t nacks;        //!< Address or command bytes NACKed
+    uint64_t pec_errors;   //!< Writes dropped for a wrong PEC
+} FAKE_GAUGE_COUNTERS;
+
+/**
+ * @brief bq40z80 replaying captured register contents, driven one bus condition at a time
+ * @note Backs the fake i2c-dev on Linux and the fake command links of the ESP-IDF build. Reads of SBS words
+ *       and blocks come from a register image, SBS blocks from 0x50 share their contents with the MAC
+ *       command of the same number, ManufacturerData() answers the latched MAC command with its echo, data
+ *       flash included. Every read is followed by its PEC, the master takes it or not, a write carrying
+ *       a PEC is dropped when it doesn't match. A command written to ManufacturerBlockAccess() or
+ *       ManufacturerAccess() is only executed by the STOP that ends the transaction, like on the gauge:
+ *       until then ManufacturerData() keeps answering the previous command. Not thread-safe, the
+ *       transport holds its own lock.
+ */
+class FAKE_GAUGE
+{
+public:
+    /**
+     * @brief Load the image of a 4S 3000 mAh pack at 78 %, discharging at 1.2 A
+     * @param address 7-bit address of the gauge
+     */
+    FAKE_GAUGE(uint8_t address = 0x0b);
+
+    /**
+     * @brief Replace an SBS word
+     */
+    void set_word(uint8_t command, uint16_t value);
+
+    /**
+     * @brief Read back an SBS word, e.g. one the driver wrote
+     */
+    uint16_t get_word(uint8_t command);
+
+    /**
+     * @brief Replace an SBS block such as ManufacturerName()
+     */
+    void set_block(uint8_t command, const uint8_t *data, uint8_t len);
+
+    /**
+     * @brief Replace the result of a ManufacturerAccess() command, without the echo
+     */
+    void set_mfa(uint16_t command, const uint8_t *data, uint8_t len);
+
+    /**
+     * @brief NACK an SBS command from now on, e.g. CurrentLong() on firmware that lacks it
+     */
+    void drop(uint8_t command);
+
+    /**
+     * @brief Last ManufacturerAccess() command executed
+     */
+    uint16_t get_mac();
+
+    /**
+     * @brief Flip a bit of the PEC sent after each of the next 'frames' reads, a master checking it sees a
+     *        corrupt frame, one ignoring it doesn't notice
+     */
+    void corrupt_reads(uint32_t frames);
+
+    /**
+     * @brief Drop data flash writes while keeping their ACKs, like a sealed gauge
+     */
+    void seal_df(bool sealed);
+
+    void get_counters(FAKE_GAUGE_COUNTERS *counters);
+    void reset_counters();
+
+    /**
+     * @brief Bus side
+     * @note start() and write() return false for a NACK. read() returns 0xff past the response.
+     */
+    bool start(uint8_t address_byte);
+    bool write(uint8_t byte);
+    uint8_t read();
+    void stop();
+
+private:
+    typedef struct
+    {
+        uint16_t command;
+        uint8_t len;
+        uint8_t data[BQ40Z80_SMBUS_BLOCK_MAX];
+    } MFA_ENTRY;
+
+    uint8_t address;
+    uint8_t kind[256];                                  //!< KIND_* of each SBS command
+    uint8_t sbs[256][1 + BQ40Z80_SMBUS_BLOCK_MAX];       //!< Words little-endian, blocks count first
+    MFA_ENTRY mfa[FAKE_GAUGE_MFA_ENTRIES];
+    uint8_t n_mfa;
+    uint8_t df[BQ40Z80_DF_SIZE];
+    bool df_sealed;                                      //!< Data flash writes are dropped
+    uint16_t mac;                                        //!< Latched ManufacturerAccess() command
+    uint16_t mac_pending;                                //!< Written, executed by the next STOP
+    bool mac_written;
+    bool writing;                                        //!< A write frame is open
+    uint8_t frame[2 + BQ40Z80_SMBUS_BLOCK_MAX + 1];      //!< Bytes of the open write frame
+    uint8_t frame_len;
+    uint8_t response[1 + BQ40Z80_MFA_ECHO_LEN + BQ40Z80_SMBUS_BLOCK_MAX + 1];
+    uint8_t response_len;
+    uint8_t response_pos;
+    uint32_t corrupt;                                    //!< Reads left to send with a wrong PEC
+    FAKE_GAUGE_COUNTERS counters;
+
+    MFA_ENTRY *find_mfa(uint16_t command);
+    uint8_t mfa_result(uint16_t command, uint8_t *data);
+    void end_frame();
+};
+
+#endif
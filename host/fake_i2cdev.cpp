@@ -0,0 +1,206 @@
+#include "fake_i2cdev.h"
+
+#include <errno.h>
+
+#define I2CDEV_MSG_MAX 8192 /*!< Longest message i2c-dev copies in */
+
+static FAKE_I2CDEV *instance = NULL;
+
+FAKE_I2CDEV::FAKE_I2CDEV(FAKE_GAUGE *gauge, unsigned long funcs)
+{
+    static const BQ40Z80_LINUX_IO FAKE_IO = {fake_open, fake_ioctl, fake_close, fake_read};
+
+    this->gauge = gauge;
+    this->funcs = funcs;
+    this->clock_hz = 0;
+    this->reset_counters();
+    bq40z80_mutex_init(&this->lock);
+    instance = this;
+    bq40z80_linux_set_io(&FAKE_IO);
+}
+
+FAKE_I2CDEV::~FAKE_I2CDEV()
+{
+    bq40z80_linux_set_io(NULL);
+    instance = NULL;
+    bq40z80_mutex_deinit(&this->lock);
+}
+
+/***************************** Public Functions *****************************/
+
+void FAKE_I2CDEV::get_counters(FAKE_I2CDEV_COUNTERS *counters)
+{
+    bq40z80_mutex_lock(&this->lock);
+    *counters = this->counters;
+    bq40z80_mutex_unlock(&this->lock);
+}
+
+void FAKE_I2CDEV::reset_counters()
+{
+    memset(&this->counters, 0, sizeof(this->counters));
+}
+
+void FAKE_I2CDEV::set_clock(uint32_t freq_hz)
+{
+    this->clock_hz = freq_hz;
+}
+
+int FAKE_I2CDEV::transfer(struct i2c_msg *msgs, uint32_t n_msgs)
+{
+    uint16_t len[I2C_RDWR_IOCTL_MAX_MSGS];
+
+    bq40z80_mutex_lock(&this->lock);
+    this->counters.ioctls++;
+
+    // i2cdev_ioctl_rdwr(): everything is checked before the adapter sees the first message
+    if (msgs == NULL || n_msgs == 0 || n_msgs > I2C_RDWR_IOCTL_MAX_MSGS)
+    {
+        this->counters.rejected++;
+        bq40z80_mutex_unlock(&this->lock);
+        return EINVAL;
+    }
+    for (uint32_t i = 0; i < n_msgs; i++)
+    {
+        struct i2c_msg *m = &msgs[i];
+        bool bad = m->len > I2CDEV_MSG_MAX;
+        if (!bad && (m->flags & I2C_M_RECV_LEN))
+            bad = !(m->flags & I2C_M_RD) || m->len == 0 || m->buf[0] < 1 || m->len < m->buf[0] + I2C_SMBUS_BLOCK_MAX;
+        if (bad)
+        {
+            this->counters.rejected++;
+            bq40z80_mutex_unlock(&this->lock);
+            return EINVAL;
+        }
+        // the kernel works on its own copy, the length it extends isn't written back
+        len[i] = m->flags & I2C_M_RECV_LEN ? m->buf[0] : m->len;
+    }
+
+    int result = 0;
+    for (uint32_t i = 0; i < n_msgs && result == 0; i++)
+    {
+        struct i2c_msg *m = &msgs[i];
+        bool read = m->flags & I2C_M_RD;
+
+        this->counters.messages++;
+        this->counters.conditions++;
+        this->counters.bytes++;
+        if (!this->gauge->start((uint8_t)(m->addr << 1 | read)))
+        {
+            result = ENXIO;
+            break;
+        }
+
+        if (!read)
+        {
+            for (uint16_t j = 0; j < len[i]; j++)
+            {
+                this->counters.bytes++;
+                if (!this->gauge->write(m->buf[j]))
+                {
+                    result = EREMOTEIO;
+                    break;
+                }
+            }
+            continue;
+        }
+
+        uint16_t j = 0;
+        if (m->flags & I2C_M_RECV_LEN)
+        {
+            // the adapter reads the count first and extends the message by it
+            uint8_t extra = len[i];
+            m->buf[j++] = this->gauge->read();
+            this->counters.bytes++;
+            if (m->buf[0] == 0 || m->buf[0] > I2C_SMBUS_BLOCK_MAX)
+            {
+                result = EPROTO;
+                break;
+            }
+            len[i] = extra + m->buf[0];
+        }
+        for (; j < len[i]; j++)
+        {
+            m->buf[j] = this->gauge->read();
+            this->counters.bytes++;
+        }
+    }
+
+    this->counters.conditions++;
+    this->gauge->stop();
+    bq40z80_mutex_unlock(&this->lock);
+    return result;
+}
+
+/***************************** Private Functions *****************************/
+
+int FAKE_I2CDEV::fake_open(const char *path, int flags)
+{
+    int n;
+    (void)flags;
+
+    if (instance != NULL && instance->clock_hz != 0 && sscanf(path, "/sys/bus/i2c/devices/i2c-%d/of_node/clock-frequency", &n) == 1)
+        return FAKE_I2CDEV_CLOCK_FD;
+    if (instance == NULL || sscanf(path, "/dev/i2c-%d", &n) != 1)
+    {
+        errno = ENOENT;
+        return -1;
+    }
+    return FAKE_I2CDEV_FD;
+}
+
+int FAKE_I2CDEV::fake_ioctl(int fd, unsigned long request, void *arg)
+{
+    if (instance == NULL || fd != FAKE_I2CDEV_FD)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    int result = 0;
+    switch (request)
+    {
+    case I2C_FUNCS:
+        *(unsigned long *)arg = instance->funcs;
+        break;
+    case I2C_TIMEOUT:
+        break;
+    case I2C_RDWR:
+    {
+        struct i2c_rdwr_ioctl_data *rdwr = (struct i2c_rdwr_ioctl_data *)arg;
+        result = instance->transfer(rdwr->msgs, rdwr->nmsgs);
+        break;
+    }
+    default:
+        result = ENOTTY;
+        break;
+    }
+
+    if (result != 0)
+    {
+        errno = result;
+        return -1;
+    }
+    return 0;
+}
+
+int FAKE_I2CDEV::fake_close(int fd)
+{
+    (void)fd;
+    return 0;
+}
+
+int FAKE_I2CDEV::fake_read(int fd, void *buf, size_t len)
+{
+    if (instance == NULL || fd != FAKE_I2CDEV_CLOCK_FD || len < 4)
+    {
+        errno = EBADF;
+        return -1;
+    }
+
+    uint8_t *raw = (uint8_t *)buf;
+    raw[0] = instance->clock_hz >> 24;
+    raw[1] = instance->clock_hz >> 16;
+    raw[2] = instance->clock_hz >> 8;
+    raw[3] = instance->clock_hz;
+    return 4;
+}
@@ -0,0 +1,76 @@
+#ifndef __FAKE_I2CDEV_H
+#define __FAKE_I2CDEV_H
+
+#include "fake_gauge.h"
+
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#define FAKE_I2CDEV_FD 0x5000       /*!< File descriptor handed out for every /dev/i2c-N */
+#define FAKE_I2CDEV_CLOCK_FD 0x5001 /*!< Same for the device tree clock-frequency of every adapter */
+#define FAKE_I2CDEV_FUNCS (I2C_FUNC_I2C | I2C_FUNC_SMBUS_READ_BLOCK_DATA | I2C_FUNC_SMBUS_PEC)
+
+/**
+ * @brief Traffic seen by the fake adapter
+ */
+typedef struct
+{
+    uint64_t ioctls;     //!< I2C_RDWR calls
+    uint64_t rejected;   //!< I2C_RDWR calls refused with EINVAL before reaching the bus
+    uint64_t messages;   //!< Messages transferred
+    uint64_t bytes;      //!< Bytes on the wire, address bytes included
+    uint64_t conditions; //!< START, repeated START and STOP conditions
+} FAKE_I2CDEV_COUNTERS;
+
+/**
+ * @brief /dev/i2c-N in process, with one FAKE_GAUGE on the bus
+ * @note Installs itself with bq40z80_linux_set_io() for its lifetime. I2C_RDWR is checked the way the
+ *       kernel's i2c-dev checks it before any byte reaches the bus: at most I2C_RDWR_IOCTL_MAX_MSGS
+ *       messages of at most 8192 bytes, and an I2C_M_RECV_LEN message must be a read whose buf[0] holds
+ *       the bytes that follow the data (1 to 2) and whose length leaves room for a full block after them.
+ *       The adapter then reads the count byte and fails with EPROTO when it is 0 or above
+ *       I2C_SMBUS_BLOCK_MAX. The caller's message lengths are left alone, as with the real ioctl.
+ *       Only one instance may exist at a time.
+ */
+class FAKE_I2CDEV
+{
+public:
+    /**
+     * @param gauge Gauge on the bus, must outlive the adapter
+     * @param funcs Reported by I2C_FUNCS, without I2C_FUNC_SMBUS_READ_BLOCK_DATA the driver guesses block lengths
+     */
+    FAKE_I2CDEV(FAKE_GAUGE *gauge, unsigned long funcs = FAKE_I2CDEV_FUNCS);
+
+    /**
+     * @brief Restore the libc system calls
+     */
+    ~FAKE_I2CDEV();
+
+    void get_counters(FAKE_I2CDEV_COUNTERS *counters);
+    void reset_counters();
+
+    /**
+     * @brief Adapter clock served in sysfs, 0 (the default) leaves the device tree without one
+     */
+    void set_clock(uint32_t freq_hz);
+
+    /**
+     * @brief Run an I2C_RDWR request
+     * @return 0 or the errno the kernel would set
+     */
+    int transfer(struct i2c_msg *msgs, uint32_t n_msgs);
+
+private:
+    FAKE_GAUGE *gauge;
+    unsigned long funcs;
+    uint32_t clock_hz;
+    FAKE_I2CDEV_COUNTERS counters;
+    bq40z80_mutex_t lock; //!< One transfer at a time, like the adapter
+
+    static int fake_open(const char *path, int flags);
+    static int fake_ioctl(int fd, unsigned long request, void *arg);
+    static int fake_close(int fd);
+    static int fake_read(int fd, void *buf, size_t len);
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef __PUBLIC_CALLS_H
+#define __PUBLIC_CALLS_H
+
+#include "bq40z80.h"
+
+#define CALL_TIMEOUT_US 1000000 /*!< Deadline of each call, far above the wire time */
+
+/**
+ * @brief Public call under test, shared by the benchmarks and the heap test
+ * @note The table spans plain SBS words, static words, blocks, MFA reads and multi-register queries
+ */
+typedef struct
+{
+    const char *name;
+    esp_err_t (*run)(BQ40Z80 *bq, BQ40Z80_CALL *call);
+} PUBLIC_CALL;
+
+static const PUBLIC_CALL CALLS[] = {
+    {"get_voltage", [](BQ40Z80 *bq, BQ40Z80_CALL *call) { uint16_t v; return bq->try_get_voltage(&v, call); }},
+    {"get_current", [](BQ40Z80 *bq, BQ40Z80_CALL *call) { int16_t v; return bq->try_get_current(&v, call); }},
+    {"get_rsoc", [](BQ40Z80 *bq, BQ40Z80_CALL *call) { uint8_t v; return bq->try_get_rsoc(&v, call); }},
+    {"get_design_capacity", [](BQ40Z80 *bq, BQ40Z80_CALL *call) { uint16_t v; return bq->try_get_design_capacity(&v, call); }},
+    {"get_cell_voltage", [](BQ40Z80 *bq, BQ40Z80_CALL *call) { uint16_t v; return bq->try_get_cell_voltage(1, &v, call); }},
+    {"get_device_type", [](BQ40Z80 *bq, BQ40Z80_CALL *call) { uint16_t v; return bq->try_get_device_type(&v, call); }},
+    {"get_firmware_version", [](BQ40Z80 *bq, BQ40Z80_CALL *call) { FIRMWARE_VERSION v; return bq->try_get_firmware_version(&v, call); }},
+    {"read_operation_status", [](BQ40Z80 *bq, BQ40Z80_CALL *call) { OPERATION_STATUS v; return bq->try_read_operation_status(&v, call); }},
+    {"read_charging_status", [](BQ40Z80 *bq, BQ40Z80_CALL *call) { CHARGING_STATUS v; return bq->try_read_charging_status(&v, call); }},
+    {"read_da_status_1", [](BQ40Z80 *bq, BQ40Z80_CALL *call) { DA_STATUS_1 v; return bq->try_read_da_status_1(&v, call); }},
+    {"read_da_status_3", [](BQ40Z80 *bq, BQ40Z80_CALL *call) { DA_STATUS_3 v; return bq->try_read_da_status_3(&v, call); }},
+    {"read_cells", [](BQ40Z80 *bq, BQ40Z80_CALL *call) { BQ40Z80_CELL_SAMPLE v; return bq->try_read_cells(&v, call); }},
+    {"read_lifetime_data_1", [](BQ40Z80 *bq, BQ40Z80_CALL *call) { LIFETIME_DATA_1 v; return bq->try_read_lifetime_data_1(&v, call); }},
+    {"read_fields_vi", [](BQ40Z80 *bq, BQ40Z80_CALL *call) {
+         BQ40Z80_TELEMETRY v;
+         return bq->try_read_fields(BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_VOLTAGE) | BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_CURRENT), &v, call);
+     }},
+    {"read_fields_all", [](BQ40Z80 *bq, BQ40Z80_CALL *call) { BQ40Z80_TELEMETRY v; return bq->try_read_fields(BQ40Z80_FIELD_MASK_ALL, &v, call); }},
+};
+
+#endif
@@ -0,0 +1,100 @@
+/**
+ * Alert line on the ESP-IDF backend, driven through a simulated GPIO: the falling edge wakes a task blocked
+ * in wait_alert(), service_alert() reads the status and re-arms the trip points, and costs nothing on the
+ * bus without a pending alert
+ */
+#include "check.h"
+#include "fake_esp.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+#define SCL_IO 22
+#define SDA_IO 21
+#define ALERT_IO ((gpio_num_t)4)
+
+typedef struct
+{
+    BQ40Z80 *bq;
+    bool woken;
+} WAITER;
+
+static void *waiter(void *arg)
+{
+    WAITER *w = (WAITER *)arg;
+    w->woken = w->bq->wait_alert(1000);
+    return NULL;
+}
+
+static void set_operation_status(FAKE_GAUGE *gauge, uint32_t status)
+{
+    uint8_t raw[4] = {(uint8_t)status, (uint8_t)(status >> 8), (uint8_t)(status >> 16), (uint8_t)(status >> 24)};
+    gauge->set_mfa(BQ40Z80_MFA_OPERATION_STATUS, raw, sizeof(raw));
+}
+
+static uint64_t transactions(FAKE_ESP *esp)
+{
+    FAKE_ESP_COUNTERS counters;
+    esp->get_counters(&counters);
+    return counters.transactions;
+}
+
+int main()
+{
+    FAKE_GAUGE gauge;
+    FAKE_ESP esp(&gauge);
+    BQ40Z80 bq(SCL_IO, SDA_IO, I2C_NUM_0);
+    WAITER w = {&bq, false};
+    pthread_t thread;
+
+    // the pull-up holds the line high, nothing pending once attached
+    CHECK_EQ(bq.attach_alert(ALERT_IO), ESP_OK);
+    CHECK(!bq.wait_alert(0));
+    uint64_t before = transactions(&esp);
+    CHECK_EQ(bq.try_service_alert(), ESP_OK);
+    CHECK_EQ(transactions(&esp), before);
+
+    CHECK_EQ(bq.try_set_trip_points(2000, 2600), ESP_OK);
+    CHECK_EQ(gauge.get_word(BQ40Z80_SBS_BTPDischargeSet), 2000);
+    CHECK_EQ(gauge.get_word(BQ40Z80_SBS_BTPChargeSet), 2600);
+
+    // the gauge trips and pulls the line low, the interrupt wakes the waiting task
+    gauge.set_word(BQ40Z80_SBS_BTPDischargeSet, 0);
+    gauge.set_word(BQ40Z80_SBS_BTPChargeSet, 0);
+    set_operation_status(&gauge, 0x0a000107 | OPERATION_STATUS::BTP_INT);
+    pthread_create(&thread, NULL, waiter, &w);
+    usleep(20000);
+    esp.set_level(ALERT_IO, 0);
+    pthread_join(thread, NULL);
+    CHECK(w.woken);
+
+    // servicing reads the status and writes the trip points again, which releases the line
+    CHECK_EQ(bq.try_service_alert(), ESP_OK);
+    CHECK_EQ(gauge.get_word(BQ40Z80_SBS_BTPDischargeSet), 2000);
+    CHECK_EQ(gauge.get_word(BQ40Z80_SBS_BTPChargeSet), 2600);
+    CHECK(!bq.wait_alert(0));
+    esp.set_level(ALERT_IO, 1);
+    CHECK(!bq.wait_alert(0));
+
+    // a failed read leaves the alert pending for the next pass
+    set_operation_status(&gauge, 0x0a000107);
+    esp.set_level(ALERT_IO, 0);
+    BQ40Z80_CALL call = bq40z80_call_within(0, 1);
+    CHECK(bq.try_service_alert(&call) != ESP_OK);
+    CHECK(bq.wait_alert(0));
+    CHECK_EQ(bq.try_service_alert(), ESP_OK);
+    CHECK(!bq.wait_alert(0));
+    esp.set_level(ALERT_IO, 1);
+
+    // a trip window follows RemainingCapacity(), 2340 mAh in the image
+    CHECK_EQ(bq.try_arm_trip_window(100), ESP_OK);
+    CHECK_EQ(gauge.get_word(BQ40Z80_SBS_BTPDischargeSet), 2240);
+    CHECK_EQ(gauge.get_word(BQ40Z80_SBS_BTPChargeSet), 2440);
+
+    // once detached the line is ignored
+    bq.detach_alert();
+    esp.set_level(ALERT_IO, 0);
+    CHECK(!bq.wait_alert(0));
+
+    return check_result("test_alert");
+}
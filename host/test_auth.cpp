@@ -0,0 +1,87 @@
+/**
+ * SHA-1 and the authentication response against known answers: the FIPS 180 vectors, messages whose
+ * padding fits one block or spills into a second, and a response of the default key
+ */
+#include "bq40z80.h"
+#include "check.h"
+
+typedef struct
+{
+    const char *message;
+    size_t len; //!< Repeats of a single-character message, 0 takes the string as is
+    const char *digest;
+} SHA1_VECTOR;
+
+static const SHA1_VECTOR VECTORS[] = {
+    {"abc", 0, "a9993e364706816aba3e25717850c26c9cd0d89d"},
+    {"", 0, "da39a3ee5e6b4b0d3255bfef95601890afd80709"},
+    // 56 bytes, the length no longer fits the first block
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 0, "84983e441c3bd26ebaae4aa1f95129e5e54670f1"},
+    // 55 bytes, the longest message padded within one block
+    {"a", 55, "c1c8bbdc22796e28c0e15163d20899b65621d65a"},
+    {"a", 64, "0098ba824b5c16427bd7a1122a5a442a25ec644d"},
+};
+
+static void parse_hex(const char *hex, uint8_t *buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        unsigned byte;
+        sscanf(hex + 2 * i, "%2x", &byte);
+        buf[i] = byte;
+    }
+}
+
+static void check_sha1()
+{
+    uint8_t message[64];
+    uint8_t expected[BQ40Z80_SHA1_LEN];
+    uint8_t digest[BQ40Z80_SHA1_LEN];
+
+    for (size_t i = 0; i < sizeof(VECTORS) / sizeof(VECTORS[0]); i++)
+    {
+        size_t len = VECTORS[i].len;
+        if (len == 0)
+        {
+            len = strlen(VECTORS[i].message);
+            memcpy(message, VECTORS[i].message, len);
+        }
+        else
+        {
+            memset(message, VECTORS[i].message[0], len);
+        }
+
+        parse_hex(VECTORS[i].digest, expected, sizeof(expected));
+        bq40z80_sha1(message, len, digest);
+        CHECK_EQ(memcmp(digest, expected, sizeof(digest)), 0);
+    }
+}
+
+static void check_auth_digest()
+{
+    static const uint8_t KEY[BQ40Z80_AUTH_KEY_LEN] = BQ40Z80_AUTH_DEFAULT_KEY;
+    uint8_t challenge[BQ40Z80_AUTH_CHALLENGE_LEN];
+    uint8_t expected[BQ40Z80_AUTH_CHALLENGE_LEN];
+    uint8_t response[BQ40Z80_AUTH_CHALLENGE_LEN];
+    uint8_t message[BQ40Z80_AUTH_KEY_LEN + BQ40Z80_SHA1_LEN];
+
+    for (uint8_t i = 0; i < sizeof(challenge); i++)
+        challenge[i] = i;
+    parse_hex("b78043012bb40f9ff86404f645c2ab6a9f28eaf3", expected, sizeof(expected));
+    bq40z80_auth_digest(KEY, challenge, response);
+    CHECK_EQ(memcmp(response, expected, sizeof(response)), 0);
+
+    // the two-compression shortcut agrees with SHA-1(key || SHA-1(key || challenge))
+    memcpy(message, KEY, sizeof(KEY));
+    memcpy(message + sizeof(KEY), challenge, sizeof(challenge));
+    bq40z80_sha1(message, sizeof(KEY) + sizeof(challenge), message + sizeof(KEY));
+    bq40z80_sha1(message, sizeof(message), response);
+    CHECK_EQ(memcmp(response, expected, sizeof(response)), 0);
+}
+
+int main()
+{
+    check_sha1();
+    check_auth_digest();
+    return check_result("test_auth");
+}
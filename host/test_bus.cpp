@@ -0,0 +1,46 @@
+/**
+ * Shared bus capacity: a gauge beyond BQ40Z80_BUS_MAX_DEVICES stays off the bus, its calls fail with
+ * ESP_ERR_NO_MEM without touching the adapter, and a freed slot takes the next gauge
+ */
+#include "fake_i2cdev.h"
+#include "check.h"
+
+int main()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80_BUS bus((i2c_port_t)1);
+    BQ40Z80 *gauges[BQ40Z80_BUS_MAX_DEVICES];
+    FAKE_I2CDEV_COUNTERS before, after;
+    uint16_t mv;
+
+    for (uint8_t i = 0; i < BQ40Z80_BUS_MAX_DEVICES; i++)
+        gauges[i] = new BQ40Z80(&bus, BQ40Z80_BUS_NO_MUX);
+    CHECK_EQ(bus.get_device_count(), BQ40Z80_BUS_MAX_DEVICES);
+
+    BQ40Z80 *extra = new BQ40Z80(&bus, BQ40Z80_BUS_NO_MUX);
+    CHECK_EQ(bus.get_device_count(), BQ40Z80_BUS_MAX_DEVICES);
+    adapter.get_counters(&before);
+    CHECK_EQ(extra->try_get_voltage(&mv), ESP_ERR_NO_MEM);
+    CHECK_EQ(extra->try_negotiate_bus_speed(), ESP_ERR_NO_MEM);
+    adapter.get_counters(&after);
+    CHECK_EQ(after.ioctls, before.ioctls);
+
+    // leaving the bus takes nothing from it, the attached gauges go on
+    delete extra;
+    CHECK_EQ(bus.get_device_count(), BQ40Z80_BUS_MAX_DEVICES);
+    CHECK_EQ(gauges[BQ40Z80_BUS_MAX_DEVICES - 1]->try_get_voltage(&mv), ESP_OK);
+    CHECK_EQ(mv, 15616);
+
+    delete gauges[0];
+    extra = new BQ40Z80(&bus, BQ40Z80_BUS_NO_MUX);
+    CHECK_EQ(bus.get_device_count(), BQ40Z80_BUS_MAX_DEVICES);
+    CHECK(bus.get_device(BQ40Z80_BUS_MAX_DEVICES - 1) == extra);
+    CHECK_EQ(extra->try_get_voltage(&mv), ESP_OK);
+
+    delete extra;
+    for (uint8_t i = 1; i < BQ40Z80_BUS_MAX_DEVICES; i++)
+        delete gauges[i];
+    CHECK_EQ(bus.get_device_count(), 0);
+    return check_result("test_bus");
+}
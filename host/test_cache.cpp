@@ -0,0 +1,33 @@
+/**
+ * Register cache against a BatteryMode write, the words in its CAPM unit must be read again
+ */
+#include "fake_i2cdev.h"
+#include "check.h"
+
+int main()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    uint16_t val;
+
+    CHECK_EQ(bq.try_get_design_capacity(&val), ESP_OK);
+    CHECK_EQ(val, 3000);
+    CHECK_EQ(bq.try_get_remaining_capacity(&val), ESP_OK);
+    CHECK_EQ(val, 2340);
+
+    // what the gauge reports in 10mWh once CAPM is set
+    gauge.set_word(BQ40Z80_SBS_DesignCapacity, 4440);
+    gauge.set_word(BQ40Z80_SBS_RemainingCapacity, 3463);
+    CHECK_EQ(bq.try_get_design_capacity(&val), ESP_OK);
+    CHECK_EQ(val, 3000);
+
+    CHECK_EQ(bq.try_set_capm(true), ESP_OK);
+    CHECK_EQ(gauge.get_word(BQ40Z80_SBS_BatteryMode), 0xe081);
+    CHECK_EQ(bq.try_get_design_capacity(&val), ESP_OK);
+    CHECK_EQ(val, 4440);
+    CHECK_EQ(bq.try_get_remaining_capacity(&val), ESP_OK);
+    CHECK_EQ(val, 3463);
+
+    return check_result("test_cache");
+}
@@ -0,0 +1,98 @@
+/**
+ * Cell history statistics on a 4S pack with exactly known answers: rest and 1024 mA load alternate in
+ * runs of four, each cell sags by its own resistance, the top cell is balanced at rest, and the ring
+ * wraps between the last two samples so the step across the wrap is the only one in a short window
+ */
+#include <stdlib.h>
+
+#include "bq40z80_cell_history.h"
+#include "check.h"
+
+#define CELLS 4
+#define CAPACITY 16
+#define LOAD_MA -1024 /*!< A power of two keeps dV/dI exact in float */
+#define REST_MV 3900  /*!< Cell 1 at rest, each next cell 8 mV higher */
+#define LOAD_MV 3892  /*!< Every cell under load, cell n+1 drops 8 * (n + 1) mV */
+
+static void make_sample(uint32_t k, BQ40Z80_CELL_SAMPLE *sample)
+{
+    // rest for k = 0..2, 7..10 and 15, load for 3..6 and 11..14
+    bool loaded = ((k + 1) / 4) % 2;
+
+    memset(sample, 0, sizeof(BQ40Z80_CELL_SAMPLE));
+    sample->timestamp_us = (int64_t)k * 250000;
+    for (uint8_t c = 0; c < CELLS; c++)
+    {
+        sample->voltage_mv[c] = loaded ? LOAD_MV : REST_MV + 8 * c;
+        sample->current_ma[c] = loaded ? LOAD_MA : 0;
+    }
+    sample->balancing = loaded ? 0 : 1 << (CELLS - 1);
+}
+
+/**
+ * @brief Statistics every window holds: as many samples at rest as under load, and whole steps between them
+ */
+static void check_cells(const BQ40Z80_CELL_ANALYSIS *analysis, uint32_t half)
+{
+    for (uint8_t c = 0; c < CELLS; c++)
+    {
+        const BQ40Z80_CELL_STATS *stats = &analysis->cell[c];
+        CHECK_EQ(stats->min_mv, LOAD_MV);
+        CHECK_EQ(stats->max_mv, REST_MV + 8 * c);
+        CHECK_EQ(stats->mean_mv, (REST_MV + LOAD_MV) / 2 + 4 * c);
+        CHECK_EQ(stats->stddev_mv, 4 + 4 * c);
+        CHECK_EQ(stats->resting, half);
+        CHECK_EQ(stats->loaded, half);
+        CHECK_EQ(stats->sag_mv, 8 * (c + 1));
+        // the voltage falls as the discharge current grows, a positive resistance of 8 * (n + 1) mV / 1024 mA
+        CHECK_EQ(stats->resistance_uohm, (int32_t)(8 * (c + 1) * 1000000.0 / -LOAD_MA));
+    }
+    CHECK_EQ(analysis->spread_max_mv, 8 * (CELLS - 1));
+    CHECK_EQ(analysis->spread_mean_mv, 8 * (CELLS - 1) / 2);
+    CHECK_EQ(analysis->lowest_cell, 0);
+
+    // at rest the cells sit 12 mV either side of their average, under load they are level
+    CHECK_EQ(analysis->cell[CELLS - 1].balancing, half);
+    CHECK_EQ(analysis->cell[CELLS - 1].offset_balancing_mv, 12);
+    CHECK_EQ(analysis->cell[CELLS - 1].offset_mv, 0);
+    for (uint8_t c = 0; c < CELLS - 1; c++)
+    {
+        CHECK_EQ(analysis->cell[c].balancing, 0);
+        CHECK_EQ(analysis->cell[c].offset_mv, 4 * c - 6);
+        CHECK_EQ(analysis->cell[c].offset_balancing_mv, 0);
+    }
+}
+
+int main()
+{
+    void *arena = malloc(BQ40Z80_CELL_HISTORY::arena_size(CAPACITY, CELLS));
+    BQ40Z80_CELL_HISTORY history(arena, BQ40Z80_CELL_HISTORY::arena_size(CAPACITY, CELLS), CELLS);
+    BQ40Z80_CELL_ANALYSIS analysis;
+    BQ40Z80_CELL_SAMPLE sample;
+
+    CHECK_EQ(history.get_capacity(), CAPACITY);
+
+    // one sample ahead of the pattern puts the wrap between its last two samples
+    make_sample(0, &sample);
+    sample.voltage_mv[0] = 3000;
+    history.append(&sample);
+    for (uint32_t k = 0; k < CAPACITY; k++)
+    {
+        make_sample(k, &sample);
+        history.append(&sample);
+    }
+    CHECK_EQ(history.count(), CAPACITY);
+
+    history.analyse(0, &analysis);
+    CHECK_EQ(analysis.samples, CAPACITY);
+    CHECK_EQ(analysis.cells, CELLS);
+    check_cells(&analysis, CAPACITY / 2);
+
+    // only the step from the last slot back to the first is left, without it there is no resistance
+    history.analyse(2, &analysis);
+    CHECK_EQ(analysis.samples, 2);
+    check_cells(&analysis, 1);
+
+    free(arena);
+    return check_result("test_cells");
+}
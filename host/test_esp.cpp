@@ -0,0 +1,81 @@
+/**
+ * ESP-IDF backend built on host against the fakes of host/esp: reads through the command links, the clock
+ * negotiation through i2c_param_config(), and not a single heap allocation per public call, PEC on or off
+ */
+#include "alloc_count.h"
+#include "check.h"
+#include "fake_esp.h"
+#include "public_calls.h"
+
+#define SCL_IO 22
+#define SDA_IO 21
+
+static void check_reads(BQ40Z80 *bq)
+{
+    uint16_t val;
+    FIRMWARE_VERSION firmware;
+
+    CHECK_EQ(bq->try_get_voltage(&val), ESP_OK);
+    CHECK_EQ(val, 15616);
+    CHECK_EQ(bq->try_get_device_type(&val), ESP_OK);
+    CHECK_EQ(val, 0x4800);
+    CHECK_EQ(bq->try_get_firmware_version(&firmware), ESP_OK);
+    CHECK_EQ(firmware.device_number, 0x4800);
+    CHECK_EQ(firmware.version, 0x0101);
+}
+
+static void check_heap(FAKE_ESP *esp, BQ40Z80 *bq, bool pec)
+{
+    FAKE_ESP_COUNTERS counters;
+
+    bq->set_pec(pec);
+    for (size_t i = 0; i < sizeof(CALLS) / sizeof(CALLS[0]); i++)
+    {
+        // the first call of each kind may set up stdio, only the steady state counts
+        CHECK_EQ(CALLS[i].run(bq, NULL), ESP_OK);
+
+        BQ40Z80_CALL call = bq40z80_call_within(CALL_TIMEOUT_US, 0);
+        bq->invalidate_cache();
+        esp->reset_counters();
+        alloc_count_reset();
+        esp_err_t err = CALLS[i].run(bq, &call);
+        uint64_t allocs = alloc_count();
+        esp->get_counters(&counters);
+
+        if (err != ESP_OK || allocs != 0)
+            fprintf(stderr, "%s, PEC %s: %s, %llu allocation(s)\n", CALLS[i].name, pec ? "on" : "off", esp_err_to_name(err), (unsigned long long)allocs);
+        CHECK_EQ(err, ESP_OK);
+        CHECK_EQ(allocs, 0);
+        CHECK_EQ(counters.links_created, 0);
+        CHECK_EQ(counters.failed, 0);
+        CHECK_EQ(call.bytes, counters.bytes);
+    }
+
+    // the aborting API wraps the same calls
+    alloc_count_reset();
+    bq->get_voltage();
+    CHECK_EQ(alloc_count(), 0);
+    bq->set_pec(false);
+}
+
+int main()
+{
+    FAKE_GAUGE gauge;
+    FAKE_ESP esp(&gauge);
+    BQ40Z80 bq(SCL_IO, SDA_IO, I2C_NUM_0);
+
+    // the image has OperationStatus()[XL] clear
+    CHECK_EQ(esp.get_clock(I2C_NUM_0), BQ40Z80_BUS_FREQ_STD_HZ);
+    uint8_t status[4] = {0x07, 0x01, 0x40, 0x0a};
+    gauge.set_mfa(BQ40Z80_MFA_OPERATION_STATUS, status, sizeof(status));
+    bq.invalidate_cache();
+    CHECK_EQ(bq.try_negotiate_bus_speed(), ESP_OK);
+    CHECK_EQ(esp.get_clock(I2C_NUM_0), BQ40Z80_BUS_FREQ_XL_HZ);
+    CHECK_EQ(bq.get_bus_speed(), BQ40Z80_BUS_FREQ_XL_HZ);
+
+    check_reads(&bq);
+    check_heap(&esp, &bq, false);
+    check_heap(&esp, &bq, true);
+
+    return check_result("test_esp");
+}
@@ -0,0 +1,173 @@
+/**
+ * Status word events: set and cleared masks of BatteryStatus() and SafetyAlert(), no dispatch without a
+ * change or after unsubscribe(), and a callback that reads the gauge and unsubscribes itself
+ */
+#include "fake_i2cdev.h"
+#include "check.h"
+
+#define POLL_TIMEOUT_US 100000 /*!< Budget of each status read */
+
+typedef struct
+{
+    uint32_t calls;
+    BQ40Z80_EVENT last;
+} RECORD;
+
+typedef struct
+{
+    uint32_t calls;
+    esp_err_t err;
+    uint16_t voltage;
+} REENTRY;
+
+static void record(BQ40Z80 *gauge, const BQ40Z80_EVENT *event, void *arg)
+{
+    RECORD *rec = (RECORD *)arg;
+    rec->calls++;
+    rec->last = *event;
+}
+
+static void reenter(BQ40Z80 *gauge, const BQ40Z80_EVENT *event, void *arg)
+{
+    REENTRY *reentry = (REENTRY *)arg;
+    reentry->calls++;
+    reentry->err = gauge->try_get_voltage(&reentry->voltage);
+    gauge->unsubscribe(reenter, arg);
+}
+
+/**
+ * @brief Options of a poll, status words are cached like any measurement and must come from the gauge
+ */
+static BQ40Z80_CALL poll()
+{
+    BQ40Z80_CALL call = bq40z80_call_within(POLL_TIMEOUT_US, 0);
+    call.fresh = true;
+    return call;
+}
+
+static void read_battery_status(BQ40Z80 *bq)
+{
+    BQ40Z80_CALL call = poll();
+    uint16_t val;
+    CHECK_EQ(bq->try_read<BQ40Z80_REG_BatteryStatus>(&val, &call), ESP_OK);
+}
+
+static void read_safety_alert(BQ40Z80 *bq)
+{
+    BQ40Z80_CALL call = poll();
+    SAFETY_STATUS alert;
+    CHECK_EQ(bq->try_read_safety_alert(&alert, &call), ESP_OK);
+}
+
+static void check_battery_status()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    RECORD rec;
+
+    memset(&rec, 0, sizeof(rec));
+    CHECK_EQ(bq.subscribe(BQ40Z80_FIELD_BATTERY_STATUS, 0x00ff, record, &rec), ESP_OK);
+
+    // the first read compares against zero, FC and FD of 0x00c0 are reported as set
+    read_battery_status(&bq);
+    CHECK_EQ(rec.calls, 1);
+    CHECK_EQ(rec.last.field, BQ40Z80_FIELD_BATTERY_STATUS);
+    CHECK_EQ(rec.last.value, 0x00c0);
+    CHECK_EQ(rec.last.set, 0x00c0);
+    CHECK_EQ(rec.last.cleared, 0);
+
+    read_battery_status(&bq);
+    CHECK_EQ(rec.calls, 1);
+
+    // FC clears and a bit outside the mask sets, only FC is reported
+    gauge.set_word(BQ40Z80_SBS_BatteryStatus, 0x0140);
+    read_battery_status(&bq);
+    CHECK_EQ(rec.calls, 2);
+    CHECK_EQ(rec.last.value, 0x0140);
+    CHECK_EQ(rec.last.set, 0);
+    CHECK_EQ(rec.last.cleared, 0x0080);
+
+    // a change outside the mask calls nobody
+    gauge.set_word(BQ40Z80_SBS_BatteryStatus, 0x0340);
+    read_battery_status(&bq);
+    CHECK_EQ(rec.calls, 2);
+
+    bq.unsubscribe(record, &rec);
+    gauge.set_word(BQ40Z80_SBS_BatteryStatus, 0x0300);
+    read_battery_status(&bq);
+    CHECK_EQ(rec.calls, 2);
+}
+
+static void check_safety_alert()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    RECORD rec;
+    uint8_t raw[4] = {0x00, 0x10, 0x00, 0x01};
+
+    memset(&rec, 0, sizeof(rec));
+    CHECK_EQ(bq.subscribe(BQ40Z80_FIELD_SAFETY_ALERT, 0xffffffff, record, &rec), ESP_OK);
+    read_safety_alert(&bq);
+    CHECK_EQ(rec.calls, 0);
+
+    gauge.set_mfa(BQ40Z80_MFA_SAFETY_ALERT, raw, sizeof(raw));
+    read_safety_alert(&bq);
+    CHECK_EQ(rec.calls, 1);
+    CHECK_EQ(rec.last.field, BQ40Z80_FIELD_SAFETY_ALERT);
+    CHECK_EQ(rec.last.set, 0x01001000);
+
+    raw[1] = 0;
+    gauge.set_mfa(BQ40Z80_MFA_SAFETY_ALERT, raw, sizeof(raw));
+    read_safety_alert(&bq);
+    CHECK_EQ(rec.calls, 2);
+    CHECK_EQ(rec.last.value, 0x01000000);
+    CHECK_EQ(rec.last.set, 0);
+    CHECK_EQ(rec.last.cleared, 0x00001000);
+}
+
+static void check_reentry()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    REENTRY reentry;
+
+    // the callback reads the gauge from inside the read that fired it, then leaves
+    memset(&reentry, 0, sizeof(reentry));
+    CHECK_EQ(bq.subscribe(BQ40Z80_FIELD_BATTERY_STATUS, 0xffff, reenter, &reentry), ESP_OK);
+    read_battery_status(&bq);
+    CHECK_EQ(reentry.calls, 1);
+    CHECK_EQ(reentry.err, ESP_OK);
+    CHECK_EQ(reentry.voltage, 15616);
+
+    gauge.set_word(BQ40Z80_SBS_BatteryStatus, 0x0000);
+    read_battery_status(&bq);
+    CHECK_EQ(reentry.calls, 1);
+}
+
+static void check_slots()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    RECORD rec[BQ40Z80_EVENT_SUBSCRIBERS + 1];
+
+    CHECK_EQ(bq.subscribe(BQ40Z80_FIELD_VOLTAGE, 0xffff, record, &rec[0]), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(bq.subscribe(BQ40Z80_FIELD_BATTERY_STATUS, 0xffff, NULL, &rec[0]), ESP_ERR_INVALID_ARG);
+    for (uint8_t i = 0; i < BQ40Z80_EVENT_SUBSCRIBERS; i++)
+        CHECK_EQ(bq.subscribe(BQ40Z80_FIELD_BATTERY_STATUS, 0xffff, record, &rec[i]), ESP_OK);
+    CHECK_EQ(bq.subscribe(BQ40Z80_FIELD_BATTERY_STATUS, 0xffff, record, &rec[BQ40Z80_EVENT_SUBSCRIBERS]), ESP_ERR_NO_MEM);
+    bq.unsubscribe(record, &rec[0]);
+    CHECK_EQ(bq.subscribe(BQ40Z80_FIELD_BATTERY_STATUS, 0xffff, record, &rec[BQ40Z80_EVENT_SUBSCRIBERS]), ESP_OK);
+}
+
+int main()
+{
+    check_battery_status();
+    check_safety_alert();
+    check_reentry();
+    check_slots();
+    return check_result("test_events");
+}
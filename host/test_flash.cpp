@@ -0,0 +1,159 @@
+/**
+ * Data flash writes: the differential write_df() with its signature and read-back checks, then the
+ * signature checks of flash(), an S-record is matched on AllDFSignature(), a FlashStream on
+ * StaticDFSignature(), both together with InstructionFlashSignature()
+ */
+#include "fake_i2cdev.h"
+#include "check.h"
+
+#define INSTRUCTION_SIGNATURE 0x9a3c             /*!< InstructionFlashSignature() of the fake gauge */
+#define STATIC_DF_SIGNATURE 0x51f0               /*!< StaticDFSignature() of the fake gauge */
+#define ALL_DF_SIGNATURE 0x7e21                  /*!< AllDFSignature() of the fake gauge, written rows don't change it */
+#define IMAGE_ADDRESS (BQ40Z80_DF_START + 0x100) /*!< Start of the write_df() image, block aligned */
+#define IMAGE_LEN (3 * BQ40Z80_DF_BLOCK + 6)     /*!< Three whole blocks and a short tail */
+
+typedef struct
+{
+    const char *image;
+    size_t pos;
+} IMAGE_ARG;
+
+static const uint8_t ROW[] = {0xde, 0xad, 0xbe, 0xef};
+
+static int read_image(void *arg, uint8_t *buf, size_t len)
+{
+    IMAGE_ARG *image = (IMAGE_ARG *)arg;
+    size_t n = strlen(image->image + image->pos);
+
+    if (n > len)
+        n = len;
+    memcpy(buf, image->image + image->pos, n);
+    image->pos += n;
+    return n;
+}
+
+/**
+ * @brief S1 record writing ROW at the start of data flash
+ */
+static void make_srec(char *line, size_t size)
+{
+    uint8_t record[] = {(uint8_t)(3 + sizeof(ROW)), BQ40Z80_DF_START >> 8, BQ40Z80_DF_START & 0xff, 0, 0, 0, 0};
+    uint8_t sum = 0;
+    int n = 0;
+
+    memcpy(record + 3, ROW, sizeof(ROW));
+    n += snprintf(line + n, size - n, "S1");
+    for (size_t i = 0; i < sizeof(record); i++)
+    {
+        sum += record[i];
+        n += snprintf(line + n, size - n, "%02X", record[i]);
+    }
+    snprintf(line + n, size - n, "%02X\nS9030000FC\n", (uint8_t)~sum);
+}
+
+static esp_err_t run_flash(BQ40Z80 *bq, uint8_t format, uint16_t static_df, uint16_t all_df, BQ40Z80_FLASH_REPORT *report)
+{
+    static char srec[64];
+    // an empty FlashStream, only its signatures matter here
+    IMAGE_ARG image = {format == BQ40Z80_FLASH_SREC ? srec : "", 0};
+    BQ40Z80_FLASH_OPTIONS options;
+
+    make_srec(srec, sizeof(srec));
+    memset(&options, 0, sizeof(options));
+    options.format = format;
+    options.check_signatures = true;
+    options.instruction_signature = INSTRUCTION_SIGNATURE;
+    options.static_df_signature = static_df;
+    options.all_df_signature = all_df;
+    return bq->try_flash(read_image, &image, &options, report);
+}
+
+static void check_write_df()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    BQ40Z80_DF_REPORT report;
+    uint8_t image[IMAGE_LEN];
+    uint8_t back[IMAGE_LEN];
+    uint16_t signature = ALL_DF_SIGNATURE;
+
+    // one byte of block 0, all of block 1, nothing of block 2, two bytes of the tail
+    CHECK_EQ(bq.try_read_df(IMAGE_ADDRESS, image, sizeof(image)), ESP_OK);
+    image[3] ^= 0xff;
+    for (uint8_t i = 0; i < BQ40Z80_DF_BLOCK; i++)
+        image[BQ40Z80_DF_BLOCK + i] ^= 0xff;
+    image[3 * BQ40Z80_DF_BLOCK + 1] ^= 0xff;
+    image[3 * BQ40Z80_DF_BLOCK + 2] ^= 0xff;
+
+    CHECK_EQ(bq.try_write_df(IMAGE_ADDRESS, image, sizeof(image), &signature, &report), ESP_OK);
+    CHECK_EQ(report.blocks, 4);
+    CHECK_EQ(report.blocks_dirty, 3);
+    CHECK_EQ(report.writes, 4); // a whole block takes two writes of at most BQ40Z80_DF_WRITE_MAX
+    CHECK_EQ(report.bytes, 1 + BQ40Z80_DF_BLOCK + 2);
+    CHECK_EQ(report.signature, ALL_DF_SIGNATURE);
+    CHECK_EQ(bq.try_read_df(IMAGE_ADDRESS, back, sizeof(back)), ESP_OK);
+    CHECK(memcmp(back, image, sizeof(image)) == 0);
+
+    // the gauge already holds the image
+    CHECK_EQ(bq.try_write_df(IMAGE_ADDRESS, image, sizeof(image), &signature, &report), ESP_OK);
+    CHECK_EQ(report.blocks, 4);
+    CHECK_EQ(report.blocks_dirty, 0);
+    CHECK_EQ(report.writes, 0);
+    CHECK_EQ(report.bytes, 0);
+
+    signature = ALL_DF_SIGNATURE ^ 1;
+    CHECK_EQ(bq.try_write_df(IMAGE_ADDRESS, image, sizeof(image), &signature, &report), ESP_ERR_INVALID_CRC);
+    CHECK_EQ(report.signature, ALL_DF_SIGNATURE);
+
+    // a sealed gauge ACKs the write and keeps its flash
+    gauge.seal_df(true);
+    image[0] ^= 0xff;
+    CHECK_EQ(bq.try_write_df(IMAGE_ADDRESS, image, sizeof(image), NULL, &report), ESP_ERR_INVALID_RESPONSE);
+    CHECK_EQ(report.writes, 1);
+    CHECK_EQ(bq.try_read_df(IMAGE_ADDRESS, back, 1), ESP_OK);
+    CHECK(back[0] != image[0]);
+}
+
+static void check_srec()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    BQ40Z80_FLASH_REPORT report;
+    uint8_t df[sizeof(ROW)];
+
+    // a matching StaticDFSignature() says nothing of the calibration rows the image carries
+    CHECK_EQ(run_flash(&bq, BQ40Z80_FLASH_SREC, STATIC_DF_SIGNATURE, ALL_DF_SIGNATURE ^ 1, &report), ESP_ERR_INVALID_CRC);
+    CHECK(!report.skipped);
+    CHECK_EQ(report.rows, 1);
+    CHECK_EQ(report.bytes, sizeof(ROW));
+    CHECK_EQ(report.all_df_signature, ALL_DF_SIGNATURE);
+    CHECK_EQ(bq.try_read_df(BQ40Z80_DF_START, df, sizeof(df)), ESP_OK);
+    CHECK(memcmp(df, ROW, sizeof(ROW)) == 0);
+
+    // a matching AllDFSignature() skips the image whatever the static one
+    CHECK_EQ(run_flash(&bq, BQ40Z80_FLASH_SREC, STATIC_DF_SIGNATURE ^ 1, ALL_DF_SIGNATURE, &report), ESP_OK);
+    CHECK(report.skipped);
+    CHECK_EQ(report.writes, 0);
+}
+
+static void check_fs()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    BQ40Z80_FLASH_REPORT report;
+
+    CHECK_EQ(run_flash(&bq, BQ40Z80_FLASH_FS, STATIC_DF_SIGNATURE, ALL_DF_SIGNATURE ^ 1, &report), ESP_OK);
+    CHECK(report.skipped);
+    CHECK_EQ(report.static_df_signature, STATIC_DF_SIGNATURE);
+}
+
+int main()
+{
+    check_write_df();
+    check_srec();
+    check_fs();
+    return check_result("test_flash");
+}
@@ -0,0 +1,165 @@
+/**
+ * Linux transport against a fake /dev/i2c-N that applies the kernel's I2C_RDWR rules
+ */
+#include "fake_i2cdev.h"
+#include "check.h"
+
+#include <errno.h>
+
+static void check_reads(unsigned long funcs, bool pec)
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge, funcs);
+    FAKE_I2CDEV_COUNTERS counters;
+    BQ40Z80 bq((i2c_port_t)1);
+    uint16_t val;
+    OPERATION_STATUS operation;
+    SAFETY_STATUS safety;
+    DA_STATUS_1 da1;
+    FIRMWARE_VERSION firmware;
+
+    bq.set_cache_ttl(0);
+    bq.set_pec(pec);
+
+    CHECK_EQ(bq.try_get_voltage(&val), ESP_OK);
+    CHECK_EQ(val, 15616);
+    CHECK_EQ(bq.try_read_safety_status(&safety), ESP_OK);
+    CHECK_EQ(safety.raw, 0);
+    CHECK_EQ(bq.try_read_operation_status(&operation), ESP_OK);
+    CHECK_EQ(operation.raw, 0x0a000107);
+    CHECK_EQ(bq.try_get_device_type(&val), ESP_OK);
+    CHECK_EQ(val, 0x4800);
+    CHECK_EQ(bq.try_get_firmware_version(&firmware), ESP_OK);
+    CHECK_EQ(firmware.device_number, 0x4800);
+    CHECK_EQ(bq.try_read_da_status_1(&da1), ESP_OK);
+    CHECK_EQ(da1.cell_voltage_1, 3895);
+    CHECK_EQ(da1.average_power, -1852);
+
+    adapter.get_counters(&counters);
+    CHECK_EQ(counters.rejected, 0);
+}
+
+static void check_errors()
+{
+    FAKE_GAUGE gauge(0x0c);
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    int16_t temperature = 0x5a5a;
+    uint8_t rsoc = 0x5a;
+    uint16_t cell = 0x5a5a;
+    CHARGING_STATUS charging;
+    MANUFACTURING_STATUS manufacturing;
+
+    charging.raw = 0x5a5a5a;
+    manufacturing.raw = 0x5a5a;
+
+    // nobody answers at 0x0b, the outputs keep what the caller put there
+    CHECK(bq.try_get_temperature(&temperature) != ESP_OK);
+    CHECK_EQ(temperature, 0x5a5a);
+    CHECK(bq.try_get_rsoc(&rsoc) != ESP_OK);
+    CHECK_EQ(rsoc, 0x5a);
+    CHECK(bq.try_get_cell_voltage(5, &cell) != ESP_OK);
+    CHECK_EQ(cell, 0x5a5a);
+    CHECK(bq.try_read_charging_status(&charging) != ESP_OK);
+    CHECK_EQ(charging.raw, 0x5a5a5a);
+    CHECK(bq.try_read_manufacturing_status(&manufacturing) != ESP_OK);
+    CHECK_EQ(manufacturing.raw, 0x5a5a);
+}
+
+static void check_kernel_rules()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    uint8_t reg = BQ40Z80_SBS_SafetyStatus;
+    uint8_t raw[1 + I2C_SMBUS_BLOCK_MAX + 1] = {0};
+    struct i2c_msg msgs[2] = {
+        {0x0b, 0, 1, &reg},
+        {0x0b, I2C_M_RD | I2C_M_RECV_LEN, 0, raw},
+    };
+
+    // the setup the driver used to send: count and PEC slot as the length, buf[0] left at zero
+    msgs[1].len = 2;
+    CHECK_EQ(adapter.transfer(msgs, 2), EINVAL);
+    raw[0] = 2;
+    CHECK_EQ(adapter.transfer(msgs, 2), EINVAL);
+
+    // buf[0] set but no room for a full block behind it
+    msgs[1].len = 1 + I2C_SMBUS_BLOCK_MAX;
+    CHECK_EQ(adapter.transfer(msgs, 2), EINVAL);
+
+    // what i2c-dev accepts: the block, its count and the PEC, the length isn't written back
+    msgs[1].len = sizeof(raw);
+    CHECK_EQ(adapter.transfer(msgs, 2), 0);
+    CHECK_EQ(raw[0], 4);
+    CHECK_EQ(msgs[1].len, sizeof(raw));
+
+    // I2C_M_RECV_LEN on a write
+    msgs[0].flags |= I2C_M_RECV_LEN;
+    CHECK_EQ(adapter.transfer(msgs, 2), EINVAL);
+    msgs[0].flags = 0;
+
+    // a count the adapter refuses
+    static const uint8_t EMPTY[1] = {0};
+    gauge.set_block(BQ40Z80_SBS_ManufacturerName, EMPTY, 0);
+    reg = BQ40Z80_SBS_ManufacturerName;
+    raw[0] = 1;
+    CHECK_EQ(adapter.transfer(msgs, 2), EPROTO);
+
+    CHECK_EQ(adapter.transfer(msgs, 0), EINVAL);
+}
+
+static void check_pec_retry()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    uint16_t val = 0;
+    FAKE_GAUGE_COUNTERS counters;
+
+    bq.set_cache_ttl(0);
+    bq.set_pec(true);
+
+    // one corrupt frame is read again, the aborting API doesn't take it down
+    gauge.corrupt_reads(1);
+    CHECK_EQ(bq.get_voltage(), 15616);
+    gauge.corrupt_reads(1);
+    CHECK_EQ(bq.get_device_type(), 0x4800);
+
+    // corrupt every time: given up after the default attempts, the output untouched
+    gauge.corrupt_reads(BQ40Z80_CALL_DEFAULT_ATTEMPTS);
+    gauge.reset_counters();
+    CHECK_EQ(bq.try_get_voltage(&val), ESP_ERR_INVALID_CRC);
+    CHECK_EQ(val, 0);
+    gauge.get_counters(&counters);
+    CHECK_EQ(counters.transactions, BQ40Z80_CALL_DEFAULT_ATTEMPTS);
+
+}
+
+static void check_nack_once()
+{
+    FAKE_GAUGE gauge(0x0c);
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    FAKE_I2CDEV_COUNTERS counters;
+    uint16_t val;
+
+    // only a PEC error is read again without call options, a NACK is not
+    bq.set_pec(true);
+    adapter.reset_counters();
+    CHECK_EQ(bq.try_get_voltage(&val), ESP_FAIL);
+    adapter.get_counters(&counters);
+    CHECK_EQ(counters.ioctls, 1);
+}
+
+int main()
+{
+    check_kernel_rules();
+    check_errors();
+    check_reads(FAKE_I2CDEV_FUNCS, false);
+    check_reads(FAKE_I2CDEV_FUNCS, true);
+    check_reads(I2C_FUNC_I2C, false);
+    check_reads(I2C_FUNC_I2C, true);
+    check_pec_retry();
+    check_nack_once();
+    return check_result("test_i2cdev");
+}
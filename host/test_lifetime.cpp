@@ -0,0 +1,66 @@
+/**
+ * Lifetime blocks of the 7-cell gauge, decoded from the wire and read back through the MAC
+ */
+#include "fake_i2cdev.h"
+#include "check.h"
+
+static void check_layout()
+{
+    uint8_t raw[BQ40Z80_LIFETIME_BLOCK_MAX];
+    LIFETIME_DATA_1 lt1;
+    LIFETIME_DATA_5 lt5;
+
+    CHECK_EQ(bq40z80_lifetime_size(1), 32);
+    CHECK_EQ(bq40z80_lifetime_size(5), 32);
+
+    // word i of block 1 is i + 1 (mV), Max Charge Current closes the block at bytes 30-31
+    for (uint8_t i = 0; i < 16; i++)
+    {
+        raw[2 * i] = i + 1;
+        raw[2 * i + 1] = 0;
+    }
+    raw[30] = 0x18;
+    raw[31] = 0xfc;
+    bq40z80_lifetime_decode(1, raw, &lt1);
+    CHECK_EQ(lt1.cell_7_max_voltage, 7);
+    CHECK_EQ(lt1.cell_1_min_voltage, 8);
+    CHECK_EQ(lt1.cell_7_min_voltage, 14);
+    CHECK_EQ(lt1.max_delta_cell_voltage, 15);
+    CHECK_EQ(lt1.max_charge_current, -1000);
+
+    // four reset counters, then the balancing time of cells 1 to 7
+    memset(raw, 0, sizeof(raw));
+    raw[3] = 2;
+    raw[4 + 6 * 4] = 0x10;
+    raw[4 + 6 * 4 + 1] = 0x0e;
+    bq40z80_lifetime_decode(5, raw, &lt5);
+    CHECK_EQ(lt5.wdt_resets, 2);
+    CHECK_EQ(lt5.cb_time_cell_7, 3600);
+
+    uint8_t back[BQ40Z80_LIFETIME_BLOCK_MAX] = {0};
+    bq40z80_lifetime_encode(5, &lt5, back);
+    CHECK(memcmp(raw, back, 32) == 0);
+}
+
+static void check_read()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    uint8_t raw[32];
+    LIFETIME_DATA_1 lt1;
+
+    for (uint8_t i = 0; i < 32; i++)
+        raw[i] = i;
+    gauge.set_mfa(BQ40Z80_MFA_LIFETIME_DATA_BLOCK_1, raw, 32);
+    CHECK_EQ(bq.try_read_lifetime_data_1(&lt1), ESP_OK);
+    CHECK_EQ(lt1.cell_7_min_voltage, 0x1b1a);
+    CHECK_EQ(lt1.max_charge_current, 0x1f1e);
+}
+
+int main()
+{
+    check_layout();
+    check_read();
+    return check_result("test_lifetime");
+}
@@ -0,0 +1,75 @@
+/**
+ * Poller against the register cache, a sample must hold the values of the time it was taken
+ */
+#include <thread>
+
+#include "bq40z80_poller.h"
+#include "fake_i2cdev.h"
+#include "check.h"
+
+static const bq40z80_field_mask_t FIELDS = BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_VOLTAGE) | BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_CURRENT);
+
+static void check_fixed_period(FAKE_GAUGE *gauge, BQ40Z80 *bq)
+{
+    BQ40Z80_POLLER poller(bq, FIELDS, 100);
+    BQ40Z80_SNAPSHOT snapshot;
+
+    CHECK_EQ(poller.poll_once(), ESP_OK);
+    CHECK(poller.read(&snapshot));
+    CHECK_EQ(snapshot.telemetry.current, -1203);
+
+    // well within the default cache TTL
+    gauge->set_word(BQ40Z80_SBS_Current, (uint16_t)-1500);
+    CHECK_EQ(poller.poll_once(), ESP_OK);
+    CHECK(poller.read(&snapshot));
+    CHECK_EQ(snapshot.sequence, 2);
+    CHECK_EQ(snapshot.telemetry.current, -1500);
+}
+
+static void check_long_period(BQ40Z80 *bq)
+{
+    // 2^29 ms is 2^32 * 125 us, a 32-bit product wraps to a deadline of now
+    BQ40Z80_POLLER poller(bq, FIELDS, 536870912);
+    BQ40Z80_SNAPSHOT snapshot;
+
+    CHECK_EQ(poller.poll_once(), ESP_OK);
+    CHECK(poller.read(&snapshot));
+    CHECK_EQ(snapshot.telemetry.voltage, 15616);
+}
+
+static void check_scheduled(FAKE_GAUGE *gauge, BQ40Z80 *bq)
+{
+    BQ40Z80_SCHEDULE schedule;
+    bq40z80_schedule_default(&schedule);
+    BQ40Z80_SCHEDULER scheduler(&schedule);
+    BQ40Z80_POLLER poller(bq, FIELDS, 50);
+    BQ40Z80_SCHEDULER_STATS stats;
+    BQ40Z80_SNAPSHOT snapshot;
+    poller.set_scheduler(&scheduler);
+
+    // above active_current_ma, the state fields are due every 250 ms
+    gauge->set_word(BQ40Z80_SBS_Current, (uint16_t)-1203);
+    CHECK_EQ(poller.poll_once(), ESP_OK);
+    scheduler.get_stats(&stats);
+    CHECK_EQ(stats.state, BQ40Z80_SCHED_ACTIVE);
+
+    gauge->set_word(BQ40Z80_SBS_Current, (uint16_t)-900);
+    std::this_thread::sleep_for(std::chrono::milliseconds(schedule.period_ms[BQ40Z80_SCHED_ACTIVE]));
+    CHECK_EQ(poller.poll_once(), ESP_OK);
+    CHECK(poller.read(&snapshot));
+    CHECK(snapshot.telemetry.valid & BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_CURRENT));
+    CHECK_EQ(snapshot.telemetry.current, -900);
+}
+
+int main()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+
+    check_fixed_period(&gauge, &bq);
+    check_long_period(&bq);
+    check_scheduled(&gauge, &bq);
+
+    return check_result("test_poller");
+}
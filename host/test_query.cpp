@@ -0,0 +1,89 @@
+/**
+ * Query planner: a single cell of DAStatus1() is one SBS block read, all seven cells take DAStatus1()
+ * and the SBS words of cells 5..7, a mix of cells, temperatures and a word reads each source once. The
+ * estimated clocks of every plan are the clocks the call puts on the wire.
+ */
+#include "fake_i2cdev.h"
+#include "check.h"
+
+#define CALL_TIMEOUT_US 100000 /*!< Budget of each query */
+#define WORD_CLOCKS (5 * 9 + 3)
+#define BLOCK_CLOCKS(len) ((4 + (len)) * 9 + 3)
+
+/**
+ * @brief Plan a field set, run it against the fake gauge and compare the plan with the wire
+ */
+static void run_plan(BQ40Z80 *bq, bq40z80_field_mask_t fields, uint8_t steps, uint32_t clocks, uint32_t bytes, BQ40Z80_TELEMETRY *data)
+{
+    BQ40Z80_QUERY_PLAN plan;
+    BQ40Z80_CALL call = bq40z80_call_within(CALL_TIMEOUT_US, 0);
+
+    bq40z80_plan_query(fields, &plan);
+    CHECK_EQ(plan.fields, fields);
+    CHECK_EQ(plan.provided & fields, fields);
+    CHECK_EQ(plan.n_steps, steps);
+    CHECK_EQ(plan.cost_clocks, clocks);
+
+    call.fresh = true;
+    CHECK_EQ(bq->try_read_fields(&plan, data, &call), ESP_OK);
+    CHECK_EQ(data->valid, plan.provided);
+    CHECK_EQ(call.transactions, steps);
+    CHECK_EQ(call.bytes, bytes);
+    CHECK_EQ(call.clocks, clocks);
+}
+
+static void check_single_cell(BQ40Z80 *bq)
+{
+    BQ40Z80_TELEMETRY data;
+    uint16_t mv;
+
+    // DAStatus1() as an SBS block beats the ManufacturerBlockAccess() round trip
+    run_plan(bq, BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_CELL_VOLTAGE_1), 1, BLOCK_CLOCKS(32), 4 + 32, &data);
+    CHECK_EQ(data.cell_voltage[0], 3895);
+    CHECK_EQ(data.bat_voltage, 15601);
+
+    // cell 4 has its own word
+    run_plan(bq, BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_CELL_VOLTAGE_4), 1, WORD_CLOCKS, 5, &data);
+    CHECK_EQ(data.cell_voltage[3], 3904);
+
+    BQ40Z80_CALL call = bq40z80_call_within(CALL_TIMEOUT_US, 0);
+    CHECK_EQ(bq->try_get_cell_voltage(2, &mv, &call), ESP_OK);
+    CHECK_EQ(mv, 3901);
+    CHECK_EQ(call.transactions, 1);
+}
+
+static void check_all_cells(BQ40Z80 *bq)
+{
+    BQ40Z80_TELEMETRY data;
+    static const uint16_t CELLS_MV[] = {3895, 3901, 3897, 3904, 0, 0, 0};
+
+    // three words for cells 5..7 are cheaper than DAStatus3()
+    run_plan(bq, BQ40Z80_FIELD_MASK_CELL_VOLTAGES, 4, BLOCK_CLOCKS(32) + 3 * WORD_CLOCKS, 4 + 32 + 3 * 5, &data);
+    for (uint8_t i = 0; i < 7; i++)
+        CHECK_EQ(data.cell_voltage[i], CELLS_MV[i]);
+}
+
+static void check_mixed(BQ40Z80 *bq)
+{
+    BQ40Z80_TELEMETRY data;
+    bq40z80_field_mask_t fields = BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_CELL_VOLTAGE_2) | BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_PACK_VOLTAGE) |
+                                  BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_TS1_TEMPERATURE) | BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_VOLTAGE);
+
+    run_plan(bq, fields, 3, BLOCK_CLOCKS(32) + BLOCK_CLOCKS(16) + WORD_CLOCKS, 4 + 32 + 4 + 16 + 5, &data);
+    CHECK_EQ(data.cell_voltage[1], 3901);
+    CHECK_EQ(data.pack_voltage, 15590);
+    CHECK_EQ(data.ts_temperature[0], 2982);
+    CHECK_EQ(data.voltage, 15616);
+}
+
+int main()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+
+    check_single_cell(&bq);
+    check_all_cells(&bq);
+    check_mixed(&bq);
+    return check_result("test_query");
+}
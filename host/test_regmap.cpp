@@ -0,0 +1,53 @@
+/**
+ * Register descriptors: a read into the value type of another quantity must not compile, the getters
+ * decode what the fake 4S pack reports
+ */
+#include <type_traits>
+
+#include "fake_i2cdev.h"
+#include "check.h"
+
+/**
+ * @brief try_read<REG>() accepts an output of type T
+ */
+template <typename REG, typename T>
+static constexpr bool readable_as()
+{
+    return std::is_invocable<decltype(&BQ40Z80::try_read<REG>), BQ40Z80 *, T *, BQ40Z80_CALL *>::value;
+}
+
+static_assert(readable_as<BQ40Z80_REG_Temperature, BQ40Z80_TEMPERATURE>(), "temperature into its own type");
+static_assert(!readable_as<BQ40Z80_REG_Voltage, BQ40Z80_TEMPERATURE>(), "voltage into a temperature");
+static_assert(!readable_as<BQ40Z80_REG_Temperature, BQ40Z80_VOLTAGE>(), "temperature into a voltage");
+static_assert(!readable_as<BQ40Z80_REG_Temperature, uint16_t>(), "temperature into a raw word");
+static_assert(!readable_as<BQ40Z80_REG_Current, BQ40Z80_VOLTAGE>(), "current into a voltage");
+static_assert(!readable_as<BQ40Z80_REG_Current, int16_t>(), "current into a raw word");
+static_assert(!readable_as<BQ40Z80_REG_CurrentLong, BQ40Z80_CURRENT>(), "CurrentLong into a 16-bit current");
+static_assert(!readable_as<BQ40Z80_REG_RemainingCapacity, BQ40Z80_VOLTAGE>(), "capacity into a voltage");
+static_assert(!readable_as<BQ40Z80_REG_DesignVoltage, BQ40Z80_CAPACITY>(), "voltage into a capacity");
+static_assert(!readable_as<BQ40Z80_REG_RelativeStateOfCharge, BQ40Z80_MINUTES>(), "percentage into minutes");
+static_assert(readable_as<BQ40Z80_REG_CellVoltage4, BQ40Z80_VOLTAGE>(), "cell voltage into a voltage");
+static_assert(readable_as<BQ40Z80_REG_CycleCount, uint16_t>(), "raw words stay raw");
+static_assert(sizeof(BQ40Z80_CURRENT_LONG) == BQ40Z80_REG_CurrentLong::len, "quantity types keep the wire size");
+
+int main()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    BQ40Z80_TEMPERATURE temperature;
+    BQ40Z80_CURRENT current;
+    int16_t celsius;
+    uint16_t mv;
+
+    CHECK_EQ(bq.try_read<BQ40Z80_REG_Temperature>(&temperature), ESP_OK);
+    CHECK_EQ(temperature.dk, 2982);
+    CHECK_EQ(bq.try_get_temperature(&celsius), ESP_OK);
+    CHECK_EQ(celsius, 250);
+    CHECK_EQ(bq.try_get_voltage(&mv), ESP_OK);
+    CHECK_EQ(mv, 15616);
+    current = bq.read<BQ40Z80_REG_Current>();
+    CHECK_EQ(current.ma, -1203);
+
+    return check_result("test_regmap");
+}
@@ -0,0 +1,106 @@
+/**
+ * High-rate current sampling: the CurrentLong() probe and the fallback to Current(), the charge and
+ * energy integrals of a constant current, the spacing statistics of a paced run and the error limit
+ */
+#include "fake_i2cdev.h"
+#include "check.h"
+
+#define SAMPLES 64
+#define INTERVAL_US 500   /*!< Grid of the paced run */
+#define VOLTAGE_MV 15616  /*!< Voltage() of the fake pack */
+#define CURRENT_MA -1203  /*!< Current() of the fake pack */
+#define CURRENT_LONG_MA -40000 /*!< CurrentLong() once the fake pack reports it, beyond Current() */
+
+/**
+ * @brief A constant current integrates to current * elapsed, the energy follows the voltage
+ */
+static void check_integrals(const BQ40Z80_CURRENT_SAMPLE *samples, const BQ40Z80_SAMPLING_REPORT *report, int32_t current_ma)
+{
+    CHECK_EQ(report->samples, SAMPLES);
+    CHECK_EQ(report->errors, 0);
+    CHECK_EQ(report->voltage_mv, VOLTAGE_MV);
+    for (uint32_t i = 0; i < report->samples; i++)
+        CHECK_EQ(samples[i].current_ma, current_ma);
+    CHECK_EQ(report->elapsed_us, samples[SAMPLES - 1].timestamp_us - samples[0].timestamp_us);
+    CHECK_EQ(report->charge_nc, (int64_t)current_ma * report->elapsed_us);
+    CHECK_EQ(report->energy_nj, report->charge_nc * VOLTAGE_MV / 1000);
+}
+
+static void check_current()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    BQ40Z80_CURRENT_SAMPLE samples[SAMPLES];
+    BQ40Z80_SAMPLING_REPORT report;
+
+    // the pack has no CurrentLong(), the probe NACKs and the run reads Current()
+    gauge.drop(BQ40Z80_SBS_CurrentLong);
+    CHECK_EQ(bq.try_sample_current(samples, SAMPLES, NULL, &report), ESP_OK);
+    CHECK(!report.current_long);
+    check_integrals(samples, &report, CURRENT_MA);
+    CHECK(report.rate_hz > 0);
+}
+
+static void check_current_long()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    BQ40Z80_CURRENT_SAMPLE samples[SAMPLES];
+    BQ40Z80_SAMPLING_OPTIONS options = {INTERVAL_US, 16};
+    BQ40Z80_SAMPLING_REPORT report;
+    uint8_t raw[4];
+
+    for (uint8_t i = 0; i < sizeof(raw); i++)
+        raw[i] = (uint32_t)CURRENT_LONG_MA >> (8 * i);
+    gauge.set_mfa(BQ40Z80_MFA_CURRENT_LONG, raw, sizeof(raw));
+
+    CHECK_EQ(bq.try_sample_current(samples, SAMPLES, &options, &report), ESP_OK);
+    CHECK(report.current_long);
+    check_integrals(samples, &report, CURRENT_LONG_MA);
+
+    // a fixed grid: the mean spacing is the interval, a late sample is followed by an early one
+    CHECK(report.interval_min_us <= report.elapsed_us / (SAMPLES - 1));
+    CHECK(report.interval_max_us >= report.elapsed_us / (SAMPLES - 1));
+    CHECK(report.elapsed_us >= (SAMPLES - 2) * INTERVAL_US);
+    CHECK(report.jitter_us <= report.interval_max_us - report.interval_min_us);
+    CHECK(report.rate_hz <= 1000000 / INTERVAL_US + 1000000 / INTERVAL_US / 10);
+    for (uint32_t i = 1; i < report.samples; i++)
+        CHECK(samples[i].timestamp_us > samples[i - 1].timestamp_us);
+}
+
+static void check_errors()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    BQ40Z80_CURRENT_SAMPLE samples[SAMPLES];
+    BQ40Z80_SAMPLING_REPORT report;
+    uint16_t voltage_mv;
+
+    // Voltage() stays cached and Current() has no probe before it, the corrupt frames hit the samples only
+    gauge.drop(BQ40Z80_SBS_CurrentLong);
+    bq.set_pec(true);
+    CHECK_EQ(bq.try_get_voltage(&voltage_mv), ESP_OK);
+
+    // a few bad frames are skipped without retry, the run goes on
+    gauge.corrupt_reads(3);
+    CHECK_EQ(bq.try_sample_current(samples, SAMPLES, NULL, &report), ESP_OK);
+    CHECK_EQ(report.errors, 3);
+    CHECK_EQ(report.samples, SAMPLES);
+
+    gauge.corrupt_reads(UINT32_MAX);
+    CHECK_EQ(bq.try_sample_current(samples, SAMPLES, NULL, &report), ESP_ERR_INVALID_CRC);
+    CHECK_EQ(report.errors, BQ40Z80_SAMPLING_ERRORS_MAX);
+    CHECK_EQ(report.samples, 0);
+    CHECK_EQ(report.charge_nc, 0);
+}
+
+int main()
+{
+    check_current();
+    check_current_long();
+    check_errors();
+    return check_result("test_sampling");
+}
@@ -0,0 +1,125 @@
+/**
+ * The pack simulator against the kernel's I2C_RDWR rules: the checks of i2c-dev, the kernel-side length of
+ * an I2C_M_RECV_LEN read and a MAC command run on the STOP, then the driver on top of it
+ */
+#include "bq40z80_sim.h"
+#include "check.h"
+
+#include <errno.h>
+#include <linux/i2c.h>
+
+static void check_kernel_rules(BQ40Z80_SIM *sim)
+{
+    BQ40Z80_SIM_COUNTERS before, after;
+    uint8_t reg = BQ40Z80_SBS_SafetyStatus;
+    uint8_t raw[2 + I2C_SMBUS_BLOCK_MAX] = {0};
+    struct i2c_msg msgs[2] = {
+        {0x0b, 0, 1, &reg},
+        {0x0b, I2C_M_RD | I2C_M_RECV_LEN, 0, raw},
+    };
+
+    sim->get_counters(&before);
+
+    // count and PEC slot as the length, buf[0] left at zero, then set
+    msgs[1].len = 2;
+    CHECK_EQ(sim->rdwr(0, msgs, 2), EINVAL);
+    raw[0] = 2;
+    CHECK_EQ(sim->rdwr(0, msgs, 2), EINVAL);
+
+    // no room for a full block behind buf[0]
+    msgs[1].len = 1 + I2C_SMBUS_BLOCK_MAX;
+    CHECK_EQ(sim->rdwr(0, msgs, 2), EINVAL);
+
+    // only a read can take its length from the device
+    msgs[1].len = sizeof(raw);
+    msgs[1].flags = I2C_M_RECV_LEN;
+    CHECK_EQ(sim->rdwr(0, msgs, 2), EINVAL);
+    CHECK_EQ(sim->rdwr(0, msgs, 0), EINVAL);
+
+    sim->get_counters(&after);
+    CHECK_EQ(after.rejected - before.rejected, 5);
+    CHECK_EQ(after.transactions - before.transactions, 0);
+
+    // count, four bytes and the PEC, the extended length stays on the kernel side
+    msgs[1].flags = I2C_M_RD | I2C_M_RECV_LEN;
+    raw[0] = 2;
+    CHECK_EQ(sim->rdwr(0, msgs, 2), 0);
+    CHECK_EQ(msgs[1].len, sizeof(raw));
+    CHECK_EQ(raw[0], 4);
+    CHECK_EQ(raw[6], 0); // nothing copied back past the PEC
+
+    // a count of zero is a protocol error of the adapter, 0x7f answers with an empty block
+    reg = 0x7f;
+    raw[0] = 1;
+    CHECK_EQ(sim->rdwr(0, msgs, 2), EPROTO);
+}
+
+static void check_mac_at_stop(BQ40Z80_SIM *sim)
+{
+    uint8_t cmd[4] = {BQ40Z80_SBS_ManufacturerBlockAccess, 2, BQ40Z80_MFA_DEVICE_TYPE & 0xff, BQ40Z80_MFA_DEVICE_TYPE >> 8};
+    uint8_t reg = BQ40Z80_SBS_ManufacturerBlockAccess;
+    uint8_t raw[2 + I2C_SMBUS_BLOCK_MAX] = {1};
+    struct i2c_msg msgs[3] = {
+        {0x0b, 0, sizeof(cmd), cmd},
+        {0x0b, 0, 1, &reg},
+        {0x0b, I2C_M_RD | I2C_M_RECV_LEN, sizeof(raw), raw},
+    };
+
+    // written and read back within one transaction: the command hasn't run yet, the echo is the previous one
+    CHECK_EQ(sim->rdwr(0, msgs, 3), 0);
+    CHECK(raw[1] != (BQ40Z80_MFA_DEVICE_TYPE & 0xff) || raw[2] != (BQ40Z80_MFA_DEVICE_TYPE >> 8));
+
+    raw[0] = 1;
+    CHECK_EQ(sim->rdwr(0, msgs + 1, 2), 0);
+    CHECK_EQ(raw[0], BQ40Z80_MFA_ECHO_LEN + 2);
+    CHECK_EQ(raw[1] | (raw[2] << 8), BQ40Z80_MFA_DEVICE_TYPE);
+    CHECK_EQ(raw[3] | (raw[4] << 8), 0x4800);
+}
+
+static void check_driver(BQ40Z80_SIM *sim, bool pec)
+{
+    BQ40Z80_SIM_COUNTERS counters;
+    BQ40Z80 bq((i2c_port_t)0);
+    uint16_t val;
+    FIRMWARE_VERSION firmware;
+    DA_STATUS_1 da1;
+
+    bq.set_cache_ttl(0);
+    bq.set_pec(pec);
+
+    CHECK_EQ(bq.try_get_voltage(&val), ESP_OK);
+    CHECK(val > 4 * 3000 && val < 4 * 4200);
+    CHECK_EQ(bq.try_get_device_type(&val), ESP_OK);
+    CHECK_EQ(val, 0x4800);
+    CHECK_EQ(bq.try_get_firmware_version(&firmware), ESP_OK);
+    CHECK_EQ(firmware.device_number, 0x4800);
+    CHECK_EQ(bq.try_read_da_status_1(&da1), ESP_OK);
+    CHECK_EQ(da1.pack_voltage, da1.bat_voltage);
+    CHECK_EQ(da1.cell_current_1, 0);
+
+    sim->get_counters(&counters);
+    CHECK_EQ(counters.pec_errors, 0);
+}
+
+int main()
+{
+    BQ40Z80_SIM_TIMING timing;
+    BQ40Z80_SIM_PACK pack;
+    BQ40Z80_SIM_COUNTERS before, after;
+
+    BQ40Z80_SIM::default_timing(&timing);
+    BQ40Z80_SIM::default_pack(&pack);
+    BQ40Z80_SIM sim(&timing);
+    CHECK_EQ(sim.add_pack(0, BQ40Z80_BUS_NO_MUX, &pack), ESP_OK);
+
+    check_kernel_rules(&sim);
+    check_mac_at_stop(&sim);
+
+    sim.get_counters(&before);
+    check_driver(&sim, false);
+    check_driver(&sim, true);
+    sim.get_counters(&after);
+    CHECK_EQ(after.rejected, before.rejected);
+
+    return check_result("test_sim");
+}
@@ -0,0 +1,73 @@
+/**
+ * SMBus clock negotiation against the adapter clock of the device tree
+ */
+#include "fake_i2cdev.h"
+#include "check.h"
+
+static void set_xl(FAKE_GAUGE *gauge, bool xl)
+{
+    uint32_t status = 0x0a000107 | (xl ? 1UL << 22 : 0);
+    uint8_t raw[4] = {(uint8_t)status, (uint8_t)(status >> 8), (uint8_t)(status >> 16), (uint8_t)(status >> 24)};
+    gauge->set_mfa(BQ40Z80_MFA_OPERATION_STATUS, raw, 4);
+}
+
+static void check_standalone()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+
+    // no clock-frequency property, the kernel runs the adapter at 100 kHz
+    {
+        BQ40Z80 bq((i2c_port_t)1);
+        CHECK_EQ(bq.get_bus_speed(), BQ40Z80_BUS_FREQ_STD_HZ);
+        CHECK_EQ(bq.try_negotiate_bus_speed(), ESP_OK);
+    }
+
+    // a 400 kHz adapter is too fast for a gauge without XL
+    adapter.set_clock(400000);
+    {
+        BQ40Z80 bq((i2c_port_t)1);
+        bq.set_cache_ttl(0);
+        CHECK_EQ(bq.get_bus_speed(), 400000);
+        CHECK_EQ(bq.try_negotiate_bus_speed(), ESP_ERR_NOT_SUPPORTED);
+        set_xl(&gauge, true);
+        CHECK_EQ(bq.try_negotiate_bus_speed(), ESP_OK);
+        CHECK_EQ(bq.get_bus_speed(), 400000);
+    }
+}
+
+static void check_shared()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+
+    adapter.set_clock(400000);
+    set_xl(&gauge, true);
+    BQ40Z80_BUS bus((i2c_port_t)1);
+    CHECK_EQ(bus.get_bus_speed(), 400000);
+
+    BQ40Z80 fast(&bus, BQ40Z80_BUS_NO_MUX);
+    fast.set_cache_ttl(0);
+    CHECK_EQ(fast.get_bus_speed(), 400000);
+    CHECK_EQ(fast.try_negotiate_bus_speed(), ESP_OK);
+
+    // the slowest gauge decides for the whole bus, the adapter can't follow it down
+    set_xl(&gauge, false);
+    {
+        BQ40Z80 slow(&bus, BQ40Z80_BUS_NO_MUX);
+        slow.set_cache_ttl(0);
+        CHECK_EQ(slow.try_negotiate_bus_speed(), ESP_ERR_NOT_SUPPORTED);
+        CHECK_EQ(slow.get_bus_speed(), 400000);
+    }
+
+    // once the slow gauge is gone the rest negotiates again
+    set_xl(&gauge, true);
+    CHECK_EQ(fast.try_negotiate_bus_speed(), ESP_OK);
+}
+
+int main()
+{
+    check_standalone();
+    check_shared();
+    return check_result("test_speed");
+}
@@ -0,0 +1,117 @@
+/**
+ * Bus counters after a scripted sequence: clean reads, a frame read again after its PEC failed, a read
+ * that runs out of attempts and an MFA block, then their JSON Lines export
+ */
+#include "fake_i2cdev.h"
+#include "check.h"
+
+#define CALL_TIMEOUT_US 100000 /*!< Budget of each read, room for every back-off */
+
+static BQ40Z80_CALL fresh()
+{
+    BQ40Z80_CALL call = bq40z80_call_within(CALL_TIMEOUT_US, 0);
+    call.fresh = true;
+    return call;
+}
+
+static const BQ40Z80_CMD_STATS *find(const BQ40Z80_STATS *stats, uint8_t kind, uint16_t command)
+{
+    for (uint32_t i = 0; i < BQ40Z80_STATS_MAX_COMMANDS; i++)
+        if (stats->commands[i].kind == kind && stats->commands[i].command == command)
+            return &stats->commands[i];
+    return NULL;
+}
+
+/**
+ * @brief Counters of one command, the histogram holds every transaction at or above the first bucket given
+ */
+static void check_command(const BQ40Z80_STATS *stats, uint8_t kind, uint16_t command, uint32_t transactions, uint32_t errors,
+                          uint32_t retries, uint64_t bytes, uint64_t clocks, uint32_t min_bucket)
+{
+    const BQ40Z80_CMD_STATS *s = find(stats, kind, command);
+    uint32_t hist = 0;
+
+    CHECK(s != NULL);
+    if (s == NULL)
+        return;
+    CHECK_EQ(s->transactions, transactions);
+    CHECK_EQ(s->errors, errors);
+    CHECK_EQ(s->retries, retries);
+    CHECK_EQ(s->bytes, bytes);
+    CHECK_EQ(s->clocks, clocks);
+    for (uint32_t i = min_bucket; i < BQ40Z80_STATS_LATENCY_BUCKETS; i++)
+        hist += s->latency_hist[i];
+    CHECK_EQ(hist, transactions);
+    if (min_bucket > 0)
+        CHECK(s->latency_max_us >= (uint32_t)BQ40Z80_STATS_LATENCY_FIRST_US << (min_bucket - 1));
+}
+
+int main()
+{
+    FAKE_GAUGE gauge;
+    FAKE_I2CDEV adapter(&gauge);
+    BQ40Z80 bq((i2c_port_t)1);
+    BQ40Z80_STATS stats;
+    BQ40Z80_CALL call;
+    static char json[BQ40Z80_STATS_MAX_COMMANDS * 256];
+    char small[16];
+    DA_STATUS_1 da1;
+    uint16_t voltage;
+    int16_t current;
+    int16_t temperature;
+
+    bq.set_pec(true);
+    bq.reset_stats();
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        call = fresh();
+        CHECK_EQ(bq.try_get_voltage(&voltage, &call), ESP_OK);
+    }
+
+    // read again after a 500 us back-off
+    gauge.corrupt_reads(1);
+    call = fresh();
+    CHECK_EQ(bq.try_get_current(&current, &call), ESP_OK);
+
+    // three attempts with 500 and 1000 us back-offs between them
+    gauge.corrupt_reads(UINT32_MAX);
+    call = fresh();
+    CHECK_EQ(bq.try_get_temperature(&temperature, &call), ESP_ERR_INVALID_CRC);
+    gauge.corrupt_reads(0);
+
+    call = fresh();
+    CHECK_EQ(bq.try_read_da_status_1(&da1, &call), ESP_OK);
+
+    // S addr+W, cmd, Sr addr+R, lo, hi, PEC, P is 6 bytes and 57 clocks per attempt
+    bq.get_stats(&stats);
+    CHECK_EQ(stats.dropped, 0);
+    check_command(&stats, BQ40Z80_STATS_KIND_SBS, BQ40Z80_SBS_Voltage, 2, 0, 0, 2 * 6, 2 * 57, 0);
+    check_command(&stats, BQ40Z80_STATS_KIND_SBS, BQ40Z80_SBS_Current, 1, 0, 1, 2 * 6, 2 * 57, 2);
+    check_command(&stats, BQ40Z80_STATS_KIND_SBS, BQ40Z80_SBS_Temperature, 1, 1, 2, 3 * 6, 3 * 57, 4);
+    // the MFA write and the ManufacturerData() read, with a PEC each
+    check_command(&stats, BQ40Z80_STATS_KIND_MFA, BQ40Z80_MFA_DA_STATUS_1, 1, 0, 0, 5 + 6 + 32 + 2, (5 + 6 + 32 + 2) * 9 + 5, 0);
+
+    size_t len = bq40z80_stats_export(&stats, NULL, 0);
+    CHECK_EQ(bq40z80_stats_export(&stats, json, sizeof(json)), len);
+    CHECK_EQ(strlen(json), len);
+    CHECK(strstr(json, "{\"kind\":\"sbs\",\"command\":9,\"transactions\":2,\"errors\":0,\"retries\":0,\"bytes\":12,\"clocks\":114,"
+                       "\"wire_us_50k\":2280,\"wire_us_100k\":1140,\"wire_us_400k\":285,") != NULL);
+    CHECK(strstr(json, "{\"kind\":\"sbs\",\"command\":8,\"transactions\":1,\"errors\":1,\"retries\":2,\"bytes\":18,") != NULL);
+    CHECK(strstr(json, "{\"kind\":\"mfa\",\"command\":113,\"transactions\":1,\"errors\":0,\"retries\":0,\"bytes\":45,") != NULL);
+    CHECK(len >= strlen("{\"dropped\":0}\n") && strcmp(json + len - strlen("{\"dropped\":0}\n"), "{\"dropped\":0}\n") == 0);
+    size_t lines = 0;
+    for (size_t i = 0; i < len; i++)
+        lines += json[i] == '\n';
+    CHECK_EQ(lines, 5);
+
+    // a short buffer is cut and terminated, the result still sizes the whole export
+    CHECK_EQ(bq40z80_stats_export(&stats, small, sizeof(small)), len);
+    CHECK_EQ(strlen(small), sizeof(small) - 1);
+
+    bq.reset_stats();
+    bq.get_stats(&stats);
+    CHECK(find(&stats, BQ40Z80_STATS_KIND_SBS, BQ40Z80_SBS_Voltage) == NULL);
+
+    return check_result("test_stats");
+}
@@ -14,17 +14,73 @@ extern "C"
 #include "bq40z80_sbs.h"
 #include "bq40z80_mfa.h"
 #include "bq40z80_registers.h"
-#include "driver/i2c.h"
-#include "esp_log.h"
+#include "bq40z80_query.h"
+#include "bq40z80_stats.h"
+#include "bq40z80_cache.h"
+#include "bq40z80_call.h"
+#include "bq40z80_pec.h"
+#include "bq40z80_bus.h"
+#include "bq40z80_regmap.h"
+#include "bq40z80_events.h"
+#include "bq40z80_df.h"
+#include "bq40z80_lifetime.h"
+#include "bq40z80_auth.h"
+#include "bq40z80_flash.h"
+#include "bq40z80_sampling.h"
+#include "bq40z80_cells.h"
+#include "bq40z80_port.h"
 
-#define I2C_MASTER_FREQ_HZ 50000    /*!< I2C master clock frequency */
-#define I2C_MASTER_TX_BUF_DISABLE 0 /*!< I2C master doesn't need buffer */
-#define I2C_MASTER_RX_BUF_DISABLE 0 /*!< I2C master doesn't need buffer */
-#define I2C_MASTER_TIMEOUT_TICK 1000 / portTICK_PERIOD_MS
+#define I2C_MASTER_FREQ_HZ 50000       /*!< I2C master clock frequency */
+#define I2C_MASTER_TX_BUF_DISABLE 0    /*!< I2C master doesn't need buffer */
+#define I2C_MASTER_RX_BUF_DISABLE 0    /*!< I2C master doesn't need buffer */
+#define I2C_MASTER_TIMEOUT_MS 1000     /*!< Transaction timeout of the aborting API */
+#define BQ40Z80_BUS_FREQ_XL_HZ 400000  /*!< SMBus clock once the gauge reports OperationStatus()[XL] */
+#define BQ40Z80_BUS_FREQ_STD_HZ 100000 /*!< SMBus clock of a gauge without OperationStatus()[XL] */
+#define BQ40Z80_BUS_FALLBACK_ERRORS 3  /*!< Consecutive failed attempts before stepping down the SMBus clock */
+#define BQ40Z80_SMBUS_BLOCK_MAX 32     /*!< Longest SMBus block, excluding the count byte */
+#define BQ40Z80_MFA_ECHO_LEN 2         /*!< ManufacturerData() repeats the MFA command before the data */
+#if !defined(BQ40Z80_TRANSPORT_LINUX)
+#define I2C_MASTER_TIMEOUT_TICK I2C_MASTER_TIMEOUT_MS / portTICK_PERIOD_MS
+#define I2C_MASTER_CMD_OPS 16 /*!< Most START/write/read/STOP operations queued by one transaction */
+#endif
+
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+    struct i2c_msg;
+
+    /**
+     * @brief System calls used by the i2c-dev transport
+     * @note Replace them with bq40z80_linux_set_io() to run the driver against an in-process fake of /dev/i2c-N.
+     *       read() only serves the adapter clock in /sys/bus/i2c/devices/i2c-N/of_node/clock-frequency.
+     */
+    typedef struct
+    {
+        int (*open)(const char *path, int flags);
+        int (*ioctl)(int fd, unsigned long request, void *arg);
+        int (*close)(int fd);
+        int (*read)(int fd, void *buf, size_t len);
+    } BQ40Z80_LINUX_IO;
 
+    /**
+     * @brief Install the system calls used by every BQ40Z80 instance created afterwards
+     * @param io System call table, NULL restores the libc implementations
+     */
+    void bq40z80_linux_set_io(const BQ40Z80_LINUX_IO *io);
+#endif
+
+    // C++ linkage for the member templates, the rest of the class is unaffected
+    extern "C++"
+    {
     class BQ40Z80
     {
     public:
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+        /**
+         * @brief Open the i2c-dev adapter the gauge is connected to
+         * @param i2c_adapter Adapter number N of /dev/i2c-N
+         * @param device_address 7-bit address of BQ40Z80 chip, default to 0x0b
+         */
+        BQ40Z80(i2c_port_t i2c_adapter, uint8_t device_address = 0x0b);
+#else
         /**
          * @brief Initlize the I2C bus
          * @param i2c_scl_io GPIO number used for I2C master clock
@@ -35,6 +91,17 @@ extern "C"
          * @param device_address 7-bit address of BQ40Z80 chip, default to 0x0b
          */
         BQ40Z80(uint8_t i2c_scl_io, uint8_t i2c_sda_io, i2c_port_t i2c_master_num, uint8_t device_address = 0x0b);
+#endif
+
+        /**
+         * @brief Attach to a bus shared with other gauges
+         * @note Doesn't touch the bus, the port stays owned by 'bus', which must outlive the gauge. A gauge
+         *       beyond BQ40Z80_BUS_MAX_DEVICES stays off the bus and its calls fail with ESP_ERR_NO_MEM.
+         * @param bus Shared bus
+         * @param mux_channel Mux channel of the gauge, BQ40Z80_BUS_NO_MUX if wired straight to the bus
+         * @param device_address 7-bit address of BQ40Z80 chip, default to 0x0b
+         */
+        BQ40Z80(BQ40Z80_BUS *bus, uint8_t mux_channel = BQ40Z80_BUS_NO_MUX, uint8_t device_address = 0x0b);
 
         ~BQ40Z80();
 
@@ -55,7 +122,7 @@ extern "C"
          * @note The source of this temperature is configured by DataFlash, see TRM
          * @return temperature, unit: 0.1 degree celsius
          */
-        uint16_t get_temperature();
+        int16_t get_temperature();
 
         /**
          * @brief Read the battery voltage (0x09)
@@ -65,9 +132,9 @@ extern "C"
 
         /**
          * @brief Read the battery current (0x0A)
-         * @return voltage, unit: milliamps
+         * @return current, positive while charging, unit: milliamps
          */
-        uint16_t get_current();
+        int16_t get_current();
 
         /**
          * @brief Read the relative state of charge(RSOC) (0x0D)
@@ -125,6 +192,24 @@ extern "C"
          */
         uint16_t get_design_voltage();
 
+        /**
+         * @brief Read the device type (MFA 0x0001)
+         * @return IC part number
+         */
+        uint16_t get_device_type();
+
+        /**
+         * @brief Read the firmware version (MFA 0x0002)
+         * @param data Buffer to store the decoded version
+         */
+        void get_firmware_version(FIRMWARE_VERSION *data);
+
+        /**
+         * @brief Read the chemical ID (MFA 0x0006)
+         * @return Chemical ID of the OCV tables used by the gauging algorithm
+         */
+        uint16_t get_chemical_id();
+
         /**
          * @brief Read the voltage of single cell
          * @param cell cell number, from 1 to 7
@@ -144,9 +229,464 @@ extern "C"
 
         void read_da_status_3(DA_STATUS_3 *buf);
 
+        /**
+         * @brief Read the voltage, current, power and balancing state of every cell
+         * @note DAStatus1(), DAStatus3() and CBStatus() in one call, gathered with bq40z80_cells_gather()
+         * @param sample Buffer to store the readings
+         */
+        void read_cells(BQ40Z80_CELL_SAMPLE *sample);
+
+        /**
+         * @brief Read OperationStatus() (0x54)
+         * @param data Buffer to store the decoded flags
+         */
+        void read_operation_status(OPERATION_STATUS *data);
+
+        /**
+         * @brief Read SafetyAlert() (0x50)
+         * @param data Buffer to store the status word
+         */
+        void read_safety_alert(SAFETY_STATUS *data);
+
+        /**
+         * @brief Read SafetyStatus() (0x51)
+         * @param data Buffer to store the status word
+         */
+        void read_safety_status(SAFETY_STATUS *data);
+
+        /**
+         * @brief Read PFAlert() (0x52)
+         * @param data Buffer to store the status word
+         */
+        void read_pf_alert(PF_STATUS *data);
+
+        /**
+         * @brief Read PFStatus() (0x53)
+         * @param data Buffer to store the status word
+         */
+        void read_pf_status(PF_STATUS *data);
+
+        /**
+         * @brief Read ChargingStatus() (0x55)
+         * @param data Buffer to store the status word
+         */
+        void read_charging_status(CHARGING_STATUS *data);
+
+        /**
+         * @brief Read GaugingStatus() (0x56)
+         * @param data Buffer to store the status word
+         */
+        void read_gauging_status(GAUGING_STATUS *data);
+
+        /**
+         * @brief Read ManufacturingStatus() (0x57)
+         * @param data Buffer to store the status word
+         */
+        void read_manufacturing_status(MANUFACTURING_STATUS *data);
+
+        /**
+         * @brief Read ManufacturerAccess() LifetimeDataBlock1() (0x0060)
+         * @param data Buffer to store the block
+         */
+        void read_lifetime_data_1(LIFETIME_DATA_1 *data);
+
+        /**
+         * @brief Read ManufacturerAccess() LifetimeDataBlock2() (0x0061)
+         * @param data Buffer to store the block
+         */
+        void read_lifetime_data_2(LIFETIME_DATA_2 *data);
+
+        /**
+         * @brief Read ManufacturerAccess() LifetimeDataBlock3() (0x0062)
+         * @param data Buffer to store the block
+         */
+        void read_lifetime_data_3(LIFETIME_DATA_3 *data);
+
+        /**
+         * @brief Read ManufacturerAccess() LifetimeDataBlock4() (0x0063)
+         * @param data Buffer to store the block
+         */
+        void read_lifetime_data_4(LIFETIME_DATA_4 *data);
+
+        /**
+         * @brief Read ManufacturerAccess() LifetimeDataBlock5() (0x0064)
+         * @param data Buffer to store the block
+         */
+        void read_lifetime_data_5(LIFETIME_DATA_5 *data);
+
+        /**
+         * @brief Read a lifetime block without decoding it
+         * @note Decode with bq40z80_lifetime_decode() or field by field with bq40z80_lifetime_value().
+         * @param block 1 to BQ40Z80_LIFETIME_BLOCKS
+         * @param raw Buffer of bq40z80_lifetime_size(block) bytes
+         */
+        void read_lifetime_block(uint8_t block, uint8_t *raw);
+
+        /**
+         * @brief Read a register described in bq40z80_regmap.h
+         * @note The value is decoded straight from the receive buffer, e.g. read<BQ40Z80_REG_Current>() returns
+         *       a BQ40Z80_CURRENT holding the signed mA of Current(). Scale and unit are available as REG::scale
+         *       and REG::unit.
+         * @return Raw value of the register
+         */
+        template <typename REG>
+        typename REG::type read();
+
+        /**
+         * @brief Read a set of fields with a prebuilt query plan
+         * @note Each transaction of the plan fills every field it carries, see BQ40Z80_TELEMETRY::valid
+         * @param plan Plan built by bq40z80_plan_query()
+         * @param data Telemetry buffer to fill
+         */
+        void read_fields(const BQ40Z80_QUERY_PLAN *plan, BQ40Z80_TELEMETRY *data);
+
+        /**
+         * @brief Plan and read a set of fields
+         * @param fields Mask of requested fields, see BQ40Z80_FIELD_MASK()
+         * @param data Telemetry buffer to fill
+         */
+        void read_fields(bq40z80_field_mask_t fields, BQ40Z80_TELEMETRY *data);
+
+        /**
+         * Non-aborting API
+         *
+         * Every function above has a try_* counterpart that returns the error instead of aborting through
+         * ESP_ERROR_CHECK. Passing a BQ40Z80_CALL bounds the whole call by its deadline, retries NACKed or
+         * timed out transactions and reports the attempts made. Without it a transaction is tried once
+         * with the I2C_MASTER_TIMEOUT_MS timeout, like the aborting API, only a read failing its PEC is
+         * tried again, up to BQ40Z80_CALL_DEFAULT_ATTEMPTS times.
+         */
+        esp_err_t try_get_battery_mode(uint16_t *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_set_battery_mode(uint16_t val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_get_temperature(int16_t *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_get_voltage(uint16_t *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_get_current(int16_t *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_get_rsoc(uint8_t *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_get_remaining_capacity(uint16_t *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_get_full_charge_capacity(uint16_t *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_get_average_time_to_empty(uint16_t *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_get_average_time_to_full(uint16_t *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_get_cycle_count(uint16_t *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_get_design_capacity(uint16_t *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_get_design_voltage(uint16_t *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_get_device_type(uint16_t *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_get_firmware_version(FIRMWARE_VERSION *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_get_chemical_id(uint16_t *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_get_cell_voltage(uint8_t cell, uint16_t *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_set_capm(bool val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_da_status_1(DA_STATUS_1 *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_da_status_3(DA_STATUS_3 *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_cells(BQ40Z80_CELL_SAMPLE *sample, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_operation_status(OPERATION_STATUS *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_safety_alert(SAFETY_STATUS *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_safety_status(SAFETY_STATUS *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_pf_alert(PF_STATUS *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_pf_status(PF_STATUS *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_charging_status(CHARGING_STATUS *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_gauging_status(GAUGING_STATUS *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_manufacturing_status(MANUFACTURING_STATUS *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_lifetime_data_1(LIFETIME_DATA_1 *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_lifetime_data_2(LIFETIME_DATA_2 *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_lifetime_data_3(LIFETIME_DATA_3 *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_lifetime_data_4(LIFETIME_DATA_4 *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_lifetime_data_5(LIFETIME_DATA_5 *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_lifetime_block(uint8_t block, uint8_t *raw, BQ40Z80_CALL *call = NULL);
+        template <typename REG>
+        esp_err_t try_read(typename REG::type *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_negotiate_bus_speed(BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_df(uint16_t address, uint8_t *data, size_t len, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_write_df(uint16_t address, const uint8_t *image, size_t len, const uint16_t *expected_signature = NULL, BQ40Z80_DF_REPORT *report = NULL, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_get_df_signature(uint16_t *val, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_set_trip_points(uint16_t discharge, uint16_t charge, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_arm_trip_window(uint16_t step, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_service_alert(BQ40Z80_CALL *call = NULL);
+        esp_err_t try_sample_current(BQ40Z80_CURRENT_SAMPLE *samples, uint32_t n, const BQ40Z80_SAMPLING_OPTIONS *options = NULL, BQ40Z80_SAMPLING_REPORT *report = NULL, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_flash(bq40z80_flash_read_t read, void *arg, const BQ40Z80_FLASH_OPTIONS *options, BQ40Z80_FLASH_REPORT *report = NULL, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_authenticate(const BQ40Z80_AUTH_CHALLENGE *challenge, BQ40Z80_AUTH_TIMING *timing = NULL, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_fields(const BQ40Z80_QUERY_PLAN *plan, BQ40Z80_TELEMETRY *data, BQ40Z80_CALL *call = NULL);
+        esp_err_t try_read_fields(bq40z80_field_mask_t fields, BQ40Z80_TELEMETRY *data, BQ40Z80_CALL *call = NULL);
+
+        /**
+         * @brief Copy the per-command bus counters
+         * @note All counters read as zero when BQ40Z80_STATS_ENABLE is 0
+         * @param snapshot Buffer to store the counters
+         */
+        void get_stats(BQ40Z80_STATS *snapshot);
+
+        /**
+         * @brief Clear the per-command bus counters
+         */
+        void reset_stats();
+
+        /**
+         * @brief Switch the SMBus clock to 400 kHz if the gauge reports OperationStatus()[XL], 100 kHz otherwise
+         * @note Called by the constructors. After BQ40Z80_BUS_FALLBACK_ERRORS consecutive failed attempts the
+         *       clock steps down to 100 kHz, then to I2C_MASTER_FREQ_HZ. Call it again to retry the faster clock.
+         *       On a shared bus this only sets the fastest clock of this gauge, the bus runs at the slowest
+         *       one of its gauges. On Linux the adapter clock is set by the kernel and read from the device
+         *       tree, this fails with ESP_ERR_NOT_SUPPORTED if it is faster than the gauge handles.
+         */
+        void negotiate_bus_speed();
+
+        /**
+         * @brief Append and check a Packet Error Code on every transaction
+         * @note A frame with a bad PEC fails with ESP_ERR_INVALID_CRC and is read again, by the aborting API
+         *       too. The gauge checks the PEC of writes on its own when one is sent.
+         *       Each PEC covers one SMBus transaction, START to STOP. A ManufacturerAccess() read is two of
+         *       them, the command written to ManufacturerBlockAccess() then the ManufacturerData() read, each
+         *       with its own PEC: the gauge only runs the command on the STOP that ends the write.
+         * @param enable true to use PEC, false by default
+         */
+        void set_pec(bool enable);
+
+        /**
+         * @brief Check whether PEC is in use, see set_pec()
+         */
+        bool get_pec();
+
+        /**
+         * @brief Get the active SMBus clock
+         * @note The clock of the shared bus for an attached gauge
+         * @return Clock frequency, unit: Hz
+         */
+        uint32_t get_bus_speed();
+
+        /**
+         * @brief Set the lifetime of cached dynamic registers
+         * @note Static registers such as DesignCapacity() or the MFA identity commands stay cached for the whole session
+         * @param ttl_ms Lifetime in milliseconds, 0 sends every read to the bus
+         */
+        void set_cache_ttl(uint32_t ttl_ms);
+
+        /**
+         * @brief Override the lifetime of a single SBS register
+         * @param sbs_command SBS command
+         * @param word true for word registers, false for block registers
+         * @param ttl_ms Lifetime in milliseconds, 0 disables caching, BQ40Z80_CACHE_TTL_FOREVER keeps it for the session
+         */
+        void set_register_ttl(uint8_t sbs_command, bool word, uint32_t ttl_ms);
+
+        /**
+         * @brief Override the lifetime of a single ManufacturerAccess command result
+         * @param mfa_command MFA command
+         * @param ttl_ms Lifetime in milliseconds, 0 disables caching, BQ40Z80_CACHE_TTL_FOREVER keeps it for the session
+         */
+        void set_mfa_ttl(uint16_t mfa_command, uint32_t ttl_ms);
+
+        /**
+         * @brief Drop every cached register, static ones included
+         */
+        void invalidate_cache();
+
+        /**
+         * @brief Copy the register cache counters
+         * @param stats Buffer to store the counters
+         */
+        void get_cache_stats(BQ40Z80_CACHE_STATS *stats);
+
+        /**
+         * @brief Call back when bits of a status word change
+         * @note The gauge remembers the last value it read of BatteryStatus() and SafetyAlert() through
+         *       ManufacturingStatus(), whichever API read it. Reads that return the same value cost one
+         *       compare and call nobody. The first read of a word compares against zero, so flags already
+         *       active at start-up are reported as set.
+         * @param field BQ40Z80_FIELD_BATTERY_STATUS or BQ40Z80_FIELD_SAFETY_ALERT..BQ40Z80_FIELD_MANUFACTURING_STATUS
+         * @param mask Bits to watch
+         * @param cb Callback
+         * @param arg Passed back to cb
+         * @return ESP_OK, ESP_ERR_INVALID_ARG for other fields or ESP_ERR_NO_MEM when every slot is taken
+         */
+        esp_err_t subscribe(uint8_t field, uint32_t mask, bq40z80_event_cb_t cb, void *arg);
+
+        /**
+         * @brief Remove every subscription of a callback and argument pair
+         * @param cb Callback
+         * @param arg Argument it was subscribed with
+         */
+        void unsubscribe(bq40z80_event_cb_t cb, void *arg);
+
+        /**
+         * @brief Arm the battery trip points, BTPDischargeSet() (0x4A) and BTPChargeSet() (0x4B)
+         * @note OperationStatus()[BTP_INT] and the BTP pin assert once RemainingCapacity() falls below
+         *       'discharge' or rises above 'charge'. Needs the BTP feature enabled in data flash, see TRM.
+         *       service_alert() writes the same points again after a trip.
+         * @param discharge Discharge trip point (mAh/cWh)
+         * @param charge Charge trip point (mAh/cWh)
+         */
+        void set_trip_points(uint16_t discharge, uint16_t charge);
+
+        /**
+         * @brief Read a range of data flash
+         * @note Streams BQ40Z80_DF_BLOCK bytes per transaction, 256 transactions for the whole space.
+         *       Needs the gauge UNSEALED.
+         * @param address First address, BQ40Z80_DF_START for the whole space
+         * @param data Buffer to store the content
+         * @param len Bytes to read, BQ40Z80_DF_SIZE for the whole space
+         */
+        void read_df(uint16_t address, uint8_t *data, size_t len);
+
+        /**
+         * @brief Write a data flash image, only where it differs from the device
+         * @note Each block is read and compared first, only the span of differing bytes is written, then
+         *       read back. The cache is dropped afterwards, static registers included, since data flash
+         *       backs many of them. Needs the gauge UNSEALED.
+         * @param address First address of the image
+         * @param image Target content
+         * @param len Size of the image
+         * @param expected_signature AllDFSignature() of the target image, NULL to skip the check
+         * @param report Optional, filled with the work done and the final signature
+         */
+        void write_df(uint16_t address, const uint8_t *image, size_t len, const uint16_t *expected_signature = NULL, BQ40Z80_DF_REPORT *report = NULL);
+
+        /**
+         * @brief Read ManufacturerAccess() AllDFSignature() (0x0009)
+         * @return Signature of the whole data flash
+         */
+        uint16_t get_df_signature();
+
+        /**
+         * @brief Arm the trip points 'step' around the present RemainingCapacity()
+         * @note service_alert() moves the window around the new capacity after each trip, so the alert
+         *       line fires once per 'step' of charge or discharge
+         * @param step Half width of the window (mAh/cWh)
+         */
+        void arm_trip_window(uint16_t step);
+
+#if !defined(BQ40Z80_TRANSPORT_LINUX)
+        /**
+         * @brief Watch the SMBALERT#/BTP line of the gauge on a GPIO
+         * @note The line is taken as active low, open drain, the internal pull-up is enabled.
+         *       The interrupt only flags the gauge, the bus is read by service_alert().
+         * @param pin GPIO wired to the line
+         * @return Error code
+         */
+        esp_err_t attach_alert(gpio_num_t pin);
+
+        /**
+         * @brief Stop watching the alert line
+         */
+        void detach_alert();
+#endif
+
+        /**
+         * @brief Flag the alert line as asserted
+         * @note For lines watched outside the library, e.g. a GPIO character device on Linux or a
+         *       simulated line on host. Safe from a signal handler on Linux.
+         */
+        void notify_alert();
+
+        /**
+         * @brief Block until the alert line asserts
+         * @param timeout_ms Timeout, the heartbeat of the caller, UINT32_MAX waits forever
+         * @return true if an alert is pending
+         */
+        bool wait_alert(uint32_t timeout_ms);
+
+        /**
+         * @brief Handle a pending alert
+         * @note Without a pending alert this returns at once, without bus traffic. Otherwise it reads
+         *       OperationStatus() and BatteryStatus(), SafetyStatus() and PFStatus() only when they are
+         *       or were active, bypassing the cache, so subscribe() callbacks fire. A tripped BTP_INT
+         *       re-arms the trip points. A failed read leaves the alert pending.
+         */
+        void service_alert();
+
+        /**
+         * @brief Authenticate the pack with a challenge and its expected response, Authenticate() (0x2F)
+         * @note Writes the challenge, polls OperationStatus()[AUTH] every BQ40Z80_AUTH_POLL_MS until the
+         *       gauge has computed the digest, reads it back and compares it in constant time. Take the
+         *       entry from a BQ40Z80_AUTH_POOL so that no SHA-1 is computed here. A shared bus is released
+         *       while the gauge computes. try_authenticate() returns ESP_ERR_INVALID_RESPONSE for a wrong
+         *       response and fills BQ40Z80_AUTH_TIMING with the time of each phase.
+         * @param challenge Challenge and expected response, use each one once
+         * @return true if the gauge holds the key
+         */
+        bool authenticate(const BQ40Z80_AUTH_CHALLENGE *challenge);
+
+        /**
+         * @brief Stream an image into the gauge
+         * @note The image is pulled BQ40Z80_FLASH_CHUNK bytes at a time and parsed line by line, it is never
+         *       held in RAM. With check_signatures set, a gauge whose signatures already match is left
+         *       alone, otherwise they are read again at the end and must match. A FlashStream is checked
+         *       against InstructionFlashSignature() and StaticDFSignature(), an S-record against
+         *       InstructionFlashSignature() and AllDFSignature(), the static signature misses its
+         *       calibration and learned rows.
+         *       FlashStream lines run as plain I2C transactions without PEC, X: delays overlap the parsing
+         *       of the lines that follow, C: lines must read back what they list.
+         *       S-record data is gathered into BQ40Z80_DF_BLOCK rows, each row is compared with the gauge
+         *       and only the differing span is written, the programming time overlaps the parsing of the
+         *       next row. Needs the gauge UNSEALED, FULL ACCESS for ROM mode.
+         * @param read Source of the image, e.g. bq40z80_flash_read_file()
+         * @param arg Argument of 'read'
+         * @param options Format and expected signatures
+         * @param report Optional, filled with the work done
+         */
+        void flash(bq40z80_flash_read_t read, void *arg, const BQ40Z80_FLASH_OPTIONS *options, BQ40Z80_FLASH_REPORT *report = NULL);
+
+        /**
+         * @brief Sample the current into a buffer at a high rate
+         * @note Reads CurrentLong() when the firmware answers it, Current() otherwise, through one read
+         *       transaction prepared before the run. Each sample bypasses the cache, the statistics and
+         *       the retries, a failed read is skipped and counted, BQ40Z80_SAMPLING_ERRORS_MAX in a row end
+         *       the run. Charge and energy are integrated as the samples arrive.
+         *       With a shared bus, the bus is released while waiting for the next slot of the grid.
+         * @param samples Buffer of 'n' samples
+         * @param n Samples to take
+         * @param options Pacing, NULL reads back to back
+         * @param report Optional, filled with the rate, jitter, cost and integrals
+         */
+        void sample_current(BQ40Z80_CURRENT_SAMPLE *samples, uint32_t n, const BQ40Z80_SAMPLING_OPTIONS *options = NULL, BQ40Z80_SAMPLING_REPORT *report = NULL);
+
     private:
+        friend class BQ40Z80_BUS; // reads freq_limit_hz to tune the shared clock
+
         i2c_port_t I2C_MASTER_NUM;
         uint8_t DEVICE_ADDRESS;
+        BQ40Z80_BUS *bus;    //!< Shared bus, NULL when the gauge owns the port
+        uint8_t MUX_CHANNEL; //!< Mux channel on 'bus'
+        bool unattached;     //!< The shared bus had no room, the gauge owns no port and every transaction fails
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+        int I2C_FD;        //!< File descriptor of /dev/i2c-N
+        bool I2C_RECV_LEN; //!< Adapter supports I2C_M_RECV_LEN, block reads need no length guess
+#endif
+        bq40z80_mutex_t lock;      //!< Serialises public calls, taken by call_begin()
+        BQ40Z80_CALL *active_call; //!< Options of the running try_* call, NULL for the aborting API
+        uint32_t bus_timeout_us;   //!< Timeout of the next transaction attempt
+        uint32_t bus_freq_hz;      //!< Active SMBus clock of a gauge owning its port, see get_bus_speed()
+        uint32_t freq_limit_hz;    //!< Fastest clock the gauge handles, from negotiation and error fallback
+        uint8_t bus_errors;        //!< Consecutive failed attempts at the active clock
+        bool pec_enable;           //!< Append and check a PEC byte on every transaction
+        uint8_t sample_reg;        //!< Command of the read prepared by bus_sample_prepare()
+        uint8_t sample_len;        //!< Bytes returned by the prepared read, count and PEC included
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+        uint32_t I2C_TIMEOUT_US; //!< Timeout last applied with I2C_TIMEOUT
+#else
+        uint8_t I2C_SCL_IO;
+        uint8_t I2C_SDA_IO;
+        uint8_t I2C_CMD_BUF[I2C_LINK_RECOMMENDED_SIZE(I2C_MASTER_CMD_OPS)];    //!< Storage of the command link, reused by every transaction
+        uint8_t SAMPLE_CMD_BUF[I2C_LINK_RECOMMENDED_SIZE(I2C_MASTER_CMD_OPS)]; //!< Storage of the link built by bus_sample_prepare()
+        i2c_cmd_handle_t sample_cmd;                                           //!< Prepared sampling read, run again for every sample
+        uint8_t sample_raw[1 + sizeof(int32_t) + 1];                           //!< Count, CurrentLong() and PEC of the prepared read
+#endif
+#if BQ40Z80_STATS_ENABLE
+        BQ40Z80_STATS stats;
+#endif
+#if BQ40Z80_CACHE_ENABLE
+        BQ40Z80_CACHE_ENTRY cache[BQ40Z80_CACHE_ENTRIES];
+        BQ40Z80_CACHE_OVERRIDE cache_overrides[BQ40Z80_CACHE_OVERRIDES];
+        BQ40Z80_CACHE_STATS cache_stats;
+        uint32_t cache_ttl_ms;
+#endif
+        BQ40Z80_EVENT_SUBSCRIBER subscribers[BQ40Z80_EVENT_SUBSCRIBERS];
+        uint32_t event_values[BQ40Z80_EVENT_WORDS]; //!< Last seen value of each tracked status word
+        bq40z80_signal_t alert;                     //!< Given by notify_alert(), taken by wait_alert()
+        uint8_t alert_pending;                      //!< Set by the alert line, cleared by service_alert()
+        uint16_t btp_discharge;                     //!< Armed BTPDischargeSet()
+        uint16_t btp_charge;                        //!< Armed BTPChargeSet()
+        uint16_t btp_step;                          //!< Window of arm_trip_window(), 0 for fixed points
+#if !defined(BQ40Z80_TRANSPORT_LINUX)
+        gpio_num_t ALERT_GPIO; //!< Line watched by attach_alert(), GPIO_NUM_NC if none
+#endif
 
         /**
          * @brief Read a two-byte word from the device using SMBus
@@ -173,10 +713,11 @@ extern "C"
         /**
          * @brief Read a block from the device using SMBus
          * @category Basic SMBus operation
-         * @note The order of bytes transmitted on the I2C bus follows the increasing index order of the 'data' array
+         * @note The order of bytes transmitted on the I2C bus follows the increasing index order of the 'data' array.
+         *       The count byte and data are read in one transaction, shorter blocks are zero padded to 'len'.
          * @param reg_addr 8-bit register address or SBS Command
          * @param data Data buffer to store the read data
-         * @param len Length of data
+         * @param len Length of data, at most BQ40Z80_SMBUS_BLOCK_MAX
          * @return Error code,
          */
         esp_err_t smbus_read_block(uint8_t reg_addr, uint8_t *data, uint8_t len);
@@ -192,9 +733,216 @@ extern "C"
          */
         esp_err_t smbus_write_block(uint8_t reg_addr, uint8_t *data, uint8_t len);
 
+        /**
+         * @brief Read the result of a ManufacturerAccess command
+         * @category MFA operation
+         * @note Writes the command to ManufacturerBlockAccess(), which the gauge executes on the STOP, then reads
+         *       ManufacturerData() back in a second transaction. The command echo is checked and stripped,
+         *       'data' only receives the payload.
+         * @param mfa_command 16-bit MFA command
+         * @param data Data buffer to store the read data
+         * @param len Length of data
+         * @return Error code
+         */
         esp_err_t mfa_read_block(uint16_t mfa_command, uint8_t *data, uint8_t len);
+
+        /**
+         * @brief Write raw bytes to the device, without count byte or PEC
+         * @category Basic SMBus operation
+         * @note For the ROM mode of the gauge, which doesn't speak SMBus blocks
+         * @param data Bytes to be written, the command first
+         * @param len Length of data
+         * @return Error code
+         */
+        esp_err_t smbus_write_raw(const uint8_t *data, uint8_t len);
+
+        /**
+         * @brief Read raw bytes from the device, without count byte or PEC
+         * @category Basic SMBus operation
+         * @param reg_addr Command written before the repeated start
+         * @param data Data buffer to store the read data
+         * @param len Length of data
+         * @return Error code
+         */
+        esp_err_t smbus_read_raw(uint8_t reg_addr, uint8_t *data, uint8_t len);
+
+        /**
+         * @brief Read the raw bytes of a register, words are stored little-endian
+         * @param kind bq40z80_reg_kind_t
+         * @param command SBS or MFA command
+         * @param data Data buffer to store the read data
+         * @param len Length of data
+         * @return Error code
+         */
+        esp_err_t read_register(uint8_t kind, uint16_t command, uint8_t *data, uint8_t len);
+
+        /**
+         * @brief Read and decode a lifetime block
+         * @param block 1 to BQ40Z80_LIFETIME_BLOCKS
+         * @param data LIFETIME_DATA_<block> to fill
+         * @param call Options of the call, see the try_* API
+         * @return Error code
+         */
+        esp_err_t try_read_lifetime(uint8_t block, void *data, BQ40Z80_CALL *call);
+
+        /**
+         * @brief Transport backend, one implementation per bq40z80_<transport>.cpp
+         * @note Same contract as the smbus_* and mfa_read_block functions above, which add the bookkeeping
+         *       shared by every backend. Each bus_* call is a single bus transaction, except bus_mfa_read_block(),
+         *       which is the command write and the result read, separated by a STOP.
+         */
+        esp_err_t bus_read_word(uint8_t reg_addr, uint16_t *data);
+        esp_err_t bus_write_word(uint8_t reg_addr, uint16_t data);
+        esp_err_t bus_read_block(uint8_t reg_addr, uint8_t *data, uint8_t len);
+        esp_err_t bus_write_block(uint8_t reg_addr, uint8_t *data, uint8_t len);
+        esp_err_t bus_mfa_read_block(uint16_t mfa_command, uint8_t *data, uint8_t len);
+        esp_err_t bus_write_raw(const uint8_t *data, uint8_t len);
+        esp_err_t bus_read_raw(uint8_t reg_addr, uint8_t *data, uint8_t len);
+        esp_err_t bus_sample_prepare(uint8_t reg_addr, uint8_t len);
+        esp_err_t bus_sample(uint8_t *raw);
+        void bus_sample_release();
+        esp_err_t bus_set_freq(uint32_t freq_hz);
+
+        /**
+         * @brief Count failed attempts and step the SMBus clock down when they pile up
+         * @param err Result of the last bus_* call
+         */
+        void bus_speed_feedback(esp_err_t err);
+
+        /**
+         * @brief Change the fastest clock of the gauge and retune the port, or the shared bus, to match
+         * @note bus_set_freq() is the backend, it updates bus_freq_hz to the clock actually in use
+         */
+        esp_err_t set_freq_limit(uint32_t freq_hz);
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+        esp_err_t i2c_transfer(struct i2c_msg *msgs, uint32_t n_msgs);
+#endif
+
+        /**
+         * @brief Validate a raw block read by a backend and copy its data out
+         * @note 'raw' starts with the SMBus count byte. mfa_block_result() also checks and strips the 2-byte
+         *       command echo that precedes the data of ManufacturerData(). Both check the trailing PEC when enabled.
+         * @param reg_addr SBS command the block was read from
+         * @param raw Count byte followed by at least 'len' bytes, plus the echo for MFA blocks and the PEC
+         * @param data Data buffer to store 'len' bytes, zero padded when the device returns fewer
+         * @param len Expected length of data
+         * @return ESP_ERR_INVALID_SIZE if the device returns more than 'len' bytes, ESP_ERR_INVALID_CRC on a
+         *         PEC mismatch, ESP_ERR_INVALID_RESPONSE if the echo doesn't match 'mfa_command'
+         */
+        esp_err_t smbus_block_result(uint8_t reg_addr, const uint8_t *raw, uint8_t *data, uint8_t len);
+        esp_err_t mfa_block_result(uint16_t mfa_command, const uint8_t *raw, uint8_t *data, uint8_t len);
+
+        /**
+         * @brief PEC of a frame sent to / read from the device
+         * @note pec_write() covers address+W, command and 'data'. pec_read() covers address+W, command,
+         *       address+R and 'data'. pec_check() compares pec_read() with the byte following 'data',
+         *       it passes when PEC is disabled.
+         */
+        uint8_t pec_write(uint8_t reg_addr, const uint8_t *data, uint8_t len);
+        uint8_t pec_read(uint8_t reg_addr, const uint8_t *data, uint8_t len);
+        esp_err_t pec_check(uint8_t reg_addr, const uint8_t *data, uint8_t len);
+        /**
+         * @brief Reset the per-device state, shared by every constructor once the port is set up
+         */
+        void device_init();
+
+        /**
+         * @brief Deadline and retry bookkeeping of the try_* API
+         * @note call_begin() returns the enclosing call to hand back to call_end(). attempt_begin() sets the
+         *       timeout of the next attempt and attempt_retry() backs off and decides whether to try again.
+         *       call_sleep_until_us() waits with the shared bus released, the next attempt_begin() selects the
+         *       gauge again.
+         */
+        BQ40Z80_CALL *call_begin(BQ40Z80_CALL *call);
+        esp_err_t call_end(BQ40Z80_CALL *outer, esp_err_t err);
+        void call_sleep_until_us(int64_t until_us);
+        void call_transaction(uint32_t bytes, uint32_t conditions, uint8_t attempts);
+        esp_err_t attempt_begin(uint32_t wire_time_us);
+        bool attempt_retry(esp_err_t err, uint8_t attempts, uint32_t wire_time_us);
+
+        /**
+         * @brief Register cache in front of the smbus_* helpers
+         * @note cache_invalidate(BQ40Z80_CACHE_NONE, 0) drops every dynamic entry, cache_invalidate_capm() the
+         *       words whose unit follows BatteryMode CAPM
+         */
+        void cache_init();
+        void cache_override(uint8_t kind, uint16_t command, uint32_t ttl_ms);
+        bool cache_lookup(uint8_t kind, uint16_t command, uint8_t *data, uint8_t len);
+        void cache_store(uint8_t kind, uint16_t command, const uint8_t *data, uint8_t len);
+        void cache_invalidate(uint8_t kind, uint16_t command);
+        void cache_invalidate_capm();
+
+        /**
+         * @brief Status word tracking behind subscribe()
+         * @note event_observe() is fed every successful SBS read from the bus
+         */
+        void events_init();
+        void event_observe(uint8_t reg_addr, const uint8_t *data, uint8_t len);
+
+        /**
+         * @brief Alert line and trip points
+         */
+        void alert_init();
+        void alert_deinit();
+        esp_err_t rearm_trip_points();
+
+        /**
+         * @brief Compare one data flash block with 'target' and write the span that differs
+         * @note Waits for *ready_us before each transaction and pushes it BQ40Z80_DF_PROGRAM_US past each
+         *       write, so the caller may work while the gauge programs
+         * @param address First address of the block
+         * @param target Content to write
+         * @param n Bytes of the block, at most BQ40Z80_DF_BLOCK
+         * @param verify Read the block back after a write
+         * @param ready_us Time the gauge accepts the next transaction
+         * @param work Counters to update
+         * @return Error code
+         */
+        esp_err_t df_sync_block(uint16_t address, const uint8_t *target, uint8_t n, bool verify, int64_t *ready_us, BQ40Z80_DF_REPORT *work);
+
+        /**
+         * @brief Flasher body of each format
+         */
+        esp_err_t flash_fs(BQ40Z80_FLASH_STREAM *stream, BQ40Z80_FLASH_REPORT *work);
+        esp_err_t flash_srec(BQ40Z80_FLASH_STREAM *stream, BQ40Z80_FLASH_REPORT *work);
+        esp_err_t flash_signatures(uint8_t format, uint16_t *instruction, uint16_t *df);
+
+        /**
+         * @brief Run the read prepared by bus_sample_prepare() once and decode the current
+         * @note Accounts the transaction to the active call, bypasses the cache, the statistics and the retries
+         * @param current_ma Buffer to store the current
+         * @return ESP_ERR_INVALID_SIZE if CurrentLong() answers short, the bus or PEC error otherwise
+         */
+        esp_err_t sample_once(int32_t *current_ma);
+#if !defined(BQ40Z80_TRANSPORT_LINUX)
+        static void alert_isr(void *arg);
+#endif
+#if BQ40Z80_STATS_ENABLE
+        void stats_record(uint8_t kind, uint16_t command, uint32_t bytes, uint32_t conditions, uint8_t attempts, esp_err_t err, int64_t start_us);
+#endif
     };
 
+    template <typename REG>
+    typename REG::type BQ40Z80::read()
+    {
+        typename REG::type val;
+        ESP_ERROR_CHECK(this->try_read<REG>(&val));
+        return val;
+    }
+
+    template <typename REG>
+    esp_err_t BQ40Z80::try_read(typename REG::type *val, BQ40Z80_CALL *call)
+    {
+        BQ40Z80_CALL *outer = this->call_begin(call);
+        uint8_t buf[REG::len];
+
+        esp_err_t err = this->read_register(REG::kind, REG::command, buf, REG::len);
+        if (err == ESP_OK)
+            bq40z80_decode<REG>(val, buf);
+        return this->call_end(outer, err);
+    }
+    }
+
 #ifdef __cplusplus
 }
 #endif
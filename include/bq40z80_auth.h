@@ -0,0 +1,65 @@
+#ifndef __BQ40Z80_AUTH_H
+#define __BQ40Z80_AUTH_H
+
+#include "bq40z80_port.h"
+
+#define BQ40Z80_AUTH_KEY_LEN 16       /*!< Bytes of the authentication key */
+#define BQ40Z80_AUTH_CHALLENGE_LEN 20 /*!< Bytes of a challenge, and of the response */
+#define BQ40Z80_SHA1_LEN 20           /*!< Bytes of a SHA-1 digest */
+
+/**
+ * @brief Authentication key of a gauge that was never programmed, 0x0123456789ABCDEFFEDCBA9876543210
+ */
+#define BQ40Z80_AUTH_DEFAULT_KEY                                                                        \
+    {                                                                                                   \
+        0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, 0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10 \
+    }
+
+#ifndef BQ40Z80_AUTH_POLL_MS
+#define BQ40Z80_AUTH_POLL_MS 10 /*!< Interval between OperationStatus()[AUTH] reads while the gauge computes */
+#endif
+
+#ifndef BQ40Z80_AUTH_TIMEOUT_MS
+#define BQ40Z80_AUTH_TIMEOUT_MS 500 /*!< Longest the gauge may compute, the TRM gives about 250 ms */
+#endif
+
+/**
+ * @brief Challenge with the response a genuine gauge returns for it
+ * @note Use each entry once, a replayed challenge proves nothing
+ */
+typedef struct
+{
+    uint8_t challenge[BQ40Z80_AUTH_CHALLENGE_LEN]; //!< Random message written to Authenticate()
+    uint8_t response[BQ40Z80_AUTH_CHALLENGE_LEN];  //!< bq40z80_auth_digest() of the challenge
+} BQ40Z80_AUTH_CHALLENGE;
+
+/**
+ * @brief Time spent in each phase of BQ40Z80::try_authenticate()
+ */
+typedef struct
+{
+    uint32_t challenge_us; //!< Writing the challenge
+    uint32_t digest_us;    //!< Waiting for the gauge, OperationStatus() polls included
+    uint32_t response_us;  //!< Reading the response and comparing it
+    uint8_t polls;         //!< OperationStatus() reads while waiting
+} BQ40Z80_AUTH_TIMING;
+
+/**
+ * @brief SHA-1 of a message
+ * @param data Message
+ * @param len Length of the message
+ * @param digest Buffer of BQ40Z80_SHA1_LEN bytes
+ */
+void bq40z80_sha1(const uint8_t *data, size_t len, uint8_t *digest);
+
+/**
+ * @brief Response of a gauge holding 'key' to 'challenge'
+ * @note SHA-1(key || SHA-1(key || challenge)) as the bq40z80 computes it. Both messages are 36 bytes and
+ *       fit a single SHA-1 block with the padding, so a response costs exactly two compressions.
+ * @param key BQ40Z80_AUTH_KEY_LEN bytes
+ * @param challenge BQ40Z80_AUTH_CHALLENGE_LEN bytes
+ * @param response Buffer of BQ40Z80_AUTH_CHALLENGE_LEN bytes
+ */
+void bq40z80_auth_digest(const uint8_t *key, const uint8_t *challenge, uint8_t *response);
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef __BQ40Z80_AUTH_POOL_H
+#define __BQ40Z80_AUTH_POOL_H
+
+#include <atomic>
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+#include <thread>
+#endif
+
+#include "bq40z80.h"
+
+#define BQ40Z80_AUTH_POOL_STACK_SIZE 4096 /*!< Stack of the FreeRTOS refill task, in bytes */
+#define BQ40Z80_AUTH_POOL_PRIORITY 1      /*!< Priority of the FreeRTOS refill task, below the poller */
+
+/**
+ * @brief Occupancy and cost of a challenge pool
+ */
+typedef struct
+{
+    uint16_t available;         //!< Entries ready to be taken
+    uint32_t generated;         //!< Entries computed since construction, misses included
+    uint32_t taken;             //!< Entries handed out by take()
+    uint32_t misses;            //!< take() calls that found the pool empty and computed inline
+    uint32_t generate_max_us;   //!< Longest computation of one entry, random challenge included
+    uint64_t generate_total_us; //!< Time spent computing entries
+} BQ40Z80_AUTH_POOL_STATS;
+
+/**
+ * @brief Stock of random challenges with the responses a genuine pack returns
+ * @note Challenges come from bq40z80_random() and responses from bq40z80_auth_digest(), off the
+ *       insertion path: a background task, a FreeRTOS task on target and a std::thread on Linux, tops the
+ *       pool up whenever take() leaves it half empty. Authenticating a pack then costs the bus exchange
+ *       and a 20-byte compare. Entries leave the pool when taken, a challenge is never handed out twice.
+ *       The key stays in RAM for the life of the pool and is wiped by the destructor.
+ */
+class BQ40Z80_AUTH_POOL
+{
+public:
+    /**
+     * @param key BQ40Z80_AUTH_KEY_LEN bytes, copied
+     * @param capacity Entries to keep ready, at least the packs authenticated in one burst
+     */
+    BQ40Z80_AUTH_POOL(const uint8_t *key, uint16_t capacity);
+
+    ~BQ40Z80_AUTH_POOL();
+
+    /**
+     * @brief Start the background task, it fills the pool at once
+     * @return ESP_OK, ESP_ERR_INVALID_STATE if already running or ESP_ERR_NO_MEM
+     */
+    esp_err_t start();
+
+    /**
+     * @brief Stop the background task and wait for it to exit
+     */
+    void stop();
+
+    /**
+     * @brief Fill the pool from the calling task, for callers that run without the background task
+     * @return Entries added
+     */
+    uint16_t refill();
+
+    /**
+     * @brief Hand out a challenge and its expected response
+     * @note Computes the entry inline when the pool is empty, counted in 'misses'
+     * @param entry Buffer to store the entry
+     * @return true if the entry was precomputed
+     */
+    bool take(BQ40Z80_AUTH_CHALLENGE *entry);
+
+    /**
+     * @brief Read the occupancy and cost counters
+     * @param stats Buffer to store the counters
+     */
+    void get_stats(BQ40Z80_AUTH_POOL_STATS *stats);
+
+private:
+    uint8_t key[BQ40Z80_AUTH_KEY_LEN];
+    BQ40Z80_AUTH_CHALLENGE *entries; //!< Ring of 'capacity' entries
+    uint16_t capacity;
+    uint16_t head;  //!< Next entry to take
+    uint16_t count; //!< Entries ready from 'head' on
+    bq40z80_mutex_t lock;
+    bq40z80_signal_t wake; //!< Given by take() when the pool runs low and by stop()
+    BQ40Z80_AUTH_POOL_STATS stats;
+    std::atomic<bool> running;
+
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+    std::thread thread;
+#else
+    TaskHandle_t task;
+    SemaphoreHandle_t stopped;
+#endif
+
+    void generate(BQ40Z80_AUTH_CHALLENGE *entry);
+    void run();
+    static void task_entry(void *arg);
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef __BQ40Z80_BUS_H
+#define __BQ40Z80_BUS_H
+
+#include "bq40z80_port.h"
+#include "bq40z80_query.h"
+#include "bq40z80_call.h"
+
+#define BQ40Z80_BUS_NO_MUX 0xff          /*!< Mux address / channel of a gauge wired straight to the bus */
+#define BQ40Z80_BUS_MUX_ADDRESS 0x70     /*!< Default 7-bit address of a TCA9548A-style mux */
+#define BQ40Z80_BUS_MUX_CHANNELS 8       /*!< Downstream channels of the mux */
+#define BQ40Z80_BUS_MAX_DEVICES 64       /*!< Gauges attached to one bus */
+#define BQ40Z80_BUS_MUX_UNKNOWN 0xfe     /*!< Cached mux channel before the first write or after a failed one */
+
+class BQ40Z80;
+
+/**
+ * @brief I2C port shared by several gauges, optionally behind a TCA9548A-style mux
+ * @note The bus owns the driver (or /dev/i2c-N), gauges attach to it through the BQ40Z80(BQ40Z80_BUS *, ...)
+ *       constructor. Every call of an attached gauge holds the bus lock, and the mux is only written when
+ *       the next transaction targets another channel than the cached one.
+ *       The SMBus clock is shared too, it is the slowest of the clocks the attached gauges negotiated.
+ *       It is retuned whenever a gauge attaches, detaches, negotiates or steps down after bus errors.
+ */
+class BQ40Z80_BUS
+{
+public:
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+    /**
+     * @brief Open the i2c-dev adapter
+     * @param i2c_adapter Adapter number N of /dev/i2c-N
+     * @param mux_address 7-bit address of the mux, BQ40Z80_BUS_NO_MUX if none
+     */
+    BQ40Z80_BUS(i2c_port_t i2c_adapter, uint8_t mux_address = BQ40Z80_BUS_NO_MUX);
+#else
+    /**
+     * @brief Initlize the I2C bus
+     * @param i2c_scl_io GPIO number used for I2C master clock
+     * @param i2c_sda_io GPIO number used for I2C master data
+     * @param i2c_master_num I2C master i2c port number
+     * @param mux_address 7-bit address of the mux, BQ40Z80_BUS_NO_MUX if none
+     */
+    BQ40Z80_BUS(uint8_t i2c_scl_io, uint8_t i2c_sda_io, i2c_port_t i2c_master_num, uint8_t mux_address = BQ40Z80_BUS_NO_MUX);
+#endif
+
+    /**
+     * @note Gauges attached to the bus must be destroyed first
+     */
+    ~BQ40Z80_BUS();
+
+    /**
+     * @brief Number of attached gauges
+     */
+    uint8_t get_device_count();
+
+    /**
+     * @brief Get an attached gauge, in attach order
+     * @return NULL if index is out of range
+     */
+    BQ40Z80 *get_device(uint8_t index);
+
+    /**
+     * @brief Read a field set from the next gauge in round-robin order
+     * @note Call it at a fixed interval to poll N gauges at interval * N each. Bound each slot with a deadline
+     *       in 'call', so a missing pack costs its slot and never delays the next one.
+     * @param plan Plan to execute, see bq40z80_plan_query()
+     * @param data Buffer to store the values
+     * @param index Set to the index of the gauge that was read, see get_device()
+     * @param call Deadline and retry options, NULL for the defaults
+     * @return Error of the read, ESP_ERR_NOT_FOUND if no gauge is attached
+     */
+    esp_err_t poll_next(const BQ40Z80_QUERY_PLAN *plan, BQ40Z80_TELEMETRY *data, uint8_t *index, BQ40Z80_CALL *call = NULL);
+
+    /**
+     * @brief Number of mux channel switches since construction
+     */
+    uint32_t get_mux_switches();
+
+    /**
+     * @brief Get the active SMBus clock
+     * @return Clock frequency, unit: Hz
+     */
+    uint32_t get_bus_speed();
+
+private:
+    friend class BQ40Z80;
+
+    i2c_port_t I2C_MASTER_NUM;
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+    int I2C_FD;              //!< File descriptor of /dev/i2c-N
+    bool I2C_RECV_LEN;       //!< Adapter supports I2C_M_RECV_LEN
+    uint32_t I2C_TIMEOUT_US; //!< Timeout last applied with I2C_TIMEOUT, shared by every attached gauge
+#else
+    uint8_t I2C_SCL_IO;
+    uint8_t I2C_SDA_IO;
+#endif
+    uint8_t MUX_ADDRESS;
+
+    bq40z80_mutex_t lock; //!< Held by attached gauges from call_begin() to call_end()
+    uint8_t mux_channel;  //!< Channel selected on the mux, BQ40Z80_BUS_NO_MUX when all are off
+    uint32_t mux_switches;
+    uint32_t freq_hz;     //!< Active SMBus clock, updated by set_freq()
+
+    BQ40Z80 *devices[BQ40Z80_BUS_MAX_DEVICES];
+    uint8_t n_devices;
+    uint8_t next_device;
+
+    /**
+     * @return ESP_ERR_NO_MEM when BQ40Z80_BUS_MAX_DEVICES gauges are attached already
+     */
+    esp_err_t attach(BQ40Z80 *device);
+    void detach(BQ40Z80 *device);
+
+    /**
+     * @brief Route the bus to a mux channel, only writes the mux when the cached channel differs
+     * @param channel Mux channel, BQ40Z80_BUS_NO_MUX turns every channel off for a gauge wired straight to the bus
+     * @param timeout_us Timeout of the mux write
+     */
+    esp_err_t select(uint8_t channel, uint32_t timeout_us);
+
+    /**
+     * @brief Retune the clock to the slowest limit of the attached gauges
+     */
+    esp_err_t negotiate();
+
+    /**
+     * @brief Transport backend, implemented next to the BQ40Z80 one
+     */
+    esp_err_t mux_write(uint8_t value, uint32_t timeout_us);
+    esp_err_t set_freq(uint32_t freq_hz); //!< Updates freq_hz to the clock actually in use
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef __BQ40Z80_CACHE_H
+#define __BQ40Z80_CACHE_H
+
+#include "bq40z80_port.h"
+
+#ifndef BQ40Z80_CACHE_ENABLE
+#define BQ40Z80_CACHE_ENABLE 1 /*!< Set to 0 to compile the register cache out */
+#endif
+
+#ifndef BQ40Z80_CACHE_ENTRIES
+#define BQ40Z80_CACHE_ENTRIES 24 /*!< Registers cached per device */
+#endif
+
+#define BQ40Z80_CACHE_DATA_MAX 20          /*!< Larger blocks, e.g. DAStatus1(), always go to the bus */
+#define BQ40Z80_CACHE_OVERRIDES 8          /*!< Per-register TTL overrides per device */
+#define BQ40Z80_CACHE_TTL_FOREVER UINT32_MAX /*!< Register never changes at runtime */
+#define BQ40Z80_CACHE_TTL_DEFAULT_MS 1000  /*!< The gauge updates its measurements about once per second */
+
+typedef enum
+{
+    BQ40Z80_CACHE_NONE = 0,  //!< Unused entry
+    BQ40Z80_CACHE_SBS_WORD,  //!< SBS word register
+    BQ40Z80_CACHE_SBS_BLOCK, //!< SBS block register
+    BQ40Z80_CACHE_MFA,       //!< ManufacturerAccess command result
+} bq40z80_cache_kind_t;
+
+typedef struct
+{
+    uint8_t kind;                         //!< bq40z80_cache_kind_t
+    uint8_t len;                          //!< Length of data
+    uint16_t command;                     //!< SBS or MFA command
+    uint32_t ttl_ms;                      //!< Lifetime of data
+    int64_t fetched_us;                   //!< Time data was read or written
+    uint8_t data[BQ40Z80_CACHE_DATA_MAX]; //!< Register content, as received on the bus
+} BQ40Z80_CACHE_ENTRY;
+
+typedef struct
+{
+    uint8_t kind;    //!< bq40z80_cache_kind_t
+    uint16_t command; //!< SBS or MFA command
+    uint32_t ttl_ms; //!< Lifetime, 0 disables caching
+} BQ40Z80_CACHE_OVERRIDE;
+
+/**
+ * @brief Register cache counters
+ */
+typedef struct
+{
+    uint32_t hits;      //!< Reads served without bus traffic
+    uint32_t misses;    //!< Reads that went to the bus
+    uint32_t evictions; //!< Entries replaced because the cache was full
+} BQ40Z80_CACHE_STATS;
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef __BQ40Z80_CALL_H
+#define __BQ40Z80_CALL_H
+
+#include "bq40z80_port.h"
+
+#define BQ40Z80_NO_DEADLINE INT64_MAX         /*!< Call without deadline, transactions still time out individually */
+#define BQ40Z80_CALL_DEFAULT_ATTEMPTS 3       /*!< Attempts per transaction when max_attempts is 0 */
+#define BQ40Z80_RETRY_NACK_BACKOFF_US 500     /*!< First back-off after a NACK, the gauge is busy for a short while */
+#define BQ40Z80_RETRY_TIMEOUT_BACKOFF_US 2000 /*!< First back-off after a timeout, the bus needs time to recover */
+#define BQ40Z80_RETRY_BACKOFF_MAX_US 16000    /*!< Back-off doubles per attempt up to this value */
+#define BQ40Z80_SMBUS_STRETCH_MAX_US 25000    /*!< SMBus tLOW:SEXT, longest clock stretching a slave may add to a transaction */
+
+/**
+ * @brief Per-call options and results of the non-aborting try_* API
+ * @note Fill deadline_us, max_attempts and fresh, the other fields are written by the call.
+ *       Every transaction of a call shares the deadline, a transaction is retried on NACK, timeout and
+ *       PEC errors with an exponential back-off as long as the deadline allows another attempt.
+ */
+typedef struct
+{
+    int64_t deadline_us;   //!< in: Absolute deadline on the bq40z80_time_us() clock, or BQ40Z80_NO_DEADLINE
+    uint8_t max_attempts;  //!< in: Attempts per transaction, 0 for BQ40Z80_CALL_DEFAULT_ATTEMPTS
+    bool fresh;            //!< in: Read dynamic registers from the gauge even when cached, static ones still hit
+    uint16_t attempts;     //!< out: Bus attempts made by the call, retries included
+    uint16_t transactions; //!< out: Transactions issued by the call, cache hits excluded
+    uint32_t bytes;        //!< out: Bytes on the wire, including address bytes and retries
+    uint32_t clocks;       //!< out: SCL clocks on the wire, see bq40z80_clocks_to_us()
+    int64_t started_us;    //!< out: Start of the call on the bq40z80_time_us() clock
+    uint32_t elapsed_us;   //!< out: Duration of the call
+    esp_err_t err;         //!< out: Same as the return value of the call
+} BQ40Z80_CALL;
+
+/**
+ * @brief Prepare call options with a relative timeout
+ * @param timeout_us Time budget of the call, starting now
+ * @param max_attempts Attempts per transaction, 0 for the default
+ * @return Call options to pass to a try_* function
+ */
+static inline BQ40Z80_CALL bq40z80_call_within(uint32_t timeout_us, uint8_t max_attempts)
+{
+    BQ40Z80_CALL call;
+    memset(&call, 0, sizeof(call));
+    call.deadline_us = bq40z80_time_us() + timeout_us;
+    call.max_attempts = max_attempts;
+    return call;
+}
+
+#endif
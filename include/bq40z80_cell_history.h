@@ -0,0 +1,131 @@
+#ifndef __BQ40Z80_CELL_HISTORY_H
+#define __BQ40Z80_CELL_HISTORY_H
+
+#include "bq40z80.h"
+
+#define BQ40Z80_CELL_CHUNK 64 /*!< Samples per pass of the cross-cell kernels, bounds their stack use */
+
+#ifndef BQ40Z80_CELL_LOAD_MA
+#define BQ40Z80_CELL_LOAD_MA 500 /*!< Discharge current from which a sample counts as under load */
+#endif
+
+#ifndef BQ40Z80_CELL_REST_MA
+#define BQ40Z80_CELL_REST_MA 50 /*!< Cell current below which a sample counts as at rest */
+#endif
+
+#ifndef BQ40Z80_CELL_STEP_MA
+#define BQ40Z80_CELL_STEP_MA 200 /*!< Current change the window must hold before a resistance is estimated */
+#endif
+
+/**
+ * @brief Statistics of one cell over a window
+ */
+typedef struct
+{
+    uint16_t min_mv;             //!< Lowest voltage
+    uint16_t max_mv;             //!< Highest voltage
+    uint16_t mean_mv;            //!< Mean voltage
+    uint16_t stddev_mv;          //!< Standard deviation of the voltage
+    uint32_t loaded;             //!< Samples discharging at BQ40Z80_CELL_LOAD_MA or more
+    uint32_t resting;            //!< Samples with the cell current within BQ40Z80_CELL_REST_MA of zero
+    int16_t sag_mv;              //!< Mean voltage at rest minus under load, 0 unless both were seen
+    int32_t resistance_uohm;     //!< dV/dI over consecutive samples, 0 until the current steps reach BQ40Z80_CELL_STEP_MA
+    uint32_t balancing;          //!< Samples with the cell balanced
+    int16_t offset_mv;           //!< Mean distance above the average cell while not balanced
+    int16_t offset_balancing_mv; //!< Mean distance above the average cell while balanced
+} BQ40Z80_CELL_STATS;
+
+/**
+ * @brief Result of BQ40Z80_CELL_HISTORY::analyse()
+ * @note Throughput: samples * cells / elapsed_us
+ */
+typedef struct
+{
+    uint32_t samples;                       //!< Samples in the window
+    uint8_t cells;                          //!< Cells analysed
+    uint16_t spread_max_mv;                 //!< Largest gap between the highest and the lowest cell of one sample
+    uint16_t spread_mean_mv;                //!< Mean gap between the highest and the lowest cell
+    uint8_t lowest_cell;                    //!< Cell with the lowest mean voltage, 0 for cell 1
+    uint32_t elapsed_us;                    //!< Time taken by analyse()
+    BQ40Z80_CELL_STATS cell[BQ40Z80_CELLS]; //!< Per cell, 'cells' of them filled
+} BQ40Z80_CELL_ANALYSIS;
+
+/**
+ * @brief Ring of per-cell samples stored as a structure of arrays in a caller-supplied arena
+ * @note Each cell owns one contiguous row of voltages, one of currents and one of powers, plus a shared row
+ *       of timestamps and balancing flags. The kernels of analyse() walk those rows with fixed-width integer
+ *       accumulators and selects instead of branches, which the compiler can turn into SIMD loops; the
+ *       statistics that compare cells run over BQ40Z80_CELL_CHUNK samples at a time. Only the first 'cells'
+ *       cells are stored and analysed. append() costs one scatter and never allocates. The history never
+ *       touches the bus, feed it from BQ40Z80::read_cells().
+ */
+class BQ40Z80_CELL_HISTORY
+{
+public:
+    /**
+     * @brief Arena needed for a capacity
+     * @param capacity Samples to hold
+     * @param cells Cells in series, 1 to BQ40Z80_CELLS
+     * @return Size in bytes, alignment slack included
+     */
+    static size_t arena_size(uint32_t capacity, uint8_t cells);
+
+    /**
+     * @param arena Storage for the samples, e.g. a PSRAM region, must outlive the history
+     * @param size Size of the arena, see arena_size()
+     * @param cells Cells in series, 1 to BQ40Z80_CELLS
+     */
+    BQ40Z80_CELL_HISTORY(void *arena, size_t size, uint8_t cells);
+
+    ~BQ40Z80_CELL_HISTORY();
+
+    /**
+     * @brief Store a sample, dropping the oldest one when full
+     * @param sample Readings, e.g. from BQ40Z80::read_cells()
+     */
+    void append(const BQ40Z80_CELL_SAMPLE *sample);
+
+    /**
+     * @brief Drop every sample
+     */
+    void clear();
+
+    /**
+     * @return Samples held
+     */
+    uint32_t count();
+
+    /**
+     * @return Samples the arena holds at most
+     */
+    uint32_t get_capacity();
+
+    /**
+     * @brief Read a sample back
+     * @param age 0 for the newest sample
+     * @param sample Buffer to store the sample, cells past 'cells' are zero
+     * @return false if fewer than age + 1 samples are held
+     */
+    bool get(uint32_t age, BQ40Z80_CELL_SAMPLE *sample);
+
+    /**
+     * @brief Compute the per-cell statistics of the newest samples
+     * @param window Samples to cover, 0 or more than held covers all of them
+     * @param analysis Buffer to store the result
+     */
+    void analyse(uint32_t window, BQ40Z80_CELL_ANALYSIS *analysis);
+
+private:
+    uint8_t cells;
+    uint32_t capacity;
+    uint32_t head; //!< Slot of the next sample
+    uint32_t held; //!< Samples stored, ending before 'head'
+    int64_t *timestamp_us;
+    uint16_t *voltage_mv; //!< 'cells' rows of 'capacity'
+    int16_t *current_ma;  //!< 'cells' rows of 'capacity'
+    int16_t *power_cw;    //!< 'cells' rows of 'capacity'
+    uint8_t *balancing;
+    bq40z80_mutex_t lock;
+};
+
+#endif
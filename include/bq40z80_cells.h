@@ -0,0 +1,30 @@
+#ifndef __BQ40Z80_CELLS_H
+#define __BQ40Z80_CELLS_H
+
+#include "bq40z80_registers.h"
+
+#define BQ40Z80_CELLS 7 /*!< Cells reported by DAStatus1() and DAStatus3() */
+
+/**
+ * @brief Per-cell readings of one moment, gathered from DAStatus1(), DAStatus3() and CBStatus()
+ */
+typedef struct
+{
+    int64_t timestamp_us;               //!< bq40z80_time_us() after the reads
+    uint16_t voltage_mv[BQ40Z80_CELLS]; //!< Cell voltage, 0 for unused cells
+    int16_t current_ma[BQ40Z80_CELLS];  //!< Current measured together with the cell voltage
+    int16_t power_cw[BQ40Z80_CELLS];    //!< Cell power
+    uint8_t balancing;                  //!< Bit n set while cell n+1 is balanced
+} BQ40Z80_CELL_SAMPLE;
+
+/**
+ * @brief Gather the per-cell fields of DAStatus1() and DAStatus3() into one sample
+ * @param da1 Cells 1 to 4
+ * @param da3 Cells 5 to 7
+ * @param cb_status CBStatus(), its low bits flag the cells being balanced
+ * @param timestamp_us Time of the reads
+ * @param sample Sample to fill
+ */
+void bq40z80_cells_gather(const DA_STATUS_1 *da1, const DA_STATUS_3 *da3, uint16_t cb_status, int64_t timestamp_us, BQ40Z80_CELL_SAMPLE *sample);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef __BQ40Z80_COLLECTOR_H
+#define __BQ40Z80_COLLECTOR_H
+
+#include "bq40z80.h"
+
+#define BQ40Z80_LIFETIME_BLOCK_TIMEOUT_MS 500 /*!< Time budget of each block read by the collector */
+
+/**
+ * @brief Change of a lifetime block found by the collector
+ */
+typedef struct
+{
+    uint8_t block;      //!< 1 to BQ40Z80_LIFETIME_BLOCKS
+    uint32_t changed;   //!< Bit i set when field i of bq40z80_lifetime_fields(block) changed
+    const uint8_t *raw; //!< Block as read, bq40z80_lifetime_size(block) bytes, valid during the callback
+} BQ40Z80_LIFETIME_UPDATE;
+
+/**
+ * @brief Callback receiving the changed lifetime fields
+ * @param update Block and fields that changed
+ * @param arg Argument given to the collector
+ */
+typedef void (*bq40z80_lifetime_cb_t)(const BQ40Z80_LIFETIME_UPDATE *update, void *arg);
+
+/**
+ * @brief Work done by a collector
+ * @note Upload volume: fields_changed against blocks_read
+ */
+typedef struct
+{
+    uint32_t collections;    //!< Successful passes over the five blocks
+    uint32_t blocks_read;    //!< Blocks fetched from the gauge
+    uint32_t blocks_changed; //!< Blocks handed to the callback
+    uint32_t fields_changed; //!< Fields flagged in the 'changed' masks
+} BQ40Z80_LIFETIME_STATS;
+
+/**
+ * @brief Slow-cadence reader of the lifetime data blocks, reporting only what changed
+ * @note Each block is fetched whole, its FNV-1a hash is compared against the previous fetch and the
+ *       callback runs only on a mismatch, with the fields that differ. An unchanged pack costs five reads
+ *       and five compares, and sends nothing. The hashes can be saved with get_hashes() and restored after
+ *       a restart with set_hashes(), a block that still matches is then not sent again. Without the
+ *       previous bytes every field of a changed block is reported.
+ *       The collector has no task of its own nor lock, drive poll() from a single task.
+ */
+class BQ40Z80_LIFETIME_COLLECTOR
+{
+public:
+    /**
+     * @param gauge Device to read, must outlive the collector
+     * @param period_ms Time between two passes of poll(), e.g. a few minutes, lifetime data updates slowly
+     * @param cb Callback receiving the changes
+     * @param arg Passed back to cb
+     */
+    BQ40Z80_LIFETIME_COLLECTOR(BQ40Z80 *gauge, uint32_t period_ms, bq40z80_lifetime_cb_t cb, void *arg);
+
+    /**
+     * @brief Run collect() when the period has elapsed since the last successful pass
+     * @return ESP_OK when nothing was due, else the result of collect()
+     */
+    esp_err_t poll();
+
+    /**
+     * @brief Fetch every lifetime block now and report the changes
+     * @note A failed read stops the pass, the blocks fetched before it are reported
+     * @return Error of the first failed read
+     */
+    esp_err_t collect();
+
+    /**
+     * @brief Copy the hash of the last fetch of each block, for persistence
+     * @param hashes Buffer of BQ40Z80_LIFETIME_BLOCKS hashes, block 1 first
+     * @return Mask of the blocks fetched or restored at least once, bit 0 for block 1
+     */
+    uint8_t get_hashes(uint32_t *hashes) const;
+
+    /**
+     * @brief Restore hashes saved by get_hashes()
+     * @param hashes BQ40Z80_LIFETIME_BLOCKS hashes, block 1 first
+     * @param known Mask returned by get_hashes()
+     */
+    void set_hashes(const uint32_t *hashes, uint8_t known);
+
+    /**
+     * @brief Read the work counters
+     * @param stats Buffer to store the counters
+     */
+    void get_stats(BQ40Z80_LIFETIME_STATS *stats) const;
+
+private:
+    BQ40Z80 *gauge;
+    uint32_t period_ms;
+    bq40z80_lifetime_cb_t cb;
+    void *arg;
+    int64_t last_us;  //!< End of the last successful pass
+    bool collected;   //!< At least one pass succeeded
+    uint8_t known;    //!< Blocks with a valid hash
+    uint8_t have_raw; //!< Blocks with their previous bytes in 'raw'
+    uint32_t hashes[BQ40Z80_LIFETIME_BLOCKS];
+    uint8_t raw[BQ40Z80_LIFETIME_BLOCKS][BQ40Z80_LIFETIME_BLOCK_MAX];
+    BQ40Z80_LIFETIME_STATS stats;
+};
+
+#endif
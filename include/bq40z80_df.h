@@ -0,0 +1,27 @@
+#ifndef __BQ40Z80_DF_H
+#define __BQ40Z80_DF_H
+
+#include "bq40z80_port.h"
+
+#define BQ40Z80_DF_START 0x4000 /*!< First data flash address */
+#define BQ40Z80_DF_SIZE 0x2000  /*!< Bytes of data flash */
+#define BQ40Z80_DF_BLOCK 32     /*!< Bytes returned by one ManufacturerBlockAccess() read */
+#define BQ40Z80_DF_WRITE_MAX 30 /*!< Data bytes per ManufacturerBlockAccess() write, the address takes the other two */
+
+#ifndef BQ40Z80_DF_PROGRAM_US
+#define BQ40Z80_DF_PROGRAM_US 2000 /*!< Time the gauge needs to program one write into flash */
+#endif
+
+/**
+ * @brief Outcome of a differential data flash write
+ */
+typedef struct
+{
+    uint16_t blocks;       //!< Blocks compared against the image
+    uint16_t blocks_dirty; //!< Blocks that differed and were written
+    uint16_t writes;       //!< ManufacturerBlockAccess() writes issued
+    uint16_t bytes;        //!< Data bytes written
+    uint16_t signature;    //!< ManufacturerAccess() AllDFSignature() after the write
+} BQ40Z80_DF_REPORT;
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef __BQ40Z80_EVENTS_H
+#define __BQ40Z80_EVENTS_H
+
+#include "bq40z80_port.h"
+#include "bq40z80_query.h"
+
+#define BQ40Z80_EVENT_SUBSCRIBERS 8 /*!< Callbacks per device */
+#define BQ40Z80_EVENT_WORDS 9       /*!< Tracked status words: BatteryStatus() and 0x50..0x57 */
+
+class BQ40Z80;
+
+/**
+ * @brief Change of a status word
+ */
+typedef struct
+{
+    uint8_t field;    //!< bq40z80_field_t of the word, BatteryStatus or SafetyAlert..ManufacturingStatus
+    uint32_t value;   //!< New value of the word
+    uint32_t set;     //!< Bits that went from 0 to 1, limited to the subscribed mask
+    uint32_t cleared; //!< Bits that went from 1 to 0, limited to the subscribed mask
+} BQ40Z80_EVENT;
+
+/**
+ * @brief Subscriber callback
+ * @note Runs in the context of the read that saw the change, with the gauge locked. It may use the
+ *       gauge but should return quickly, the read it interrupts is still in progress.
+ */
+typedef void (*bq40z80_event_cb_t)(BQ40Z80 *gauge, const BQ40Z80_EVENT *event, void *arg);
+
+typedef struct
+{
+    bq40z80_event_cb_t cb; //!< NULL for a free slot
+    void *arg;             //!< Passed back to cb
+    uint8_t field;         //!< Watched status word
+    uint32_t mask;         //!< Watched bits
+} BQ40Z80_EVENT_SUBSCRIBER;
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef __BQ40Z80_FLASH_H
+#define __BQ40Z80_FLASH_H
+
+#include <stdio.h>
+
+#include "bq40z80_port.h"
+
+#define BQ40Z80_FLASH_CHUNK 256    /*!< Bytes pulled from the source per read */
+#define BQ40Z80_FLASH_LINE_MAX 256 /*!< Longest line of a FlashStream or S-record file, end of line excluded */
+#define BQ40Z80_FLASH_DATA_MAX 64  /*!< Most bytes after the address of a FlashStream line */
+
+#ifndef BQ40Z80_FLASH_ROM_ENTRY_MS
+#define BQ40Z80_FLASH_ROM_ENTRY_MS 500 /*!< Time the gauge needs to switch to ROM mode */
+#endif
+
+#ifndef BQ40Z80_FLASH_BOOT_MS
+#define BQ40Z80_FLASH_BOOT_MS 500 /*!< Time the gauge needs to start the firmware after a FlashStream */
+#endif
+
+/**
+ * @brief Image formats of BQ40Z80::flash()
+ */
+typedef enum
+{
+    BQ40Z80_FLASH_FS = 0, //!< TI FlashStream (.bq.fs, .df.fs): W/C/R/X lines replayed on the bus, ROM mode included
+    BQ40Z80_FLASH_SREC,   //!< Motorola S-record of data flash, written row by row where it differs from the gauge
+} bq40z80_flash_format_t;
+
+/**
+ * @brief Source of an image
+ * @param arg Argument given with the callback
+ * @param buf Buffer to fill
+ * @param len Room in the buffer
+ * @return Bytes stored, 0 at the end of the image, negative on error
+ */
+typedef int (*bq40z80_flash_read_t)(void *arg, uint8_t *buf, size_t len);
+
+/**
+ * @brief What BQ40Z80::flash() writes and checks
+ */
+typedef struct
+{
+    uint8_t format;                 //!< bq40z80_flash_format_t
+    bool enter_rom_mode;            //!< Send ManufacturerAccess() ROMMode() first, clear for streams that carry it
+    bool check_signatures;          //!< Compare the signatures below before and after flashing
+    uint16_t instruction_signature; //!< Expected InstructionFlashSignature() (0x0004)
+    uint16_t static_df_signature;   //!< Expected StaticDFSignature() (0x0005), checked for BQ40Z80_FLASH_FS
+    uint16_t all_df_signature;      //!< Expected AllDFSignature() (0x0009), checked for BQ40Z80_FLASH_SREC
+} BQ40Z80_FLASH_OPTIONS;
+
+/**
+ * @brief Work done by BQ40Z80::flash()
+ */
+typedef struct
+{
+    bool skipped;                   //!< The signatures already matched, nothing was written
+    uint32_t lines;                 //!< Lines parsed, comments included
+    uint32_t writes;                //!< Write transactions issued
+    uint32_t bytes;                 //!< Data bytes written, commands and addresses excluded
+    uint32_t rows;                  //!< Data flash rows of an S-record compared against the gauge
+    uint32_t rows_skipped;          //!< Rows that already matched
+    uint32_t delay_ms;              //!< Delays requested by X: lines
+    uint32_t elapsed_us;            //!< Duration of the whole flash, signature checks included
+    uint16_t instruction_signature; //!< InstructionFlashSignature() at the end, when checked
+    uint16_t static_df_signature;   //!< StaticDFSignature() at the end, when checked for BQ40Z80_FLASH_FS
+    uint16_t all_df_signature;      //!< AllDFSignature() at the end, when checked for BQ40Z80_FLASH_SREC
+} BQ40Z80_FLASH_REPORT;
+
+/**
+ * @brief Line reader over a bq40z80_flash_read_t, holds one chunk and one line
+ */
+typedef struct
+{
+    bq40z80_flash_read_t read;
+    void *arg;
+    uint8_t chunk[BQ40Z80_FLASH_CHUNK];
+    uint16_t pos;  //!< Next byte of 'chunk'
+    uint16_t fill; //!< Bytes held in 'chunk'
+    bool end;      //!< The source reported its end
+    uint32_t line_no;
+    char line[BQ40Z80_FLASH_LINE_MAX + 1];
+} BQ40Z80_FLASH_STREAM;
+
+/**
+ * @brief bq40z80_flash_read_t over a stdio stream
+ * @param arg FILE * opened for reading
+ * @param buf Buffer to fill
+ * @param len Room in the buffer
+ * @return Bytes stored, 0 at the end of the file, -1 on error
+ */
+int bq40z80_flash_read_file(void *arg, uint8_t *buf, size_t len);
+
+#endif
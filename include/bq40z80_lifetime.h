@@ -0,0 +1,60 @@
+#ifndef __BQ40Z80_LIFETIME_H
+#define __BQ40Z80_LIFETIME_H
+
+#include "bq40z80_registers.h"
+
+#define BQ40Z80_LIFETIME_BLOCKS 5     /*!< LifetimeDataBlock1() to LifetimeDataBlock5() */
+#define BQ40Z80_LIFETIME_BLOCK_MAX 32 /*!< Size of the largest lifetime block, in bytes */
+
+/**
+ * @brief Layout of one field of a lifetime block
+ * @note The offset is the same in the wire block and in the LIFETIME_DATA_<block> struct
+ */
+typedef struct
+{
+    const char *name; //!< Member name in LIFETIME_DATA_<block>
+    uint8_t offset;   //!< Offset in the block
+    uint8_t width;    //!< 1, 2 or 4 bytes, little-endian on the wire
+    bool is_signed;   //!< Two's complement value
+} BQ40Z80_LIFETIME_FIELD;
+
+/**
+ * @brief Size of a lifetime block
+ * @param block 1 to BQ40Z80_LIFETIME_BLOCKS
+ * @return Bytes returned by the gauge, 0 for an unknown block
+ */
+uint8_t bq40z80_lifetime_size(uint8_t block);
+
+/**
+ * @brief Fields of a lifetime block, in wire order
+ * @param block 1 to BQ40Z80_LIFETIME_BLOCKS
+ * @param count Number of fields, at most 32 so a uint32_t holds one bit per field
+ * @return Field table, NULL for an unknown block
+ */
+const BQ40Z80_LIFETIME_FIELD *bq40z80_lifetime_fields(uint8_t block, uint8_t *count);
+
+/**
+ * @brief Value of one field of a raw lifetime block
+ * @param field Entry of bq40z80_lifetime_fields()
+ * @param raw Block as read from the gauge
+ * @return Value, sign-extended for signed fields
+ */
+int64_t bq40z80_lifetime_value(const BQ40Z80_LIFETIME_FIELD *field, const uint8_t *raw);
+
+/**
+ * @brief Decode a raw lifetime block
+ * @param block 1 to BQ40Z80_LIFETIME_BLOCKS
+ * @param raw Block as read from the gauge, bq40z80_lifetime_size(block) bytes
+ * @param data LIFETIME_DATA_<block> to fill
+ */
+void bq40z80_lifetime_decode(uint8_t block, const uint8_t *raw, void *data);
+
+/**
+ * @brief Encode a lifetime block as the gauge sends it, the inverse of bq40z80_lifetime_decode()
+ * @param block 1 to BQ40Z80_LIFETIME_BLOCKS
+ * @param data LIFETIME_DATA_<block> to encode
+ * @param raw Buffer of bq40z80_lifetime_size(block) bytes
+ */
+void bq40z80_lifetime_encode(uint8_t block, const void *data, uint8_t *raw);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef __BQ40Z80_PEC_H
+#define __BQ40Z80_PEC_H
+
+#include "bq40z80_port.h"
+
+#define BQ40Z80_PEC_POLYNOMIAL 0x07 /*!< SMBus PEC, CRC-8 x^8 + x^2 + x + 1 */
+
+/**
+ * @brief Update an SMBus Packet Error Code with more bytes of the frame
+ * @note Table driven, one lookup per byte. The 256-byte table is generated at compile time.
+ * @param crc PEC of the previous bytes, 0 at the start of a frame
+ * @param data Bytes as transmitted on the wire, including address bytes
+ * @param len Number of bytes
+ * @return Updated PEC
+ */
+uint8_t bq40z80_pec(uint8_t crc, const uint8_t *data, size_t len);
+
+#endif
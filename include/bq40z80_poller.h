@@ -0,0 +1,122 @@
+#ifndef __BQ40Z80_POLLER_H
+#define __BQ40Z80_POLLER_H
+
+#include <atomic>
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+#include <thread>
+#endif
+
+#include "bq40z80.h"
+#include "bq40z80_recorder.h"
+#include "bq40z80_scheduler.h"
+
+#define BQ40Z80_POLLER_STACK_SIZE 4096 /*!< Stack of the FreeRTOS poller task, in bytes */
+#define BQ40Z80_POLLER_PRIORITY 5      /*!< Priority of the FreeRTOS poller task */
+
+/**
+ * @brief Telemetry published by the poller
+ */
+typedef struct
+{
+    uint32_t sequence;           //!< Number of the sample, starts at 1 and increases by one per successful poll
+    int64_t timestamp_us;        //!< Start of the read on the bq40z80_time_us() clock
+    uint32_t duration_us;        //!< Time spent on the bus for this sample
+    BQ40Z80_TELEMETRY telemetry; //!< Fields read, see BQ40Z80_TELEMETRY::valid
+} BQ40Z80_SNAPSHOT;
+
+/**
+ * @brief Background reader publishing the latest telemetry of a gauge
+ * @note The poller runs a FreeRTOS task on target and a std::thread on Linux. It reads the configured
+ *       fields once per period through the non-aborting API, with the period as deadline, and publishes
+ *       them through a seqlock. read() never touches the bus nor takes a lock, so any number of tasks can
+ *       fetch the latest sample at the cost of a ~100 byte copy.
+ *       Each poll reads the dynamic registers from the gauge whatever the cache TTL, so the timestamp of a
+ *       sample is the time its values were read. The values are stored in the cache for other callers.
+ */
+class BQ40Z80_POLLER
+{
+public:
+    /**
+     * @param gauge Device to poll, must outlive the poller
+     * @param fields Mask of fields to read, see BQ40Z80_FIELD_MASK()
+     * @param period_ms Polling period
+     */
+    BQ40Z80_POLLER(BQ40Z80 *gauge, bq40z80_field_mask_t fields, uint32_t period_ms);
+
+    ~BQ40Z80_POLLER();
+
+    /**
+     * @brief Start the background task
+     * @return ESP_OK, ESP_ERR_INVALID_STATE if already running or ESP_ERR_NO_MEM
+     */
+    esp_err_t start();
+
+    /**
+     * @brief Stop the background task and wait for it to exit
+     */
+    void stop();
+
+    /**
+     * @brief Read the gauge once and publish the result, for callers that drive the schedule themselves
+     * @return Error of the read, nothing is published on failure
+     */
+    esp_err_t poll_once();
+
+    /**
+     * @brief Fetch the latest published sample without bus access
+     * @param snapshot Buffer to store the sample
+     * @return false if nothing has been published yet
+     */
+    bool read(BQ40Z80_SNAPSHOT *snapshot) const;
+
+    /**
+     * @brief Number of polls that failed since construction
+     */
+    uint32_t failures() const;
+
+    /**
+     * @brief Append every published sample to a recorder
+     * @note Set it before start(), NULL detaches
+     * @param recorder Recorder to feed, must outlive the poller
+     */
+    void set_recorder(BQ40Z80_RECORDER *recorder);
+
+    /**
+     * @brief Let a scheduler pick the fields read at each period
+     * @note The period of the poller becomes the tick of the scheduler, keep it at or below the shortest
+     *       period of the policy. Each poll reads the due fields only, bypassing the register cache, and
+     *       publishes them merged with the last value of the others, a tick with nothing due publishes
+     *       nothing. Set it before start(), NULL goes back to reading every field each period.
+     * @param scheduler Scheduler to follow, must outlive the poller
+     */
+    void set_scheduler(BQ40Z80_SCHEDULER *scheduler);
+
+private:
+    static constexpr size_t WORDS = (sizeof(BQ40Z80_SNAPSHOT) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+    BQ40Z80 *gauge;
+    BQ40Z80_RECORDER *recorder;
+    BQ40Z80_SCHEDULER *scheduler;
+    BQ40Z80_TELEMETRY latest; //!< Fields read so far under the scheduler
+    BQ40Z80_QUERY_PLAN plan;
+    uint32_t period_ms;
+    uint32_t sequence;
+
+    std::atomic<uint32_t> seq;          //!< Seqlock counter, odd while a sample is being written
+    std::atomic<uint32_t> words[WORDS]; //!< Published BQ40Z80_SNAPSHOT, copied word by word
+    std::atomic<uint32_t> n_failures;
+    std::atomic<bool> running;
+
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+    std::thread thread;
+#else
+    TaskHandle_t task;
+    SemaphoreHandle_t stopped;
+#endif
+
+    void publish(const BQ40Z80_SNAPSHOT *snapshot);
+    void run();
+    static void task_entry(void *arg);
+};
+
+#endif
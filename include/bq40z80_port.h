@@ -0,0 +1,316 @@
+#ifndef __BQ40Z80_PORT_H
+#define __BQ40Z80_PORT_H
+
+/**
+ * Transport backend selection
+ *
+ * By default the library talks to the gauge through the ESP-IDF I2C master driver.
+ * Define BQ40Z80_TRANSPORT_LINUX to use the Linux userspace i2c-dev interface (/dev/i2c-N) instead,
+ * in which case the few ESP-IDF types and macros the library relies on are provided here.
+ */
+
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/random.h>
+
+typedef int esp_err_t;
+typedef int i2c_port_t; //!< i2c-dev adapter number, N in /dev/i2c-N
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_NO_MEM 0x101
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#define ESP_ERR_INVALID_SIZE 0x104
+#define ESP_ERR_NOT_FOUND 0x105
+#define ESP_ERR_NOT_SUPPORTED 0x106
+#define ESP_ERR_TIMEOUT 0x107
+#define ESP_ERR_INVALID_RESPONSE 0x108
+#define ESP_ERR_INVALID_CRC 0x109
+
+static inline const char *esp_err_to_name(esp_err_t err)
+{
+    switch (err)
+    {
+    case ESP_OK:
+        return "ESP_OK";
+    case ESP_FAIL:
+        return "ESP_FAIL";
+    case ESP_ERR_NO_MEM:
+        return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG:
+        return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE:
+        return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE:
+        return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND:
+        return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED:
+        return "ESP_ERR_NOT_SUPPORTED";
+    case ESP_ERR_TIMEOUT:
+        return "ESP_ERR_TIMEOUT";
+    case ESP_ERR_INVALID_RESPONSE:
+        return "ESP_ERR_INVALID_RESPONSE";
+    case ESP_ERR_INVALID_CRC:
+        return "ESP_ERR_INVALID_CRC";
+    default:
+        return "UNKNOWN ERROR";
+    }
+}
+
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) fprintf(stderr, "W (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) fprintf(stderr, "I (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ((void)(tag))
+
+#define ESP_ERROR_CHECK(x)                                                                          \
+    do                                                                                              \
+    {                                                                                               \
+        esp_err_t err_rc_ = (x);                                                                    \
+        if (err_rc_ != ESP_OK)                                                                      \
+        {                                                                                           \
+            fprintf(stderr, "ESP_ERROR_CHECK failed: 0x%x at %s:%d (%s)\n", err_rc_, __FILE__, __LINE__, #x); \
+            abort();                                                                                \
+        }                                                                                           \
+    } while (0)
+
+#else
+
+#include <esp_types.h>
+#include "driver/i2c.h"
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#endif
+
+/**
+ * @brief Monotonic time in microseconds
+ */
+static inline int64_t bq40z80_time_us(void)
+{
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+    return esp_timer_get_time();
+#endif
+}
+
+/**
+ * @brief Block the calling task
+ * @note Short delays busy-wait on ESP-IDF, the FreeRTOS tick is too coarse for them
+ * @param us Delay in microseconds
+ */
+static inline void bq40z80_sleep_us(uint32_t us)
+{
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+    usleep(us);
+#else
+    if (us >= portTICK_PERIOD_MS * 1000)
+        vTaskDelay(us / (portTICK_PERIOD_MS * 1000));
+    else
+        esp_rom_delay_us(us);
+#endif
+}
+
+/**
+ * @brief Block the calling task until a point on the bq40z80_time_us() clock, returns at once if it passed
+ * @param deadline_us Time to wait for
+ */
+static inline void bq40z80_sleep_until_us(int64_t deadline_us)
+{
+    int64_t remaining = deadline_us - bq40z80_time_us();
+    if (remaining > 0)
+        bq40z80_sleep_us((uint32_t)remaining);
+}
+
+/**
+ * @brief Fill a buffer from the cryptographic random source
+ * @note getrandom() on Linux, the hardware RNG on ESP-IDF, which needs the RF or the bootloader entropy
+ *       source enabled to be truly random
+ * @param buf Buffer to fill
+ * @param len Bytes to fill
+ */
+static inline void bq40z80_random(void *buf, size_t len)
+{
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+    uint8_t *p = (uint8_t *)buf;
+    while (len > 0)
+    {
+        ssize_t n = getrandom(p, len, 0);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            ESP_LOGE("BQ40Z80", "getrandom failed (%d)", errno);
+            abort();
+        }
+        p += n;
+        len -= n;
+    }
+#else
+    esp_fill_random(buf, len);
+#endif
+}
+
+/**
+ * @brief Recursive mutex serialising the users of a device
+ */
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+typedef pthread_mutex_t bq40z80_mutex_t;
+
+static inline void bq40z80_mutex_init(bq40z80_mutex_t *mutex)
+{
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+static inline void bq40z80_mutex_lock(bq40z80_mutex_t *mutex)
+{
+    pthread_mutex_lock(mutex);
+}
+
+static inline void bq40z80_mutex_unlock(bq40z80_mutex_t *mutex)
+{
+    pthread_mutex_unlock(mutex);
+}
+
+static inline void bq40z80_mutex_deinit(bq40z80_mutex_t *mutex)
+{
+    pthread_mutex_destroy(mutex);
+}
+#else
+typedef struct
+{
+    StaticSemaphore_t storage;
+    SemaphoreHandle_t handle;
+} bq40z80_mutex_t;
+
+static inline void bq40z80_mutex_init(bq40z80_mutex_t *mutex)
+{
+    mutex->handle = xSemaphoreCreateRecursiveMutexStatic(&mutex->storage);
+}
+
+static inline void bq40z80_mutex_lock(bq40z80_mutex_t *mutex)
+{
+    xSemaphoreTakeRecursive(mutex->handle, portMAX_DELAY);
+}
+
+static inline void bq40z80_mutex_unlock(bq40z80_mutex_t *mutex)
+{
+    xSemaphoreGiveRecursive(mutex->handle);
+}
+
+static inline void bq40z80_mutex_deinit(bq40z80_mutex_t *mutex)
+{
+    vSemaphoreDelete(mutex->handle);
+}
+#endif
+
+/**
+ * @brief Binary signal from an interrupt or another task to a waiting task
+ */
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+typedef sem_t bq40z80_signal_t;
+
+static inline void bq40z80_signal_init(bq40z80_signal_t *signal)
+{
+    sem_init(signal, 0, 0);
+}
+
+static inline void bq40z80_signal_give(bq40z80_signal_t *signal)
+{
+    // async-signal-safe, usable from a handler standing in for the interrupt
+    int val;
+    if (sem_getvalue(signal, &val) == 0 && val == 0)
+        sem_post(signal);
+}
+
+static inline void bq40z80_signal_give_from_isr(bq40z80_signal_t *signal)
+{
+    bq40z80_signal_give(signal);
+}
+
+static inline bool bq40z80_signal_take(bq40z80_signal_t *signal, uint32_t timeout_ms)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+    int ret;
+    while ((ret = sem_timedwait(signal, &ts)) != 0 && errno == EINTR)
+        ;
+    return ret == 0;
+}
+
+static inline void bq40z80_signal_deinit(bq40z80_signal_t *signal)
+{
+    sem_destroy(signal);
+}
+#else
+typedef struct
+{
+    StaticSemaphore_t storage;
+    SemaphoreHandle_t handle;
+} bq40z80_signal_t;
+
+static inline void bq40z80_signal_init(bq40z80_signal_t *signal)
+{
+    signal->handle = xSemaphoreCreateBinaryStatic(&signal->storage);
+}
+
+static inline void bq40z80_signal_give(bq40z80_signal_t *signal)
+{
+    xSemaphoreGive(signal->handle);
+}
+
+static inline void IRAM_ATTR bq40z80_signal_give_from_isr(bq40z80_signal_t *signal)
+{
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(signal->handle, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static inline bool bq40z80_signal_take(bq40z80_signal_t *signal, uint32_t timeout_ms)
+{
+    return xSemaphoreTake(signal->handle, timeout_ms == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms)) == pdTRUE;
+}
+
+static inline void bq40z80_signal_deinit(bq40z80_signal_t *signal)
+{
+    vSemaphoreDelete(signal->handle);
+}
+#endif
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef __BQ40Z80_QUERY_H
+#define __BQ40Z80_QUERY_H
+
+#include "bq40z80_port.h"
+#include "bq40z80_registers.h"
+
+/**
+ * @brief Telemetry fields that can be requested in a single query
+ * @note A field can be reachable through several SBS/MFA commands, e.g. CellVoltage4 is available as
+ *       SBS word 0x3F and inside DAStatus1(), itself an SBS block 0x71 or an MFA block. The query planner
+ *       picks the cheapest set of transactions.
+ */
+typedef enum
+{
+    BQ40Z80_FIELD_TEMPERATURE = 0,       //!< Temperature() (0.1 K)
+    BQ40Z80_FIELD_VOLTAGE,               //!< Voltage() (mV)
+    BQ40Z80_FIELD_CURRENT,               //!< Current() (mA)
+    BQ40Z80_FIELD_AVERAGE_CURRENT,       //!< AverageCurrent() (mA)
+    BQ40Z80_FIELD_RSOC,                  //!< RelativeStateOfCharge() (%)
+    BQ40Z80_FIELD_REMAINING_CAPACITY,    //!< RemainingCapacity() (mAh/cWh)
+    BQ40Z80_FIELD_FULL_CHARGE_CAPACITY,  //!< FullChargeCapacity() (mAh/cWh)
+    BQ40Z80_FIELD_BATTERY_STATUS,        //!< BatteryStatus()
+    BQ40Z80_FIELD_CELL_VOLTAGE_1,        //!< Cell Voltage 1 (mV)
+    BQ40Z80_FIELD_CELL_VOLTAGE_2,        //!< Cell Voltage 2 (mV)
+    BQ40Z80_FIELD_CELL_VOLTAGE_3,        //!< Cell Voltage 3 (mV)
+    BQ40Z80_FIELD_CELL_VOLTAGE_4,        //!< Cell Voltage 4 (mV)
+    BQ40Z80_FIELD_CELL_VOLTAGE_5,        //!< Cell Voltage 5 (mV)
+    BQ40Z80_FIELD_CELL_VOLTAGE_6,        //!< Cell Voltage 6 (mV)
+    BQ40Z80_FIELD_CELL_VOLTAGE_7,        //!< Cell Voltage 7 (mV)
+    BQ40Z80_FIELD_BAT_VOLTAGE,           //!< BAT Voltage from DAStatus1() (mV)
+    BQ40Z80_FIELD_PACK_VOLTAGE,          //!< PACK Voltage from DAStatus1() (mV)
+    BQ40Z80_FIELD_INT_TEMPERATURE,       //!< Int Temperature from DAStatus2() (0.1 K)
+    BQ40Z80_FIELD_TS1_TEMPERATURE,       //!< TS1 Temperature from DAStatus2() (0.1 K)
+    BQ40Z80_FIELD_TS2_TEMPERATURE,       //!< TS2 Temperature from DAStatus2() (0.1 K)
+    BQ40Z80_FIELD_TS3_TEMPERATURE,       //!< TS3 Temperature from DAStatus2() (0.1 K)
+    BQ40Z80_FIELD_TS4_TEMPERATURE,       //!< TS4 Temperature from DAStatus2() (0.1 K)
+    BQ40Z80_FIELD_CELL_TEMPERATURE,      //!< Cell Temperature from DAStatus2() (0.1 K)
+    BQ40Z80_FIELD_FET_TEMPERATURE,       //!< FET Temperature from DAStatus2() (0.1 K)
+    BQ40Z80_FIELD_SAFETY_ALERT,          //!< SafetyAlert()
+    BQ40Z80_FIELD_SAFETY_STATUS,         //!< SafetyStatus()
+    BQ40Z80_FIELD_PF_ALERT,              //!< PFAlert()
+    BQ40Z80_FIELD_PF_STATUS,             //!< PFStatus()
+    BQ40Z80_FIELD_OPERATION_STATUS,      //!< OperationStatus()
+    BQ40Z80_FIELD_CHARGING_STATUS,       //!< ChargingStatus()
+    BQ40Z80_FIELD_GAUGING_STATUS,        //!< GaugingStatus()
+    BQ40Z80_FIELD_MANUFACTURING_STATUS,  //!< ManufacturingStatus()
+    BQ40Z80_FIELD_COUNT
+} bq40z80_field_t;
+
+typedef uint64_t bq40z80_field_mask_t;
+
+#define BQ40Z80_FIELD_MASK(field) ((bq40z80_field_mask_t)1 << (field))
+#define BQ40Z80_FIELD_MASK_ALL (BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_COUNT) - 1)
+#define BQ40Z80_FIELD_MASK_CELL_VOLTAGES (BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_CELL_VOLTAGE_7 + 1) - BQ40Z80_FIELD_MASK(BQ40Z80_FIELD_CELL_VOLTAGE_1))
+
+#define BQ40Z80_QUERY_MAX_STEPS 26 /*!< Upper bound of transactions in a plan, one per known source */
+
+/**
+ * @brief Ordered list of bus transactions that covers a field set
+ * @note Plans only depend on the requested fields, build them once with bq40z80_plan_query() and reuse them
+ */
+typedef struct
+{
+    bq40z80_field_mask_t fields;            //!< Requested fields
+    bq40z80_field_mask_t provided;          //!< Fields filled by executing the plan, superset of fields
+    uint32_t cost_clocks;                   //!< Estimated SCL clocks on the wire, including START/STOP conditions
+    uint8_t n_steps;                        //!< Number of transactions
+    uint8_t steps[BQ40Z80_QUERY_MAX_STEPS]; //!< Source index of each transaction
+} BQ40Z80_QUERY_PLAN;
+
+/**
+ * @brief Values read by a query, only fields set in 'valid' hold data
+ */
+typedef struct
+{
+    bq40z80_field_mask_t valid; //!< Fields filled by the last query
+
+    uint16_t temperature;          //!< Temperature() (0.1 K)
+    uint16_t voltage;              //!< Voltage() (mV)
+    int16_t current;               //!< Current() (mA)
+    int16_t average_current;       //!< AverageCurrent() (mA)
+    uint8_t rsoc;                  //!< RelativeStateOfCharge() (%)
+    uint16_t remaining_capacity;   //!< RemainingCapacity() (mAh/cWh)
+    uint16_t full_charge_capacity; //!< FullChargeCapacity() (mAh/cWh)
+    uint16_t battery_status;       //!< BatteryStatus()
+
+    uint16_t cell_voltage[7]; //!< Cell Voltage 1..7 (mV)
+    uint16_t bat_voltage;     //!< BAT Voltage (mV)
+    uint16_t pack_voltage;    //!< PACK Voltage (mV)
+
+    uint16_t int_temperature;   //!< Int Temperature (0.1 K)
+    uint16_t ts_temperature[4]; //!< TS1..TS4 Temperature (0.1 K)
+    uint16_t cell_temperature;  //!< Cell Temperature (0.1 K)
+    uint16_t fet_temperature;   //!< FET Temperature (0.1 K)
+
+    SAFETY_STATUS safety_alert;                //!< SafetyAlert()
+    SAFETY_STATUS safety_status;               //!< SafetyStatus()
+    PF_STATUS pf_alert;                        //!< PFAlert()
+    PF_STATUS pf_status;                       //!< PFStatus()
+    OPERATION_STATUS operation_status;         //!< OperationStatus()
+    CHARGING_STATUS charging_status;           //!< ChargingStatus()
+    GAUGING_STATUS gauging_status;             //!< GaugingStatus()
+    MANUFACTURING_STATUS manufacturing_status; //!< ManufacturingStatus()
+} BQ40Z80_TELEMETRY;
+
+/**
+ * @brief Build the cheapest transaction list that reads every requested field
+ * @note Transactions are compared by estimated SCL clocks, so a few SBS word reads win over a
+ *       DAStatus block when they cover the same fields, and one block wins once it replaces enough words.
+ * @param fields Mask of requested fields, see BQ40Z80_FIELD_MASK()
+ * @param plan Plan to fill
+ */
+void bq40z80_plan_query(bq40z80_field_mask_t fields, BQ40Z80_QUERY_PLAN *plan);
+
+/**
+ * @brief Store a raw field value in a telemetry buffer
+ * @note BQ40Z80_TELEMETRY::valid is left untouched
+ * @param data Telemetry buffer
+ * @param field bq40z80_field_t
+ * @param val Raw value, truncated to the width of the field
+ */
+void bq40z80_set_field(BQ40Z80_TELEMETRY *data, uint8_t field, uint32_t val);
+
+/**
+ * @brief Fetch a field of a telemetry buffer
+ * @param data Telemetry buffer
+ * @param field bq40z80_field_t
+ * @return Field value, sign-extended for the signed currents, status words as their raw bits
+ */
+int32_t bq40z80_get_field(const BQ40Z80_TELEMETRY *data, uint8_t field);
+
+#endif
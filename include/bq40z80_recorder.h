@@ -0,0 +1,122 @@
+#ifndef __BQ40Z80_RECORDER_H
+#define __BQ40Z80_RECORDER_H
+
+#include "bq40z80.h"
+
+#define BQ40Z80_RECORDER_BLOCK_SIZE 512 /*!< Bytes per arena block, the unit of eviction */
+
+/**
+ * @brief Position of a reader in the recorder, opaque to the caller
+ * @note A cursor carries the decoder state, so several readers can walk the history independently
+ */
+typedef struct
+{
+    uint32_t block;                      //!< Sequence number of the block being read
+    uint16_t offset;                     //!< Next record in the block
+    uint32_t lost;                       //!< Blocks evicted under the cursor since rewind()
+    int64_t timestamp_us;                //!< Timestamp of the last decoded sample
+    bq40z80_field_mask_t valid;          //!< Valid fields of the last decoded sample
+    int32_t values[BQ40Z80_FIELD_COUNT]; //!< Field values of the last decoded sample
+} BQ40Z80_RECORDER_CURSOR;
+
+/**
+ * @brief Occupancy and cost of a recorder
+ * @note Compression ratio: raw_bytes / encoded_bytes
+ */
+typedef struct
+{
+    uint32_t samples;         //!< Samples held in the arena
+    uint32_t encoded_bytes;   //!< Bytes the held samples take in the arena, block headers included
+    uint32_t raw_bytes;       //!< Bytes the held samples take as a 64-bit timestamp plus each field at its native width
+    uint32_t evicted_samples; //!< Samples dropped to make room since construction
+    uint32_t appended;        //!< Samples appended since construction
+    uint32_t append_max_us;   //!< Longest append(), needs BQ40Z80_STATS_ENABLE
+    uint64_t append_total_us; //!< Time spent in append(), needs BQ40Z80_STATS_ENABLE
+} BQ40Z80_RECORDER_STATS;
+
+/**
+ * @brief Ring buffer of telemetry samples in a caller-supplied arena
+ * @note The arena is split in BQ40Z80_RECORDER_BLOCK_SIZE blocks. The first sample of a block is stored
+ *       against zero and every following one as zigzag varint deltas from its predecessor, so slowly moving
+ *       values take one byte per field. When the arena is full the oldest block is dropped whole, every
+ *       block decodes on its own. append() costs one pass over the recorded fields and never allocates.
+ *       The recorder never touches the bus, feed it from BQ40Z80_POLLER::set_recorder() or after any read.
+ */
+class BQ40Z80_RECORDER
+{
+public:
+    /**
+     * @param arena Storage for the samples, e.g. a PSRAM region, must outlive the recorder
+     * @param size Size of the arena, at least two blocks
+     * @param fields Mask of fields to record, others are ignored by append()
+     */
+    BQ40Z80_RECORDER(void *arena, size_t size, bq40z80_field_mask_t fields);
+
+    ~BQ40Z80_RECORDER();
+
+    /**
+     * @brief Record a sample
+     * @param timestamp_us Time of the sample, e.g. BQ40Z80_SNAPSHOT::timestamp_us
+     * @param data Telemetry, only the recorded fields set in 'valid' are stored
+     * @return ESP_OK or ESP_ERR_INVALID_SIZE if the arena is smaller than two blocks
+     */
+    esp_err_t append(int64_t timestamp_us, const BQ40Z80_TELEMETRY *data);
+
+    /**
+     * @brief Drop every sample
+     */
+    void clear();
+
+    /**
+     * @brief Point a cursor at the oldest sample held
+     * @param cursor Cursor to initialise
+     */
+    void rewind(BQ40Z80_RECORDER_CURSOR *cursor);
+
+    /**
+     * @brief Decode the next sample straight from the arena
+     * @note A cursor overtaken by eviction skips to the oldest sample and counts the dropped blocks in 'lost'
+     * @param cursor Cursor set up by rewind()
+     * @param timestamp_us Time of the sample
+     * @param data Telemetry to fill, fields missing from the sample are zero and clear in 'valid'
+     * @return false once the cursor reached the newest sample
+     */
+    bool next(BQ40Z80_RECORDER_CURSOR *cursor, int64_t *timestamp_us, BQ40Z80_TELEMETRY *data);
+
+    /**
+     * @brief Read the occupancy and cost counters
+     * @param stats Buffer to store the counters
+     */
+    void get_stats(BQ40Z80_RECORDER_STATS *stats);
+
+private:
+    typedef struct
+    {
+        uint32_t sequence; //!< Increases by one per block started
+        uint16_t used;     //!< Bytes written, header included
+        uint16_t samples;  //!< Samples stored
+    } BLOCK_HEADER;
+
+    uint8_t *arena;
+    uint16_t n_blocks;
+    uint16_t head;    //!< Block being written
+    uint16_t in_use;  //!< Blocks holding samples, head included
+    uint32_t next_sequence;
+    bq40z80_field_mask_t fields;
+    uint8_t n_fields;
+    uint16_t record_max; //!< Worst case size of one record
+    uint16_t raw_size;   //!< Size of one sample in the raw_bytes accounting
+    bq40z80_mutex_t lock;
+    BQ40Z80_RECORDER_STATS stats;
+
+    // encoder state, reset at the start of each block
+    int64_t last_timestamp_us;
+    bq40z80_field_mask_t last_valid;
+    int32_t last_values[BQ40Z80_FIELD_COUNT];
+
+    BLOCK_HEADER *block(uint16_t index);
+    uint16_t oldest();
+    void start_block();
+};
+
+#endif
@@ -1,7 +1,7 @@
 #ifndef __BQ40Z80_REGISTERS_H
 #define __BQ40Z80_REGISTERS_H
 
-#include <esp_types.h>
+#include "bq40z80_port.h"
 
 typedef struct
 {
@@ -11,16 +11,16 @@ typedef struct
     uint16_t cell_voltage_4; //!< Cell Voltage 4 (mV)
     uint16_t bat_voltage;    //!< BAT Voltage. Voltage at the BAT pin. Different from Voltage() which is the sum of all cell voltages (mV)
     uint16_t pack_voltage;   //!< PACK Voltage. Voltage at the PACK+ pin. (mV)
-    uint16_t cell_current_1; //!< Cell Current 1. Simultaneous current measured during Cell Voltage 1 measurement (mA)
-    uint16_t cell_current_2; //!< Cell Current 2. Simultaneous current measured during Cell Voltage 2 measurement (mA)
-    uint16_t cell_current_3; //!< Cell Current 3. Simultaneous current measured during Cell Voltage 3 measurement (mA)
-    uint16_t cell_current_4; //!< Cell Current 4. Simultaneous current measured during Cell Voltage 4 measurement (mA)
-    uint16_t cell_power_1;   //!< Cell Power 1. Calculated using Cell Voltage1 and Cell Current 1 data (cW)
-    uint16_t cell_power_2;   //!< Cell Power 2. Calculated using Cell Voltage2 and Cell Current 2 data (cW)
-    uint16_t cell_power_3;   //!< Cell Power 3. Calculated using Cell Voltage3 and Cell Current 3 data (cW)
-    uint16_t cell_power_4;   //!< Cell Power 4. Calculated using Cell Voltage4 and Cell Current 4 data (cW)
-    uint16_t power;          //!< Power calculated by Voltage() × Current() (cW)
-    uint16_t average_power;  //!< Average Power (cW)
+    int16_t cell_current_1;  //!< Cell Current 1. Simultaneous current measured during Cell Voltage 1 measurement (mA)
+    int16_t cell_current_2;  //!< Cell Current 2. Simultaneous current measured during Cell Voltage 2 measurement (mA)
+    int16_t cell_current_3;  //!< Cell Current 3. Simultaneous current measured during Cell Voltage 3 measurement (mA)
+    int16_t cell_current_4;  //!< Cell Current 4. Simultaneous current measured during Cell Voltage 4 measurement (mA)
+    int16_t cell_power_1;    //!< Cell Power 1. Calculated using Cell Voltage1 and Cell Current 1 data (cW)
+    int16_t cell_power_2;    //!< Cell Power 2. Calculated using Cell Voltage2 and Cell Current 2 data (cW)
+    int16_t cell_power_3;    //!< Cell Power 3. Calculated using Cell Voltage3 and Cell Current 3 data (cW)
+    int16_t cell_power_4;    //!< Cell Power 4. Calculated using Cell Voltage4 and Cell Current 4 data (cW)
+    int16_t power;           //!< Power calculated by Voltage() × Current() (cW)
+    int16_t average_power;   //!< Average Power (cW)
 } DA_STATUS_1;
 
 typedef struct
@@ -38,81 +38,338 @@ typedef struct
 typedef struct
 {
     uint16_t cell_voltage_5; //!< Cell Voltage 5 (mV)
+    int16_t cell_current_5;  //!< Cell Current 5. Simultaneous current measured during Cell Voltage 5 measurement (mA)
+    int16_t cell_power_5;    //!< Cell Power 5. Calculated using Cell Voltage 5 and Cell Current 5 data (cW)
     uint16_t cell_voltage_6; //!< Cell Voltage 6 (mV)
+    int16_t cell_current_6;  //!< Cell Current 6. Simultaneous current measured during Cell Voltage 6 measurement (mA)
+    int16_t cell_power_6;    //!< Cell Power 6. Calculated using Cell Voltage 6 and Cell Current 6 data (cW)
     uint16_t cell_voltage_7; //!< Cell Voltage 7 (mV)
-    uint16_t cell_current_5; //!< Cell Current 5. Simultaneous current measured during Cell Voltage 5 measurement (mA)
-    uint16_t cell_current_6; //!< Cell Current 6. Simultaneous current measured during Cell Voltage 6 measurement (mA)
-    uint16_t cell_current_7; //!< Cell Current 7. (mA)
-    uint16_t cell_power_5;   //!< Cell Power 5. Calculated using Cell Voltage 5 and Cell Current 5 data (cW)
-    uint16_t cell_power_6;   //!< Cell Power 6. Calculated using Cell Voltage 6 and Cell Current 6 data (cW)
-    uint16_t cell_power_7;   //!< Cell Power 7. Calculated using Cell Voltage 7 and Cell Current 7 data (cW)
+    int16_t cell_current_7;  //!< Cell Current 7. (mA)
+    int16_t cell_power_7;    //!< Cell Power 7. Calculated using Cell Voltage 7 and Cell Current 7 data (cW)
 } DA_STATUS_3;
 
 typedef struct
 {
-    bool iata_cterm; //!< IATA charge control: 1 = Active, 0 = Inactive
-    bool rsvd_30;    //!< Reserved. Do not use.
-    bool emshut;     //!< Emergency FET shutdown: 1 = Active, 0 = Inactive
-    bool cb;         //!< Cell balancing status: 1 = Active, 0 = Inactive
-    bool slpcc;      //!< CC measurement in SLEEP mode: 1 = Active, 0 = Inactive
-    bool slpad;      //!< ADC measurement in SLEEP mode: 1 = Active, 0 = Inactive
-    bool smblcal;    //!< Auto CC calibration
-    bool init;       //!< Initialization after full reset: 1 = Active, 0 = Inactive
-    bool sleepm;     //!< SLEEP mode triggered via command: 1 = Active, 0 = Inactive
-    bool xl;         //!< 400-kHz SMBus mode: 1 = Active, 0 = Inactive
-    bool cal_offset; //!< Calibration output (raw CC offset data)
-    bool cal;        //!< Calibration output (raw ADC and CC data)
-    bool autocalm;   //!< Auto CC Offset calibration by the MAC AutoCCOffset(): 1 = Calibration ongoing, 0 = Calibration completed
-    bool auth;       //!< Authentication in progress: 1 = Active, 0 = Inactive
-    bool led;        //!< LED Display: 1 = Display on, 0 = Display off
-    bool sdm;        //!< Shutdown triggered via command: 1 = Active, 0 = Inactive
-    bool sleep;      //!< SLEEP mode conditions met: 1 = Active, 0 = Inactive
-    bool xchg;       //!< Charging disabled: 1 = Active, 0 = Inactive
-    bool xdsg;       //!< Discharging disabled: 1 = Active, 0 = Inactive
-    bool pf;         //!< PERMANENT FAILURE mode status: 1 = Active, 0 = Inactive
-    bool ss;         //!< SAFETY status: 1 = Active, 0 = Inactive
-    bool sdv;        //!< Shutdown triggered via low battery stack voltage: 1 = Active, 0 = Inactive
-    bool sec1;       //!< SECURITY mode bit 1
-    bool sec0;       //!< SECURITY mode bit 0
-    bool btp_int;    //!< Battery trip point interrupt: 1 = Active, 0 = Inactive
-    bool rsvd_6;     //!< Reserved. Do not use.
-    bool fuse;       //!< Fuse status: 1 = Active, 0 = Inactive
-    bool pdsg;       //!< Pre-discharge FET status: 1 = Active, 0 = Inactive
-    bool pchg;       //!< Precharge FET status: 1 = Active, 0 = Inactive
-    bool chg;        //!< CHG FET status: 1 = Active, 0 = Inactive
-    bool dsg;        //!< DSG FET status: 1 = Active, 0 = Inactive
-    bool pres;       //!< System present low: 1 = Active, 0 = Inactive
-} OPERATION_STATUS;
+    uint16_t device_number;  //!< Device number
+    uint16_t version;        //!< Firmware version
+    uint16_t build_number;   //!< Build number
+    uint8_t firmware_type;   //!< Firmware type
+    uint16_t it_version;     //!< Impedance Track version
+} FIRMWARE_VERSION;
 
+/**
+ * @brief ManufacturerAccess() LifetimeDataBlock1() (0x0060), cell voltage and charge current extremes seen
+ *        over the life of the pack
+ * @note Every lifetime block is laid out in wire order without padding, see bq40z80_lifetime_fields().
+ *       The voltages of all 7 cells fill the block, unlike on the 4-cell gauges there is no room left for
+ *       the discharge and temperature extremes.
+ */
 typedef struct
 {
-    // Charging Status Flags (Bits 23–8)
-    bool rsvd_23; //!< Reserved. Do not use.
-    bool rsvd_22; //!< Reserved. Do not use.
-    bool rsvd_21; //!< Reserved. Do not use.
-    bool rsvd_20; //!< Reserved. Do not use.
-    bool nct;     //!< Near charge termination: 1 = Active, 0 = Inactive
-    bool ccc;     //!< Charging loss compensation: 1 = Active, 0 = Inactive
-    bool cvr;     //!< Charging voltage rate of change: 1 = Active, 0 = Inactive
-    bool ccr;     //!< Charging current rate of change: 1 = Active, 0 = Inactive
-    bool vct;     //!< Charge termination: 1 = Active, 0 = Inactive
-    bool mchg;    //!< Maintenance charge: 1 = Active, 0 = Inactive
-    bool su;      //!< Suspend charge: 1 = Active, 0 = Inactive
-    bool in;      //!< Charge inhibit: 1 = Active, 0 = Inactive
-    bool hv;      //!< High voltage region: 1 = Active, 0 = Inactive
-    bool mv;      //!< Mid voltage region: 1 = Active, 0 = Inactive
-    bool lv;      //!< Low voltage region: 1 = Active, 0 = Inactive
-    bool pv;      //!< Precharge voltage region: 1 = Active, 0 = Inactive
+    uint16_t cell_1_max_voltage;     //!< Cell 1 Max Voltage (mV)
+    uint16_t cell_2_max_voltage;     //!< Cell 2 Max Voltage (mV)
+    uint16_t cell_3_max_voltage;     //!< Cell 3 Max Voltage (mV)
+    uint16_t cell_4_max_voltage;     //!< Cell 4 Max Voltage (mV)
+    uint16_t cell_5_max_voltage;     //!< Cell 5 Max Voltage (mV)
+    uint16_t cell_6_max_voltage;     //!< Cell 6 Max Voltage (mV)
+    uint16_t cell_7_max_voltage;     //!< Cell 7 Max Voltage (mV)
+    uint16_t cell_1_min_voltage;     //!< Cell 1 Min Voltage (mV)
+    uint16_t cell_2_min_voltage;     //!< Cell 2 Min Voltage (mV)
+    uint16_t cell_3_min_voltage;     //!< Cell 3 Min Voltage (mV)
+    uint16_t cell_4_min_voltage;     //!< Cell 4 Min Voltage (mV)
+    uint16_t cell_5_min_voltage;     //!< Cell 5 Min Voltage (mV)
+    uint16_t cell_6_min_voltage;     //!< Cell 6 Min Voltage (mV)
+    uint16_t cell_7_min_voltage;     //!< Cell 7 Min Voltage (mV)
+    uint16_t max_delta_cell_voltage; //!< Max Delta Cell Voltage (mV)
+    int16_t max_charge_current;      //!< Max Charge Current (mA)
+} LIFETIME_DATA_1;
+
+/**
+ * @brief ManufacturerAccess() LifetimeDataBlock2() (0x0061), protection event counters
+ * @note The last_* fields hold CycleCount() at the latest event
+ */
+typedef struct
+{
+    uint16_t cov_events;      //!< No. of COV Events
+    uint16_t last_cov_event;  //!< Last COV Event
+    uint16_t cuv_events;      //!< No. of CUV Events
+    uint16_t last_cuv_event;  //!< Last CUV Event
+    uint16_t ocd1_events;     //!< No. of OCD1 Events
+    uint16_t last_ocd1_event; //!< Last OCD1 Event
+    uint16_t ocd2_events;     //!< No. of OCD2 Events
+    uint16_t last_ocd2_event; //!< Last OCD2 Event
+    uint16_t occ1_events;     //!< No. of OCC1 Events
+    uint16_t last_occ1_event; //!< Last OCC1 Event
+    uint16_t occ2_events;     //!< No. of OCC2 Events
+    uint16_t last_occ2_event; //!< Last OCC2 Event
+    uint16_t aold_events;     //!< No. of AOLD Events
+    uint16_t last_aold_event; //!< Last AOLD Event
+    uint16_t ascd_events;     //!< No. of ASCD Events
+    uint16_t last_ascd_event; //!< Last ASCD Event
+} LIFETIME_DATA_2;
+
+/**
+ * @brief ManufacturerAccess() LifetimeDataBlock3() (0x0062), protection and gauging event counters
+ * @note The last_* fields hold CycleCount() at the latest event
+ */
+typedef struct
+{
+    uint16_t ascc_events;                   //!< No. of ASCC Events
+    uint16_t last_ascc_event;               //!< Last ASCC Event
+    uint16_t otc_events;                    //!< No. of OTC Events
+    uint16_t last_otc_event;                //!< Last OTC Event
+    uint16_t otd_events;                    //!< No. of OTD Events
+    uint16_t last_otd_event;                //!< Last OTD Event
+    uint16_t otf_events;                    //!< No. of OTF Events
+    uint16_t last_otf_event;                //!< Last OTF Event
+    uint16_t valid_charge_terminations;     //!< No. Valid Charge Term
+    uint16_t last_valid_charge_termination; //!< Last Valid Charge Term
+    uint16_t qmax_updates;                  //!< No. of Qmax Updates
+    uint16_t last_qmax_update;              //!< Last Qmax Update
+    uint16_t ra_updates;                    //!< No. of Ra Updates
+    uint16_t last_ra_update;                //!< Last Ra Update
+    uint16_t ra_disables;                   //!< No. of Ra Disable
+    uint16_t last_ra_disable;               //!< Last Ra Disable
+} LIFETIME_DATA_3;
+
+/**
+ * @brief ManufacturerAccess() LifetimeDataBlock4() (0x0063), time spent in each temperature range
+ */
+typedef struct
+{
+    uint32_t total_fw_runtime; //!< Total FW Runtime (h)
+    uint32_t time_ut;          //!< Time Spent in UT, under temperature (h)
+    uint32_t time_lt;          //!< Time Spent in LT, low temperature (h)
+    uint32_t time_stl;         //!< Time Spent in STL, standard temperature low (h)
+    uint32_t time_rt;          //!< Time Spent in RT, recommended temperature (h)
+    uint32_t time_sth;         //!< Time Spent in STH, standard temperature high (h)
+    uint32_t time_ht;          //!< Time Spent in HT, high temperature (h)
+    uint32_t time_ot;          //!< Time Spent in OT, over temperature (h)
+} LIFETIME_DATA_4;
+
+/**
+ * @brief ManufacturerAccess() LifetimeDataBlock5() (0x0064), resets and cell balancing
+ */
+typedef struct
+{
+    uint8_t shutdowns;       //!< No. of Shutdowns
+    uint8_t partial_resets;  //!< No. of Partial Resets
+    uint8_t full_resets;     //!< No. of Full Resets
+    uint8_t wdt_resets;      //!< No. of WDT Resets
+    uint32_t cb_time_cell_1; //!< CB Time Cell 1, cell balancing time (s)
+    uint32_t cb_time_cell_2; //!< CB Time Cell 2, cell balancing time (s)
+    uint32_t cb_time_cell_3; //!< CB Time Cell 3, cell balancing time (s)
+    uint32_t cb_time_cell_4; //!< CB Time Cell 4, cell balancing time (s)
+    uint32_t cb_time_cell_5; //!< CB Time Cell 5, cell balancing time (s)
+    uint32_t cb_time_cell_6; //!< CB Time Cell 6, cell balancing time (s)
+    uint32_t cb_time_cell_7; //!< CB Time Cell 7, cell balancing time (s)
+} LIFETIME_DATA_5;
+
+#ifdef __cplusplus
+/**
+ * @brief Declare a flag of a packed status word
+ * @note Generates the mask constant NAME, for single-mask tests with any()/all(), and the accessor name()
+ * @param NAME Mask constant
+ * @param name Accessor
+ * @param bit Bit number in the status word
+ */
+#define BQ40Z80_FLAG(NAME, name, bit)                      \
+    static constexpr uint32_t NAME = (uint32_t)1 << (bit); \
+    constexpr bool name() const { return (this->raw & NAME) != 0; }
+
+/**
+ * @brief Mask helpers shared by every packed status word
+ */
+#define BQ40Z80_STATUS_WORD                                                             \
+    uint32_t raw; /*!< Status word as reported by the gauge, reserved bits included */ \
+    constexpr bool any(uint32_t mask) const { return (this->raw & mask) != 0; }        \
+    constexpr bool all(uint32_t mask) const { return (this->raw & mask) == mask; }
 
+/**
+ * @brief SafetyAlert() (0x50) and SafetyStatus() (0x51)
+ * @note Any safety fault: raw != 0
+ */
+typedef struct SAFETY_STATUS
+{
+    BQ40Z80_STATUS_WORD
+    BQ40Z80_FLAG(CUV, cuv, 0)      //!< Cell undervoltage
+    BQ40Z80_FLAG(COV, cov, 1)      //!< Cell overvoltage
+    BQ40Z80_FLAG(OCC1, occ1, 2)    //!< Overcurrent during charge 1
+    BQ40Z80_FLAG(OCC2, occ2, 3)    //!< Overcurrent during charge 2
+    BQ40Z80_FLAG(OCD1, ocd1, 4)    //!< Overcurrent during discharge 1
+    BQ40Z80_FLAG(OCD2, ocd2, 5)    //!< Overcurrent during discharge 2
+    BQ40Z80_FLAG(AOLD, aold, 6)    //!< Overload during discharge
+    BQ40Z80_FLAG(AOLDL, aoldl, 7)  //!< Overload during discharge latch
+    BQ40Z80_FLAG(ASCC, ascc, 8)    //!< Short circuit during charge
+    BQ40Z80_FLAG(ASCCL, asccl, 9)  //!< Short circuit during charge latch
+    BQ40Z80_FLAG(ASCD, ascd, 10)   //!< Short circuit during discharge
+    BQ40Z80_FLAG(ASCDL, ascdl, 11) //!< Short circuit during discharge latch
+    BQ40Z80_FLAG(OTC, otc, 12)     //!< Overtemperature during charge
+    BQ40Z80_FLAG(OTD, otd, 13)     //!< Overtemperature during discharge
+    BQ40Z80_FLAG(CUVC, cuvc, 14)   //!< Cell undervoltage compensated
+    BQ40Z80_FLAG(OTF, otf, 16)     //!< Overtemperature FET
+    BQ40Z80_FLAG(PTO, pto, 18)     //!< Precharge timeout
+    BQ40Z80_FLAG(CTO, cto, 20)     //!< Charge timeout
+    BQ40Z80_FLAG(OC, oc, 22)       //!< Overcharge
+    BQ40Z80_FLAG(CHGC, chgc, 23)   //!< Overcharging current
+    BQ40Z80_FLAG(CHGV, chgv, 24)   //!< Overcharging voltage
+    BQ40Z80_FLAG(PCHGC, pchgc, 25) //!< Over-precharge current
+    BQ40Z80_FLAG(UTC, utc, 26)     //!< Undertemperature during charge
+    BQ40Z80_FLAG(UTD, utd, 27)     //!< Undertemperature during discharge
+} SAFETY_STATUS;
+
+/**
+ * @brief PFAlert() (0x52) and PFStatus() (0x53)
+ */
+typedef struct PF_STATUS
+{
+    BQ40Z80_STATUS_WORD
+    BQ40Z80_FLAG(SUV, suv, 0)                    //!< Safety cell undervoltage failure
+    BQ40Z80_FLAG(SOV, sov, 1)                    //!< Safety cell overvoltage failure
+    BQ40Z80_FLAG(SOCC, socc, 2)                  //!< Safety overcurrent in charge
+    BQ40Z80_FLAG(SOCD, socd, 3)                  //!< Safety overcurrent in discharge
+    BQ40Z80_FLAG(SOT, sot, 4)                    //!< Safety overtemperature cell failure
+    BQ40Z80_FLAG(SOTF, sotf, 6)                  //!< Safety overtemperature FET failure
+    BQ40Z80_FLAG(CB, cb, 8)                      //!< Cell balancing failure
+    BQ40Z80_FLAG(IMP, imp, 9)                    //!< Cell impedance failure
+    BQ40Z80_FLAG(CD, cd, 10)                     //!< Capacity degradation failure
+    BQ40Z80_FLAG(VIMR, vimr, 11)                 //!< Voltage imbalance at rest failure
+    BQ40Z80_FLAG(VIMA, vima, 12)                 //!< Voltage imbalance while pack is active failure
+    BQ40Z80_FLAG(AFER, afer, 13)                 //!< AFE register failure
+    BQ40Z80_FLAG(AFEC, afec, 14)                 //!< AFE communication failure
+    BQ40Z80_FLAG(SECOND_LEVEL, second_level, 15) //!< Second level protector failure
+    BQ40Z80_FLAG(CFETF, cfetf, 16)               //!< Charge FET failure
+    BQ40Z80_FLAG(DFETF, dfetf, 17)               //!< Discharge FET failure
+    BQ40Z80_FLAG(FUSE, fuse, 19)                 //!< Chemical fuse failure
+    BQ40Z80_FLAG(TS1, ts1, 24)                   //!< Open thermistor TS1 failure
+    BQ40Z80_FLAG(TS2, ts2, 25)                   //!< Open thermistor TS2 failure
+    BQ40Z80_FLAG(TS3, ts3, 26)                   //!< Open thermistor TS3 failure
+    BQ40Z80_FLAG(TS4, ts4, 27)                   //!< Open thermistor TS4 failure
+    BQ40Z80_FLAG(DFW, dfw, 28)                   //!< Data flash wearout failure
+} PF_STATUS;
+
+/**
+ * @brief OperationStatus() (0x54)
+ * @note Safety or permanent failure active: any(OPERATION_STATUS::SS | OPERATION_STATUS::PF)
+ */
+typedef struct OPERATION_STATUS
+{
+    BQ40Z80_STATUS_WORD
+    BQ40Z80_FLAG(PRES, pres, 0)              //!< System present low
+    BQ40Z80_FLAG(DSG, dsg, 1)                //!< DSG FET status
+    BQ40Z80_FLAG(CHG, chg, 2)                //!< CHG FET status
+    BQ40Z80_FLAG(PCHG, pchg, 3)              //!< Precharge FET status
+    BQ40Z80_FLAG(PDSG, pdsg, 4)              //!< Pre-discharge FET status
+    BQ40Z80_FLAG(FUSE, fuse, 5)              //!< Fuse status
+    BQ40Z80_FLAG(BTP_INT, btp_int, 7)        //!< Battery trip point interrupt
+    BQ40Z80_FLAG(SEC0, sec0, 8)              //!< SECURITY mode bit 0
+    BQ40Z80_FLAG(SEC1, sec1, 9)              //!< SECURITY mode bit 1
+    BQ40Z80_FLAG(SDV, sdv, 10)               //!< Shutdown triggered via low battery stack voltage
+    BQ40Z80_FLAG(SS, ss, 11)                 //!< SAFETY status
+    BQ40Z80_FLAG(PF, pf, 12)                 //!< PERMANENT FAILURE mode status
+    BQ40Z80_FLAG(XDSG, xdsg, 13)             //!< Discharging disabled
+    BQ40Z80_FLAG(XCHG, xchg, 14)             //!< Charging disabled
+    BQ40Z80_FLAG(SLEEP, sleep, 15)           //!< SLEEP mode conditions met
+    BQ40Z80_FLAG(SDM, sdm, 16)               //!< Shutdown triggered via command
+    BQ40Z80_FLAG(LED, led, 17)               //!< LED Display on
+    BQ40Z80_FLAG(AUTH, auth, 18)             //!< Authentication in progress
+    BQ40Z80_FLAG(AUTOCALM, autocalm, 19)     //!< Auto CC Offset calibration by the MAC AutoCCOffset() ongoing
+    BQ40Z80_FLAG(CAL, cal, 20)               //!< Calibration output (raw ADC and CC data)
+    BQ40Z80_FLAG(CAL_OFFSET, cal_offset, 21) //!< Calibration output (raw CC offset data)
+    BQ40Z80_FLAG(XL, xl, 22)                 //!< 400-kHz SMBus mode
+    BQ40Z80_FLAG(SLEEPM, sleepm, 23)         //!< SLEEP mode triggered via command
+    BQ40Z80_FLAG(INIT, init, 24)             //!< Initialization after full reset
+    BQ40Z80_FLAG(SMBLCAL, smblcal, 25)       //!< Auto CC calibration
+    BQ40Z80_FLAG(SLPAD, slpad, 26)           //!< ADC measurement in SLEEP mode
+    BQ40Z80_FLAG(SLPCC, slpcc, 27)           //!< CC measurement in SLEEP mode
+    BQ40Z80_FLAG(CB, cb, 28)                 //!< Cell balancing status
+    BQ40Z80_FLAG(EMSHUT, emshut, 29)         //!< Emergency FET shutdown
+    BQ40Z80_FLAG(IATA_CTERM, iata_cterm, 31) //!< IATA charge control
+
+    /**
+     * @brief SECURITY mode [SEC1:SEC0]: 0 = Reserved, 1 = Full Access, 2 = Unsealed, 3 = Sealed
+     */
+    constexpr uint8_t security() const { return (this->raw >> 8) & 0x03; }
+} OPERATION_STATUS;
+
+/**
+ * @brief ChargingStatus() (0x55), 3 bytes on the wire
+ */
+typedef struct CHARGING_STATUS
+{
+    BQ40Z80_STATUS_WORD
     // Temperature Range Flags (Bits 7–0)
-    bool rsvd_7; //!< Reserved. Do not use.
-    bool ot;     //!< Overtemperature region: 1 = Active, 0 = Inactive
-    bool ht;     //!< High temperature region: 1 = Active, 0 = Inactive
-    bool sth;    //!< Standard temperature high region: 1 = Active, 0 = Inactive
-    bool rt;     //!< Recommended temperature region: 1 = Active, 0 = Inactive
-    bool stl;    //!< Standard temperature low region: 1 = Active, 0 = Inactive
-    bool lt;     //!< Low temperature region: 1 = Active, 0 = Inactive
-    bool ut;     //!< Undertemperature region: 1 = Active, 0 = Inactive
+    BQ40Z80_FLAG(UT, ut, 0)   //!< Undertemperature region
+    BQ40Z80_FLAG(LT, lt, 1)   //!< Low temperature region
+    BQ40Z80_FLAG(STL, stl, 2) //!< Standard temperature low region
+    BQ40Z80_FLAG(RT, rt, 3)   //!< Recommended temperature region
+    BQ40Z80_FLAG(STH, sth, 4) //!< Standard temperature high region
+    BQ40Z80_FLAG(HT, ht, 5)   //!< High temperature region
+    BQ40Z80_FLAG(OT, ot, 6)   //!< Overtemperature region
+
+    // Charging Status Flags (Bits 23–8)
+    BQ40Z80_FLAG(PV, pv, 8)      //!< Precharge voltage region
+    BQ40Z80_FLAG(LV, lv, 9)      //!< Low voltage region
+    BQ40Z80_FLAG(MV, mv, 10)     //!< Mid voltage region
+    BQ40Z80_FLAG(HV, hv, 11)     //!< High voltage region
+    BQ40Z80_FLAG(IN, in, 12)     //!< Charge inhibit
+    BQ40Z80_FLAG(SU, su, 13)     //!< Suspend charge
+    BQ40Z80_FLAG(MCHG, mchg, 14) //!< Maintenance charge
+    BQ40Z80_FLAG(VCT, vct, 15)   //!< Charge termination
+    BQ40Z80_FLAG(CCR, ccr, 16)   //!< Charging current rate of change
+    BQ40Z80_FLAG(CVR, cvr, 17)   //!< Charging voltage rate of change
+    BQ40Z80_FLAG(CCC, ccc, 18)   //!< Charging loss compensation
+    BQ40Z80_FLAG(NCT, nct, 19)   //!< Near charge termination
 } CHARGING_STATUS;
 
+/**
+ * @brief GaugingStatus() (0x56)
+ */
+typedef struct GAUGING_STATUS
+{
+    BQ40Z80_STATUS_WORD
+    BQ40Z80_FLAG(FD, fd, 0)            //!< Fully discharged detected
+    BQ40Z80_FLAG(FC, fc, 1)            //!< Fully charged detected
+    BQ40Z80_FLAG(TD, td, 2)            //!< Terminate discharge
+    BQ40Z80_FLAG(TC, tc, 3)            //!< Terminate charge
+    BQ40Z80_FLAG(BAL_EN, bal_en, 4)    //!< Cell balancing possible
+    BQ40Z80_FLAG(EDV, edv, 5)          //!< End-of-discharge termination voltage
+    BQ40Z80_FLAG(DSG, dsg, 6)          //!< Discharge/relax
+    BQ40Z80_FLAG(CF, cf, 7)            //!< Condition flag
+    BQ40Z80_FLAG(REST, rest, 8)        //!< Rest
+    BQ40Z80_FLAG(R_DIS, r_dis, 10)     //!< Resistance updates disabled
+    BQ40Z80_FLAG(VOK, vok, 11)         //!< Voltage OK for QMax update
+    BQ40Z80_FLAG(QEN, qen, 12)         //!< Impedance Track gauging enabled
+    BQ40Z80_FLAG(SLPQMAX, slpqmax, 13) //!< QMax update in SLEEP mode
+    BQ40Z80_FLAG(NSFM, nsfm, 15)       //!< Negative scale factor mode
+    BQ40Z80_FLAG(VDQ, vdq, 16)         //!< Discharge qualified for learning
+    BQ40Z80_FLAG(QMAX, qmax, 17)       //!< QMax updated
+    BQ40Z80_FLAG(RX, rx, 18)           //!< Resistance updated
+    BQ40Z80_FLAG(LDMD, ldmd, 19)       //!< LOAD mode
+    BQ40Z80_FLAG(OCVFR, ocvfr, 20)     //!< Open circuit voltage in flat region
+} GAUGING_STATUS;
+
+/**
+ * @brief ManufacturingStatus() (0x57), 2 bytes on the wire
+ */
+typedef struct MANUFACTURING_STATUS
+{
+    BQ40Z80_STATUS_WORD
+    BQ40Z80_FLAG(PCHG_TEST, pchg_test, 0) //!< Precharge FET test
+    BQ40Z80_FLAG(CHG_TEST, chg_test, 1)   //!< Charge FET test
+    BQ40Z80_FLAG(DSG_TEST, dsg_test, 2)   //!< Discharge FET test
+    BQ40Z80_FLAG(GAUGE_EN, gauge_en, 3)   //!< Gas gauging enabled
+    BQ40Z80_FLAG(FET_EN, fet_en, 4)       //!< FET action enabled
+    BQ40Z80_FLAG(LF_EN, lf_en, 5)         //!< Lifetime data collection enabled
+    BQ40Z80_FLAG(PF_EN, pf_en, 6)         //!< Permanent failure enabled
+    BQ40Z80_FLAG(BBR_EN, bbr_en, 7)       //!< Black box recorder enabled
+    BQ40Z80_FLAG(FUSE_EN, fuse_en, 8)     //!< Fuse action enabled
+    BQ40Z80_FLAG(LED_EN, led_en, 9)       //!< LED display enabled
+    BQ40Z80_FLAG(CAL_EN, cal_en, 15)      //!< Calibration mode enabled
+} MANUFACTURING_STATUS;
+
+#undef BQ40Z80_FLAG
+#undef BQ40Z80_STATUS_WORD
+#endif
+
 #endif
\ No newline at end of file
@@ -0,0 +1,156 @@
+#ifndef __BQ40Z80_REGMAP_H
+#define __BQ40Z80_REGMAP_H
+
+#include "bq40z80_port.h"
+#include "bq40z80_sbs.h"
+#include "bq40z80_mfa.h"
+#include "bq40z80_registers.h"
+
+typedef enum
+{
+    BQ40Z80_REG_SBS_WORD = 0, //!< SMBus read word
+    BQ40Z80_REG_SBS_BLOCK,    //!< SMBus read block
+    BQ40Z80_REG_MFA,          //!< ManufacturerBlockAccess() command, read back from ManufacturerData()
+} bq40z80_reg_kind_t;
+
+/**
+ * @brief Value types of the scalar registers, one per quantity
+ * @note One member each, so the layout is the wire word while the types don't convert into one another
+ */
+typedef struct
+{
+    uint16_t dk; //!< 0.1 K
+} BQ40Z80_TEMPERATURE;
+
+typedef struct
+{
+    uint16_t mv; //!< mV
+} BQ40Z80_VOLTAGE;
+
+typedef struct
+{
+    int16_t ma; //!< mA, negative while discharging
+} BQ40Z80_CURRENT;
+
+typedef struct
+{
+    int32_t ma; //!< mA, negative while discharging
+} BQ40Z80_CURRENT_LONG;
+
+typedef struct
+{
+    uint16_t ma; //!< mA requested from the charger
+} BQ40Z80_CHARGING_CURRENT;
+
+typedef struct
+{
+    uint16_t mah; //!< mAh, cWh while BatteryMode() CAPM is set
+} BQ40Z80_CAPACITY;
+
+typedef struct
+{
+    uint16_t percent; //!< %
+} BQ40Z80_PERCENT;
+
+typedef struct
+{
+    uint16_t min; //!< Minutes, 65535 when not applicable
+} BQ40Z80_MINUTES;
+
+#ifdef __cplusplus
+extern "C++"
+{
+/**
+ * @brief Declare a register descriptor
+ * @note Each register is its own type that carries its command, width and value type, so a read can't
+ *       decode a register into a value of another size or layout. Scalar registers carry the quantity type
+ *       of what they measure, a read into a BQ40Z80_TEMPERATURE through BQ40Z80_REG_Voltage does not
+ *       compile. Registers of the same quantity, e.g. the capacities, stay interchangeable, as do the raw
+ *       uint16_t words. The value type mirrors the little-endian wire layout.
+ * @param name Descriptor type
+ * @param kind_ bq40z80_reg_kind_t
+ * @param command_ SBS or MFA command
+ * @param type_ Value type, sizeof(type_) bytes on the wire
+ * @param word_ Width of the little-endian words the value is made of, swapped on big-endian targets
+ * @param signed_ Raw value is two's complement
+ * @param scale_ Factor from the raw value to 'unit_'
+ * @param unit_ Unit after scaling
+ */
+#define BQ40Z80_REGISTER(name, kind_, command_, type_, word_, signed_, scale_, unit_) \
+    struct name                                                                       \
+    {                                                                                 \
+        typedef type_ type;                                                           \
+        static constexpr uint8_t kind = kind_;                                        \
+        static constexpr uint16_t command = command_;                                 \
+        static constexpr uint8_t len = sizeof(type_);                                 \
+        static constexpr uint8_t word = word_;                                        \
+        static constexpr bool is_signed = signed_;                                    \
+        static constexpr float scale = scale_;                                        \
+        static constexpr const char *unit = unit_;                                    \
+    }
+
+    BQ40Z80_REGISTER(BQ40Z80_REG_BatteryMode, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_BatteryMode, uint16_t, 2, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_AtRate, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_AtRate, BQ40Z80_CURRENT, 2, true, 0.001f, "A");
+    BQ40Z80_REGISTER(BQ40Z80_REG_Temperature, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_Temperature, BQ40Z80_TEMPERATURE, 2, false, 0.1f, "K");
+    BQ40Z80_REGISTER(BQ40Z80_REG_Voltage, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_Voltage, BQ40Z80_VOLTAGE, 2, false, 0.001f, "V");
+    BQ40Z80_REGISTER(BQ40Z80_REG_Current, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_Current, BQ40Z80_CURRENT, 2, true, 0.001f, "A");
+    BQ40Z80_REGISTER(BQ40Z80_REG_AverageCurrent, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_AverageCurrent, BQ40Z80_CURRENT, 2, true, 0.001f, "A");
+    BQ40Z80_REGISTER(BQ40Z80_REG_MaxError, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_MaxError, BQ40Z80_PERCENT, 2, false, 1.0f, "%");
+    BQ40Z80_REGISTER(BQ40Z80_REG_RelativeStateOfCharge, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_RelativeStateOfCharge, BQ40Z80_PERCENT, 2, false, 1.0f, "%");
+    BQ40Z80_REGISTER(BQ40Z80_REG_AbsoluteStateOfCharge, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_AbsoluteStateOfCharge, BQ40Z80_PERCENT, 2, false, 1.0f, "%");
+    BQ40Z80_REGISTER(BQ40Z80_REG_RemainingCapacity, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_RemainingCapacity, BQ40Z80_CAPACITY, 2, false, 1.0f, "mAh/cWh");
+    BQ40Z80_REGISTER(BQ40Z80_REG_FullChargeCapacity, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_FullChargeCapacity, BQ40Z80_CAPACITY, 2, false, 1.0f, "mAh/cWh");
+    BQ40Z80_REGISTER(BQ40Z80_REG_RunTimeToEmpty, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_RunTimeToEmpty, BQ40Z80_MINUTES, 2, false, 1.0f, "min");
+    BQ40Z80_REGISTER(BQ40Z80_REG_AverageTimeToEmpty, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_AverageTimeToEmpty, BQ40Z80_MINUTES, 2, false, 1.0f, "min");
+    BQ40Z80_REGISTER(BQ40Z80_REG_AverageTimeToFull, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_AverageTimeToFull, BQ40Z80_MINUTES, 2, false, 1.0f, "min");
+    BQ40Z80_REGISTER(BQ40Z80_REG_ChargingCurrent, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_ChargingCurrent, BQ40Z80_CHARGING_CURRENT, 2, false, 0.001f, "A");
+    BQ40Z80_REGISTER(BQ40Z80_REG_ChargingVoltage, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_ChargingVoltage, BQ40Z80_VOLTAGE, 2, false, 0.001f, "V");
+    BQ40Z80_REGISTER(BQ40Z80_REG_BatteryStatus, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_BatteryStatus, uint16_t, 2, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_CycleCount, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_CycleCount, uint16_t, 2, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_DesignCapacity, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_DesignCapacity, BQ40Z80_CAPACITY, 2, false, 1.0f, "mAh/cWh");
+    BQ40Z80_REGISTER(BQ40Z80_REG_DesignVoltage, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_DesignVoltage, BQ40Z80_VOLTAGE, 2, false, 0.001f, "V");
+    BQ40Z80_REGISTER(BQ40Z80_REG_SpecificationInfo, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_SpecificationInfo, uint16_t, 2, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_ManufacturerDate, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_ManufacturerDate, uint16_t, 2, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_SerialNumber, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_SerialNumber, uint16_t, 2, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_CellVoltage4, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_CellVoltage4, BQ40Z80_VOLTAGE, 2, false, 0.001f, "V");
+    BQ40Z80_REGISTER(BQ40Z80_REG_CellVoltage5, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_CellVoltage5, BQ40Z80_VOLTAGE, 2, false, 0.001f, "V");
+    BQ40Z80_REGISTER(BQ40Z80_REG_CellVoltage6, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_CellVoltage6, BQ40Z80_VOLTAGE, 2, false, 0.001f, "V");
+    BQ40Z80_REGISTER(BQ40Z80_REG_CellVoltage7, BQ40Z80_REG_SBS_WORD, BQ40Z80_SBS_CellVoltage7, BQ40Z80_VOLTAGE, 2, false, 0.001f, "V");
+    BQ40Z80_REGISTER(BQ40Z80_REG_SafetyAlert, BQ40Z80_REG_SBS_BLOCK, BQ40Z80_SBS_SafetyAlert, SAFETY_STATUS, 4, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_SafetyStatus, BQ40Z80_REG_SBS_BLOCK, BQ40Z80_SBS_SafetyStatus, SAFETY_STATUS, 4, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_PFAlert, BQ40Z80_REG_SBS_BLOCK, BQ40Z80_SBS_PFAlert, PF_STATUS, 4, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_PFStatus, BQ40Z80_REG_SBS_BLOCK, BQ40Z80_SBS_PFStatus, PF_STATUS, 4, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_OperationStatus, BQ40Z80_REG_SBS_BLOCK, BQ40Z80_SBS_OperationStatus, OPERATION_STATUS, 4, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_GaugingStatus, BQ40Z80_REG_SBS_BLOCK, BQ40Z80_SBS_GaugingStatus, GAUGING_STATUS, 4, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_CurrentLong, BQ40Z80_REG_SBS_BLOCK, BQ40Z80_SBS_CurrentLong, BQ40Z80_CURRENT_LONG, 4, true, 0.001f, "A");
+    BQ40Z80_REGISTER(BQ40Z80_REG_DeviceType, BQ40Z80_REG_MFA, BQ40Z80_MFA_DEVICE_TYPE, uint16_t, 2, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_ChemicalID, BQ40Z80_REG_MFA, BQ40Z80_MFA_CHEMICAL_ID, uint16_t, 2, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_DAStatus1, BQ40Z80_REG_MFA, BQ40Z80_MFA_DA_STATUS_1, DA_STATUS_1, 2, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_DAStatus2, BQ40Z80_REG_MFA, BQ40Z80_MFA_DA_STATUS_2, DA_STATUS_2, 2, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_DAStatus3, BQ40Z80_REG_MFA, BQ40Z80_MFA_DA_STATUS_3, DA_STATUS_3, 2, false, 1.0f, "");
+    BQ40Z80_REGISTER(BQ40Z80_REG_CBStatus, BQ40Z80_REG_MFA, BQ40Z80_MFA_CB_STATUS, uint16_t, 2, false, 1.0f, "");
+
+    /**
+     * @brief Decode a register straight from the receive buffer
+     * @note A single memcpy on little-endian targets, the layout of REG::type is the wire layout
+     * @param val Value to fill
+     * @param buf Received bytes, REG::len of them
+     */
+    template <typename REG>
+    static inline void bq40z80_decode(typename REG::type *val, const uint8_t *buf)
+    {
+        static_assert(sizeof(typename REG::type) == REG::len, "register type doesn't match its wire length");
+        static_assert(REG::len % REG::word == 0, "register length isn't a multiple of its word width");
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        uint8_t swapped[REG::len];
+        for (uint8_t i = 0; i < REG::len; i++)
+            swapped[i] = buf[i - i % REG::word + REG::word - 1 - i % REG::word];
+        memcpy(val, swapped, REG::len);
+#else
+        memcpy(val, buf, REG::len);
+#endif
+    }
+}
+#endif
+
+#endif
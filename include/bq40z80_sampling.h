@@ -0,0 +1,45 @@
+#ifndef __BQ40Z80_SAMPLING_H
+#define __BQ40Z80_SAMPLING_H
+
+#include "bq40z80_port.h"
+
+#define BQ40Z80_SAMPLING_ERRORS_MAX 8 /*!< Consecutive failed reads that end a sampling run */
+
+/**
+ * @brief One current sample of BQ40Z80::sample_current()
+ */
+typedef struct
+{
+    int64_t timestamp_us; //!< bq40z80_time_us() halfway through the read
+    int32_t current_ma;   //!< Positive while charging
+} BQ40Z80_CURRENT_SAMPLE;
+
+/**
+ * @brief Pacing of BQ40Z80::sample_current()
+ */
+typedef struct
+{
+    uint32_t interval_us;   //!< Spacing of the samples on a fixed grid, 0 reads back to back
+    uint16_t voltage_every; //!< Samples between two Voltage() reads for the energy, 0 reads it once before the run
+} BQ40Z80_SAMPLING_OPTIONS;
+
+/**
+ * @brief Outcome of BQ40Z80::sample_current()
+ */
+typedef struct
+{
+    bool current_long;        //!< Samples come from CurrentLong(), from Current() otherwise
+    uint32_t samples;         //!< Samples stored
+    uint32_t errors;          //!< Failed reads, skipped without retry to keep the spacing
+    uint32_t elapsed_us;      //!< From the first to the last sample
+    uint32_t rate_hz;         //!< Achieved sample rate
+    uint32_t interval_min_us; //!< Shortest spacing of two samples
+    uint32_t interval_max_us; //!< Longest spacing of two samples
+    uint32_t jitter_us;       //!< Standard deviation of the spacing
+    uint32_t overhead_ns;     //!< CPU time per read outside the bus transfer and the pacing sleep
+    int64_t charge_nc;        //!< Trapezoidal integral of the current, nC = mA * us
+    int64_t energy_nj;        //!< Integral of the current times the last Voltage()
+    uint16_t voltage_mv;      //!< Last Voltage() used for the energy
+} BQ40Z80_SAMPLING_REPORT;
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef __BQ40Z80_SCHEDULER_H
+#define __BQ40Z80_SCHEDULER_H
+
+#include "bq40z80.h"
+
+#define BQ40Z80_SCHEDULER_WINDOW_MS 5000 /*!< Bus utilisation is measured and the budget enforced over this window */
+#define BQ40Z80_SCHEDULER_STRETCH_MAX 64 /*!< Largest factor the budget may stretch the periods by */
+
+/**
+ * @brief State of the pack as seen by the scheduler
+ */
+typedef enum
+{
+    BQ40Z80_SCHED_ACTIVE = 0, //!< High current or charge near termination, fastest periods
+    BQ40Z80_SCHED_IDLE,       //!< Awake, low current
+    BQ40Z80_SCHED_SLEEP,      //!< OperationStatus()[SLEEP] set
+    BQ40Z80_SCHED_STATES
+} bq40z80_sched_state_t;
+
+/**
+ * @brief Polling policy
+ * @note A field is read every period_ms[state], times slow_factor for slow_fields. static_fields are read
+ *       every static_ms whatever the state. The budget stretches every period alike when exceeded.
+ */
+typedef struct
+{
+    uint32_t period_ms[BQ40Z80_SCHED_STATES]; //!< Period of the regular fields in each state
+    uint32_t static_ms;                       //!< Period of static_fields
+    uint8_t slow_factor;                      //!< Multiplier of the period of slow_fields
+    bq40z80_field_mask_t slow_fields;         //!< Fields that move slowly, e.g. temperatures
+    bq40z80_field_mask_t static_fields;       //!< Fields that barely change, e.g. FullChargeCapacity()
+    uint16_t active_current_ma;               //!< |Current()| from which the pack counts as active
+    uint8_t budget_pct;                       //!< Largest share of bus time spent polling, 0 for no limit
+} BQ40Z80_SCHEDULE;
+
+/**
+ * @brief Achieved polling of a scheduler
+ */
+typedef struct
+{
+    uint8_t state;                          //!< bq40z80_sched_state_t
+    uint16_t utilisation_permille;          //!< Share of bus time over the last window
+    uint16_t stretch_pct;                   //!< Factor applied to the periods by the budget, 100 when within budget
+    uint32_t reads[BQ40Z80_FIELD_COUNT];    //!< Reads of each field since construction
+    uint32_t rate_mhz[BQ40Z80_FIELD_COUNT]; //!< Achieved read rate of each field (mHz), 0 before the second read
+} BQ40Z80_SCHEDULER_STATS;
+
+/**
+ * @brief Fill a policy with defaults
+ * @note 250 ms active, 2 s idle, 20 s asleep, temperatures and capacities four times slower,
+ *       FullChargeCapacity() and ManufacturingStatus() every 10 minutes, 500 mA, 20 % of the bus
+ * @param schedule Policy to fill
+ */
+void bq40z80_schedule_default(BQ40Z80_SCHEDULE *schedule);
+
+/**
+ * @brief Per-field polling periods that follow the state of the pack
+ * @note The scheduler never touches the bus. due() tells which fields to read, update() takes the result
+ *       and the bus time it cost. Current(), OperationStatus() and ChargingStatus() set the state, they are
+ *       added to every due() mask at the regular period. Attach it to a BQ40Z80_POLLER with set_scheduler(),
+ *       whose period becomes the tick, or drive it by hand with BQ40Z80_CALL::fresh set on the reads, else
+ *       the cache TTL bounds the periods from below.
+ */
+class BQ40Z80_SCHEDULER
+{
+public:
+    /**
+     * @param schedule Polling policy, copied
+     */
+    BQ40Z80_SCHEDULER(const BQ40Z80_SCHEDULE *schedule);
+
+    ~BQ40Z80_SCHEDULER();
+
+    /**
+     * @brief Fields to read now
+     * @param fields Fields of interest
+     * @param now_us Present time on the bq40z80_time_us() clock
+     * @return Due fields, 0 if nothing is due
+     */
+    bq40z80_field_mask_t due(bq40z80_field_mask_t fields, int64_t now_us);
+
+    /**
+     * @brief Account for a read
+     * @param now_us Start of the read
+     * @param bus_us Time spent on the bus, e.g. BQ40Z80_CALL::elapsed_us
+     * @param data Fields read, see BQ40Z80_TELEMETRY::valid
+     */
+    void update(int64_t now_us, uint32_t bus_us, const BQ40Z80_TELEMETRY *data);
+
+    /**
+     * @brief Read the achieved polling
+     * @param stats Buffer to store the counters
+     */
+    void get_stats(BQ40Z80_SCHEDULER_STATS *stats);
+
+private:
+    BQ40Z80_SCHEDULE schedule;
+    bq40z80_mutex_t lock;
+    uint8_t state;
+    float stretch;
+    int64_t window_start_us;
+    uint64_t window_bus_us;
+    uint16_t utilisation_permille;
+    int16_t current;  //!< Last Current()
+    bool sleeping;    //!< Last OperationStatus()[SLEEP]
+    bool terminating; //!< Last ChargingStatus()[NCT] or [VCT]
+    int64_t last_read_us[BQ40Z80_FIELD_COUNT];
+    uint32_t interval_ms[BQ40Z80_FIELD_COUNT]; //!< Smoothed time between two reads
+    uint32_t reads[BQ40Z80_FIELD_COUNT];
+
+    uint32_t period_ms(uint8_t field);
+};
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef __BQ40Z80_SIM_H
+#define __BQ40Z80_SIM_H
+
+#if defined(BQ40Z80_TRANSPORT_LINUX)
+
+#include "bq40z80.h"
+
+#define BQ40Z80_SIM_ADAPTERS 256                        /*!< Simulated /dev/i2c-N adapters, N from 0 to BQ40Z80_SIM_ADAPTERS - 1 */
+#define BQ40Z80_SIM_MUX_ADDRESS BQ40Z80_BUS_MUX_ADDRESS /*!< Address of the simulated TCA9548-style mux on every adapter */
+#define BQ40Z80_SIM_FD_BASE 0x4000                      /*!< File descriptors handed out for adapter N are BQ40Z80_SIM_FD_BASE + N */
+#define BQ40Z80_SIM_CLOCK_FD_BASE 0x4800                /*!< Same for the device tree clock-frequency of adapter N */
+
+/**
+ * @brief Bus timing and fault model of the simulator
+ * @note Applied to every transaction of every adapter. The wire time is counted in any case, it is only
+ *       spent for real when 'realtime' is set, with the adapter held like a physical bus.
+ */
+typedef struct
+{
+    uint32_t freq_hz;           //!< SCL clock the wire time is computed at, also the adapter clock in sysfs
+    uint32_t stretch_us;        //!< Clock stretching the gauge adds to every transaction
+    uint32_t stretch_jitter_us; //!< Random extra stretching, uniform from 0 to this value
+    uint32_t auth_us;           //!< Time a gauge computes an Authenticate() response, OperationStatus()[AUTH] is set meanwhile
+    uint32_t nack_ppm;          //!< Transactions NACKed, per million
+    uint32_t time_scale;        //!< Pack model time runs this many times faster than the clock, 0 counts as 1
+    uint32_t seed;              //!< Seed of the fault and jitter generator, the same seed replays the same faults
+    bool realtime;              //!< Sleep for the wire time and stretching, a stretch past I2C_TIMEOUT fails with ETIMEDOUT
+} BQ40Z80_SIM_TIMING;
+
+/**
+ * @brief Electrical model of one simulated pack
+ */
+typedef struct
+{
+    uint8_t cells;                //!< Cells in series, 1 to 7
+    uint16_t design_capacity_mah; //!< DesignCapacity(), also the full charge capacity
+    uint8_t soc_pct;              //!< State of charge at start
+    uint16_t resistance_mohm;     //!< Internal resistance of each cell
+    uint16_t ambient_dk;          //!< Ambient temperature (0.1 K)
+    uint16_t serial_number;       //!< SerialNumber(), also skews the cell voltages apart
+} BQ40Z80_SIM_PACK;
+
+/**
+ * @brief Traffic seen by the simulator
+ */
+typedef struct
+{
+    uint64_t transactions; //!< I2C_RDWR calls handled
+    uint64_t rejected;     //!< I2C_RDWR calls refused with EINVAL before reaching the bus, like i2c-dev does
+    uint64_t nacks;        //!< Transactions failed by the NACK model or for an absent device
+    uint64_t timeouts;     //!< Transactions failed by stretching past I2C_TIMEOUT
+    uint64_t pec_errors;   //!< Writes whose PEC didn't match, NACKed
+    uint64_t wire_time_us; //!< Wire time plus stretching of every transaction
+} BQ40Z80_SIM_COUNTERS;
+
+struct BQ40Z80_SIM_GAUGE;
+struct BQ40Z80_SIM_ADAPTER;
+
+/**
+ * @brief In-process bq40z80 behind the i2c-dev system calls
+ * @note Installs itself with bq40z80_linux_set_io(), so the unchanged driver talks to it through
+ *       /dev/i2c-N paths. Each adapter carries one gauge at 0x0b wired straight to the bus and one per
+ *       channel of a mux at BQ40Z80_SIM_MUX_ADDRESS, as BQ40Z80_BUS expects. The gauges answer the SBS
+ *       commands and the ManufacturerAccess() flow through ManufacturerBlockAccess() and
+ *       ManufacturerData(), data flash included, from a coulomb-counting pack model: linear OCV curve,
+ *       IR drop, I²R heating, status flags following the state of charge. Values are plausible, not
+ *       those of the Impedance Track algorithm. Adapters run in parallel, transactions on one adapter are
+ *       serialised. Only one simulator may exist at a time.
+ */
+class BQ40Z80_SIM
+{
+public:
+    /**
+     * @param timing Bus timing and fault model, copied
+     */
+    BQ40Z80_SIM(const BQ40Z80_SIM_TIMING *timing);
+
+    /**
+     * @brief Restore the libc system calls and drop every pack
+     */
+    ~BQ40Z80_SIM();
+
+    /**
+     * @brief Fill a timing model with defaults
+     * @note 100 kHz, 50 us stretching, 250 ms per authentication, no faults, real time off
+     * @param timing Model to fill
+     */
+    static void default_timing(BQ40Z80_SIM_TIMING *timing);
+
+    /**
+     * @brief Fill a pack model with defaults
+     * @note 4 cells, 3000 mAh, 80 %, 30 mOhm, 25 °C
+     * @param pack Model to fill
+     */
+    static void default_pack(BQ40Z80_SIM_PACK *pack);
+
+    /**
+     * @brief Plug a pack in
+     * @param adapter Adapter number, the N of /dev/i2c-N
+     * @param mux_channel Mux channel, BQ40Z80_BUS_NO_MUX for a gauge wired straight to the bus
+     * @param pack Model of the pack, copied
+     * @return ESP_OK, ESP_ERR_INVALID_ARG or ESP_ERR_INVALID_STATE if the slot is taken
+     */
+    esp_err_t add_pack(uint8_t adapter, uint8_t mux_channel, const BQ40Z80_SIM_PACK *pack);
+
+    /**
+     * @brief Set the current flowing through a pack
+     * @param adapter Adapter number
+     * @param mux_channel Mux channel or BQ40Z80_BUS_NO_MUX
+     * @param current_ma Current, positive while charging (mA)
+     * @return ESP_OK or ESP_ERR_NOT_FOUND
+     */
+    esp_err_t set_current(uint8_t adapter, uint8_t mux_channel, int16_t current_ma);
+
+    /**
+     * @brief Change the authentication key of a pack, BQ40Z80_AUTH_DEFAULT_KEY until then
+     * @param adapter Adapter number
+     * @param mux_channel Mux channel or BQ40Z80_BUS_NO_MUX
+     * @param key BQ40Z80_AUTH_KEY_LEN bytes
+     * @return ESP_OK or ESP_ERR_NOT_FOUND
+     */
+    esp_err_t set_auth_key(uint8_t adapter, uint8_t mux_channel, const uint8_t *key);
+
+    /**
+     * @brief Read the traffic counters of every adapter
+     * @param counters Buffer to store the counters
+     */
+    void get_counters(BQ40Z80_SIM_COUNTERS *counters);
+
+    /**
+     * @brief Run an I2C_RDWR request on an adapter
+     * @note The messages go through the checks of i2c-dev first. Like the kernel, the length an I2C_M_RECV_LEN
+     *       read is extended by stays on the kernel side, the caller's len is left as is.
+     * @param adapter Adapter number
+     * @param msgs Messages, buffers are filled by the reads
+     * @param n_msgs Number of messages
+     * @return 0 or the errno the kernel would set
+     */
+    int rdwr(uint8_t adapter, struct i2c_msg *msgs, uint32_t n_msgs);
+
+private:
+    BQ40Z80_SIM_TIMING timing;
+    BQ40Z80_SIM_ADAPTER *adapters[BQ40Z80_SIM_ADAPTERS]; //!< Created by the first open() or add_pack()
+    bq40z80_mutex_t lock;                                //!< Guards 'adapters'
+
+    BQ40Z80_SIM_ADAPTER *adapter(uint8_t index, bool create);
+    int transfer(BQ40Z80_SIM_ADAPTER *adapter, struct i2c_msg *msgs, uint32_t n_msgs);
+    int gauge_transfer(BQ40Z80_SIM_ADAPTER *adapter, BQ40Z80_SIM_GAUGE *pack, struct i2c_msg *msgs, uint16_t *len, uint32_t n_msgs);
+
+    static int sim_open(const char *path, int flags);
+    static int sim_ioctl(int fd, unsigned long request, void *arg);
+    static int sim_close(int fd);
+    static int sim_read(int fd, void *buf, size_t len);
+};
+
+#endif
+
+#endif
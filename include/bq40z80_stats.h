@@ -0,0 +1,96 @@
+#ifndef __BQ40Z80_STATS_H
+#define __BQ40Z80_STATS_H
+
+#include "bq40z80_port.h"
+
+#ifndef BQ40Z80_STATS_ENABLE
+#define BQ40Z80_STATS_ENABLE 1 /*!< Set to 0 to compile the bus counters out */
+#endif
+
+#ifndef BQ40Z80_STATS_MAX_COMMANDS
+#define BQ40Z80_STATS_MAX_COMMANDS 32 /*!< Distinct commands tracked per device, must be a power of two */
+#endif
+
+#define BQ40Z80_STATS_LATENCY_BUCKETS 10     /*!< Latency histogram buckets */
+#define BQ40Z80_STATS_LATENCY_FIRST_US 128   /*!< Upper bound of the first bucket, each next bucket doubles it */
+
+typedef enum
+{
+    BQ40Z80_STATS_KIND_NONE = 0, //!< Unused slot
+    BQ40Z80_STATS_KIND_SBS,      //!< SBS command, keyed by the 8-bit command
+    BQ40Z80_STATS_KIND_MFA,      //!< ManufacturerAccess command, keyed by the 16-bit command
+} bq40z80_stats_kind_t;
+
+/**
+ * @brief Bus counters of one SBS or MFA command
+ */
+typedef struct
+{
+    uint8_t kind;                                          //!< bq40z80_stats_kind_t
+    uint16_t command;                                      //!< SBS or MFA command
+    uint32_t transactions;                                 //!< Calls, successful or not
+    uint32_t errors;                                       //!< Calls that returned an error
+    uint32_t retries;                                      //!< Extra attempts made on top of the first one
+    uint64_t bytes;                                        //!< Bytes on the wire, including address bytes
+    uint64_t wire_time_us;                                 //!< Estimated time on the wire at the bus clock
+    uint64_t clocks;                                       //!< SCL clocks on the wire, gives the wire time at any clock
+    uint64_t latency_total_us;                             //!< Measured call latency, sum
+    uint32_t latency_max_us;                               //!< Measured call latency, worst case
+    uint32_t latency_hist[BQ40Z80_STATS_LATENCY_BUCKETS]; //!< Bucket i counts latencies below 128 us << i, the last one everything above
+} BQ40Z80_CMD_STATS;
+
+/**
+ * @brief Snapshot of the bus counters of a device
+ * @note Slots are indexed by a hash of the command, skip the ones whose kind is BQ40Z80_STATS_KIND_NONE
+ */
+typedef struct
+{
+    uint32_t dropped;                                       //!< Transactions not recorded because the table was full
+    BQ40Z80_CMD_STATS commands[BQ40Z80_STATS_MAX_COMMANDS]; //!< Per-command counters
+} BQ40Z80_STATS;
+
+/**
+ * @brief Estimate the wire time of a transaction
+ * @param bytes Bytes on the wire, including address bytes
+ * @param conditions Number of START, repeated START and STOP conditions
+ * @param freq_hz SCL frequency
+ * @return Time in microseconds, 9 clocks per byte and one per condition
+ */
+static inline uint32_t bq40z80_wire_time_us(uint32_t bytes, uint32_t conditions, uint32_t freq_hz)
+{
+    return (uint32_t)(((uint64_t)(bytes * 9 + conditions) * 1000000 + freq_hz - 1) / freq_hz);
+}
+
+/**
+ * @brief Convert SCL clocks to time at a given bus clock
+ * @note What-if estimate for BQ40Z80_CMD_STATS::clocks or BQ40Z80_CALL::clocks, e.g. at 50, 100 or 400 kHz
+ * @param clocks SCL clocks
+ * @param freq_hz SCL frequency
+ * @return Time in microseconds
+ */
+static inline uint64_t bq40z80_clocks_to_us(uint64_t clocks, uint32_t freq_hz)
+{
+    return (clocks * 1000000 + freq_hz - 1) / freq_hz;
+}
+
+/**
+ * @brief Write the bus counters as JSON Lines, one object per command
+ * @note Each line holds kind, command, transactions, errors, retries, bytes, clocks, the wire time at
+ *       50, 100 and 400 kHz, and the mean and worst measured latency. A last line carries 'dropped'.
+ *       Meant for regression tracking, diff two exports of the same workload.
+ * @param stats Counters from BQ40Z80::get_stats()
+ * @param buf Output buffer, may be NULL to size it
+ * @param len Size of buf
+ * @return Length of the full output without the terminating null, like snprintf()
+ */
+size_t bq40z80_stats_export(const BQ40Z80_STATS *stats, char *buf, size_t len);
+
+/**
+ * @brief Integer square root, rounded down
+ * @note Turns the variances of the sampling and cell reports into standard deviations without floating point
+ * @param val Radicand
+ * @return floor(sqrt(val))
+ */
+uint32_t bq40z80_isqrt(uint64_t val);
+
+#endif